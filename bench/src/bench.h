@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <json.hpp>
+
+using nlohmann::json;
+
+namespace bench {
+    // Number of heap allocations done through operator new since startup
+    uint64_t allocations();
+
+    // Print the result of a single benchmark run as one JSON object per line
+    void report(const std::string& suite, const std::string& name, json params, uint64_t samples, double seconds, uint64_t allocs);
+
+    // Benchmark suites
+    void streams(int durationMs);
+    void fir(int durationMs);
+    void blocks(int durationMs);
+    void convert(int durationMs);
+    void codec(int durationMs);
+}
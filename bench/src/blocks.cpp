@@ -0,0 +1,209 @@
+#include <chrono>
+#include <math.h>
+#include <dsp/filter/decimating_fir.h>
+#include <dsp/multirate/power_decimator.h>
+#include <dsp/multirate/polyphase_resampler.h>
+#include <dsp/channel/frequency_xlator.h>
+#include <dsp/demod/quadrature.h>
+#include <dsp/demod/broadcast_fm.h>
+#include <dsp/loop/agc.h>
+#include <dsp/noise_reduction/fm_if.h>
+#include <dsp/compression/sample_stream_compressor.h>
+#include <dsp/taps/low_pass.h>
+#include <signal_path/iq_frontend.h>
+#include "bench.h"
+
+// Largest block size used, the output buffers are sized for it
+#define BLOCKS_MAX_BLOCK_SIZE   65536
+
+namespace bench {
+    // Synthetic inputs shared by all benchmarks
+    static dsp::complex_t* iq = NULL;
+    static float* real = NULL;
+
+    static void genInputs() {
+        if (iq) { return; }
+        iq = dsp::buffer::alloc<dsp::complex_t>(BLOCKS_MAX_BLOCK_SIZE);
+        real = dsp::buffer::alloc<float>(BLOCKS_MAX_BLOCK_SIZE);
+
+        // A few tones on top of some noise from a fixed seed, so that runs are comparable
+        uint32_t seed = 0x12345678;
+        for (int i = 0; i < BLOCKS_MAX_BLOCK_SIZE; i++) {
+            float noise[2];
+            for (int j = 0; j < 2; j++) {
+                seed = seed * 1664525u + 1013904223u;
+                noise[j] = ((float)(seed >> 8) / (float)(1 << 24) - 0.5f) * 0.01f;
+            }
+            double phase = 2.0 * M_PI * 0.0123 * (double)i;
+            double fmPhase = 2.0 * M_PI * (0.05 * (double)i + 0.3 * sin(2.0 * M_PI * 0.00071 * (double)i));
+            iq[i].re = 0.5f * cos(phase) + 0.3f * cos(fmPhase) + noise[0];
+            iq[i].im = 0.5f * sin(phase) + 0.3f * sin(fmPhase) + noise[1];
+            real[i] = iq[i].re;
+        }
+    }
+
+    // Call process() on blocks of the synthetic input for the given duration and report the throughput.
+    // The process function gets the number of input samples to process.
+    template <class Func>
+    void measure(const std::string& name, json params, int blockSize, int durationMs, Func process) {
+        // Warm up the caches and let the block do any lazy allocation
+        process(blockSize);
+
+        uint64_t samples = 0;
+        uint64_t allocs = allocations();
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start;
+        while (std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() < durationMs) {
+            process(blockSize);
+            samples += blockSize;
+            end = std::chrono::high_resolution_clock::now();
+        }
+        allocs = allocations() - allocs;
+
+        params["block_size"] = blockSize;
+        report("blocks", name, params, samples, std::chrono::duration<double>(end - start).count(), allocs);
+    }
+
+    // Gives access to the FFT path of the front end without running the whole front end
+    class FFTPath : public IQFrontEnd {
+    public:
+        FFTPath(int fftSize, double fftRate) {
+            fftBuf = dsp::buffer::alloc<float>(fftSize);
+            init(&dummy, 8000000.0, false, 1, false, fftSize, fftRate, IQFrontEnd::FFTWindow::NUTTALL, acquire, release, this);
+        }
+
+        int getBatchSize() {
+            return fftPlan->batch;
+        }
+
+        ~FFTPath() {
+            dsp::buffer::free(fftBuf);
+        }
+
+        void process(dsp::complex_t* data) {
+            handler(data, _nzFFTSize, this);
+        }
+
+    private:
+        static float* acquire(void* ctx) {
+            return ((FFTPath*)ctx)->fftBuf;
+        }
+
+        static void release(void* ctx) {}
+
+        dsp::stream<dsp::complex_t> dummy;
+        float* fftBuf;
+    };
+
+    void blocks(int durationMs) {
+        genInputs();
+        dsp::complex_t* cbuf = dsp::buffer::alloc<dsp::complex_t>(BLOCKS_MAX_BLOCK_SIZE * 4);
+        dsp::stereo_t* sout = dsp::buffer::alloc<dsp::stereo_t>(BLOCKS_MAX_BLOCK_SIZE * 4);
+        float* fout = dsp::buffer::alloc<float>(BLOCKS_MAX_BLOCK_SIZE * 4);
+        uint8_t* bout = dsp::buffer::alloc<uint8_t>(BLOCKS_MAX_BLOCK_SIZE * sizeof(dsp::complex_t) + 64);
+
+        for (int blockSize : { 1024, 16384, BLOCKS_MAX_BLOCK_SIZE }) {
+            // Decimating FIR with the taps of an ideal decimation low-pass
+            for (int decim : { 2, 4, 8 }) {
+                for (int tapCount : { 31, 127 }) {
+                    dsp::tap<float> taps = dsp::taps::windowedSinc<float>(tapCount, 0.5 / (double)decim, 1.0, dsp::window::nuttall);
+                    dsp::filter::DecimatingFIR<dsp::complex_t, float> fir(NULL, taps, decim);
+                    json params;
+                    params["decimation"] = decim;
+                    params["taps"] = tapCount;
+                    measure("decimating_fir", params, blockSize, durationMs, [&](int count) { fir.process(count, iq, cbuf); });
+                    dsp::taps::free(taps);
+                }
+            }
+
+            // Power decimator, one plan per ratio
+            for (int ratio = 2; ratio <= dsp::multirate::PowerDecimator<dsp::complex_t>::getMaxRatio(); ratio *= 2) {
+                dsp::multirate::PowerDecimator<dsp::complex_t> decim(NULL, ratio);
+                json params;
+                params["ratio"] = ratio;
+                measure("power_decimator", params, blockSize, durationMs, [&](int count) { decim.process(count, iq, cbuf); });
+            }
+
+            // Polyphase resampler on common conversions, with the taps the rational resampler would use
+            struct Conversion { double inSr; double outSr; int interp; int decim; };
+            for (const auto& conv : { Conversion{ 48000.0, 44100.0, 147, 160 }, Conversion{ 250000.0, 48000.0, 24, 125 }, Conversion{ 44100.0, 48000.0, 160, 147 } }) {
+                double tapBandwidth = std::min<double>(conv.inSr, conv.outSr) / 2.0;
+                dsp::tap<float> taps = dsp::taps::lowPass(tapBandwidth, tapBandwidth * 0.1, conv.inSr * (double)conv.interp);
+                for (int i = 0; i < taps.size; i++) { taps.taps[i] *= (float)conv.interp; }
+                dsp::multirate::PolyphaseResampler<dsp::complex_t> resamp(NULL, conv.interp, conv.decim, taps);
+                json params;
+                params["in_samplerate"] = conv.inSr;
+                params["out_samplerate"] = conv.outSr;
+                params["taps"] = taps.size;
+                measure("polyphase_resampler", params, blockSize, durationMs, [&](int count) { resamp.process(count, iq, cbuf); });
+                dsp::taps::free(taps);
+            }
+
+            // Frequency translation
+            {
+                dsp::channel::FrequencyXlator xlator(NULL, 123456.0, 2400000.0);
+                measure("frequency_xlator", json::object(), blockSize, durationMs, [&](int count) { xlator.process(count, iq, cbuf); });
+            }
+
+            // FM quadrature demodulator
+            {
+                dsp::demod::Quadrature quad(NULL, 75000.0, 250000.0);
+                measure("quadrature", json::object(), blockSize, durationMs, [&](int count) { quad.process(count, iq, fout); });
+            }
+
+            // Broadcast FM demodulator, mono and stereo
+            for (bool stereo : { false, true }) {
+                dsp::demod::BroadcastFM bfm(NULL, 75000.0, 250000.0, stereo, true);
+                json params;
+                params["stereo"] = stereo;
+                int rdsCount;
+                measure("broadcast_fm", params, blockSize, durationMs, [&](int count) { bfm.process(count, iq, sout, rdsCount); });
+            }
+
+            // AGC on complex and real samples with the settings of the demodulators
+            {
+                dsp::loop::AGC<dsp::complex_t> cagc(NULL, 1.0, 50.0 / 48000.0, 5.0 / 48000.0, 10e6, 10.0, INFINITY);
+                dsp::loop::AGC<float> fagc(NULL, 1.0, 50.0 / 48000.0, 5.0 / 48000.0, 10e6, 10.0, INFINITY);
+                json params;
+                params["type"] = "complex";
+                measure("agc", params, blockSize, durationMs, [&](int count) { cagc.process(count, iq, cbuf); });
+                params["type"] = "float";
+                measure("agc", params, blockSize, durationMs, [&](int count) { fagc.process(count, real, fout); });
+            }
+
+            // FM IF noise reduction
+            for (int bins : { 8, 32, 128 }) {
+                dsp::noise_reduction::FMIF fmif(NULL, bins);
+                json params;
+                params["bins"] = bins;
+                measure("fm_if", params, blockSize, durationMs, [&](int count) { fmif.process(count, iq, cbuf); });
+            }
+
+            // Sample compression used by the server
+            for (auto pcmType : { dsp::compression::PCM_TYPE_I8, dsp::compression::PCM_TYPE_I16, dsp::compression::PCM_TYPE_F32 }) {
+                json params;
+                params["pcm_type"] = (int)pcmType;
+                measure("sample_stream_compressor", params, blockSize, durationMs, [&](int count) {
+                    dsp::compression::SampleStreamCompressor::process(count, pcmType, iq, bout);
+                });
+            }
+        }
+
+        // FFT path of the front end, the FFT size takes the place of the block size.
+        // High FFT rates get several frames transformed per FFT execution.
+        for (int fftSize : { 1024, 8192, BLOCKS_MAX_BLOCK_SIZE }) {
+            for (double fftRate : { 20.0, 240.0 }) {
+                FFTPath fft(fftSize, fftRate);
+                json params;
+                params["fft_rate"] = fftRate;
+                params["batch"] = fft.getBatchSize();
+                measure("iq_frontend_fft", params, fftSize, durationMs, [&](int count) { fft.process(iq); });
+            }
+        }
+
+        dsp::buffer::free(cbuf);
+        dsp::buffer::free(sout);
+        dsp::buffer::free(fout);
+        dsp::buffer::free(bout);
+    }
+}
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <dsp/compression/sample_stream_compressor.h>
+#include <dsp/compression/sample_stream_decompressor.h>
+#include <dsp/buffer/buffer.h>
+#include "bench.h"
+
+namespace bench {
+    // Noise floor of the test signal, the SNR loss is the rise of that floor due to the coding
+    const float CODEC_NOISE_LEVEL = 0.01f;
+
+    // Strong and weak carriers over white noise, like a typical slice of spectrum
+    static void codecSignal(dsp::complex_t* out, int count) {
+        const double freqs[] = { 0.0123, 0.2071, -0.3317 };
+        const float amps[] = { 0.5f, 0.05f, 0.005f };
+        for (int i = 0; i < count; i++) {
+            dsp::complex_t s = { 0.0f, 0.0f };
+            for (int j = 0; j < 3; j++) {
+                s.re += amps[j] * cos(2.0 * M_PI * freqs[j] * i);
+                s.im += amps[j] * sin(2.0 * M_PI * freqs[j] * i);
+            }
+
+            // Box-Muller
+            double u1 = ((double)rand() + 1.0) / ((double)RAND_MAX + 2.0);
+            double u2 = (double)rand() / (double)RAND_MAX;
+            double r = CODEC_NOISE_LEVEL * sqrt(-2.0 * log(u1));
+            s.re += r * cos(2.0 * M_PI * u2);
+            s.im += r * sin(2.0 * M_PI * u2);
+            out[i] = s;
+        }
+    }
+
+    // Encode and decode the same block over and over for the given duration, reporting each separately
+    void codecRun(const std::string& name, int durationMs, dsp::compression::PCMType type) {
+        using namespace dsp::compression;
+        const int blockSize = 65536;
+        dsp::complex_t* in = dsp::buffer::alloc<dsp::complex_t>(blockSize);
+        uint8_t* coded = dsp::buffer::alloc<uint8_t>(STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) + 8);
+        dsp::complex_t* out = dsp::buffer::alloc<dsp::complex_t>(STREAM_BUFFER_SIZE);
+        codecSignal(in, blockSize);
+
+        // Ratio and error
+        int codedSize = SampleStreamCompressor::process(blockSize, type, in, coded);
+        int outCount = SampleStreamDecompressor::process(codedSize, coded, out);
+        double signalPower = 0.0;
+        double errorPower = 0.0;
+        for (int i = 0; i < outCount; i++) {
+            double dre = out[i].re - in[i].re;
+            double dim = out[i].im - in[i].im;
+            signalPower += in[i].re * in[i].re + in[i].im * in[i].im;
+            errorPower += dre * dre + dim * dim;
+        }
+        signalPower /= blockSize;
+        errorPower /= blockSize;
+        double noisePower = 2.0 * CODEC_NOISE_LEVEL * CODEC_NOISE_LEVEL;
+
+        json params;
+        params["ratio"] = (double)codedSize / (double)(blockSize * sizeof(dsp::complex_t));
+        params["bits_per_sample"] = (double)codedSize * 8.0 / (double)blockSize;
+        params["sqnr_db"] = (errorPower > 0.0) ? 10.0 * log10(signalPower / errorPower) : INFINITY;
+        params["snr_loss_db"] = 10.0 * log10((noisePower + errorPower) / noisePower);
+        params["valid"] = (outCount == blockSize);
+
+        // Encoding
+        uint64_t samples = 0;
+        uint64_t allocs = allocations();
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start;
+        while (std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() < durationMs) {
+            SampleStreamCompressor::process(blockSize, type, in, coded);
+            samples += blockSize;
+            end = std::chrono::high_resolution_clock::now();
+        }
+        allocs = allocations() - allocs;
+        report("codec", name + "_encode", params, samples, std::chrono::duration<double>(end - start).count(), allocs);
+
+        // Decoding
+        samples = 0;
+        allocs = allocations();
+        start = std::chrono::high_resolution_clock::now();
+        end = start;
+        while (std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() < durationMs) {
+            SampleStreamDecompressor::process(codedSize, coded, out);
+            samples += blockSize;
+            end = std::chrono::high_resolution_clock::now();
+        }
+        allocs = allocations() - allocs;
+        report("codec", name + "_decode", params, samples, std::chrono::duration<double>(end - start).count(), allocs);
+
+        dsp::buffer::free(in);
+        dsp::buffer::free(coded);
+        dsp::buffer::free(out);
+    }
+
+    void codec(int durationMs) {
+        using namespace dsp::compression;
+        codecRun("i8", durationMs, PCM_TYPE_I8);
+        codecRun("i16", durationMs, PCM_TYPE_I16);
+        codecRun("f32", durationMs, PCM_TYPE_F32);
+        codecRun("bfp8", durationMs, PCM_TYPE_BFP8);
+        codecRun("bfp10", durationMs, PCM_TYPE_BFP10);
+        codecRun("bfp12", durationMs, PCM_TYPE_BFP12);
+        codecRun("rice16", durationMs, PCM_TYPE_RICE16);
+        codecRun("rice12", durationMs, PCM_TYPE_RICE12);
+    }
+}
@@ -0,0 +1,47 @@
+#include <chrono>
+#include <stdlib.h>
+#include <dsp/convert/sample_format.h>
+#include <dsp/buffer/buffer.h>
+#include "bench.h"
+
+namespace bench {
+    // Convert the same block over and over for the given duration
+    template <class Func>
+    void convertRun(const std::string& name, int durationMs, Func convert) {
+        const int blockSize = 65536;
+        uint8_t* in = dsp::buffer::alloc<uint8_t>(blockSize * 8);
+        dsp::complex_t* out = dsp::buffer::alloc<dsp::complex_t>(blockSize);
+        for (int i = 0; i < blockSize * 8; i++) { in[i] = rand(); }
+
+        uint64_t samples = 0;
+        uint64_t allocs = allocations();
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start;
+        while (std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() < durationMs) {
+            convert(blockSize, in, out);
+            samples += blockSize;
+            end = std::chrono::high_resolution_clock::now();
+        }
+        allocs = allocations() - allocs;
+
+        dsp::buffer::free(in);
+        dsp::buffer::free(out);
+
+        json params;
+        params["kernels"] = dsp::convert::getSampleFormatKernels();
+        report("convert", name, params, samples, std::chrono::duration<double>(end - start).count(), allocs);
+    }
+
+    void convert(int durationMs) {
+        using namespace dsp::convert;
+        convertRun("u8", durationMs, [](int count, uint8_t* in, dsp::complex_t* out) { u8ToComplex(count, in, out, 127.4f, 1.0f / 128.0f); });
+        convertRun("s8", durationMs, [](int count, uint8_t* in, dsp::complex_t* out) { s8ToComplex(count, (int8_t*)in, out, 0.0f, 1.0f / 128.0f); });
+        convertRun("s12_packed", durationMs, [](int count, uint8_t* in, dsp::complex_t* out) { s12PackedToComplex(count, in, out, 0.0f, 1.0f / 2048.0f); });
+        convertRun("s16", durationMs, [](int count, uint8_t* in, dsp::complex_t* out) { s16ToComplex(count, (int16_t*)in, out, 0.0f, 1.0f / 32768.0f); });
+        convertRun("s16_split", durationMs, [](int count, uint8_t* in, dsp::complex_t* out) {
+            s16SplitToComplex(count, (int16_t*)in, (int16_t*)&in[count * 2], out, 0.0f, 1.0f / 32768.0f);
+        });
+        convertRun("s24", durationMs, [](int count, uint8_t* in, dsp::complex_t* out) { s24ToComplex(count, in, out, 0.0f, 1.0f / 8388607.0f); });
+        convertRun("s32", durationMs, [](int count, uint8_t* in, dsp::complex_t* out) { s32ToComplex(count, (int32_t*)in, out, 0.0f, 1.0f / 2147483647.0f); });
+    }
+}
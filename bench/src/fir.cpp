@@ -0,0 +1,53 @@
+#include <chrono>
+#include <dsp/filter/fir.h>
+#include <dsp/taps/windowed_sinc.h>
+#include <dsp/window/nuttall.h>
+#include "bench.h"
+
+namespace bench {
+    // Run the filter on the same block over and over for the given duration
+    template <class D>
+    void firRun(const std::string& name, int tapCount, typename dsp::filter::FIR<D, float>::Engine engine, int durationMs) {
+        const int blockSize = 16384;
+        dsp::stream<D> in;
+        dsp::tap<float> taps = dsp::taps::windowedSinc<float>(tapCount, 0.1, 1.0, dsp::window::nuttall);
+        dsp::filter::FIR<D, float> fir(&in, taps);
+        fir.setEngine(engine);
+        D* out = dsp::buffer::alloc<D>(blockSize);
+        dsp::buffer::clear(in.writeBuf, blockSize);
+
+        uint64_t samples = 0;
+        uint64_t allocs = allocations();
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start;
+        while (std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() < durationMs) {
+            samples += fir.process(blockSize, in.writeBuf, out);
+            end = std::chrono::high_resolution_clock::now();
+        }
+        allocs = allocations() - allocs;
+
+        dsp::buffer::free(out);
+        dsp::taps::free(taps);
+
+        json params;
+        params["taps"] = tapCount;
+        params["engine"] = (engine == dsp::filter::FIR<D, float>::ENGINE_FFT) ? "fft" : "direct";
+        params["crossover"] = dsp::filter::getFFTCrossover<D, float>();
+        report("fir", name, params, samples, std::chrono::duration<double>(end - start).count(), allocs);
+    }
+
+    template <class D>
+    void firType(const std::string& name, int durationMs) {
+        for (int tapCount : { 16, 64, 256, 1024, 4096 }) {
+            firRun<D>(name, tapCount, dsp::filter::FIR<D, float>::ENGINE_DIRECT, durationMs);
+            firRun<D>(name, tapCount, dsp::filter::FIR<D, float>::ENGINE_FFT, durationMs);
+        }
+    }
+
+    void fir(int durationMs) {
+        dsp::filter::measureFFTCrossovers();
+        firType<float>("float", durationMs);
+        firType<dsp::complex_t>("complex", durationMs);
+        firType<dsp::stereo_t>("stereo", durationMs);
+    }
+}
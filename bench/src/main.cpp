@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include "bench.h"
+
+// Count every heap allocation made through operator new
+static std::atomic<uint64_t> allocCount = 0;
+
+void* operator new(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) { throw std::bad_alloc(); }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept {
+    free(ptr);
+}
+
+namespace bench {
+    uint64_t allocations() {
+        return allocCount.load(std::memory_order_relaxed);
+    }
+
+    void report(const std::string& suite, const std::string& name, json params, uint64_t samples, double seconds, uint64_t allocs) {
+        json res;
+        res["suite"] = suite;
+        res["name"] = name;
+        res["params"] = params;
+        res["samples"] = samples;
+        res["seconds"] = seconds;
+        res["msps"] = (seconds > 0.0) ? ((double)samples / seconds) / 1e6 : 0.0;
+        res["ns_per_sample"] = samples ? (seconds * 1e9) / (double)samples : 0.0;
+        res["allocations"] = allocs;
+        printf("%s\n", res.dump().c_str());
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Duration of each individual benchmark in milliseconds
+    int durationMs = (argc > 1) ? atoi(argv[1]) : 1000;
+
+    // Optionally only run a single suite
+    const char* suite = (argc > 2) ? argv[2] : NULL;
+
+    if (durationMs <= 0) {
+        fprintf(stderr, "Usage: %s [duration_ms] [streams|fir|blocks|convert|codec]\n", argv[0]);
+        return -1;
+    }
+
+    if (!suite || !strcmp(suite, "streams")) { bench::streams(durationMs); }
+    if (!suite || !strcmp(suite, "fir")) { bench::fir(durationMs); }
+    if (!suite || !strcmp(suite, "blocks")) { bench::blocks(durationMs); }
+    if (!suite || !strcmp(suite, "convert")) { bench::convert(durationMs); }
+    if (!suite || !strcmp(suite, "codec")) { bench::codec(durationMs); }
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <dsp/stream.h>
+#include <dsp/ring_stream.h>
+#include <dsp/routing/stream_link.h>
+#include "bench.h"
+
+namespace bench {
+    // Push blocks through a chain of copy-only hops and measure how many samples come out the other end.
+    // Since the hops do nothing but a memcpy, this mostly measures the cost of the stream handoff itself.
+    template <class S>
+    void streamChain(const std::string& name, int hops, int blockSize, int durationMs) {
+        // Create the chain
+        std::vector<S*> streams;
+        std::vector<dsp::routing::StreamLink<dsp::complex_t>*> links;
+        for (int i = 0; i <= hops; i++) {
+            streams.push_back(new S());
+        }
+        for (int i = 0; i < hops; i++) {
+            links.push_back(new dsp::routing::StreamLink<dsp::complex_t>(streams[i], streams[i + 1]));
+            links[i]->start();
+        }
+
+        // Start the writer and reader
+        std::atomic<uint64_t> samples = 0;
+        std::thread writer([&]() {
+            while (true) {
+                dsp::buffer::clear(streams[0]->writeBuf, blockSize);
+                if (!streams[0]->swap(blockSize)) { return; }
+            }
+        });
+        std::thread reader([&]() {
+            while (true) {
+                int count = streams[hops]->read();
+                if (count < 0) { return; }
+                streams[hops]->flush();
+                samples += count;
+            }
+        });
+
+        // Measure
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto start = std::chrono::high_resolution_clock::now();
+        uint64_t startSamples = samples;
+        uint64_t startAllocs = allocations();
+        std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+        uint64_t endSamples = samples;
+        uint64_t endAllocs = allocations();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        // Stop everything
+        streams[0]->stopWriter();
+        writer.join();
+        for (auto& l : links) { l->stop(); }
+        streams[hops]->stopReader();
+        reader.join();
+        for (auto& l : links) { delete l; }
+        for (auto& s : streams) { delete s; }
+
+        json params;
+        params["hops"] = hops;
+        params["block_size"] = blockSize;
+        report("streams", name, params, endSamples - startSamples, std::chrono::duration<double>(end - start).count(), endAllocs - startAllocs);
+    }
+
+    void streams(int durationMs) {
+        for (int hops : { 1, 4 }) {
+            for (int blockSize : { 256, 4096, 65536 }) {
+                streamChain<dsp::stream<dsp::complex_t>>("stream", hops, blockSize, durationMs);
+                streamChain<dsp::ring_stream<dsp::complex_t>>("ring_stream", hops, blockSize, durationMs);
+            }
+        }
+    }
+}
@@ -0,0 +1,222 @@
+#include "batch.h"
+#include "core.h"
+#include <utils/flog.h>
+#include <utils/iq_reader.h>
+#include <signal_path/signal_path.h>
+#include <gui/gui.h>
+#include <filesystem>
+#include <regex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+namespace batch {
+    dsp::stream<dsp::complex_t> input;
+    std::atomic<uint64_t> position = 0;
+    std::atomic_bool done = false;
+
+    float* acquireFFTBuffer(void* ctx) {
+        return NULL;
+    }
+
+    void releaseFFTBuffer(void* ctx) {}
+
+    double getFrequency(std::string filename) {
+        std::regex expr("[0-9]+Hz");
+        std::smatch matches;
+        std::regex_search(filename, matches, expr);
+        if (matches.empty()) { return 0; }
+        std::string freqStr = matches[0].str();
+        return std::atof(freqStr.substr(0, freqStr.size() - 2).c_str());
+    }
+
+    // Restore the saved offsets of the VFOs, the same way the GUI does
+    void vfoCreatedHandler(VFOManager::VFO* vfo, void* ctx) {
+        std::string name = vfo->getName();
+        core::configManager.acquire();
+        if (!core::configManager.conf["vfoOffsets"].contains(name)) {
+            core::configManager.release();
+            return;
+        }
+        double offset = core::configManager.conf["vfoOffsets"][name];
+        core::configManager.release();
+        sigpath::vfoManager.setCenterOffset(name, offset);
+    }
+    EventHandler<VFOManager::VFO*> vfoCreated(vfoCreatedHandler, NULL);
+
+    // Modules that only process samples. The others either need the GUI, talk to the network, or would compete with
+    // the file or pace the DSP to real time.
+    const std::vector<std::string> batchModules = {
+        "radio",
+        "recorder",
+        "meteor_demodulator",
+        "m17_decoder",
+        "pager_decoder"
+    };
+
+    bool skipModule(const std::filesystem::path& file) {
+        if (file.extension().generic_string() != SDRPP_MOD_EXTENTSION) { return true; }
+        std::string name = file.stem().string();
+        return std::find(batchModules.begin(), batchModules.end(), name) == batchModules.end();
+    }
+
+    void feeder(IQReader* reader) {
+        double sampleRate = reader->getCapture(0).sampleRate;
+        int blockSize = std::clamp<int>(sampleRate / 200.0, 1, STREAM_BUFFER_SIZE);
+        uint64_t readAhead = sampleRate * BATCH_READ_AHEAD_TIME;
+        uint64_t frameCount = reader->getFrameCount();
+        uint64_t pos = 0;
+        uint64_t prefetched = 0;
+
+        // No pacing, swap() only returns once the IQ frontend took the previous block
+        while (pos < frameCount) {
+            if (prefetched < pos || prefetched - pos < readAhead / 2) {
+                reader->prefetch(pos, readAhead);
+                prefetched = pos + readAhead;
+            }
+            int count = reader->read(pos, input.writeBuf, blockSize);
+            if (!input.swap(count)) { break; }
+            pos += count;
+            position = pos;
+        }
+
+        // Wait for the last block to be read, then stop the input
+        input.waitFlushed();
+        input.stopWriter();
+        done = true;
+    }
+
+    // Runs and samples of the IQ frontend's blocks, including the time its VFOs waited for the decoders to take
+    // their output. They stop moving once what's left of the file went through and the decoders took all of it.
+    double getProgress() {
+        double progress = 0.0;
+        for (auto& bp : sigpath::profiler.getProfiles()) {
+            progress += (double)bp.runs + (double)bp.samples + bp.swapWait;
+        }
+        return progress;
+    }
+
+    // Wait for the DSP to process everything that is left of the file, the input is already flushed
+    void drain() {
+        double lastProgress = getProgress();
+        auto lastChange = std::chrono::steady_clock::now();
+        while (std::chrono::duration<double>(std::chrono::steady_clock::now() - lastChange).count() < BATCH_IDLE_TIME) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            double progress = getProgress();
+            if (progress == lastProgress) { continue; }
+            lastProgress = progress;
+            lastChange = std::chrono::steady_clock::now();
+        }
+    }
+
+    int main(std::string path) {
+        flog::info("=====| BATCH MODE |=====");
+
+        // Open the recording, only the frequency and samplerate it starts with are used
+        IQReader* reader = IQReader::open(path);
+        if (!reader) {
+            flog::error("'{0}' is not a valid baseband recording", path);
+            return -1;
+        }
+        IQReader::Capture cap = reader->getCapture(0);
+        double sampleRate = cap.sampleRate;
+        double frequency = core::args["frequency"];
+        if (!frequency) { frequency = cap.frequency; }
+        if (!frequency) { frequency = getFrequency(std::filesystem::path(path).filename().string()); }
+        if (!frequency) { flog::warn("No center frequency given and none found in the file name, using 0Hz"); }
+
+        // Nothing changed here is worth saving, and other batch runs may share the config
+        core::configManager.disableAutoSave();
+
+        // Init DSP, the input is running at the samplerate of the file from the start
+        sigpath::iqFrontEnd.init(&input, sampleRate, false, 1, false, BATCH_FFT_SIZE, BATCH_FFT_RATE, IQFrontEnd::FFTWindow::NUTTALL, acquireFFTBuffer, releaseFFTBuffer, NULL);
+        if (sigpath::scheduler.isRunning()) { sigpath::iqFrontEnd.setScheduler(&sigpath::scheduler); }
+        sigpath::iqFrontEnd.setProfiler(&sigpath::profiler);
+        sigpath::iqFrontEnd.start();
+        core::setInputSampleRate(sampleRate);
+        gui::waterfall.setCenterFrequency(frequency);
+        sigpath::vfoManager.onVfoCreated.bindHandler(&vfoCreated);
+
+        // Load config
+        core::configManager.acquire();
+        std::string modulesDir = core::configManager.conf["modulesDirectory"];
+        std::vector<std::string> modules = core::configManager.conf["modules"];
+        auto modList = core::configManager.conf["moduleInstances"].items();
+        core::configManager.release();
+        modulesDir = std::filesystem::absolute(modulesDir).string();
+
+        flog::info("Loading modules");
+        if (std::filesystem::is_directory(modulesDir)) {
+            for (const auto& file : std::filesystem::directory_iterator(modulesDir)) {
+                if (!file.is_regular_file() || skipModule(file.path())) { continue; }
+                std::string path = file.path().generic_string();
+                flog::info("Loading {0}", path);
+                core::moduleManager.loadModule(path);
+            }
+        }
+        else {
+            flog::warn("Module directory {0} does not exist, not loading modules from directory", modulesDir);
+        }
+        for (auto const& apath : modules) {
+            std::filesystem::path file = std::filesystem::absolute(apath);
+            if (!std::filesystem::is_regular_file(file) || skipModule(file)) { continue; }
+            std::string path = file.generic_string();
+            flog::info("Loading {0}", path);
+            core::moduleManager.loadModule(path);
+        }
+
+        // Create module instances, recorders that are enabled start recording on post-init
+        for (auto const& [name, _module] : modList) {
+            std::string mod = _module["module"];
+            bool enabled = _module["enabled"];
+            if (core::moduleManager.modules.find(mod) == core::moduleManager.modules.end()) { continue; }
+            flog::info("Initializing {0} ({1})", name, mod);
+            core::moduleManager.createInstance(name, mod);
+            if (!enabled) { core::moduleManager.disableInstance(name); }
+        }
+        core::moduleManager.doPostInitAll();
+
+        // Process the file
+        uint64_t frameCount = reader->getFrameCount();
+        double duration = frameCount / sampleRate;
+        flog::info("Processing {0} ({1}s at {2}S/s, {3}Hz)", path, duration, sampleRate, frequency);
+        auto start = std::chrono::steady_clock::now();
+        auto lastReport = start;
+        std::thread feederThread(feeder, reader);
+        while (!done) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - lastReport).count() < BATCH_PROGRESS_INTERVAL) { continue; }
+            lastReport = now;
+            double processed = position / sampleRate;
+            double elapsed = std::chrono::duration<double>(now - start).count();
+            flog::info("{0}% ({1}x real time)", (int)(100.0 * position / frameCount), processed / elapsed);
+        }
+        feederThread.join();
+        drain();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Deleting the instances closes whatever they were writing. The recorders go first, so that they stop and
+        // write out everything left in their disk queue while the streams they record are still there.
+        std::vector<std::string> names;
+        for (auto& [name, inst] : core::moduleManager.instances) {
+            if (core::moduleManager.getInstanceModuleName(name) == "recorder") { names.push_back(name); }
+        }
+        for (auto& [name, inst] : core::moduleManager.instances) {
+            if (core::moduleManager.getInstanceModuleName(name) != "recorder") { names.push_back(name); }
+        }
+        for (auto& name : names) { core::moduleManager.deleteInstance(name); }
+        sigpath::vfoManager.onVfoCreated.unbindHandler(&vfoCreated);
+        sigpath::iqFrontEnd.stop();
+        sigpath::iqFrontEnd.setProfiler(NULL);
+        for (auto& [name, mod] : core::moduleManager.modules) {
+            mod.end();
+        }
+        sigpath::scheduler.stop();
+
+        delete reader;
+        flog::info("Processed {0}s of samples in {1}s, {2}x real time", duration, elapsed, duration / elapsed);
+        return 0;
+    }
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+
+// The FFT isn't displayed, it only runs at the lowest rate the IQ frontend needs
+#define BATCH_FFT_SIZE          1024
+#define BATCH_FFT_RATE          1.0
+
+// Seconds of the file the OS is asked to read ahead of processing
+#define BATCH_READ_AHEAD_TIME   1.0
+
+// Seconds of wall time between progress reports
+#define BATCH_PROGRESS_INTERVAL 5.0
+
+// Once the file is read, seconds the counters of the IQ frontend must stay still for the DSP to be considered done
+#define BATCH_IDLE_TIME         0.1
+
+namespace batch {
+    // Feed a baseband recording through the IQ frontend, VFOs and decoders as fast as they can process it, then exit.
+    // Only the modules that work without the GUI are loaded, so nothing is paced to real time and audio goes to the
+    // null sink.
+    int main(std::string path);
+};
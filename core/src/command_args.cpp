@@ -14,6 +14,9 @@ void CommandArgsParser::defineAll() {
 #endif
 
         define('a', "addr", "Server mode address", "0.0.0.0");
+        define('b', "batch", "Process a baseband recording as fast as possible without GUI, then exit", "");
+        define('\0', "clients", "Server mode maximum number of clients", 8);
+        define('\0', "frequency", "Batch mode center frequency, read from the file name if not given", 0.0);
         define('h', "help", "Show help");
         define('p', "port", "Server mode port", 5259);
         define('r', "root", "Root directory, where all config files are stored", std::filesystem::absolute(root).string());
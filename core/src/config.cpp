@@ -1,6 +1,7 @@
 #include <config.h>
 #include <utils/flog.h>
 #include <fstream>
+#include <sstream>
 
 #include <filesystem>
 
@@ -15,40 +16,83 @@ void ConfigManager::setPath(std::string file) {
     path = std::filesystem::absolute(file).string();
 }
 
+void ConfigManager::setFormat(Format format) {
+    // Only used when writing, so this can be called while the config is acquired
+    std::lock_guard<std::mutex> lck(saveMtx);
+    this->format = format;
+}
+
+void ConfigManager::setSeparate(std::string key, Format format) {
+    std::lock_guard<std::mutex> lck(mtx);
+    if (path == "") {
+        flog::error("Config manager tried to separate '{0}' with no path specified", key);
+        return;
+    }
+
+    // Stored next to the main file, "config.json" keeps "key" in "config.key.json"
+    std::filesystem::path p(path);
+    SeparateTree tree;
+    tree.path = (p.parent_path() / (p.stem().string() + "." + key + p.extension().string())).string();
+    tree.format = format;
+    tree.saved = json();
+    separate[key] = tree;
+}
+
 void ConfigManager::load(json def, bool lock) {
     if (lock) { mtx.lock(); }
     if (path == "") {
         flog::error("Config manager tried to load file with no path specified");
+        if (lock) { mtx.unlock(); }
         return;
     }
+    bool reset = false;
     if (!std::filesystem::exists(path)) {
         flog::warn("Config file '{0}' does not exist, creating it", path);
         conf = def;
-        save(false);
+        reset = true;
     }
-    if (!std::filesystem::is_regular_file(path)) {
+    else if (!std::filesystem::is_regular_file(path)) {
         flog::error("Config file '{0}' isn't a file", path);
+        if (lock) { mtx.unlock(); }
         return;
     }
-
-    try {
-        std::ifstream file(path.c_str());
-        file >> conf;
-        file.close();
-    }
-    catch (const std::exception& e) {
-        flog::error("Config file '{}' is corrupted, resetting it: {}", path, e.what());
+    else if (!readFile(path, conf)) {
+        flog::error("Config file '{}' is corrupted, resetting it", path);
         conf = def;
-        save(false);
+        reset = true;
     }
+
+    // Bring back the separate subtrees, a subtree still in the main file gets moved out on the next save
+    for (auto& [key, tree] : separate) {
+        if (!std::filesystem::exists(tree.path)) { continue; }
+        json sub;
+        if (readFile(tree.path, sub)) {
+            conf[key] = sub;
+            tree.saved = sub;
+        }
+        else {
+            flog::error("Config file '{}' is corrupted, resetting it", tree.path);
+            if (def.contains(key)) { conf[key] = def[key]; }
+            reset = true;
+        }
+    }
+
+    if (reset) { save(false); }
     if (lock) { mtx.unlock(); }
 }
 
 void ConfigManager::save(bool lock) {
+    // Only copy the config while locked, serializing and writing it is done without holding the lock
+    if (lock) { mtx.lock(); }
+    json snapshot = conf;
+    uint64_t gen = ++snapshotGen;
+    changed = false;
+    if (lock) { mtx.unlock(); }
+
+    // Changes made during the write keep it set, and a failed write sets it back so that it's tried again later
+    if (writeSnapshot(snapshot, gen)) { return; }
     if (lock) { mtx.lock(); }
-    std::ofstream file(path.c_str());
-    file << conf.dump(4);
-    file.close();
+    markChanged();
     if (lock) { mtx.unlock(); }
 }
 
@@ -75,27 +119,120 @@ void ConfigManager::acquire() {
 }
 
 void ConfigManager::release(bool modified) {
-    changed |= modified;
+    if (modified) { markChanged(); }
     mtx.unlock();
 }
 
+void ConfigManager::markChanged() {
+    auto now = std::chrono::steady_clock::now();
+    if (!changed) { firstChange = now; }
+    lastChange = now;
+    changed = true;
+}
+
 void ConfigManager::autoSaveWorker() {
     while (autoSaveEnabled) {
-        if (!mtx.try_lock()) {
-            flog::warn("ConfigManager locked, waiting...");
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-            continue;
-        }
-        if (changed) {
-            changed = false;
-            save(false);
+        // Save once the changes have settled, or if they've been going on for too long
+        bool due = false;
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            if (changed) {
+                auto now = std::chrono::steady_clock::now();
+                due = (now - lastChange >= std::chrono::milliseconds(CONFIG_AUTOSAVE_SETTLE_MS)) ||
+                      (now - firstChange >= std::chrono::milliseconds(CONFIG_AUTOSAVE_MAX_DELAY_MS));
+            }
         }
-        mtx.unlock();
+        if (due) { save(); }
 
         // Sleep but listen for wakeup call
         {
             std::unique_lock<std::mutex> lock(termMtx);
-            termCond.wait_for(lock, std::chrono::milliseconds(1000), [this]() { return termFlag; });
+            termCond.wait_for(lock, std::chrono::milliseconds(CONFIG_AUTOSAVE_POLL_MS), [this]() { return termFlag; });
         }
     }
-}
\ No newline at end of file
+}
+
+bool ConfigManager::writeSnapshot(json& snapshot, uint64_t generation) {
+    std::lock_guard<std::mutex> lck(saveMtx);
+
+    // A newer snapshot may have been written in the meantime
+    if (generation < savedGen) { return true; }
+    savedGen = generation;
+
+    // Separate subtrees are only rewritten when they changed
+    bool success = true;
+    for (auto& [key, tree] : separate) {
+        json sub;
+        if (snapshot.is_object() && snapshot.contains(key)) {
+            sub = std::move(snapshot[key]);
+            snapshot.erase(key);
+        }
+        if (sub == tree.saved) { continue; }
+        if (writeFile(tree.path, serialize(sub, tree.format))) { tree.saved = std::move(sub); }
+        else { success = false; }
+    }
+
+    // Same for the main file
+    std::string data = serialize(snapshot, format);
+    if (data == savedMain) { return success; }
+    if (!writeFile(path, data)) { return false; }
+    savedMain = std::move(data);
+    return success;
+}
+
+std::string ConfigManager::serialize(const json& data, Format format) {
+    switch (format) {
+        case FORMAT_COMPACT:
+            return data.dump();
+        case FORMAT_CBOR: {
+            std::vector<uint8_t> cbor = json::to_cbor(data);
+            return std::string(cbor.begin(), cbor.end());
+        }
+        default:
+            return data.dump(4);
+    }
+}
+
+bool ConfigManager::readFile(const std::string& path, json& data) {
+    try {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        std::stringstream ss;
+        ss << file.rdbuf();
+        std::string str = ss.str();
+
+        // Any format can be loaded, JSON text always starts with an object or an array
+        size_t first = str.find_first_not_of(" \t\r\n");
+        if (first != std::string::npos && (str[first] == '{' || str[first] == '[')) {
+            data = json::parse(str);
+        }
+        else {
+            data = json::from_cbor(str);
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        flog::error("Could not load config file '{}': {}", path, e.what());
+        return false;
+    }
+}
+
+bool ConfigManager::writeFile(const std::string& path, const std::string& data) {
+    // Write to a temporary file and rename it over the old one, so that a crash never leaves a truncated config
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size());
+        file.close();
+        if (file.fail()) {
+            flog::error("Could not write config file '{0}'", tmpPath);
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        flog::error("Could not replace config file '{0}': {1}", path, ec.message());
+        return false;
+    }
+    return true;
+}
@@ -2,16 +2,37 @@
 #include <json.hpp>
 #include <thread>
 #include <string>
+#include <map>
 #include <mutex>
+#include <chrono>
 #include <condition_variable>
 
 using nlohmann::json;
 
+// Changes are only saved once they stop for a moment, so that dragging a slider results in a single write.
+// Continuous changes still get saved every CONFIG_AUTOSAVE_MAX_DELAY_MS.
+#define CONFIG_AUTOSAVE_SETTLE_MS       500
+#define CONFIG_AUTOSAVE_MAX_DELAY_MS    5000
+#define CONFIG_AUTOSAVE_POLL_MS         250
+
 class ConfigManager {
 public:
+    enum Format {
+        FORMAT_PRETTY,  // Indented JSON
+        FORMAT_COMPACT, // JSON without whitespace
+        FORMAT_CBOR     // Binary JSON
+    };
+
     ConfigManager();
     ~ConfigManager();
     void setPath(std::string file);
+
+    // Format the main file is written in, any of them can be loaded
+    void setFormat(Format format);
+
+    // Persist the subtree under key in its own file, only rewritten when it changed. Must be called before load().
+    void setSeparate(std::string key, Format format = FORMAT_PRETTY);
+
     void load(json def, bool lock = true);
     void save(bool lock = true);
     void enableAutoSave();
@@ -22,15 +43,37 @@ public:
     json conf;
 
 private:
+    struct SeparateTree {
+        std::string path;
+        Format format;
+        json saved;
+    };
+
+    void markChanged();
     void autoSaveWorker();
+    bool writeSnapshot(json& snapshot, uint64_t generation);
+    static std::string serialize(const json& data, Format format);
+    static bool readFile(const std::string& path, json& data);
+    static bool writeFile(const std::string& path, const std::string& data);
 
     std::string path = "";
+    Format format = FORMAT_PRETTY;
+    std::map<std::string, SeparateTree> separate;
     volatile bool changed = false;
     volatile bool autoSaveEnabled = false;
+    std::chrono::steady_clock::time_point firstChange;
+    std::chrono::steady_clock::time_point lastChange;
     std::thread autoSaveThread;
     std::mutex mtx;
 
+    // Snapshots are taken under mtx then written under saveMtx, so that the config isn't locked during the write.
+    // The generation keeps an older snapshot from overwriting a newer one.
+    std::mutex saveMtx;
+    uint64_t snapshotGen = 0;
+    uint64_t savedGen = 0;
+    std::string savedMain;
+
     std::mutex termMtx;
     std::condition_variable termCond;
     volatile bool termFlag = false;
-};
\ No newline at end of file
+};
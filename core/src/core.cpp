@@ -1,4 +1,5 @@
 #include <server.h>
+#include <batch.h>
 #include "imgui.h"
 #include <stdio.h>
 #include <gui/main_window.h>
@@ -19,6 +20,10 @@
 #include <stb_image_resize.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/filter/fir.h>
+#include <dsp/convert/sample_format.h>
+#include <dsp/math/reduce.h>
+#include <dsp/fft/planner.h>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -39,9 +44,13 @@ namespace core {
     CommandArgsParser args;
 
     void setInputSampleRate(double samplerate) {
-        // Forward this to the server
-        if (args["server"].b()) { server::setInputSampleRate(samplerate); return; }
-        
+        // The server has no display, its VFOs only need the new samplerate before it's forwarded to the clients
+        if (args["server"].b()) {
+            sigpath::iqFrontEnd.setSampleRate(samplerate);
+            server::setInputSampleRate(samplerate);
+            return;
+        }
+
         // Update IQ frontend input samplerate and get effective samplerate
         sigpath::iqFrontEnd.setSampleRate(samplerate);
         double effectiveSr  = sigpath::iqFrontEnd.getEffectiveSamplerate();
@@ -55,6 +64,10 @@ namespace core {
         // Debug logs
         flog::info("New DSP samplerate: {0} (source samplerate is {1})", effectiveSr, samplerate);
     }
+
+    bool isBatchMode() {
+        return !((std::string)args["batch"]).empty();
+    }
 };
 
 // main
@@ -80,8 +93,8 @@ int sdrpp_main(int argc, char* argv[]) {
     bool serverMode = (bool)core::args["server"];
 
 #ifdef _WIN32
-    // Free console if the user hasn't asked for a console and not in server mode
-    if (!core::args["con"].b() && !serverMode) { FreeConsole(); }
+    // Free console if the user hasn't asked for a console and not in server or batch mode
+    if (!core::args["con"].b() && !serverMode && !core::isBatchMode()) { FreeConsole(); }
 
     // Set error mode to avoid abnoxious popups
     SetErrorMode(SEM_NOOPENFILEERRORBOX | SEM_NOGPFAULTERRORBOX | SEM_FAILCRITICALERRORS);
@@ -115,6 +128,7 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["bandPlanPos"] = 0;
     defConfig["centerTuning"] = false;
     defConfig["colorMap"] = "Classic";
+    defConfig["configFormat"] = "pretty";
     defConfig["fftHold"] = false;
     defConfig["fftHoldSpeed"] = 60;
     defConfig["fftSmoothing"] = false;
@@ -123,8 +137,11 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["snrSmoothingSpeed"] = 20;
     defConfig["fastFFT"] = false;
     defConfig["fftHeight"] = 300;
+    defConfig["fftMode"] = 0;
+    defConfig["fftPlanning"] = "measure";
     defConfig["fftRate"] = 20;
     defConfig["fftSize"] = 65536;
+    defConfig["fftThreads"] = 0;
     defConfig["fftWindow"] = 2;
     defConfig["frequency"] = 100000000.0;
     defConfig["fullWaterfallUpdate"] = false;
@@ -230,6 +247,10 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["decimationPower"] = 0;
     defConfig["iqCorrection"] = false;
     defConfig["invertIQ"] = false;
+    defConfig["channelizerChannels"] = 0;
+    defConfig["dspScheduler"] = false;
+    defConfig["dspThreads"] = 0;
+    defConfig["dspProfiling"] = false;
 
     defConfig["streams"]["Radio"]["muted"] = false;
     defConfig["streams"]["Radio"]["sink"] = "Audio";
@@ -325,12 +346,47 @@ int sdrpp_main(int argc, char* argv[]) {
         core::configManager.conf["moduleInstances"][_name] = newMod;
     }
 
+    // Format the config is saved in from now on, "pretty", "compact" or "cbor"
+    std::string configFormat = core::configManager.conf["configFormat"];
+    if (configFormat == "compact") { core::configManager.setFormat(ConfigManager::FORMAT_COMPACT); }
+    else if (configFormat == "cbor") { core::configManager.setFormat(ConfigManager::FORMAT_CBOR); }
+    else { core::configManager.setFormat(ConfigManager::FORMAT_PRETTY); }
+
     // Load UI scaling
     style::uiScale = core::configManager.conf["uiScale"];
 
+    // Start the shared DSP thread pool if enabled (0 threads means one per core)
+    if (core::configManager.conf["dspScheduler"]) {
+        int dspThreads = core::configManager.conf["dspThreads"];
+        sigpath::scheduler.start(dspThreads);
+        flog::info("Started DSP scheduler with {0} threads", sigpath::scheduler.getThreadCount());
+    }
+
+    // Load the FFTW wisdom before any FFT gets planned, "estimate", "measure" or "patient" planning (0 threads means one per core)
+    std::string fftPlanning = core::configManager.conf["fftPlanning"];
+    dsp::fft::Effort fftEffort = dsp::fft::EFFORT_MEASURE;
+    if (fftPlanning == "estimate") { fftEffort = dsp::fft::EFFORT_ESTIMATE; }
+    else if (fftPlanning == "patient") { fftEffort = dsp::fft::EFFORT_PATIENT; }
+    int fftThreads = core::configManager.conf["fftThreads"];
+    dsp::fft::init(root + "/fftw_wisdom.dat", fftEffort, fftThreads);
+
+    flog::info("Sample format conversion kernels: {0}", dsp::convert::getSampleFormatKernels());
+    flog::info("Spectrum reduction kernels: {0}", dsp::math::getReduceKernels());
+
     core::configManager.release(true);
 
-    if (serverMode) { return server::main(); }
+    // Measure from how many taps the FIR filters are faster using the FFT engine on this machine. A batch run waits
+    // for it since its filters are all created right away, otherwise the default is used until it's done.
+    if (core::isBatchMode()) {
+        dsp::filter::measureFFTCrossovers();
+        return batch::main((std::string)core::args["batch"]);
+    }
+    if (serverMode) {
+        dsp::filter::startFFTCrossoverMeasurement();
+        int ret = server::main();
+        dsp::filter::stopFFTCrossoverMeasurement();
+        return ret;
+    }
 
     core::configManager.acquire();
     std::string resDir = core::configManager.conf["resourcesDirectory"];
@@ -367,6 +423,8 @@ int sdrpp_main(int argc, char* argv[]) {
     flog::info("Loading band plans color table");
     bandplan::loadColorTable(bandColors);
 
+    dsp::filter::startFFTCrossoverMeasurement();
+
     gui::mainWindow.init();
 
     flog::info("Ready.");
@@ -376,6 +434,8 @@ int sdrpp_main(int argc, char* argv[]) {
 
     // On android, none of this shutdown should happen due to the way the UI works
 #ifndef __ANDROID__
+    dsp::filter::stopFFTCrossoverMeasurement();
+
     // Shut down all modules
     for (auto& [name, mod] : core::moduleManager.modules) {
         mod.end();
@@ -385,6 +445,7 @@ int sdrpp_main(int argc, char* argv[]) {
     backend::end();
 
     sigpath::iqFrontEnd.stop();
+    sigpath::scheduler.stop();
 
     core::configManager.disableAutoSave();
     core::configManager.save();
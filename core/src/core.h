@@ -11,6 +11,9 @@ namespace core {
     SDRPP_EXPORT CommandArgsParser args;
 
     void setInputSampleRate(double samplerate);
+
+    // Processing a recording from the command line instead of running the GUI
+    bool isBatchMode();
 };
 
 int sdrpp_main(int argc, char* argv[]);
\ No newline at end of file
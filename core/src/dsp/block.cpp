@@ -0,0 +1,53 @@
+#include "block.h"
+#include "scheduler.h"
+#include "profiler.h"
+
+namespace dsp {
+    void block::setScheduler(Scheduler* sched, const std::string& name) {
+        assert(_block_init);
+        std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+        tempStop();
+        _scheduler = sched;
+        _schedName = name;
+        tempStart();
+    }
+
+    void block::setProfiler(Profiler* prof, const std::string& name) {
+        // Not done under the control mutex since the profiler takes it while holding its own
+        Profiler* old = _profiler.exchange(prof);
+        if (old) { old->remove(this); }
+        if (prof) { prof->add(this, name); }
+    }
+
+    void block::doStart() {
+        if (_scheduler) {
+            _scheduler->add(this, _schedName);
+            return;
+        }
+        workerThread = std::thread(&block::workerLoop, this);
+    }
+
+    void block::doStop() {
+        for (auto& in : inputs) {
+            in->stopReader();
+        }
+        for (auto& out : outputs) {
+            out->stopWriter();
+        }
+
+        if (_scheduler) {
+            _scheduler->remove(this);
+        }
+        // TODO: Make sure this isn't needed, I don't know why it stops
+        else if (workerThread.joinable()) {
+            workerThread.join();
+        }
+
+        for (auto& in : inputs) {
+            in->clearReadStop();
+        }
+        for (auto& out : outputs) {
+            out->clearWriteStop();
+        }
+    }
+}
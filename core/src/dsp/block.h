@@ -3,10 +3,16 @@
 #include <thread>
 #include <vector>
 #include <algorithm>
+#include <string>
 #include "stream.h"
 #include "types.h"
 
 namespace dsp {
+    template <class T>
+    class chain;
+    class Scheduler;
+    class Profiler;
+
     class generic_block {
     public:
         virtual void start() {}
@@ -15,12 +21,17 @@ namespace dsp {
     };
 
     class block : public generic_block {
+        template <class T>
+        friend class chain;
+        friend class Scheduler;
+        friend class Profiler;
     public:
         virtual void init() {}
 
         virtual ~block() {
             if (!_block_init) { return; }
             stop();
+            if (_profiler) { setProfiler(NULL); }
             _block_init = false;
         }
 
@@ -64,35 +75,31 @@ namespace dsp {
 
         virtual int run() = 0;
 
-    protected:
-        void workerLoop() {
-            while (run() >= 0) {}
-        }
-
-        virtual void doStart() {
-            workerThread = std::thread(&block::workerLoop, this);
-        }
+        // Run the block on a shared scheduler instead of its own thread (NULL to go back to a thread).
+        // Only valid for blocks whose run() does at most one read() per input and one swap() per output.
+        void setScheduler(Scheduler* sched, const std::string& name = "");
 
-        virtual void doStop() {
-            for (auto& in : inputs) {
-                in->stopReader();
-            }
-            for (auto& out : outputs) {
-                out->stopWriter();
-            }
-
-            // TODO: Make sure this isn't needed, I don't know why it stops
-            if (workerThread.joinable()) {
-                workerThread.join();
-            }
+        // Record execution counters and list the block in a profiler (NULL to stop profiling it).
+        // The profiler reads the block's streams, so it must be removed before they get destroyed.
+        void setProfiler(Profiler* prof, const std::string& name = "");
 
-            for (auto& in : inputs) {
-                in->clearReadStop();
-            }
-            for (auto& out : outputs) {
-                out->clearWriteStop();
+    protected:
+        void workerLoop() {
+            while (true) {
+                if (!_profiler) {
+                    if (run() < 0) { return; }
+                    continue;
+                }
+                uint64_t start = profilerTime();
+                int ret = run();
+                runTime += profilerTime() - start;
+                runs++;
+                if (ret < 0) { return; }
             }
         }
+
+        virtual void doStart();
+        virtual void doStop();
     
         void acquire() {
             ctrlMtx.lock();
@@ -104,18 +111,33 @@ namespace dsp {
 
         void registerInput(untyped_stream* inStream) {
             inputs.push_back(inStream);
+            if (streamsProfiled) { inStream->setProfiled(true); }
         }
 
         void unregisterInput(untyped_stream* inStream) {
-            inputs.erase(std::remove(inputs.begin(), inputs.end(), inStream), inputs.end());
+            auto it = std::remove(inputs.begin(), inputs.end(), inStream);
+            if (streamsProfiled && it != inputs.end()) { inStream->setProfiled(false); }
+            inputs.erase(it, inputs.end());
         }
 
         void registerOutput(untyped_stream* outStream) {
             outputs.push_back(outStream);
+            if (streamsProfiled) { outStream->setProfiled(true); }
         }
 
         void unregisterOutput(untyped_stream* outStream) {
-            outputs.erase(std::remove(outputs.begin(), outputs.end(), outStream), outputs.end());
+            auto it = std::remove(outputs.begin(), outputs.end(), outStream);
+            if (streamsProfiled && it != outputs.end()) { outStream->setProfiled(false); }
+            outputs.erase(it, outputs.end());
+        }
+
+        // Turn on the profiling counters of the block's streams, they're off by default to keep them cheap
+        void setStreamsProfiled(bool profiled) {
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            if (streamsProfiled == profiled) { return; }
+            streamsProfiled = profiled;
+            for (auto& in : inputs) { in->setProfiled(profiled); }
+            for (auto& out : outputs) { out->setProfiled(profiled); }
         }
 
         bool _block_init = false;
@@ -129,5 +151,15 @@ namespace dsp {
         bool tempStopped = false;
         int tempStopDepth = 0;
         std::thread workerThread;
+
+        Scheduler* _scheduler = NULL;
+        std::string _schedName;
+
+        // Profiling counters, times are in nanoseconds
+        std::atomic<Profiler*> _profiler = NULL;
+        bool streamsProfiled = false;
+        std::atomic<uint64_t> runs = 0;
+        std::atomic<uint64_t> runTime = 0;
+        std::atomic<uint64_t> fusedSamples = 0; // Samples processed by a fused chain without going through the input stream
     };
-}
\ No newline at end of file
+}
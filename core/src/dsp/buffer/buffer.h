@@ -1,5 +1,7 @@
 #pragma once
 #include <volk/volk.h>
+#include <string.h>
+#include <algorithm>
 
 namespace dsp::buffer {
     template<class T>
@@ -15,4 +17,21 @@ namespace dsp::buffer {
     inline void free(void* buffer) {
         volk_free(buffer);
     }
+
+    // Make sure a buffer holds at least count samples, keeping its first keep samples if it has to grow.
+    // It grows by at least half its capacity so that small variations of the block size don't reallocate every time.
+    // Returns true if the buffer was reallocated.
+    template<class T>
+    inline bool reserve(T*& buffer, int& capacity, int count, int keep = 0) {
+        if (count <= capacity) { return false; }
+        int newCapacity = std::max<int>(count, capacity + (capacity / 2));
+        T* newBuffer = alloc<T>(newCapacity);
+        if (buffer) {
+            memcpy(newBuffer, buffer, keep * sizeof(T));
+            free(buffer);
+        }
+        buffer = newBuffer;
+        capacity = newCapacity;
+        return true;
+    }
 }
\ No newline at end of file
@@ -24,8 +24,10 @@ namespace dsp::buffer {
         void init(stream<T>* in) {
             _in = in;
 
+            // The frames are allocated to the size of the incoming blocks as they get written
             for (int i = 0; i < TEST_BUFFER_SIZE; i++) {
-                buffers[i] = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+                buffers[i] = NULL;
+                capacities[i] = 0;
             }
 
             base_type::registerInput(in);
@@ -54,6 +56,7 @@ namespace dsp::buffer {
             if (count < 0) { return -1; }
 
             if (bypass) {
+                out.reserve(count);
                 memcpy(out.writeBuf, _in->readBuf, count * sizeof(T));
                 _in->flush();
                 if (!out.swap(count)) { return -1; }
@@ -63,6 +66,7 @@ namespace dsp::buffer {
             // Push it on the ring buffer
             {
                 std::lock_guard<std::mutex> lck(bufMtx);
+                buffer::reserve(buffers[writeCur], capacities[writeCur], count);
                 memcpy(buffers[writeCur], _in->readBuf, count * sizeof(T));
                 sizes[writeCur] = count;
                 writeCur++;
@@ -82,6 +86,7 @@ namespace dsp::buffer {
 
                 // Write one to output buffer and unlock in preparation to swap buffers
                 int count = sizes[readCur];
+                out.reserve(count);
                 memcpy(out.writeBuf, buffers[readCur], count * sizeof(T));
                 readCur++;
                 readCur = ((readCur) % TEST_BUFFER_SIZE);
@@ -92,7 +97,7 @@ namespace dsp::buffer {
             }
         }
 
-        stream<T> out;
+        stream<T> out{ 0 };
 
         int writeCur = 0;
         int readCur = 0;
@@ -126,6 +131,7 @@ namespace dsp::buffer {
         std::condition_variable cnd;
         T* buffers[TEST_BUFFER_SIZE];
         int sizes[TEST_BUFFER_SIZE];
+        int capacities[TEST_BUFFER_SIZE];
 
         bool stopWorker = false;
     };
@@ -1,14 +1,37 @@
 #pragma once
 #include <vector>
 #include <map>
+#include <type_traits>
 #include "processor.h"
 
+// Number of samples pushed through all blocks of a fused segment at once
+#define CHAIN_DEFAULT_FUSED_CHUNK_SIZE  4096
+
 namespace dsp {
     template<class T>
     class chain {
+        typedef int (*process_func)(Processor<T, T>* block, int count, T* in, T* out);
+        typedef int (*max_output_func)(Processor<T, T>* block, int count);
+
+        // Detects blocks that have an inline process(count, in, out) method
+        template <class B, class = void>
+        struct has_process : std::false_type {};
+        template <class B>
+        struct has_process<B, std::void_t<decltype((int)std::declval<B&>().process(0, (T*)NULL, (T*)NULL))>> : std::true_type {};
+
+        // Detects blocks that can output more samples than they're given, they tell how many with getMaxOutput(count)
+        template <class B, class = void>
+        struct has_max_output : std::false_type {};
+        template <class B>
+        struct has_max_output<B, std::void_t<decltype((int)std::declval<B&>().getMaxOutput(0))>> : std::true_type {};
+
     public:
         chain() {}
 
+        ~chain() {
+            for (auto& seg : segments) { delete seg; }
+        }
+
         chain(stream<T>* in) { init(in); }
 
         void init(stream<T>* in) {
@@ -18,18 +41,40 @@ namespace dsp {
 
         template<typename Func>
         void setInput(stream<T>* in, Func onOutputChange) {
+            if (running && fused) { stopFused(); }
             _in = in;
             for (auto& ln : links) {
                 if (states[ln]) {
                     ln->setInput(_in);
+                    if (running && fused) { startFused(); }
                     return;
                 }
             }
             out = _in;
             onOutputChange(out);
         }
-        
-        void addBlock(Processor<T, T>* block, bool enabled) {
+
+        // In fused mode, consecutive enabled blocks that have an inline process() are run back to back
+        // by a single worker thread on small chunks instead of each having their own thread.
+        // Blocks without an inline process() keep running in their own thread.
+        void setFused(bool enabled) {
+            if (fused == enabled) { return; }
+            bool wasRunning = running;
+            stop();
+            fused = enabled;
+            if (wasRunning) { start(); }
+        }
+
+        void setFusedChunkSize(int size) {
+            assert(size > 0);
+            bool wasRunning = running;
+            stop();
+            chunkSize = size;
+            if (wasRunning) { start(); }
+        }
+
+        template<class B>
+        void addBlock(B* block, bool enabled) {
             // Check if block is already part of the chain
             if (blockExists(block)) {
                 throw std::runtime_error("[chain] Tried to add a block that is already part of the chain");
@@ -38,6 +83,10 @@ namespace dsp {
             // Add to the list
             links.push_back(block);
             states[block] = false;
+            if constexpr (has_process<B>::value) {
+                processFuncs[block] = &fusedProcess<B>;
+                maxOutputFuncs[block] = &fusedMaxOutput<B>;
+            }
 
             // Enable if needed
             if (enabled) { enableBlock(block, [](stream<T>* out){}); }
@@ -55,6 +104,8 @@ namespace dsp {
         
             // Remove block from the list
             states.erase(block);
+            processFuncs.erase(block);
+            maxOutputFuncs.erase(block);
             links.erase(std::find(links.begin(), links.end(), block));
         }
 
@@ -67,6 +118,7 @@ namespace dsp {
             
             // If already enable, don't do anything
             if (states[block]) { return; }
+            if (running && fused) { stopFused(); }
 
             // Gather blocks before and after the block to enable
             Processor<T, T>* before = blockBefore(block);
@@ -85,8 +137,11 @@ namespace dsp {
             block->setInput(before ? &before->out : _in);
 
             // Start new block
-            if (running) { block->start(); }
             states[block] = true;
+            if (running) {
+                if (fused) { startFused(); }
+                else { block->start(); }
+            }
         }
 
         template<typename Func>
@@ -100,6 +155,7 @@ namespace dsp {
             if (!states[block]) { return; }
 
             // Stop disabled block
+            if (running && fused) { stopFused(); }
             block->stop();
             states[block] = false;
 
@@ -115,6 +171,8 @@ namespace dsp {
                 out = before ? &before->out : _in;
                 onOutputChange(out);
             }
+
+            if (running && fused) { startFused(); }
         }
 
         template<typename Func>
@@ -143,18 +201,28 @@ namespace dsp {
 
         void start() {
             if (running) { return; }
-            for (auto& ln : links) {
-                if (!states[ln]) { continue; }
-                ln->start();
+            if (fused) {
+                startFused();
+            }
+            else {
+                for (auto& ln : links) {
+                    if (!states[ln]) { continue; }
+                    ln->start();
+                }
             }
             running = true;
         }
 
         void stop() {
             if (!running) { return; }
-            for (auto& ln : links) {
-                if (!states[ln]) { continue; }
-                ln->stop();
+            if (fused) {
+                stopFused();
+            }
+            else {
+                for (auto& ln : links) {
+                    if (!states[ln]) { continue; }
+                    ln->stop();
+                }
             }
             running = false;
         }
@@ -162,11 +230,164 @@ namespace dsp {
         stream<T>* out;
 
     private:
+        struct segment {
+            stream<T>* in;
+            stream<T>* out;
+            std::vector<Processor<T, T>*> blocks;
+            std::vector<process_func> funcs;
+            std::vector<max_output_func> maxOutputFuncs;
+            T* work[2];
+            int workCap[2];
+            std::thread workerThread;
+        };
+
+        template<class B>
+        static int fusedProcess(Processor<T, T>* block, int count, T* in, T* out) {
+            return static_cast<B*>(block)->process(count, in, out);
+        }
+
+        template<class B>
+        static int fusedMaxOutput(Processor<T, T>* block, int count) {
+            if constexpr (has_max_output<B>::value) {
+                return static_cast<B*>(block)->getMaxOutput(count);
+            }
+            else {
+                return count;
+            }
+        }
+
+        void startFused() {
+            // Split the enabled blocks into runs of fusable blocks
+            stream<T>* lastOut = _in;
+            segment* seg = NULL;
+            for (auto& ln : links) {
+                if (!states[ln]) { continue; }
+                auto it = processFuncs.find(ln);
+                if (it == processFuncs.end()) {
+                    // Not fusable, let it run in its own thread
+                    seg = NULL;
+                    ln->start();
+                }
+                else {
+                    if (!seg) {
+                        seg = new segment;
+                        seg->in = lastOut;
+                        segments.push_back(seg);
+                    }
+                    seg->blocks.push_back(ln);
+                    seg->funcs.push_back(it->second);
+                    seg->maxOutputFuncs.push_back(maxOutputFuncs[ln]);
+                    seg->out = &ln->out;
+                }
+                lastOut = &ln->out;
+            }
+
+            // Start the segments, those with a single block gain nothing from being fused
+            for (auto& seg : segments) {
+                if (seg->blocks.size() == 1) {
+                    seg->blocks[0]->start();
+                    continue;
+                }
+
+                // Size the work buffers for a full chunk going through the blocks with their current settings
+                seg->work[0] = seg->work[1] = NULL;
+                seg->workCap[0] = seg->workCap[1] = 0;
+                int size = chunkSize;
+                int last = seg->blocks.size() - 1;
+                for (int i = 0; i < last; i++) {
+                    std::lock_guard<std::recursive_mutex> lck(seg->blocks[i]->ctrlMtx);
+                    size = seg->maxOutputFuncs[i](seg->blocks[i], size);
+                    buffer::reserve(seg->work[i & 1], seg->workCap[i & 1], size);
+                }
+                seg->workerThread = std::thread(&chain::fusedWorker, this, seg);
+            }
+        }
+
+        void stopFused() {
+            for (auto& seg : segments) {
+                if (seg->blocks.size() == 1) { continue; }
+                seg->in->stopReader();
+                seg->out->stopWriter();
+                if (seg->workerThread.joinable()) { seg->workerThread.join(); }
+                seg->in->clearReadStop();
+                seg->out->clearWriteStop();
+                buffer::free(seg->work[0]);
+                buffer::free(seg->work[1]);
+            }
+
+            // Stop the blocks running in their own thread (no-op for the fused ones)
+            for (auto& ln : links) {
+                if (!states[ln]) { continue; }
+                ln->stop();
+            }
+
+            for (auto& seg : segments) { delete seg; }
+            segments.clear();
+        }
+
+        void fusedWorker(segment* seg) {
+            int last = seg->blocks.size() - 1;
+            while (true) {
+                int count = seg->in->read();
+                if (count < 0) { return; }
+
+                // Push the input through all blocks one chunk at a time so that the data stays in cache
+                int outCount = 0;
+                for (int offset = 0; offset < count; offset += chunkSize) {
+                    int chunkCount = std::min<int>(chunkSize, count - offset);
+                    T* data = &seg->in->readBuf[offset];
+                    for (int i = 0; i <= last && chunkCount; i++) {
+                        T* dst;
+                        {
+                            // Settings of a block are changed under its control mutex
+                            Processor<T, T>* blk = seg->blocks[i];
+                            std::lock_guard<std::recursive_mutex> lck(blk->ctrlMtx);
+
+                            // Make room for the output, the blocks' ratios can change between chunks. The content of
+                            // the output is lost when it grows, so what's already in there is sent first.
+                            int maxOutput = seg->maxOutputFuncs[i](blk, chunkCount);
+                            if (i < last) {
+                                buffer::reserve(seg->work[i & 1], seg->workCap[i & 1], maxOutput);
+                                dst = seg->work[i & 1];
+                            }
+                            else {
+                                if (outCount + maxOutput > seg->out->getBufferSize()) {
+                                    if (outCount && !seg->out->swap(outCount)) { return; }
+                                    outCount = 0;
+                                    seg->out->reserve(maxOutput);
+                                }
+                                dst = &seg->out->writeBuf[outCount];
+                            }
+
+                            if (blk->_profiler) {
+                                // The first block's input is still read through its stream
+                                if (i) { blk->fusedSamples += chunkCount; }
+                                uint64_t start = profilerTime();
+                                chunkCount = seg->funcs[i](blk, chunkCount, data, dst);
+                                blk->runTime += profilerTime() - start;
+                                blk->runs++;
+                            }
+                            else {
+                                chunkCount = seg->funcs[i](blk, chunkCount, data, dst);
+                            }
+                        }
+                        data = dst;
+                    }
+                    outCount += chunkCount;
+                }
+
+                seg->in->flush();
+                if (outCount) {
+                    if (!seg->out->swap(outCount)) { return; }
+                }
+            }
+        }
+
         Processor<T, T>* blockBefore(Processor<T, T>* block) {
-            // TODO: This is wrong and must be fixed when I get more time
+            Processor<T, T>* before = NULL;
             for (auto& ln : links) {
-                if (ln == block) { return NULL; }
-                if (states[ln]) { return ln; }
+                if (ln == block) { return before; }
+                if (states[ln]) { before = ln; }
             }
             return NULL;
         }
@@ -190,6 +411,11 @@ namespace dsp {
         stream<T>* _in;
         std::vector<Processor<T, T>*> links;
         std::map<Processor<T, T>*, bool> states;
+        std::map<Processor<T, T>*, process_func> processFuncs;
+        std::map<Processor<T, T>*, max_output_func> maxOutputFuncs;
+        std::vector<segment*> segments;
         bool running = false;
+        bool fused = false;
+        int chunkSize = CHAIN_DEFAULT_FUSED_CHUNK_SIZE;
     };
 }
\ No newline at end of file
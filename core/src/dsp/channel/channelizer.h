@@ -0,0 +1,241 @@
+#pragma once
+#include "../sink.h"
+#include "../taps/windowed_sinc.h"
+#include "../taps/estimate_tap_count.h"
+#include "../window/nuttall.h"
+#include "../math/constants.h"
+#include "../fft/planner.h"
+
+// Default number of channels of the filter bank
+#define CHANNELIZER_DEFAULT_CHANNEL_COUNT   64
+
+namespace dsp::channel {
+    // 2x oversampled polyphase filter bank channelizer. The input band is split into channelCount
+    // channels spaced by samplerate/channelCount, channel k being centered on k*samplerate/channelCount
+    // (channels above channelCount/2 are the negative frequencies). Each channel is output at
+    // 2*samplerate/channelCount, which leaves room for signals that are not centered on the channel.
+    // All channels are computed with a single FFT per output sample, only the bound ones are written.
+    class Channelizer : public Sink<complex_t> {
+        using base_type = Sink<complex_t>;
+    public:
+        // Fraction of the channel spacing, on each side of the channel center, that is free of aliasing
+        static constexpr double PASSBAND = 0.75;
+
+        Channelizer() {}
+
+        Channelizer(stream<complex_t>* in, int channelCount) { init(in, channelCount); }
+
+        ~Channelizer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            destroyBuffers();
+        }
+
+        void init(stream<complex_t>* in, int channelCount) {
+            assert(channelCount >= 4 && !(channelCount % 2));
+            _channelCount = channelCount;
+            initBuffers();
+            base_type::init(in);
+        }
+
+        void setChannelCount(int channelCount) {
+            assert(base_type::_block_init);
+            assert(channelCount >= 4 && !(channelCount % 2));
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            if (channelCount == _channelCount) { return; }
+            base_type::tempStop();
+
+            // Channels that no longer exist can't stay bound
+            for (auto it = outputs.begin(); it != outputs.end();) {
+                if (it->channel >= channelCount) {
+                    base_type::unregisterOutput(it->out);
+                    it = outputs.erase(it);
+                    continue;
+                }
+                it++;
+            }
+
+            _channelCount = channelCount;
+            destroyBuffers();
+            initBuffers();
+            base_type::tempStart();
+        }
+
+        int getChannelCount() {
+            return _channelCount;
+        }
+
+        void bindChannel(int channel, stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            assert(channel >= 0 && channel < _channelCount);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the stream isn't already bound
+            for (const auto& o : outputs) {
+                if (o.out == stream) {
+                    throw std::runtime_error("[Channelizer] Tried to bind stream to that is already bound");
+                }
+            }
+
+            // Add to the list
+            base_type::tempStop();
+            base_type::registerOutput(stream);
+            outputs.push_back({ channel, stream });
+            base_type::tempStart();
+        }
+
+        void unbindChannel(stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the stream is bound
+            auto oit = std::find_if(outputs.begin(), outputs.end(), [stream](const Output& o) { return o.out == stream; });
+            if (oit == outputs.end()) {
+                throw std::runtime_error("[Channelizer] Tried to unbind stream to that isn't bound");
+            }
+
+            // Remove from the list
+            base_type::tempStop();
+            outputs.erase(oit);
+            base_type::unregisterOutput(stream);
+            base_type::tempStart();
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            buffer::clear(buffer, ftaps.size - 1);
+            offset = 0;
+            odd = false;
+            base_type::tempStart();
+        }
+
+        inline int process(int count, const complex_t* in) {
+            // Copy data to work buffer
+            if (buffer::reserve(buffer, bufCapacity, ftaps.size - 1 + count, ftaps.size - 1)) {
+                bufStart = &buffer[ftaps.size - 1];
+            }
+            memcpy(bufStart, in, count * sizeof(complex_t));
+
+            // Compute one output sample per channel every half FFT
+            int outCount = 0;
+            int decim = _channelCount / 2;
+            for (const auto& o : outputs) { o.out->reserve((count / decim) + 1); }
+            if (outputs.empty()) {
+                // Nothing to compute, only keep the output phase
+                for (; offset < count; offset += decim) { odd = !odd; }
+            }
+            for (; offset < count; offset += decim) {
+                // Apply the prototype filter (its taps are symmetric so no need to reverse them)
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)prod, (lv_32fc_t*)&buffer[offset], ftaps.taps, ftaps.size);
+
+                // Fold the filtered window into the FFT input
+                memcpy(fftIn, prod, _channelCount * sizeof(complex_t));
+                for (int i = _channelCount; i < ftaps.size; i += _channelCount) {
+                    volk_32f_x2_add_32f((float*)fftIn, (float*)fftIn, (float*)&prod[i], _channelCount * 2);
+                }
+
+                // Do FFT, each bin is now one channel
+                fftwf_execute(plan);
+
+                // Correct the phase of the bound channels. Since the hop is half the FFT size,
+                // odd channels flip sign on every other output sample.
+                for (const auto& o : outputs) {
+                    complex_t corr = phase[o.channel];
+                    if (odd && (o.channel & 1)) { corr = corr * -1.0f; }
+                    o.out->writeBuf[outCount] = fftOut[o.channel] * corr;
+                }
+                outCount++;
+                odd = !odd;
+            }
+            offset -= count;
+
+            // Move unused data
+            memmove(buffer, &buffer[count], (ftaps.size - 1) * sizeof(complex_t));
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf);
+
+            base_type::_in->flush();
+
+            // Swap if some data was generated
+            if (outCount) {
+                for (const auto& o : outputs) {
+                    if (!o.out->swap(outCount)) { return -1; }
+                }
+            }
+            return count;
+        }
+
+    protected:
+        struct Output {
+            int channel;
+            stream<complex_t>* out;
+        };
+
+        void initBuffers() {
+            // Prototype low-pass: flat up to PASSBAND channel spacings, fully attenuated at 2-PASSBAND
+            // so that the images folded back by the decimation never land in the passband.
+            // The tap count is rounded up to a whole number of FFTs.
+            double transWidth = (1.0 - PASSBAND) * 2.0 / (double)_channelCount;
+            int count = taps::estimateTapCount(transWidth, 1.0);
+            count = ((count + _channelCount - 1) / _channelCount) * _channelCount;
+            ftaps = taps::windowedSinc<float>(count, 1.0 / (double)_channelCount, 1.0, window::nuttall);
+
+            // Constant phase rotation of each channel due to the fold
+            phase = buffer::alloc<complex_t>(_channelCount);
+            for (int i = 0; i < _channelCount; i++) {
+                double angle = -2.0 * DB_M_PI * (double)i / (double)_channelCount;
+                phase[i] = { (float)cos(angle), (float)sin(angle) };
+            }
+
+            // The room for the input samples is allocated by the first process()
+            buffer = NULL;
+            bufCapacity = 0;
+            buffer::reserve(buffer, bufCapacity, ftaps.size);
+            bufStart = &buffer[ftaps.size - 1];
+            buffer::clear(buffer, ftaps.size - 1);
+            prod = buffer::alloc<complex_t>(ftaps.size);
+
+            fftIn = (complex_t*)fftwf_malloc(_channelCount * sizeof(complex_t));
+            fftOut = (complex_t*)fftwf_malloc(_channelCount * sizeof(complex_t));
+            plan = fft::planDFT(_channelCount, (fftwf_complex*)fftIn, (fftwf_complex*)fftOut, FFTW_FORWARD);
+
+            offset = 0;
+            odd = false;
+        }
+
+        void destroyBuffers() {
+            taps::free(ftaps);
+            buffer::free(phase);
+            buffer::free(buffer);
+            buffer::free(prod);
+            fft::destroyPlan(plan);
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+        }
+
+        int _channelCount;
+        std::vector<Output> outputs;
+
+        tap<float> ftaps;
+        complex_t* phase;
+        complex_t* buffer;
+        complex_t* bufStart;
+        int bufCapacity;
+        complex_t* prod;
+        complex_t* fftIn;
+        complex_t* fftOut;
+        fftwf_plan plan;
+
+        int offset = 0;
+        bool odd = false;
+    };
+}
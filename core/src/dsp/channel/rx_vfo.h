@@ -29,6 +29,12 @@ namespace dsp::channel {
             generateTaps();
             filter.init(NULL, ftaps);
 
+            // Only used for processing, and the output buffers are sized by run() from the block size
+            xlator.out.free();
+            resamp.out.free();
+            filter.out.free();
+            base_type::out.free();
+
             base_type::init(in);
         }
 
@@ -103,6 +109,8 @@ namespace dsp::channel {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            // The output buffer is also used for the input rate samples before resampling
+            out.reserve(std::max<int>(count, ceil((double)count * _outSamplerate / _inSamplerate) + 1));
             int outCount = process(count, base_type::_in->readBuf, out.writeBuf);
 
             // Swap if some data was generated
@@ -0,0 +1,320 @@
+#include "pcm_codec.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace dsp::compression {
+    inline uint64_t bitMask(int bits) {
+        return (bits >= 64) ? ~0ull : ((1ull << bits) - 1);
+    }
+
+    // MSB first bit packing
+    class BitWriter {
+    public:
+        BitWriter(uint8_t* out) : start(out), ptr(out) {}
+
+        // At most 32 bits at a time
+        inline void write(uint32_t value, int bits) {
+            acc = (acc << bits) | (value & bitMask(bits));
+            accBits += bits;
+            while (accBits >= 8) {
+                accBits -= 8;
+                *ptr++ = (uint8_t)(acc >> accBits);
+            }
+        }
+
+        // q zeros followed by a one
+        inline void writeUnary(uint32_t q) {
+            for (; q >= 31; q -= 31) { write(0, 31); }
+            write(1, q + 1);
+        }
+
+        // Pad the last byte with zeros and return the number of bytes written
+        int flush() {
+            if (accBits) { write(0, 8 - accBits); }
+            return ptr - start;
+        }
+
+    private:
+        uint8_t* start;
+        uint8_t* ptr;
+        uint64_t acc = 0;
+        int accBits = 0;
+    };
+
+    // Reads what BitWriter wrote, every read fails past the end of the data
+    class BitReader {
+    public:
+        BitReader(const uint8_t* in, int len) : ptr(in), end(in + len) {}
+
+        inline bool read(int bits, uint32_t& value) {
+            while (accBits < bits) {
+                if (ptr >= end) { return false; }
+                acc = (acc << 8) | *ptr++;
+                accBits += 8;
+            }
+            accBits -= bits;
+            value = (uint32_t)((acc >> accBits) & bitMask(bits));
+            return true;
+        }
+
+        inline bool readUnary(uint32_t& q, uint32_t limit) {
+            q = 0;
+            while (true) {
+                // Skip whole bytes of zeros at once
+                if (!(acc & bitMask(accBits))) {
+                    q += accBits;
+                    accBits = 0;
+                    if (q > limit || ptr >= end) { return false; }
+                    acc = *ptr++;
+                    accBits = 8;
+                    continue;
+                }
+                accBits--;
+                if ((acc >> accBits) & 1) { return true; }
+                q++;
+            }
+        }
+
+    private:
+        const uint8_t* ptr;
+        const uint8_t* end;
+        uint64_t acc = 0;
+        int accBits = 0;
+    };
+
+    inline int typeBits(PCMType type) {
+        switch (type) {
+            case PCM_TYPE_BFP8: return 8;
+            case PCM_TYPE_BFP10: return 10;
+            case PCM_TYPE_BFP12: return 12;
+            case PCM_TYPE_RICE16: return 16;
+            case PCM_TYPE_RICE12: return 12;
+            default: return 0;
+        }
+    }
+
+    inline float maxAbs(const float* in, int count) {
+        float maxVal = 0.0f;
+        for (int i = 0; i < count; i++) { maxVal = std::max<float>(maxVal, fabsf(in[i])); }
+        return maxVal;
+    }
+
+    inline int32_t quantize(float val, float scale, int32_t maxQ) {
+        float q = std::clamp<float>(val * scale, -maxQ, maxQ);
+        return (q == q) ? (int32_t)lrintf(q) : 0;
+    }
+
+    // Layout: uint32 count, then for every block an int8 exponent and the mantissas of I and Q interleaved.
+    // The last block is padded with zeros.
+    static int encodeBFP(const complex_t* in, int count, int bits, uint8_t* out) {
+        const float* vals = (const float*)in;
+        const int32_t maxQ = (1 << (bits - 1)) - 1;
+        *(uint32_t*)out = count;
+        BitWriter bw(&out[4]);
+        for (int start = 0; start < count; start += PCM_BFP_BLOCK_SIZE) {
+            int n = std::min<int>(PCM_BFP_BLOCK_SIZE, count - start) * 2;
+            const float* block = &vals[start * 2];
+
+            // Exponent of the largest component, it then fits in the mantissa
+            int exp = 0;
+            float maxVal = maxAbs(block, n);
+            if (maxVal > 0.0f && std::isfinite(maxVal)) { frexpf(maxVal, &exp); }
+            exp = std::clamp<int>(exp, -100, 127);
+            bw.write((uint8_t)(int8_t)exp, 8);
+
+            float scale = ldexpf(1.0f, (bits - 1) - exp);
+            for (int i = 0; i < PCM_BFP_BLOCK_SIZE * 2; i++) {
+                bw.write((i < n) ? (uint32_t)quantize(block[i], scale, maxQ) : 0, bits);
+            }
+        }
+        return 4 + bw.flush();
+    }
+
+    static int decodeBFP(const uint8_t* in, int len, int bits, complex_t* out, int maxCount) {
+        if (len < 4) { return -1; }
+        uint32_t count = *(uint32_t*)in;
+        if (count > (uint32_t)maxCount) { return -1; }
+        size_t blocks = (count + PCM_BFP_BLOCK_SIZE - 1) / PCM_BFP_BLOCK_SIZE;
+        size_t blockSize = 1 + (PCM_BFP_BLOCK_SIZE * 2 * bits) / 8;
+        if ((size_t)len < 4 + blocks * blockSize) { return -1; }
+
+        float* vals = (float*)out;
+        BitReader br(&in[4], len - 4);
+        for (uint32_t start = 0; start < count; start += PCM_BFP_BLOCK_SIZE) {
+            int n = std::min<uint32_t>(PCM_BFP_BLOCK_SIZE, count - start) * 2;
+            float* block = &vals[start * 2];
+            uint32_t exp, q;
+            if (!br.read(8, exp)) { return -1; }
+            float scale = ldexpf(1.0f, (int)(int8_t)exp - (bits - 1));
+            for (int i = 0; i < PCM_BFP_BLOCK_SIZE * 2; i++) {
+                if (!br.read(bits, q)) { return -1; }
+                if (i < n) { block[i] = (float)((int32_t)(q << (32 - bits)) >> (32 - bits)) * scale; }
+            }
+        }
+        return count;
+    }
+
+    inline uint32_t zigzag(int32_t val) {
+        return ((uint32_t)val << 1) ^ (uint32_t)(val >> 31);
+    }
+
+    inline int32_t unzigzag(uint32_t val) {
+        return (int32_t)(val >> 1) ^ -(int32_t)(val & 1);
+    }
+
+    // Layout: uint32 count, float scaler, then for every block and for I then Q, the order of the predictor (2 bits),
+    // the Rice parameter (5 bits, 31 for raw residuals) and the residuals. The predictors carry over from block to block.
+    static int encodeRice(const complex_t* in, int count, int bits, uint8_t* out) {
+        const float* vals = (const float*)in;
+        const int32_t maxQ = (1 << (bits - 1)) - 1;
+        const int rawBits = bits + 2; // Largest residual of the order 2 predictor, zigzag mapped
+
+        float maxVal = maxAbs(vals, count * 2);
+        if (!std::isfinite(maxVal)) { maxVal = 0.0f; }
+        float scale = (maxVal > 0.0f) ? (float)maxQ / maxVal : 0.0f;
+        *(uint32_t*)out = count;
+        *(float*)&out[4] = maxVal;
+
+        BitWriter bw(&out[8]);
+        int32_t hist[2][2] = { { 0, 0 }, { 0, 0 } };
+        uint32_t res[3][PCM_RICE_BLOCK_SIZE];
+        for (int start = 0; start < count; start += PCM_RICE_BLOCK_SIZE) {
+            int n = std::min<int>(PCM_RICE_BLOCK_SIZE, count - start);
+            for (int c = 0; c < 2; c++) {
+                // Residual of every predictor
+                int32_t x1 = hist[c][0];
+                int32_t x2 = hist[c][1];
+                uint64_t sums[3] = { 0, 0, 0 };
+                for (int i = 0; i < n; i++) {
+                    int32_t x = quantize(vals[(start + i) * 2 + c], scale, maxQ);
+                    res[0][i] = zigzag(x);
+                    res[1][i] = zigzag(x - x1);
+                    res[2][i] = zigzag(x - 2 * x1 + x2);
+                    sums[0] += res[0][i];
+                    sums[1] += res[1][i];
+                    sums[2] += res[2][i];
+                    x2 = x1;
+                    x1 = x;
+                }
+                hist[c][0] = x1;
+                hist[c][1] = x2;
+                int order = 0;
+                if (sums[1] < sums[order]) { order = 1; }
+                if (sums[2] < sums[order]) { order = 2; }
+                const uint32_t* r = res[order];
+
+                // The parameter close to log2 of the mean residual is best, check its neighbours and the raw residuals
+                int k = 0;
+                while (k < rawBits && ((uint64_t)n << (k + 1)) <= sums[order]) { k++; }
+                int bestK = 31;
+                uint64_t bestCost = (uint64_t)n * rawBits;
+                for (int ck = std::max<int>(k - 1, 0); ck <= std::min<int>(k + 1, rawBits - 1); ck++) {
+                    uint64_t cost = (uint64_t)n * (ck + 1);
+                    for (int i = 0; i < n; i++) { cost += r[i] >> ck; }
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestK = ck;
+                    }
+                }
+
+                bw.write(order, 2);
+                bw.write(bestK, 5);
+                if (bestK == 31) {
+                    for (int i = 0; i < n; i++) { bw.write(r[i], rawBits); }
+                }
+                else {
+                    for (int i = 0; i < n; i++) {
+                        bw.writeUnary(r[i] >> bestK);
+                        if (bestK) { bw.write(r[i], bestK); }
+                    }
+                }
+            }
+        }
+        return 8 + bw.flush();
+    }
+
+    static int decodeRice(const uint8_t* in, int len, int bits, complex_t* out, int maxCount) {
+        if (len < 8) { return -1; }
+        uint32_t count = *(uint32_t*)in;
+        float maxVal = *(float*)&in[4];
+        if (count > (uint32_t)maxCount || !std::isfinite(maxVal)) { return -1; }
+        const int rawBits = bits + 2;
+        const uint32_t maxQuotient = 1u << rawBits;
+        const int32_t maxQ = (1 << (bits - 1)) - 1;
+        float scale = maxVal / (float)((1 << (bits - 1)) - 1);
+
+        float* vals = (float*)out;
+        BitReader br(&in[8], len - 8);
+        int32_t hist[2][2] = { { 0, 0 }, { 0, 0 } };
+        for (uint32_t start = 0; start < count; start += PCM_RICE_BLOCK_SIZE) {
+            int n = std::min<uint32_t>(PCM_RICE_BLOCK_SIZE, count - start);
+            for (int c = 0; c < 2; c++) {
+                uint32_t order, k;
+                if (!br.read(2, order) || !br.read(5, k)) { return -1; }
+                if (order > 2 || (k >= (uint32_t)rawBits && k != 31)) { return -1; }
+
+                int32_t x1 = hist[c][0];
+                int32_t x2 = hist[c][1];
+                for (int i = 0; i < n; i++) {
+                    uint32_t u, low = 0;
+                    if (k == 31) {
+                        if (!br.read(rawBits, u)) { return -1; }
+                    }
+                    else {
+                        uint32_t q;
+                        if (!br.readUnary(q, maxQuotient)) { return -1; }
+                        if (k && !br.read(k, low)) { return -1; }
+                        uint64_t r = ((uint64_t)q << k) | low;
+                        if (r >> rawBits) { return -1; }
+                        u = r;
+                    }
+
+                    // The encoder only produces samples within the quantizer's range, anything else is a corrupt packet
+                    int64_t x = unzigzag(u);
+                    if (order == 1) { x += x1; }
+                    else if (order == 2) { x += 2 * (int64_t)x1 - x2; }
+                    if (x < -maxQ || x > maxQ) { return -1; }
+                    vals[(start + i) * 2 + c] = (float)x * scale;
+                    x2 = x1;
+                    x1 = x;
+                }
+                hist[c][0] = x1;
+                hist[c][1] = x2;
+            }
+        }
+        return count;
+    }
+
+    bool isCodedPCMType(PCMType type) {
+        return typeBits(type) != 0;
+    }
+
+    int encodePCM(PCMType type, const complex_t* in, int count, uint8_t* out) {
+        switch (type) {
+            case PCM_TYPE_BFP8:
+            case PCM_TYPE_BFP10:
+            case PCM_TYPE_BFP12:
+                return encodeBFP(in, count, typeBits(type), out);
+            case PCM_TYPE_RICE16:
+            case PCM_TYPE_RICE12:
+                return encodeRice(in, count, typeBits(type), out);
+            default:
+                return 0;
+        }
+    }
+
+    int decodePCM(PCMType type, const uint8_t* in, int len, complex_t* out, int maxCount) {
+        switch (type) {
+            case PCM_TYPE_BFP8:
+            case PCM_TYPE_BFP10:
+            case PCM_TYPE_BFP12:
+                return decodeBFP(in, len, typeBits(type), out, maxCount);
+            case PCM_TYPE_RICE16:
+            case PCM_TYPE_RICE12:
+                return decodeRice(in, len, typeBits(type), out, maxCount);
+            default:
+                return -1;
+        }
+    }
+}
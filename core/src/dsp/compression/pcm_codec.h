@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include "../types.h"
+#include "pcm_type.h"
+
+// Samples sharing an exponent in the block floating point types
+#define PCM_BFP_BLOCK_SIZE      16
+
+// Samples sharing a predictor and a Rice parameter in the Rice types
+#define PCM_RICE_BLOCK_SIZE     256
+
+// Upper bound of the size of count samples once coded with any of the types below
+#define PCM_CODED_MAX_SIZE(count)   (8 + (count) * 5 + 64)
+
+namespace dsp::compression {
+    // Codecs of the PCM types that do more than quantize every component the same way.
+    //
+    // PCM_TYPE_BFP8/10/12: every PCM_BFP_BLOCK_SIZE samples share an exponent, so the error on a
+    // component is at most 2^-(bits-1) of the largest component of its group instead of the whole buffer.
+    //
+    // PCM_TYPE_RICE16/12: the buffer is quantized to 16 or 12 bits against its largest component,
+    // then for every PCM_RICE_BLOCK_SIZE samples of I and Q, the fixed predictor of order 0 to 2 with the
+    // smallest residual is picked and the residual is Rice coded. Nothing is lost past the quantization.
+
+    bool isCodedPCMType(PCMType type);
+
+    // Returns the number of bytes written to out, at most PCM_CODED_MAX_SIZE(count)
+    int encodePCM(PCMType type, const complex_t* in, int count, uint8_t* out);
+
+    // Returns the number of samples written to out, or -1 if the data is invalid or holds more than maxCount samples
+    int decodePCM(PCMType type, const uint8_t* in, int len, complex_t* out, int maxCount);
+}
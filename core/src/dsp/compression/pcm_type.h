@@ -4,6 +4,13 @@ namespace dsp::compression {
     enum PCMType {
         PCM_TYPE_I8,
         PCM_TYPE_I16,
-        PCM_TYPE_F32
+        PCM_TYPE_F32,
+
+        // Coded types, see pcm_codec.h
+        PCM_TYPE_BFP8,
+        PCM_TYPE_BFP10,
+        PCM_TYPE_BFP12,
+        PCM_TYPE_RICE16,
+        PCM_TYPE_RICE12
     };
-}
\ No newline at end of file
+}
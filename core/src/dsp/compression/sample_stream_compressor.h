@@ -1,6 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "pcm_type.h"
+#include "pcm_codec.h"
 
 namespace dsp::compression {
     class SampleStreamCompressor : public Processor<complex_t, uint8_t> {
@@ -37,6 +38,12 @@ namespace dsp::compression {
             *compressionType = 0;
             *sampleType = pcmType;
 
+            // Coded types carry their own scaling
+            if (isCodedPCMType(pcmType)) {
+                *scaler = 0;
+                return 8 + encodePCM(pcmType, in, count, (uint8_t*)dataBuf);
+            }
+
             // If type is float32, no compression is needed
             if (pcmType == PCMType::PCM_TYPE_F32) {
                 *scaler = 0;
@@ -1,6 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "pcm_type.h"
+#include "pcm_codec.h"
 
 namespace dsp::compression {
     class SampleStreamDecompressor : public Processor<uint8_t, complex_t> {
@@ -10,7 +11,8 @@ namespace dsp::compression {
 
         SampleStreamDecompressor(stream<uint8_t>* in) { base_type::init(in); }
 
-        inline int process(int count, const uint8_t* in, complex_t* out) {
+        inline static int process(int count, const uint8_t* in, complex_t* out) {
+            if (count < 8) { return 0; }
             uint16_t sampleType = *(uint16_t*)&in[2];
             float scaler = *(float*)&in[4];
             const void* dataBuf = &in[8];
@@ -29,6 +31,9 @@ namespace dsp::compression {
                 volk_8i_s32f_convert_32f((float*)out, (int8_t*)dataBuf, 128.0f / scaler, outCount * 2);
                 return outCount;
             }
+            else if (isCodedPCMType((PCMType)sampleType)) {
+                return std::max<int>(decodePCM((PCMType)sampleType, (const uint8_t*)dataBuf, count - 8, out, STREAM_BUFFER_SIZE), 0);
+            }
             
             return 0;
         }
@@ -0,0 +1,359 @@
+#include "sample_format.h"
+#include <utility>
+#include "../simd.h"
+
+namespace dsp::convert {
+    // ================= Generic =================
+
+    template <class Load>
+    static inline void genericConvert(int start, int count, float* out, float offset, float scale, bool swapIQ, Load load) {
+        float bias = -offset * scale;
+        int reId = swapIQ ? 1 : 0;
+        for (int i = start; i < count; i++) {
+            out[(2 * i) + reId] = load(2 * i) * scale + bias;
+            out[(2 * i) + 1 - reId] = load((2 * i) + 1) * scale + bias;
+        }
+    }
+
+    static inline int32_t loadS12(const uint8_t* in, int id) {
+        const uint8_t* p = &in[(id / 2) * 3];
+        int32_t v = (id & 1) ? ((p[2] << 4) | (p[1] >> 4)) : (((p[1] & 0x0F) << 8) | p[0]);
+        return (v << 20) >> 20;
+    }
+
+    static inline int32_t loadS24(const uint8_t* in, int id) {
+        const uint8_t* p = &in[id * 3];
+        int32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (v << 8) >> 8;
+    }
+
+    static void genericU8(int start, int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        genericConvert(start, count, out, offset, scale, swapIQ, [in](int id) { return (float)in[id]; });
+    }
+
+    static void genericS8(int start, int count, const int8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        genericConvert(start, count, out, offset, scale, swapIQ, [in](int id) { return (float)in[id]; });
+    }
+
+    static void genericS12Packed(int start, int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        genericConvert(start, count, out, offset, scale, swapIQ, [in](int id) { return (float)loadS12(in, id); });
+    }
+
+    static void genericS16(int start, int count, const int16_t* in, float* out, float offset, float scale, bool swapIQ) {
+        genericConvert(start, count, out, offset, scale, swapIQ, [in](int id) { return (float)in[id]; });
+    }
+
+    static void genericS16Split(int start, int count, const int16_t* inI, const int16_t* inQ, float* out, float offset, float scale, bool swapIQ) {
+        genericConvert(start, count, out, offset, scale, swapIQ, [inI, inQ](int id) { return (float)((id & 1) ? inQ[id / 2] : inI[id / 2]); });
+    }
+
+    static void genericS24(int start, int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        genericConvert(start, count, out, offset, scale, swapIQ, [in](int id) { return (float)loadS24(in, id); });
+    }
+
+    static void genericS32(int start, int count, const int32_t* in, float* out, float offset, float scale, bool swapIQ) {
+        genericConvert(start, count, out, offset, scale, swapIQ, [in](int id) { return (float)in[id]; });
+    }
+
+    // ================= AVX2 =================
+    // Each iteration produces 4 complex samples from 8 integers, the remainder is done by the generic code
+
+#ifdef DSP_SIMD_X86
+    DSP_SIMD_AVX2 static inline void avx2Store(float* out, __m256i v, __m256 scale, __m256 bias, bool swapIQ) {
+        __m256 f = _mm256_fmadd_ps(_mm256_cvtepi32_ps(v), scale, bias);
+        if (swapIQ) { f = _mm256_permute_ps(f, 0xB1); }
+        _mm256_storeu_ps(out, f);
+    }
+
+    DSP_SIMD_AVX2 static void avx2U8(int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        __m256 vscale = _mm256_set1_ps(scale);
+        __m256 vbias = _mm256_set1_ps(-offset * scale);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&in[2 * i]));
+            avx2Store(&out[2 * i], v, vscale, vbias, swapIQ);
+        }
+        genericU8(i, count, in, out, offset, scale, swapIQ);
+    }
+
+    DSP_SIMD_AVX2 static void avx2S8(int count, const int8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        __m256 vscale = _mm256_set1_ps(scale);
+        __m256 vbias = _mm256_set1_ps(-offset * scale);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256i v = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)&in[2 * i]));
+            avx2Store(&out[2 * i], v, vscale, vbias, swapIQ);
+        }
+        genericS8(i, count, in, out, offset, scale, swapIQ);
+    }
+
+    DSP_SIMD_AVX2 static void avx2S12Packed(int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        __m256 vscale = _mm256_set1_ps(scale);
+        __m256 vbias = _mm256_set1_ps(-offset * scale);
+
+        // Gather the two bytes holding each 12bit value into a 16bit lane
+        const __m128i shuf = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+
+        // 16 bytes are loaded for the 12 used, so stop early enough to not read past the end
+        int i = 0;
+        for (; i + 6 <= count; i += 4) {
+            __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&in[3 * i]), shuf);
+
+            // I is in the low 12 bits and Q in the high 12 bits of their lane, sign extend both
+            __m128i vi = _mm_srai_epi16(_mm_slli_epi16(v, 4), 4);
+            __m128i vq = _mm_srai_epi16(v, 4);
+            v = _mm_blend_epi16(vi, vq, 0xAA);
+
+            avx2Store(&out[2 * i], _mm256_cvtepi16_epi32(v), vscale, vbias, swapIQ);
+        }
+        genericS12Packed(i, count, in, out, offset, scale, swapIQ);
+    }
+
+    DSP_SIMD_AVX2 static void avx2S16(int count, const int16_t* in, float* out, float offset, float scale, bool swapIQ) {
+        __m256 vscale = _mm256_set1_ps(scale);
+        __m256 vbias = _mm256_set1_ps(-offset * scale);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&in[2 * i]));
+            avx2Store(&out[2 * i], v, vscale, vbias, swapIQ);
+        }
+        genericS16(i, count, in, out, offset, scale, swapIQ);
+    }
+
+    DSP_SIMD_AVX2 static void avx2S16Split(int count, const int16_t* inI, const int16_t* inQ, float* out, float offset, float scale, bool swapIQ) {
+        __m256 vscale = _mm256_set1_ps(scale);
+        __m256 vbias = _mm256_set1_ps(-offset * scale);
+        if (swapIQ) { std::swap(inI, inQ); }
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 fi = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&inI[i]))), vscale, vbias);
+            __m256 fq = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&inQ[i]))), vscale, vbias);
+
+            // Interleave, the unpacks work within each 128bit lane so the halves need to be put back in order
+            __m256 lo = _mm256_unpacklo_ps(fi, fq);
+            __m256 hi = _mm256_unpackhi_ps(fi, fq);
+            _mm256_storeu_ps(&out[2 * i], _mm256_permute2f128_ps(lo, hi, 0x20));
+            _mm256_storeu_ps(&out[(2 * i) + 8], _mm256_permute2f128_ps(lo, hi, 0x31));
+        }
+        genericS16Split(i, count, inI, inQ, out, offset, scale, false);
+    }
+
+    DSP_SIMD_AVX2 static void avx2S24(int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        __m256 vscale = _mm256_set1_ps(scale);
+        __m256 vbias = _mm256_set1_ps(-offset * scale);
+
+        // Place the 3 bytes of each value in the top of a 32bit lane, then shift down to sign extend
+        const __m256i shuf = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                              -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+        // 28 bytes are read for the 24 used, so stop early enough to not read past the end
+        int i = 0;
+        for (; i + 6 <= count; i += 4) {
+            __m128i lo = _mm_loadu_si128((const __m128i*)&in[6 * i]);
+            __m128i hi = _mm_loadu_si128((const __m128i*)&in[(6 * i) + 12]);
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, shuf), 8);
+            avx2Store(&out[2 * i], v, vscale, vbias, swapIQ);
+        }
+        genericS24(i, count, in, out, offset, scale, swapIQ);
+    }
+
+    DSP_SIMD_AVX2 static void avx2S32(int count, const int32_t* in, float* out, float offset, float scale, bool swapIQ) {
+        __m256 vscale = _mm256_set1_ps(scale);
+        __m256 vbias = _mm256_set1_ps(-offset * scale);
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            avx2Store(&out[2 * i], _mm256_loadu_si256((const __m256i*)&in[2 * i]), vscale, vbias, swapIQ);
+        }
+        genericS32(i, count, in, out, offset, scale, swapIQ);
+    }
+
+#endif
+
+    // ================= NEON =================
+    // Each iteration produces 8 complex samples, the remainder is done by the generic code
+
+#ifdef DSP_SIMD_NEON
+    static inline void neonStore(float* out, int32x4_t v, float32x4_t scale, float32x4_t bias, bool swapIQ) {
+        float32x4_t f = vmlaq_f32(bias, vcvtq_f32_s32(v), scale);
+        if (swapIQ) { f = vrev64q_f32(f); }
+        vst1q_f32(out, f);
+    }
+
+    static inline void neonStore16(float* out, int16x8_t v, float32x4_t scale, float32x4_t bias, bool swapIQ) {
+        neonStore(out, vmovl_s16(vget_low_s16(v)), scale, bias, swapIQ);
+        neonStore(&out[4], vmovl_s16(vget_high_s16(v)), scale, bias, swapIQ);
+    }
+
+    // Store 8 I values and 8 Q values interleaved
+    static inline void neonStoreIQ(float* out, int16x8_t vi, int16x8_t vq, float32x4_t scale, float32x4_t bias) {
+        float32x4x2_t lo, hi;
+        lo.val[0] = vmlaq_f32(bias, vcvtq_f32_s32(vmovl_s16(vget_low_s16(vi))), scale);
+        lo.val[1] = vmlaq_f32(bias, vcvtq_f32_s32(vmovl_s16(vget_low_s16(vq))), scale);
+        hi.val[0] = vmlaq_f32(bias, vcvtq_f32_s32(vmovl_s16(vget_high_s16(vi))), scale);
+        hi.val[1] = vmlaq_f32(bias, vcvtq_f32_s32(vmovl_s16(vget_high_s16(vq))), scale);
+        vst2q_f32(out, lo);
+        vst2q_f32(&out[8], hi);
+    }
+
+    static void neonU8(int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        float32x4_t vscale = vdupq_n_f32(scale);
+        float32x4_t vbias = vdupq_n_f32(-offset * scale);
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            int16x8_t v = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&in[2 * i])));
+            neonStore16(&out[2 * i], v, vscale, vbias, swapIQ);
+            v = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&in[(2 * i) + 8])));
+            neonStore16(&out[(2 * i) + 8], v, vscale, vbias, swapIQ);
+        }
+        genericU8(i, count, in, out, offset, scale, swapIQ);
+    }
+
+    static void neonS8(int count, const int8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        float32x4_t vscale = vdupq_n_f32(scale);
+        float32x4_t vbias = vdupq_n_f32(-offset * scale);
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            neonStore16(&out[2 * i], vmovl_s8(vld1_s8(&in[2 * i])), vscale, vbias, swapIQ);
+            neonStore16(&out[(2 * i) + 8], vmovl_s8(vld1_s8(&in[(2 * i) + 8])), vscale, vbias, swapIQ);
+        }
+        genericS8(i, count, in, out, offset, scale, swapIQ);
+    }
+
+    static void neonS12Packed(int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ) {
+        float32x4_t vscale = vdupq_n_f32(scale);
+        float32x4_t vbias = vdupq_n_f32(-offset * scale);
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            // De-interleave the 3 bytes of each IQ pair
+            uint8x8x3_t b = vld3_u8(&in[3 * i]);
+
+            // Rebuild I and Q in the top 12 bits of a 16bit lane, then shift down to sign extend
+            uint16x8_t ui = vorrq_u16(vshll_n_u8(vand_u8(b.val[1], vdup_n_u8(0x0F)), 8), vmovl_u8(b.val[0]));
+            uint16x8_t uq = vorrq_u16(vshll_n_u8(b.val[2], 8), vmovl_u8(b.val[1]));
+            int16x8_t vi = vshrq_n_s16(vshlq_n_s16(vreinterpretq_s16_u16(ui), 4), 4);
+            int16x8_t vq = vshrq_n_s16(vreinterpretq_s16_u16(uq), 4);
+
+            if (swapIQ) {
+                neonStoreIQ(&out[2 * i], vq, vi, vscale, vbias);
+            }
+            else {
+                neonStoreIQ(&out[2 * i], vi, vq, vscale, vbias);
+            }
+        }
+        genericS12Packed(i, count, in, out, offset, scale, swapIQ);
+    }
+
+    static void neonS16(int count, const int16_t* in, float* out, float offset, float scale, bool swapIQ) {
+        float32x4_t vscale = vdupq_n_f32(scale);
+        float32x4_t vbias = vdupq_n_f32(-offset * scale);
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            neonStore16(&out[2 * i], vld1q_s16(&in[2 * i]), vscale, vbias, swapIQ);
+            neonStore16(&out[(2 * i) + 8], vld1q_s16(&in[(2 * i) + 8]), vscale, vbias, swapIQ);
+        }
+        genericS16(i, count, in, out, offset, scale, swapIQ);
+    }
+
+    static void neonS16Split(int count, const int16_t* inI, const int16_t* inQ, float* out, float offset, float scale, bool swapIQ) {
+        float32x4_t vscale = vdupq_n_f32(scale);
+        float32x4_t vbias = vdupq_n_f32(-offset * scale);
+        if (swapIQ) { std::swap(inI, inQ); }
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            neonStoreIQ(&out[2 * i], vld1q_s16(&inI[i]), vld1q_s16(&inQ[i]), vscale, vbias);
+        }
+        genericS16Split(i, count, inI, inQ, out, offset, scale, false);
+    }
+
+    static void neonS32(int count, const int32_t* in, float* out, float offset, float scale, bool swapIQ) {
+        float32x4_t vscale = vdupq_n_f32(scale);
+        float32x4_t vbias = vdupq_n_f32(-offset * scale);
+        int i = 0;
+        for (; i + 2 <= count; i += 2) {
+            neonStore(&out[2 * i], vld1q_s32(&in[2 * i]), vscale, vbias, swapIQ);
+        }
+        genericS32(i, count, in, out, offset, scale, swapIQ);
+    }
+#endif
+
+    // ================= Dispatch =================
+
+    struct Kernels {
+        const char* name;
+        void (*u8)(int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ);
+        void (*s8)(int count, const int8_t* in, float* out, float offset, float scale, bool swapIQ);
+        void (*s12Packed)(int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ);
+        void (*s16)(int count, const int16_t* in, float* out, float offset, float scale, bool swapIQ);
+        void (*s16Split)(int count, const int16_t* inI, const int16_t* inQ, float* out, float offset, float scale, bool swapIQ);
+        void (*s24)(int count, const uint8_t* in, float* out, float offset, float scale, bool swapIQ);
+        void (*s32)(int count, const int32_t* in, float* out, float offset, float scale, bool swapIQ);
+    };
+
+    template <class T, void (*Func)(int start, int count, const T* in, float* out, float offset, float scale, bool swapIQ)>
+    static void generic(int count, const T* in, float* out, float offset, float scale, bool swapIQ) {
+        Func(0, count, in, out, offset, scale, swapIQ);
+    }
+
+    static void genericSplit(int count, const int16_t* inI, const int16_t* inQ, float* out, float offset, float scale, bool swapIQ) {
+        genericS16Split(0, count, inI, inQ, out, offset, scale, swapIQ);
+    }
+
+    static Kernels selectKernels() {
+#ifdef DSP_SIMD_X86
+        if (simd::cpuHasAVX2()) {
+            return { "avx2", avx2U8, avx2S8, avx2S12Packed, avx2S16, avx2S16Split, avx2S24, avx2S32 };
+        }
+#endif
+#ifdef DSP_SIMD_NEON
+        return { "neon", neonU8, neonS8, neonS12Packed, neonS16, neonS16Split, generic<uint8_t, genericS24>, neonS32 };
+#endif
+        return {
+            "generic",
+            generic<uint8_t, genericU8>,
+            generic<int8_t, genericS8>,
+            generic<uint8_t, genericS12Packed>,
+            generic<int16_t, genericS16>,
+            genericSplit,
+            generic<uint8_t, genericS24>,
+            generic<int32_t, genericS32>
+        };
+    }
+
+    static const Kernels& kernels() {
+        static const Kernels k = selectKernels();
+        return k;
+    }
+
+    void u8ToComplex(int count, const uint8_t* in, complex_t* out, float offset, float scale, bool swapIQ) {
+        kernels().u8(count, in, (float*)out, offset, scale, swapIQ);
+    }
+
+    void s8ToComplex(int count, const int8_t* in, complex_t* out, float offset, float scale, bool swapIQ) {
+        kernels().s8(count, in, (float*)out, offset, scale, swapIQ);
+    }
+
+    void s12PackedToComplex(int count, const uint8_t* in, complex_t* out, float offset, float scale, bool swapIQ) {
+        kernels().s12Packed(count, in, (float*)out, offset, scale, swapIQ);
+    }
+
+    void s16ToComplex(int count, const int16_t* in, complex_t* out, float offset, float scale, bool swapIQ) {
+        kernels().s16(count, in, (float*)out, offset, scale, swapIQ);
+    }
+
+    void s16SplitToComplex(int count, const int16_t* inI, const int16_t* inQ, complex_t* out, float offset, float scale, bool swapIQ) {
+        kernels().s16Split(count, inI, inQ, (float*)out, offset, scale, swapIQ);
+    }
+
+    void s24ToComplex(int count, const uint8_t* in, complex_t* out, float offset, float scale, bool swapIQ) {
+        kernels().s24(count, in, (float*)out, offset, scale, swapIQ);
+    }
+
+    void s32ToComplex(int count, const int32_t* in, complex_t* out, float offset, float scale, bool swapIQ) {
+        kernels().s32(count, in, (float*)out, offset, scale, swapIQ);
+    }
+
+    const char* getSampleFormatKernels() {
+        return kernels().name;
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include "../types.h"
+
+namespace dsp::convert {
+    // Conversion of the interleaved integer IQ formats delivered by SDR hardware to complex_t.
+    // Each component is computed as (x - offset) * scale, and I and Q are exchanged when swapIQ is set.
+    // count is the number of complex samples. The fastest implementation supported by the CPU is picked at runtime.
+
+    void u8ToComplex(int count, const uint8_t* in, complex_t* out, float offset, float scale, bool swapIQ = false);
+    void s8ToComplex(int count, const int8_t* in, complex_t* out, float offset, float scale, bool swapIQ = false);
+
+    // 12bit samples packed in 3 bytes per IQ pair: I[7:0], Q[3:0] I[11:8], Q[11:4]
+    void s12PackedToComplex(int count, const uint8_t* in, complex_t* out, float offset, float scale, bool swapIQ = false);
+
+    void s16ToComplex(int count, const int16_t* in, complex_t* out, float offset, float scale, bool swapIQ = false);
+
+    // I and Q in separate buffers
+    void s16SplitToComplex(int count, const int16_t* inI, const int16_t* inQ, complex_t* out, float offset, float scale, bool swapIQ = false);
+
+    // Little endian 24bit samples, 6 bytes per IQ pair
+    void s24ToComplex(int count, const uint8_t* in, complex_t* out, float offset, float scale, bool swapIQ = false);
+
+    void s32ToComplex(int count, const int32_t* in, complex_t* out, float offset, float scale, bool swapIQ = false);
+
+    // Name of the instruction set used by the conversions ("avx2", "neon" or "generic")
+    const char* getSampleFormatKernels();
+}
@@ -0,0 +1,136 @@
+#include "planner.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <filesystem>
+#include <utils/flog.h>
+
+namespace dsp::fft {
+    static std::recursive_mutex plannerMtx;
+    static std::string _wisdomPath;
+    static std::string savedWisdom;
+    static unsigned int effortFlags = FFTW_ESTIMATE;
+    static int maxThreads = 1;
+
+    static std::string exportWisdom() {
+        char* str = fftwf_export_wisdom_to_string();
+        if (!str) { return ""; }
+        std::string wisdom = str;
+        fftwf_free(str);
+        return wisdom;
+    }
+
+    void init(const std::string& wisdomPath, Effort effort, int threads) {
+        std::lock_guard<std::recursive_mutex> lck(plannerMtx);
+        _wisdomPath = wisdomPath;
+        switch (effort) {
+            case EFFORT_MEASURE: effortFlags = FFTW_MEASURE; break;
+            case EFFORT_PATIENT: effortFlags = FFTW_PATIENT; break;
+            default: effortFlags = FFTW_ESTIMATE; break;
+        }
+
+#ifdef SDRPP_FFTW_THREADS
+        if (threads <= 0) { threads = std::thread::hardware_concurrency(); }
+        maxThreads = fftwf_init_threads() ? std::max<int>(threads, 1) : 1;
+#endif
+
+        // A missing or corrupted file only means that the plans have to be measured again
+        if (std::filesystem::exists(_wisdomPath)) {
+            if (fftwf_import_wisdom_from_filename(_wisdomPath.c_str())) {
+                flog::info("Loaded FFTW wisdom from '{0}'", _wisdomPath);
+            }
+            else {
+                flog::warn("Could not load FFTW wisdom from '{0}'", _wisdomPath);
+            }
+        }
+        savedWisdom = exportWisdom();
+    }
+
+    void saveWisdom() {
+        std::lock_guard<std::recursive_mutex> lck(plannerMtx);
+        if (_wisdomPath.empty()) { return; }
+        std::string wisdom = exportWisdom();
+        if (wisdom == savedWisdom) { return; }
+        if (!fftwf_export_wisdom_to_filename(_wisdomPath.c_str())) {
+            flog::error("Could not save FFTW wisdom to '{0}'", _wisdomPath);
+            return;
+        }
+        savedWisdom = wisdom;
+    }
+
+    unsigned int getEffortFlags() {
+        std::lock_guard<std::recursive_mutex> lck(plannerMtx);
+        return effortFlags;
+    }
+
+    // Must be called with the planner mutex locked
+    static void setThreads(int size) {
+#ifdef SDRPP_FFTW_THREADS
+        fftwf_plan_with_nthreads((size >= FFT_PLANNER_THREADS_MIN_SIZE) ? maxThreads : 1);
+#endif
+    }
+
+    // Measured plans are the only ones that gather new wisdom, saving right away keeps it if SDR++ doesn't exit cleanly
+    static void planned(unsigned int flags) {
+        if (!(flags & (FFTW_ESTIMATE | FFTW_WISDOM_ONLY))) { saveWisdom(); }
+    }
+
+    fftwf_plan planDFT(int size, fftwf_complex* in, fftwf_complex* out, int sign, unsigned int flags) {
+        std::lock_guard<std::recursive_mutex> lck(plannerMtx);
+        setThreads(size);
+        fftwf_plan plan = fftwf_plan_dft_1d(size, in, out, sign, flags);
+        planned(flags);
+        return plan;
+    }
+
+    fftwf_plan planR2C(int size, float* in, fftwf_complex* out, unsigned int flags) {
+        std::lock_guard<std::recursive_mutex> lck(plannerMtx);
+        setThreads(size);
+        fftwf_plan plan = fftwf_plan_dft_r2c_1d(size, in, out, flags);
+        planned(flags);
+        return plan;
+    }
+
+    fftwf_plan planC2R(int size, fftwf_complex* in, float* out, unsigned int flags) {
+        std::lock_guard<std::recursive_mutex> lck(plannerMtx);
+        setThreads(size);
+        fftwf_plan plan = fftwf_plan_dft_c2r_1d(size, in, out, flags);
+        planned(flags);
+        return plan;
+    }
+
+    fftwf_plan planBatchDFT(int size, int batch, fftwf_complex* in, fftwf_complex* out, int sign, unsigned int flags) {
+        std::lock_guard<std::recursive_mutex> lck(plannerMtx);
+        setThreads(size * batch);
+        fftwf_plan plan = fftwf_plan_many_dft(1, &size, batch, in, NULL, 1, size, out, NULL, 1, size, sign, flags);
+        planned(flags);
+        return plan;
+    }
+
+    void destroyPlan(fftwf_plan plan) {
+        if (!plan) { return; }
+        std::lock_guard<std::recursive_mutex> lck(plannerMtx);
+        fftwf_destroy_plan(plan);
+    }
+
+    bool measureBatchDFT(int size, int batch, int sign) {
+        std::lock_guard<std::recursive_mutex> lck(plannerMtx);
+        if (effortFlags & FFTW_ESTIMATE) { return true; }
+
+        // Measured on scratch buffers so that the caller's plan can then be made from the wisdom alone.
+        // The time limit bounds how long the other plans wait for the lock.
+        fftwf_complex* in = (fftwf_complex*)fftwf_malloc(size * batch * sizeof(fftwf_complex));
+        fftwf_complex* out = (fftwf_complex*)fftwf_malloc(size * batch * sizeof(fftwf_complex));
+        setThreads(size * batch);
+        fftwf_set_timelimit(FFT_PLANNER_MEASURE_TIME_LIMIT);
+        fftwf_plan plan = fftwf_plan_many_dft(1, &size, batch, in, NULL, 1, size, out, NULL, 1, size, sign, effortFlags);
+        fftwf_set_timelimit(FFTW_NO_TIMELIMIT);
+        if (plan) { fftwf_destroy_plan(plan); }
+        fftwf_free(in);
+        fftwf_free(out);
+        if (!plan) { return false; }
+
+        saveWisdom();
+        return true;
+    }
+}
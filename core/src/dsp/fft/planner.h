@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <fftw3.h>
+
+// FFTs of at least this size get planned with all the planner threads, smaller ones don't benefit from it
+#define FFT_PLANNER_THREADS_MIN_SIZE    65536
+
+// Longest time in seconds spent measuring a single plan, the other plans wait for it
+#define FFT_PLANNER_MEASURE_TIME_LIMIT  2.0
+
+namespace dsp::fft {
+    // Planning rigor of the FFTs that are worth measuring, e.g. the spectrum FFT
+    enum Effort {
+        EFFORT_ESTIMATE,
+        EFFORT_MEASURE,
+        EFFORT_PATIENT
+    };
+
+    // Load the wisdom saved by a previous run and set the planning options, threads being the
+    // maximum number of threads per plan (0 for one per core). Must be called before any plan is made.
+    void init(const std::string& wisdomPath, Effort effort, int threads);
+
+    // Write the wisdom to disk if some was gathered since the last save
+    void saveWisdom();
+
+    // FFTW flags of the configured effort
+    unsigned int getEffortFlags();
+
+    // FFTW only allows executing plans from several threads at the same time, so all
+    // plans must be created and destroyed through these. They also apply the wisdom and threads settings.
+    // Plans with an effort above FFTW_ESTIMATE overwrite the content of the buffers while planning.
+    fftwf_plan planDFT(int size, fftwf_complex* in, fftwf_complex* out, int sign, unsigned int flags = FFTW_ESTIMATE);
+    fftwf_plan planR2C(int size, float* in, fftwf_complex* out, unsigned int flags = FFTW_ESTIMATE);
+    fftwf_plan planC2R(int size, fftwf_complex* in, float* out, unsigned int flags = FFTW_ESTIMATE);
+
+    // Transform of batch contiguous frames of the given size in one execution
+    fftwf_plan planBatchDFT(int size, int batch, fftwf_complex* in, fftwf_complex* out, int sign, unsigned int flags = FFTW_ESTIMATE);
+
+    void destroyPlan(fftwf_plan plan);
+
+    // Gather the wisdom of a batch DFT with the configured effort, measured on scratch buffers. Once this returned
+    // true, planBatchDFT() with the effort flags and FFTW_WISDOM_ONLY succeeds right away.
+    bool measureBatchDFT(int size, int batch, int sign);
+}
@@ -30,6 +30,7 @@ namespace dsp::filter {
             base_type::tempStop();
             _decimation = decimation;
             offset = 0;
+            base_type::updateEngine();
             base_type::tempStart();
         }
 
@@ -44,19 +45,26 @@ namespace dsp::filter {
 
         inline int process(int count, const D* in, D* out) {
             // Copy data to work buffer
+            base_type::reserveBuffer(count);
             memcpy(base_type::bufStart, in, count * sizeof(D));
 
             // Do convolution
             int outCount = 0;
-            for (; offset < count; offset += _decimation) {
-                if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[outCount++], &base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
+            if (base_type::useFFT) {
+                // Only compute the chunks that contain at least one output
+                int step = base_type::conv.getStep();
+                for (int i = 0; i < count; i += step) {
+                    int n = std::min<int>(step, count - i);
+                    if (offset >= i + n) { continue; }
+                    const D* res = base_type::conv.process(n, &base_type::buffer[i]);
+                    for (; offset < i + n; offset += _decimation) {
+                        out[outCount++] = res[offset - i];
+                    }
                 }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], (lv_32fc_t*)base_type::_taps.taps, base_type::_taps.size);
+            }
+            else {
+                for (; offset < count; offset += _decimation) {
+                    base_type::directProcess(1, &base_type::buffer[offset], &out[outCount++], base_type::_taps);
                 }
             }
             offset -= count;
@@ -82,6 +90,11 @@ namespace dsp::filter {
         }
 
     protected:
+        // Only one output out of _decimation has to be computed by the direct form
+        int fftCrossover() {
+            return base_type::fftCrossover() * _decimation;
+        }
+
         int _decimation;
         int offset = 0;
     };
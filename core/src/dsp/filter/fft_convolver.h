@@ -0,0 +1,107 @@
+#pragma once
+#include "../types.h"
+#include "../taps/tap.h"
+#include "../fft/planner.h"
+
+namespace dsp::filter {
+    // Overlap-save FFT convolution engine used by the FIR filters for long filters.
+    // It computes exactly the same outputs as the direct form, out[i] = sum(in[i + j] * taps[j]),
+    // but at a cost that barely depends on the number of taps.
+    template <class D, class T>
+    class FFTConvolver {
+    public:
+        FFTConvolver() {}
+
+        ~FFTConvolver() {
+            destroy();
+        }
+
+        void init(const tap<T>& taps) {
+            destroy();
+            tapCount = taps.size;
+
+            // Use an FFT of at least 4 times the filter size, so that most of each FFT produces new samples
+            fftSize = 256;
+            while (fftSize < tapCount * 4) { fftSize <<= 1; }
+            step = fftSize - tapCount + 1;
+
+            if constexpr (std::is_same_v<D, float>) {
+                bins = (fftSize / 2) + 1;
+                fftIn = (float*)fftwf_malloc(fftSize * sizeof(float));
+                fftOut = (complex_t*)fftwf_malloc(bins * sizeof(complex_t));
+                forwardPlan = fft::planR2C(fftSize, fftIn, (fftwf_complex*)fftOut);
+                backwardPlan = fft::planC2R(fftSize, (fftwf_complex*)fftOut, fftIn);
+            }
+            else {
+                bins = fftSize;
+                fftIn = (complex_t*)fftwf_malloc(fftSize * sizeof(complex_t));
+                fftOut = (complex_t*)fftwf_malloc(bins * sizeof(complex_t));
+                forwardPlan = fft::planDFT(fftSize, (fftwf_complex*)fftIn, (fftwf_complex*)fftOut, FFTW_FORWARD);
+                backwardPlan = fft::planDFT(fftSize, (fftwf_complex*)fftOut, (fftwf_complex*)fftIn, FFTW_BACKWARD);
+            }
+
+            // Compute the spectrum of the reversed taps, with the FFT normalization baked in
+            buffer::clear(fftIn, fftSize);
+            float norm = 1.0f / (float)fftSize;
+            for (int i = 0; i < tapCount; i++) {
+                if constexpr (std::is_same_v<D, float>) {
+                    fftIn[i] = taps.taps[tapCount - 1 - i] * norm;
+                }
+                else if constexpr (std::is_same_v<T, float>) {
+                    fftIn[i] = { taps.taps[tapCount - 1 - i] * norm, 0.0f };
+                }
+                else {
+                    fftIn[i] = taps.taps[tapCount - 1 - i] * norm;
+                }
+            }
+            fftwf_execute(forwardPlan);
+            tapsFFT = buffer::alloc<complex_t>(bins);
+            memcpy(tapsFFT, fftOut, bins * sizeof(complex_t));
+        }
+
+        void destroy() {
+            if (!tapsFFT) { return; }
+            fft::destroyPlan(forwardPlan);
+            fft::destroyPlan(backwardPlan);
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+            buffer::free(tapsFFT);
+            tapsFFT = NULL;
+        }
+
+        // Maximum number of outputs computed by a single call to process()
+        inline int getStep() { return step; }
+
+        // Compute count (at most getStep()) outputs. The input must hold tapCount - 1 + count samples.
+        // The returned outputs are only valid until the next call.
+        inline const D* process(int count, const D* in) {
+            // Load the input block, padded with zeros if it's shorter than a full step
+            int inCount = tapCount - 1 + count;
+            memcpy(fftIn, in, inCount * sizeof(D));
+            if (inCount < fftSize) { buffer::clear(&fftIn[inCount], fftSize - inCount); }
+
+            // Multiply the spectrums and go back to the time domain
+            fftwf_execute(forwardPlan);
+            volk_32fc_x2_multiply_32fc((lv_32fc_t*)fftOut, (lv_32fc_t*)fftOut, (lv_32fc_t*)tapsFFT, bins);
+            fftwf_execute(backwardPlan);
+
+            // The first tapCount - 1 samples are corrupted by the circular convolution
+            return (const D*)&fftIn[tapCount - 1];
+        }
+
+    protected:
+        // Stereo samples go through the complex FFT, the same way the direct form handles them as complex
+        using fft_type = std::conditional_t<std::is_same_v<D, float>, float, complex_t>;
+
+        int tapCount = 0;
+        int fftSize = 0;
+        int bins = 0;
+        int step = 0;
+
+        fft_type* fftIn = NULL;
+        complex_t* fftOut = NULL;
+        complex_t* tapsFFT = NULL;
+        fftwf_plan forwardPlan;
+        fftwf_plan backwardPlan;
+    };
+}
\ No newline at end of file
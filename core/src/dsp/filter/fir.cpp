@@ -0,0 +1,113 @@
+#include "fir.h"
+#include <utils/flog.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+namespace dsp::filter {
+    std::atomic<int> floatCrossover = FIR_DEFAULT_FFT_CROSSOVER;
+    std::atomic<int> complexCrossover = FIR_DEFAULT_FFT_CROSSOVER;
+    std::atomic<int> stereoCrossover = FIR_DEFAULT_FFT_CROSSOVER;
+    std::atomic<int> complexTapsCrossover = FIR_DEFAULT_FFT_CROSSOVER;
+
+    std::thread measureThread;
+    std::atomic_bool measureStop = false;
+
+    // Time both engines on a range of tap counts and return the smallest one for which the FFT is faster, or -1 if stopped
+    template <class D, class T>
+    static int measureFFTCrossover() {
+        const int count = 16384;
+        const int maxTaps = 4096;
+        D* in = buffer::alloc<D>(count + maxTaps);
+        D* out = buffer::alloc<D>(count);
+        buffer::clear(in, count + maxTaps);
+
+        int crossover = maxTaps;
+        for (int tapCount = 8; tapCount <= maxTaps; tapCount *= 2) {
+            if (measureStop) {
+                crossover = -1;
+                break;
+            }
+
+            tap<T> taps = taps::alloc<T>(tapCount);
+            buffer::clear(taps.taps, tapCount);
+            FFTConvolver<D, T> conv;
+            conv.init(taps);
+
+            // Keep the best of a few runs to be less sensitive to scheduling noise
+            double direct = 1e9;
+            double fft = 1e9;
+            for (int i = 0; i < 3; i++) {
+                auto start = std::chrono::high_resolution_clock::now();
+                FIR<D, T>::directProcess(count, in, out, taps);
+                auto mid = std::chrono::high_resolution_clock::now();
+                for (int j = 0; j < count; j += conv.getStep()) {
+                    int n = std::min<int>(conv.getStep(), count - j);
+                    memcpy(&out[j], conv.process(n, &in[j]), n * sizeof(D));
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                direct = std::min<double>(direct, std::chrono::duration<double>(mid - start).count());
+                fft = std::min<double>(fft, std::chrono::duration<double>(end - mid).count());
+            }
+            taps::free(taps);
+
+            if (fft < direct) {
+                crossover = tapCount;
+                break;
+            }
+        }
+
+        buffer::free(in);
+        buffer::free(out);
+        return crossover;
+    }
+
+    template <class D, class T>
+    static bool measureInto(std::atomic<int>& crossover) {
+        int taps = measureFFTCrossover<D, T>();
+        if (taps < 0) { return false; }
+        crossover = taps;
+        return true;
+    }
+
+    template <>
+    int getFFTCrossover<float, float>() {
+        return floatCrossover.load(std::memory_order_relaxed);
+    }
+
+    template <>
+    int getFFTCrossover<complex_t, float>() {
+        return complexCrossover.load(std::memory_order_relaxed);
+    }
+
+    template <>
+    int getFFTCrossover<stereo_t, float>() {
+        return stereoCrossover.load(std::memory_order_relaxed);
+    }
+
+    template <>
+    int getFFTCrossover<complex_t, complex_t>() {
+        return complexTapsCrossover.load(std::memory_order_relaxed);
+    }
+
+    void measureFFTCrossovers() {
+        if (!measureInto<float, float>(floatCrossover)) { return; }
+        if (!measureInto<complex_t, float>(complexCrossover)) { return; }
+        if (!measureInto<stereo_t, float>(stereoCrossover)) { return; }
+        if (!measureInto<complex_t, complex_t>(complexTapsCrossover)) { return; }
+        flog::info("FIR FFT crossover: {0} taps (float), {1} taps (complex), {2} taps (stereo), {3} taps (complex taps)",
+                   (int)floatCrossover, (int)complexCrossover, (int)stereoCrossover, (int)complexTapsCrossover);
+    }
+
+    void startFFTCrossoverMeasurement() {
+        if (measureThread.joinable()) { return; }
+        measureStop = false;
+        measureThread = std::thread(measureFFTCrossovers);
+    }
+
+    void stopFFTCrossoverMeasurement() {
+        if (!measureThread.joinable()) { return; }
+        measureStop = true;
+        measureThread.join();
+    }
+}
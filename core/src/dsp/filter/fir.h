@@ -1,12 +1,39 @@
 #pragma once
 #include "../processor.h"
 #include "../taps/tap.h"
+#include "fft_convolver.h"
+
+// Number of taps from which the FFT engine is used when the crossover wasn't measured
+#define FIR_DEFAULT_FFT_CROSSOVER   64
 
 namespace dsp::filter {
+    // Number of taps from which the FFT engine is faster than the direct form on this machine. It's measured by the
+    // core, once for all modules, in the background after it starts. Until then, and for the types that aren't
+    // measured, the default is used.
+    template <class D, class T>
+    inline int getFFTCrossover() { return FIR_DEFAULT_FFT_CROSSOVER; }
+    template <> int getFFTCrossover<float, float>();
+    template <> int getFFTCrossover<complex_t, float>();
+    template <> int getFFTCrossover<stereo_t, float>();
+    template <> int getFFTCrossover<complex_t, complex_t>();
+
+    // Measure the crossover of all the supported types, blocking until done or stopped
+    void measureFFTCrossovers();
+
+    // Measure the crossovers on a background thread, stopping aborts what's left of the measurement
+    void startFFTCrossoverMeasurement();
+    void stopFFTCrossoverMeasurement();
+
     template <class D, class T>
     class FIR : public Processor<D, D> {
         using base_type = Processor<D, D>;
     public:
+        enum Engine {
+            ENGINE_AUTO,    // Pick the fastest engine for the number of taps
+            ENGINE_DIRECT,  // One dot product per output sample
+            ENGINE_FFT      // Overlap-save FFT convolution
+        };
+
         FIR() {}
 
         FIR(stream<D>* in, tap<T>& taps) { init(in, taps); }
@@ -20,12 +47,13 @@ namespace dsp::filter {
         virtual void init(stream<D>* in, tap<T>& taps) {
             _taps = taps;
 
-            // Allocate and clear buffer
-            buffer = buffer::alloc<D>(STREAM_BUFFER_SIZE + 64000);
+            // Allocate and clear buffer, the room for the input samples is allocated by the first process()
+            buffer::reserve(buffer, bufCapacity, _taps.size);
             bufStart = &buffer[_taps.size - 1];
             buffer::clear<D>(buffer, _taps.size - 1);
 
             base_type::init(in);
+            updateEngine();
         }
 
         virtual void setTaps(tap<T>& taps) {
@@ -34,6 +62,7 @@ namespace dsp::filter {
             base_type::tempStop();
 
             int oldTC = _taps.size;
+            buffer::reserve(buffer, bufCapacity, taps.size, oldTC - 1);
             _taps = taps;
 
             // Update start of buffer
@@ -47,10 +76,25 @@ namespace dsp::filter {
                 memcpy(&buffer[_taps.size - oldTC], buffer, (oldTC - 1) * sizeof(D));
                 buffer::clear<D>(buffer, _taps.size - oldTC);
             }
+
+            updateEngine();
             
             base_type::tempStart();
         }
 
+        void setEngine(Engine engine) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            _engine = engine;
+            updateEngine();
+            base_type::tempStart();
+        }
+
+        bool usingFFT() {
+            return useFFT;
+        }
+
         virtual void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
@@ -61,20 +105,20 @@ namespace dsp::filter {
 
         inline int process(int count, const D* in, D* out) {
             // Copy data to work buffer
+            reserveBuffer(count);
             memcpy(bufStart, in, count * sizeof(D));
             
             // Do convolution
-            for (int i = 0; i < count; i++) {
-                if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[i], &buffer[i], _taps.taps, _taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], _taps.taps, _taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], (lv_32fc_t*)_taps.taps, _taps.size);
+            if (useFFT) {
+                int step = conv.getStep();
+                for (int i = 0; i < count; i += step) {
+                    int n = std::min<int>(step, count - i);
+                    memcpy(&out[i], conv.process(n, &buffer[i]), n * sizeof(D));
                 }
             }
+            else {
+                directProcess(count, buffer, out, _taps);
+            }
 
             // Move unused data
             memmove(buffer, &buffer[count], (_taps.size - 1) * sizeof(D));
@@ -93,9 +137,51 @@ namespace dsp::filter {
             return count;
         }
 
+        // Direct form convolution, the input must hold taps.size - 1 + count samples
+        static inline void directProcess(int count, const D* in, D* out, const tap<T>& taps) {
+            for (int i = 0; i < count; i++) {
+                if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
+                    volk_32f_x2_dot_prod_32f(&out[i], &in[i], taps.taps, taps.size);
+                }
+                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&in[i], taps.taps, taps.size);
+                }
+                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
+                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&in[i], (lv_32fc_t*)taps.taps, taps.size);
+                }
+            }
+        }
+
     protected:
+        // Make sure the work buffer can hold count new samples after the history
+        inline void reserveBuffer(int count) {
+            if (buffer::reserve(buffer, bufCapacity, _taps.size - 1 + count, _taps.size - 1)) {
+                bufStart = &buffer[_taps.size - 1];
+            }
+        }
+
+        // Number of taps from which the FFT engine is faster than the direct form
+        virtual int fftCrossover() {
+            return getFFTCrossover<D, T>();
+        }
+
+        void updateEngine() {
+            useFFT = (_engine == ENGINE_FFT) || (_engine == ENGINE_AUTO && _taps.size >= fftCrossover());
+            if (useFFT) {
+                conv.init(_taps);
+            }
+            else {
+                conv.destroy();
+            }
+        }
+
         tap<T> _taps;
-        D* buffer;
+        D* buffer = NULL;
         D* bufStart;
+        int bufCapacity = 0;
+
+        Engine _engine = ENGINE_AUTO;
+        bool useFFT = false;
+        FFTConvolver<D, T> conv;
     };
-}
\ No newline at end of file
+}
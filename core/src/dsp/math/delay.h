@@ -19,7 +19,8 @@ namespace dsp::math {
         void init(stream<T>* in, int delay) {
             _delay = delay;
 
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + 64000);
+            // The room for the input samples is allocated by the first process()
+            buffer::reserve(buffer, bufCapacity, _delay + 1);
             bufStart = &buffer[_delay];
             buffer::clear(buffer, _delay);
 
@@ -31,6 +32,7 @@ namespace dsp::math {
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
             _delay = delay;
+            buffer::reserve(buffer, bufCapacity, _delay + 1);
             bufStart = &buffer[_delay];
             reset();
             base_type::tempStart();
@@ -46,6 +48,9 @@ namespace dsp::math {
 
         inline int process(int count, const T* in, T* out) {
             // Copy data into delay buffer
+            if (buffer::reserve(buffer, bufCapacity, _delay + count, _delay)) {
+                bufStart = &buffer[_delay];
+            }
             memcpy(bufStart, in, count * sizeof(T));
 
             // Copy data out of the delay buffer
@@ -70,7 +75,8 @@ namespace dsp::math {
 
     private:
         int _delay;
-        T* buffer;
+        T* buffer = NULL;
         T* bufStart;
+        int bufCapacity = 0;
     };
 }
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "reduce.h"
+#include <algorithm>
+#include <math.h>
+#include "../simd.h"
+
+namespace dsp::math {
+    // ================= Generic =================
+
+    template <ReduceMode MODE>
+    static inline float identity() {
+        if constexpr (MODE == REDUCE_MIN) { return INFINITY; }
+        else if constexpr (MODE == REDUCE_MAX) { return -INFINITY; }
+        else { return 0.0f; }
+    }
+
+    template <ReduceMode MODE>
+    static inline float apply(float a, float b) {
+        if constexpr (MODE == REDUCE_MIN) { return (b < a) ? b : a; }
+        else if constexpr (MODE == REDUCE_MAX) { return (b > a) ? b : a; }
+        else { return a + b; }
+    }
+
+    template <ReduceMode MODE>
+    static inline float finish(float acc, int count) {
+        if constexpr (MODE == REDUCE_MEAN) { return (count > 0) ? (acc / (float)count) : 0.0f; }
+        else { return acc; }
+    }
+
+    template <ReduceMode MODE>
+    static inline float genericReduce(const float* in, int count) {
+        float acc = identity<MODE>();
+        for (int i = 0; i < count; i++) { acc = apply<MODE>(acc, in[i]); }
+        return finish<MODE>(acc, count);
+    }
+
+    // ================= AVX2 =================
+    // 16 floats per iteration in two accumulators, the remainder is done by the scalar code
+
+#ifdef DSP_SIMD_X86
+    template <ReduceMode MODE>
+    DSP_SIMD_AVX2 static inline __m256 avx2Apply(__m256 a, __m256 b) {
+        if constexpr (MODE == REDUCE_MIN) { return _mm256_min_ps(a, b); }
+        else if constexpr (MODE == REDUCE_MAX) { return _mm256_max_ps(a, b); }
+        else { return _mm256_add_ps(a, b); }
+    }
+
+    template <ReduceMode MODE>
+    DSP_SIMD_AVX2 static inline __m128 sseApply(__m128 a, __m128 b) {
+        if constexpr (MODE == REDUCE_MIN) { return _mm_min_ps(a, b); }
+        else if constexpr (MODE == REDUCE_MAX) { return _mm_max_ps(a, b); }
+        else { return _mm_add_ps(a, b); }
+    }
+
+    template <ReduceMode MODE>
+    DSP_SIMD_AVX2 static inline float avx2Reduce(const float* in, int count) {
+        float acc = identity<MODE>();
+        int i = 0;
+        if (count >= 16) {
+            __m256 a0 = _mm256_loadu_ps(&in[0]);
+            __m256 a1 = _mm256_loadu_ps(&in[8]);
+            for (i = 16; i + 16 <= count; i += 16) {
+                a0 = avx2Apply<MODE>(a0, _mm256_loadu_ps(&in[i]));
+                a1 = avx2Apply<MODE>(a1, _mm256_loadu_ps(&in[i + 8]));
+            }
+            a0 = avx2Apply<MODE>(a0, a1);
+
+            // Horizontal reduction of the 8 lanes
+            __m128 v = sseApply<MODE>(_mm256_castps256_ps128(a0), _mm256_extractf128_ps(a0, 1));
+            v = sseApply<MODE>(v, _mm_movehl_ps(v, v));
+            v = sseApply<MODE>(v, _mm_shuffle_ps(v, v, 1));
+            acc = _mm_cvtss_f32(v);
+        }
+        for (; i < count; i++) { acc = apply<MODE>(acc, in[i]); }
+        return finish<MODE>(acc, count);
+    }
+
+    template <ReduceMode MODE>
+    DSP_SIMD_AVX2 static float avx2Single(const float* in, int count) {
+        return avx2Reduce<MODE>(in, count);
+    }
+
+    template <ReduceMode MODE>
+    DSP_SIMD_AVX2 static void avx2Bins(const float* in, const int* starts, const int* counts, int outSize, float* out) {
+        for (int i = 0; i < outSize; i++) {
+            out[i] = avx2Reduce<MODE>(&in[starts[i]], counts[i]);
+        }
+    }
+#endif
+
+    // ================= NEON =================
+    // 8 floats per iteration in two accumulators, the remainder is done by the scalar code
+
+#ifdef DSP_SIMD_NEON
+    template <ReduceMode MODE>
+    static inline float32x4_t neonApply(float32x4_t a, float32x4_t b) {
+        if constexpr (MODE == REDUCE_MIN) { return vminq_f32(a, b); }
+        else if constexpr (MODE == REDUCE_MAX) { return vmaxq_f32(a, b); }
+        else { return vaddq_f32(a, b); }
+    }
+
+    template <ReduceMode MODE>
+    static inline float neonReduce(const float* in, int count) {
+        float acc = identity<MODE>();
+        int i = 0;
+        if (count >= 8) {
+            float32x4_t a0 = vld1q_f32(&in[0]);
+            float32x4_t a1 = vld1q_f32(&in[4]);
+            for (i = 8; i + 8 <= count; i += 8) {
+                a0 = neonApply<MODE>(a0, vld1q_f32(&in[i]));
+                a1 = neonApply<MODE>(a1, vld1q_f32(&in[i + 4]));
+            }
+            a0 = neonApply<MODE>(a0, a1);
+
+            // Horizontal reduction of the 4 lanes
+            float32x2_t v = vget_low_f32(a0);
+            float32x2_t h = vget_high_f32(a0);
+            if constexpr (MODE == REDUCE_MIN) { v = vpmin_f32(vmin_f32(v, h), vmin_f32(v, h)); }
+            else if constexpr (MODE == REDUCE_MAX) { v = vpmax_f32(vmax_f32(v, h), vmax_f32(v, h)); }
+            else { v = vpadd_f32(vadd_f32(v, h), vadd_f32(v, h)); }
+            acc = vget_lane_f32(v, 0);
+        }
+        for (; i < count; i++) { acc = apply<MODE>(acc, in[i]); }
+        return finish<MODE>(acc, count);
+    }
+
+    template <ReduceMode MODE>
+    static float neonSingle(const float* in, int count) {
+        return neonReduce<MODE>(in, count);
+    }
+
+    template <ReduceMode MODE>
+    static void neonBins(const float* in, const int* starts, const int* counts, int outSize, float* out) {
+        for (int i = 0; i < outSize; i++) {
+            out[i] = neonReduce<MODE>(&in[starts[i]], counts[i]);
+        }
+    }
+#endif
+
+    // ================= Dispatch =================
+
+    template <ReduceMode MODE>
+    static float genericSingle(const float* in, int count) {
+        return genericReduce<MODE>(in, count);
+    }
+
+    template <ReduceMode MODE>
+    static void genericBins(const float* in, const int* starts, const int* counts, int outSize, float* out) {
+        for (int i = 0; i < outSize; i++) {
+            out[i] = genericReduce<MODE>(&in[starts[i]], counts[i]);
+        }
+    }
+
+    // Indexed by ReduceMode
+    struct Kernels {
+        const char* name;
+        float (*reduce[3])(const float* in, int count);
+        void (*bins[3])(const float* in, const int* starts, const int* counts, int outSize, float* out);
+    };
+
+    static Kernels selectKernels() {
+#ifdef DSP_SIMD_X86
+        if (simd::cpuHasAVX2()) {
+            return {
+                "avx2",
+                { avx2Single<REDUCE_MIN>, avx2Single<REDUCE_MAX>, avx2Single<REDUCE_MEAN> },
+                { avx2Bins<REDUCE_MIN>, avx2Bins<REDUCE_MAX>, avx2Bins<REDUCE_MEAN> }
+            };
+        }
+#endif
+#ifdef DSP_SIMD_NEON
+        return {
+            "neon",
+            { neonSingle<REDUCE_MIN>, neonSingle<REDUCE_MAX>, neonSingle<REDUCE_MEAN> },
+            { neonBins<REDUCE_MIN>, neonBins<REDUCE_MAX>, neonBins<REDUCE_MEAN> }
+        };
+#endif
+        return {
+            "generic",
+            { genericSingle<REDUCE_MIN>, genericSingle<REDUCE_MAX>, genericSingle<REDUCE_MEAN> },
+            { genericBins<REDUCE_MIN>, genericBins<REDUCE_MAX>, genericBins<REDUCE_MEAN> }
+        };
+    }
+
+    static const Kernels& kernels() {
+        static const Kernels k = selectKernels();
+        return k;
+    }
+
+    float reduce(const float* in, int count, ReduceMode mode) {
+        return kernels().reduce[mode](in, std::max<int>(count, 0));
+    }
+
+    const char* getReduceKernels() {
+        return kernels().name;
+    }
+
+    void BinReducer::plan(int offset, int width, int inSize, int outSize) {
+        // Nothing to do if the zoom didn't change
+        if (offset == _offset && width == _width && inSize == _inSize && outSize == _outSize) { return; }
+        _offset = offset;
+        _width = width;
+        _inSize = inSize;
+        _outSize = outSize;
+
+        starts.resize(outSize);
+        counts.resize(outSize);
+        if (outSize <= 0) { return; }
+
+        // Step in double precision so that the error doesn't build up across the line
+        double factor = (double)width / (double)outSize;
+        int windowSize = std::max<int>(ceil(factor), 1);
+        double start = std::max<int>(offset, 0);
+        for (int i = 0; i < outSize; i++) {
+            int id = std::clamp<int>(start + (double)i * factor, 0, inSize);
+            starts[i] = id;
+            counts[i] = std::min<int>(windowSize, inSize - id);
+        }
+    }
+
+    void BinReducer::process(const float* in, float* out, ReduceMode mode) {
+        if (_outSize <= 0) { return; }
+        kernels().bins[mode](in, starts.data(), counts.data(), _outSize, out);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+namespace dsp::math {
+    enum ReduceMode {
+        REDUCE_MIN,
+        REDUCE_MAX,
+        REDUCE_MEAN
+    };
+
+    // Minimum, maximum or mean of count floats. An empty range gives INFINITY,
+    // -INFINITY and 0 respectively. The fastest implementation supported by the CPU is picked at runtime.
+    float reduce(const float* in, int count, ReduceMode mode);
+
+    // Name of the instruction set used by the reductions ("avx2", "neon" or "generic")
+    const char* getReduceKernels();
+
+    // Reduces a window of an array of bins to a smaller number of output bins, each output bin
+    // covering ceil(width / outSize) input bins. Used to fit FFT lines to the number of pixels on screen.
+    // The start and size of every window is computed once by plan() and reused until the zoom changes.
+    class BinReducer {
+    public:
+        // Windows start at offset + i * (width / outSize) and are truncated to the inSize input bins
+        void plan(int offset, int width, int inSize, int outSize);
+
+        // Write the outSize reduced bins of the last plan, in must hold the inSize input bins
+        void process(const float* in, float* out, ReduceMode mode = REDUCE_MAX);
+
+    private:
+        int _offset = -1;
+        int _width = -1;
+        int _inSize = -1;
+        int _outSize = -1;
+        std::vector<int> starts;
+        std::vector<int> counts;
+    };
+}
@@ -27,8 +27,8 @@ namespace dsp::multirate {
             // Build filter bank
             phases = buildPolyphaseBank(_interp, _taps);
 
-            // Allocate delay buffer
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + 64000);
+            // Allocate delay buffer, the room for the input samples is allocated by the first process()
+            buffer::reserve(buffer, bufCapacity, phases.tapsPerPhase);
             bufStart = &buffer[phases.tapsPerPhase - 1];
             buffer::clear<T>(buffer, phases.tapsPerPhase - 1);
 
@@ -50,6 +50,7 @@ namespace dsp::multirate {
             phases = buildPolyphaseBank(_interp, _taps);
 
             // Reset buffer
+            buffer::reserve(buffer, bufCapacity, phases.tapsPerPhase);
             bufStart = &buffer[phases.tapsPerPhase - 1];
             reset();
 
@@ -66,10 +67,18 @@ namespace dsp::multirate {
             base_type::tempStart();
         }
 
+        // Most samples process() can output for the given input
+        inline int getMaxOutput(int count) {
+            return ((int64_t)count * _interp) / _decim + 1;
+        }
+
         inline int process(int count, const T* in, T* out) {
             int outCount = 0;
 
             // Copy input to buffer
+            if (buffer::reserve(buffer, bufCapacity, phases.tapsPerPhase - 1 + count, phases.tapsPerPhase - 1)) {
+                bufStart = &buffer[phases.tapsPerPhase - 1];
+            }
             memcpy(bufStart, in, count * sizeof(T));
 
             while (offset < count) {
@@ -102,6 +111,7 @@ namespace dsp::multirate {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            base_type::out.reserve(getMaxOutput(count));
             int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             // Swap if some data was generated
@@ -119,8 +129,9 @@ namespace dsp::multirate {
         PolyphaseBank<float> phases;
         int phase = 0;
         int offset = 0;
-        T* buffer;
+        T* buffer = NULL;
         T* bufStart;
+        int bufCapacity = 0;
 
     };
 }
\ No newline at end of file
@@ -95,10 +95,19 @@ namespace dsp::multirate {
             return count;
         }
 
+        // The resampler works in place in the output, after the decimator
+        inline int getMaxOutput(int count) {
+            if (mode == Mode::BOTH || mode == Mode::RESAMP_ONLY) {
+                return std::max<int>(count, resamp.getMaxOutput(count));
+            }
+            return count;
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            base_type::out.reserve(getMaxOutput(count));
             int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             // Swap if some data was generated
@@ -57,10 +57,15 @@ namespace dsp::multirate {
             return resamp.process(count, in, out);
         }
 
+        inline int getMaxOutput(int count) {
+            return resamp.getMaxOutput(count);
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            base_type::out.reserve(getMaxOutput(count));
             int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             // Swap if some data was generated
@@ -1,7 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "../window/nuttall.h"
-#include <fftw3.h>
+#include "../fft/planner.h"
 
 namespace dsp::noise_reduction {
     class FMIF : public Processor<complex_t, complex_t> {
@@ -44,6 +44,9 @@ namespace dsp::noise_reduction {
 
         int process(int count, const complex_t* in, complex_t* out) {
             // Write new input data to buffer buffer
+            if (buffer::reserve(buffer, bufCapacity, _bins - 1 + count, _bins - 1)) {
+                bufferStart = &buffer[_bins - 1];
+            }
             memcpy(bufferStart, in, count * sizeof(complex_t));
             
             // Iterate the FFT
@@ -96,8 +99,10 @@ namespace dsp::noise_reduction {
             backFFTIn = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
             backFFTOut = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
 
-            // Allocate and clear delay buffer
-            buffer = buffer::alloc<complex_t>(STREAM_BUFFER_SIZE + 64000);
+            // Allocate and clear delay buffer, the room for the input samples is allocated by the first process()
+            buffer = NULL;
+            bufCapacity = 0;
+            buffer::reserve(buffer, bufCapacity, _bins);
             bufferStart = &buffer[_bins - 1];
             buffer::clear(buffer, _bins - 1);
 
@@ -112,13 +117,13 @@ namespace dsp::noise_reduction {
             for (int i = 0; i < _bins; i++) { fftWin[i] = window::nuttall(i, _bins - 1); }
 
             // Plan FFTs
-            forwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)forwFFTIn, (fftwf_complex*)forwFFTOut, FFTW_FORWARD, FFTW_ESTIMATE);
-            backwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)backFFTIn, (fftwf_complex*)backFFTOut, FFTW_BACKWARD, FFTW_ESTIMATE);
+            forwardPlan = fft::planDFT(_bins, (fftwf_complex*)forwFFTIn, (fftwf_complex*)forwFFTOut, FFTW_FORWARD);
+            backwardPlan = fft::planDFT(_bins, (fftwf_complex*)backFFTIn, (fftwf_complex*)backFFTOut, FFTW_BACKWARD);
         }
 
         void destroyBuffers() {
-            fftwf_destroy_plan(forwardPlan);
-            fftwf_destroy_plan(backwardPlan);
+            fft::destroyPlan(forwardPlan);
+            fft::destroyPlan(backwardPlan);
             fftwf_free(forwFFTIn);
             fftwf_free(forwFFTOut);
             fftwf_free(backFFTIn);
@@ -138,6 +143,7 @@ namespace dsp::noise_reduction {
 
         complex_t* buffer;
         complex_t* bufferStart;
+        int bufCapacity;
 
         float* fftWin;
 
@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "block.h"
+
+namespace dsp {
+    // Keeps track of a set of blocks and turns their execution counters and the counters
+    // of their streams into per-block figures, to find which block of a flowgraph is the bottleneck.
+    // When run by their own thread, the time a block spends in run() includes the time
+    // it spends blocked in read() and swap(), the time actually spent processing is the difference.
+    class Profiler {
+    public:
+        struct BlockProfile {
+            std::string name;
+            double elapsed;         // Seconds since the block was added or the counters were reset
+            uint64_t runs;
+            uint64_t samples;       // Samples read from the inputs, or written to the outputs if there are none
+            double runTime;         // Seconds
+            double readWait;        // Seconds blocked waiting for input data
+            double swapWait;        // Seconds blocked waiting for the outputs to be read
+            double inputOccupancy;  // Average fraction of the input buffering that held data (0 to 1)
+            double outputOccupancy; // Average fraction of the output buffering that held data (0 to 1)
+        };
+
+        ~Profiler() {
+            // Make sure the remaining blocks don't try to remove themselves later on
+            std::lock_guard<std::mutex> lck(mtx);
+            for (auto& [blk, entry] : entries) {
+                blk->_profiler = NULL;
+            }
+        }
+
+        std::vector<BlockProfile> getProfiles() {
+            std::lock_guard<std::mutex> lck(mtx);
+            uint64_t now = profilerTime();
+            std::vector<BlockProfile> profiles;
+            for (auto& [blk, entry] : entries) {
+                Totals tot = getTotals(blk);
+                const Totals& base = entry.base;
+                BlockProfile bp;
+                bp.name = entry.name;
+                bp.elapsed = (double)(now - entry.since) / 1e9;
+                bp.runs = diff(tot.runs, base.runs);
+                bp.samples = diff(tot.samples, base.samples);
+                bp.runTime = (double)diff(tot.runTime, base.runTime) / 1e9;
+                bp.readWait = (double)diff(tot.readWait, base.readWait) / 1e9;
+                bp.swapWait = (double)diff(tot.swapWait, base.swapWait) / 1e9;
+                bp.inputOccupancy = occupancy(tot.inResidence - base.inResidence, bp.elapsed);
+                bp.outputOccupancy = occupancy(tot.outResidence - base.outResidence, bp.elapsed);
+                profiles.push_back(bp);
+            }
+            std::sort(profiles.begin(), profiles.end(), [](const BlockProfile& a, const BlockProfile& b) { return a.name < b.name; });
+            return profiles;
+        }
+
+        // Restart all counters from zero
+        void reset() {
+            std::lock_guard<std::mutex> lck(mtx);
+            uint64_t now = profilerTime();
+            for (auto& [blk, entry] : entries) {
+                entry.base = getTotals(blk);
+                entry.since = now;
+            }
+        }
+
+    protected:
+        friend class block;
+
+        // Raw counters, times are in nanoseconds and residences are normalized by the stream capacity
+        struct Totals {
+            uint64_t runs = 0;
+            uint64_t samples = 0;
+            uint64_t runTime = 0;
+            uint64_t readWait = 0;
+            uint64_t swapWait = 0;
+            double inResidence = 0.0;
+            double outResidence = 0.0;
+        };
+
+        struct Entry {
+            std::string name;
+            Totals base;
+            uint64_t since;
+        };
+
+        void add(block* blk, const std::string& name) {
+            blk->setStreamsProfiled(true);
+            std::lock_guard<std::mutex> lck(mtx);
+            Entry entry;
+            entry.name = name;
+            entry.base = getTotals(blk);
+            entry.since = profilerTime();
+            entries[blk] = entry;
+        }
+
+        void remove(block* blk) {
+            blk->setStreamsProfiled(false);
+            std::lock_guard<std::mutex> lck(mtx);
+            entries.erase(blk);
+        }
+
+        Totals getTotals(block* blk) {
+            // The list of streams can only be safely read under the control mutex
+            std::lock_guard<std::recursive_mutex> lck(blk->ctrlMtx);
+            Totals tot;
+            tot.runs = blk->runs;
+            tot.runTime = blk->runTime;
+            tot.samples = blk->fusedSamples;
+            for (auto& in : blk->inputs) {
+                auto st = in->getStats();
+                tot.samples += st.samplesRead;
+                tot.readWait += st.readWaitTime;
+                tot.inResidence += (double)st.residenceTime / (double)(blk->inputs.size() * in->getBlockCapacity());
+            }
+            for (auto& out : blk->outputs) {
+                auto st = out->getStats();
+                if (blk->inputs.empty()) { tot.samples += st.samplesWritten; }
+                tot.swapWait += st.swapWaitTime;
+                tot.outResidence += (double)st.residenceTime / (double)(blk->outputs.size() * out->getBlockCapacity());
+            }
+            return tot;
+        }
+
+        // Counters can appear to go backwards when a block changes streams
+        static uint64_t diff(uint64_t a, uint64_t b) {
+            return (a > b) ? (a - b) : 0;
+        }
+
+        static double occupancy(double residence, double elapsed) {
+            if (elapsed <= 0.0) { return 0.0; }
+            return std::clamp<double>((residence / 1e9) / elapsed, 0.0, 1.0);
+        }
+
+        std::mutex mtx;
+        std::map<block*, Entry> entries;
+    };
+}
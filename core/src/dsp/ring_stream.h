@@ -0,0 +1,245 @@
+#pragma once
+#include <assert.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "stream.h"
+#include "simd.h"
+
+// Default number of blocks in the ring
+#define RING_STREAM_DEFAULT_BLOCK_COUNT     4
+
+// Number of busy polls, each followed by a CPU pause, then yields, before a waiting thread is parked
+#define RING_STREAM_SPIN_COUNT              256
+#define RING_STREAM_YIELD_COUNT             16
+
+namespace dsp {
+    // Single producer, single consumer stream backed by a lock-free ring of fixed size blocks.
+    // It keeps the same writeBuf/readBuf/swap/read/flush contract as dsp::stream,
+    // but the writer can run up to blockCount-1 blocks ahead of the reader and neither
+    // side takes a lock unless it has to sleep. No DSP path uses it yet, it's only measured
+    // against dsp::stream by the bench.
+    template <class T>
+    class ring_stream : public stream<T> {
+        using base_type = stream<T>;
+    public:
+        ring_stream(int blockCount = RING_STREAM_DEFAULT_BLOCK_COUNT, int blockSize = STREAM_BUFFER_SIZE) : base_type(typename base_type::no_alloc_t()) {
+            assert(blockCount >= 2);
+            allocate(blockCount, blockSize);
+        }
+
+        virtual ~ring_stream() {
+            freeBlocks();
+        }
+
+        // Must only be called while neither the reader nor the writer is running
+        virtual void setBufferSize(int samples) {
+            int count = blocks.size();
+            freeBlocks();
+            allocate(count, samples);
+        }
+
+        // Must only be called while neither the reader nor the writer is running
+        void setBlockCount(int blockCount) {
+            assert(blockCount >= 2);
+            freeBlocks();
+            allocate(blockCount, _blockSize);
+        }
+
+        virtual inline bool swap(int size) {
+            // Wait for the block after the current one to be released by the reader
+            uint64_t h = head.load(std::memory_order_relaxed);
+            bool ok = wait([this, h]() { return (h + 1) - tail.load() < blocks.size(); }, writerStop, writerWaiting, writerMtx, writerCV, untyped_stream::swapWaitTime);
+            if (!ok) { return false; }
+
+            // Publish the block and hand the next one to the writer
+            sizes[h % blocks.size()] = size;
+            if (untyped_stream::isProfiled()) {
+                writtenAt[h % blocks.size()] = profilerTime();
+                untyped_stream::samplesWritten += size;
+            }
+            else {
+                writtenAt[h % blocks.size()] = 0;
+            }
+            head.store(h + 1);
+            base_type::writeBuf = blocks[(h + 1) % blocks.size()];
+            base_type::writeCap = caps[(h + 1) % blocks.size()];
+
+            // Wake up the reader only if it's parked
+            if (readerWaiting.load()) {
+                std::lock_guard<std::mutex> lck(readerMtx);
+                readerCV.notify_all();
+            }
+            untyped_stream::notifyReader();
+
+            return true;
+        }
+
+        // Only the block owned by the writer gets reallocated, the others keep their size until they're written to
+        virtual inline void reserve(int samples) {
+            int id = head.load(std::memory_order_relaxed) % blocks.size();
+            if (!buffer::reserve(blocks[id], caps[id], samples)) { return; }
+            base_type::writeBuf = blocks[id];
+            base_type::writeCap = caps[id];
+        }
+
+        // Blocks of the ring can't be lent, so the data is copied instead
+        virtual inline bool share(T* buf, int size, void (*release)(void* ctx), void* ctx) {
+            reserve(size);
+            memcpy(base_type::writeBuf, buf, size * sizeof(T));
+            if (!swap(size)) { return false; }
+            release(ctx);
+            return true;
+        }
+
+        virtual inline int read() {
+            // Wait for a block to be published
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            bool ok = wait([this, t]() { return head.load() > t; }, readerStop, readerWaiting, readerMtx, readerCV, untyped_stream::readWaitTime);
+            if (!ok) { return -1; }
+
+            base_type::readBuf = blocks[t % blocks.size()];
+            if (untyped_stream::isProfiled()) {
+                untyped_stream::samplesRead += sizes[t % blocks.size()];
+                untyped_stream::blocksRead++;
+            }
+            return sizes[t % blocks.size()];
+        }
+
+        virtual inline void flush() {
+            // Release the block being read, if any
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            if (t >= head.load()) { return; }
+            uint64_t written = writtenAt[t % blocks.size()];
+            if (written) { untyped_stream::residenceTime += profilerTime() - written; }
+            tail.store(t + 1);
+
+            // Wake up the writer only if it's parked
+            if (writerWaiting.load()) {
+                std::lock_guard<std::mutex> lck(writerMtx);
+                writerCV.notify_all();
+            }
+            untyped_stream::notifyWriter();
+        }
+
+        virtual bool isReadable() {
+            return readerStop || head.load() > tail.load(std::memory_order_relaxed);
+        }
+
+        virtual bool isWritable() {
+            return writerStop || (head.load(std::memory_order_relaxed) + 1) - tail.load() < blocks.size();
+        }
+
+        virtual void stopWriter() {
+            {
+                std::lock_guard<std::mutex> lck(writerMtx);
+                writerStop = true;
+            }
+            writerCV.notify_all();
+        }
+
+        virtual void clearWriteStop() {
+            writerStop = false;
+        }
+
+        virtual void stopReader() {
+            {
+                std::lock_guard<std::mutex> lck(readerMtx);
+                readerStop = true;
+            }
+            readerCV.notify_all();
+        }
+
+        virtual void clearReadStop() {
+            readerStop = false;
+        }
+
+        int getBlockCount() { return blocks.size(); }
+
+        virtual int getBlockCapacity() { return blocks.size() - 1; }
+
+    private:
+        void allocate(int blockCount, int blockSize) {
+            _blockSize = blockSize;
+            blocks.resize(blockCount);
+            sizes.resize(blockCount);
+            caps.resize(blockCount);
+            writtenAt.resize(blockCount);
+            for (int i = 0; i < blockCount; i++) {
+                blocks[i] = buffer::alloc<T>(blockSize);
+                caps[i] = blockSize;
+                sizes[i] = 0;
+                writtenAt[i] = 0;
+            }
+            head = 0;
+            tail = 0;
+            base_type::writeBuf = blocks[0];
+            base_type::readBuf = blocks[0];
+            base_type::writeCap = blockSize;
+            base_type::readCap = blockSize;
+        }
+
+        void freeBlocks() {
+            for (auto& b : blocks) {
+                buffer::free(b);
+            }
+            blocks.clear();
+            sizes.clear();
+            caps.clear();
+            writtenAt.clear();
+
+            // Prevent the base class from freeing the blocks a second time
+            base_type::writeBuf = NULL;
+            base_type::readBuf = NULL;
+            base_type::writeCap = 0;
+            base_type::readCap = 0;
+        }
+
+        template <class Func>
+        inline bool wait(Func ready, std::atomic_bool& stop, std::atomic_bool& waiting, std::mutex& mtx, std::condition_variable& cv, std::atomic<uint64_t>& waitTime) {
+            if (stop.load(std::memory_order_relaxed)) { return false; }
+            if (ready()) { return true; }
+            bool profiled = untyped_stream::isProfiled();
+            uint64_t start = profiled ? profilerTime() : 0;
+
+            // Spin for a short while, the other side is usually only a few microseconds away
+            for (int i = 0; i < RING_STREAM_SPIN_COUNT + RING_STREAM_YIELD_COUNT; i++) {
+                if (stop.load(std::memory_order_relaxed)) { return false; }
+                if (ready()) {
+                    if (profiled) { waitTime += profilerTime() - start; }
+                    return true;
+                }
+                if (i < RING_STREAM_SPIN_COUNT) { simd::cpuRelax(); }
+                else { std::this_thread::yield(); }
+            }
+
+            // Park until woken up by the other side or stopped
+            std::unique_lock<std::mutex> lck(mtx);
+            waiting = true;
+            cv.wait(lck, [&]() { return stop || ready(); });
+            waiting = false;
+            if (profiled) { waitTime += profilerTime() - start; }
+            return !stop;
+        }
+
+        std::vector<T*> blocks;
+        std::vector<int> sizes;
+        std::vector<int> caps;
+        std::vector<uint64_t> writtenAt;
+        int _blockSize;
+
+        // Total number of blocks published by the writer and released by the reader
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+
+        std::mutex writerMtx;
+        std::condition_variable writerCV;
+        std::atomic_bool writerWaiting = false;
+        std::atomic_bool writerStop = false;
+
+        std::mutex readerMtx;
+        std::condition_variable readerCV;
+        std::atomic_bool readerWaiting = false;
+        std::atomic_bool readerStop = false;
+    };
+}
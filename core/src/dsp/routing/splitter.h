@@ -1,7 +1,14 @@
 #pragma once
 #include "../sink.h"
 
+// Longest time a destroyed splitter waits for the readers to flush the shared input
+#define SPLITTER_RELEASE_TIMEOUT_MS 1000
+
 namespace dsp::routing {
+    // By default, every bound stream gets a copy of the input. With sharing enabled, the bound streams are instead
+    // handed the input buffer itself and the input is only flushed once every one of them flushed it, so their readers
+    // must not modify the data and must flush it when done. Streams whose reader needs to modify the data in place must
+    // then be bound with a private copy.
     template <class T>
     class Splitter : public Sink<T> {
         using base_type = Sink<T>;
@@ -10,58 +17,151 @@ namespace dsp::routing {
 
         Splitter(stream<T>* in) { base_type::init(in); }
 
-        void bindStream(stream<T>* stream) {
+        ~Splitter() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            for (const auto& stream : streams) {
+                stream->reclaim();
+            }
+
+            // The readers that already took the input still hold a reference until they flush it. Those that
+            // don't in time are detached so that they can't call back into the destroyed splitter.
+            std::unique_lock<std::mutex> lck(refMtx);
+            if (refCV.wait_for(lck, std::chrono::milliseconds(SPLITTER_RELEASE_TIMEOUT_MS), [this]() { return !refCount; })) { return; }
+            for (const auto& stream : streams) {
+                stream->detachShared();
+            }
+        }
+
+        // Must be set before binding streams
+        void setSharing(bool enabled) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            
+            base_type::tempStop();
+            sharing = enabled;
+            base_type::tempStart();
+        }
+
+        void bindStream(stream<T>* stream, bool privateCopy = false) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
             // Check that the stream isn't already bound
-            if (std::find(streams.begin(), streams.end(), stream) != streams.end()) {
+            if (std::find(streams.begin(), streams.end(), stream) != streams.end() ||
+                std::find(copyStreams.begin(), copyStreams.end(), stream) != copyStreams.end()) {
                 throw std::runtime_error("[Splitter] Tried to bind stream to that is already bound");
             }
 
             // Add to the list
             base_type::tempStop();
             base_type::registerOutput(stream);
-            streams.push_back(stream);
+            if (privateCopy || !sharing) {
+                copyStreams.push_back(stream);
+            }
+            else {
+                streams.push_back(stream);
+            }
             base_type::tempStart();
         }
 
         void unbindStream(stream<T>* stream) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            
+
             // Check that the stream is bound
             auto sit = std::find(streams.begin(), streams.end(), stream);
-            if (sit == streams.end()) {
+            auto cit = std::find(copyStreams.begin(), copyStreams.end(), stream);
+            if (sit == streams.end() && cit == copyStreams.end()) {
                 throw std::runtime_error("[Splitter] Tried to unbind stream to that isn't bound");
             }
 
-            // Add to the list
+            // Remove from the list
             base_type::tempStop();
-            streams.erase(sit);
+            if (sit != streams.end()) {
+                streams.erase(sit);
+
+                // Take back the input buffer if the reader didn't get to it, it might never flush it
+                stream->reclaim();
+            }
+            else {
+                copyStreams.erase(cit);
+            }
             base_type::unregisterOutput(stream);
             base_type::tempStart();
         }
 
         int run() {
+            // The input is only flushed once the readers released it, reading it before would get the same block again.
+            // The scheduler runs the block again once the outputs are flushed, so it doesn't wait for it.
+            {
+                std::unique_lock<std::mutex> lck(refMtx);
+                if (refCount && base_type::_scheduler) { return 0; }
+                refCV.wait(lck, [this]() { return !refCount || stopping; });
+                if (stopping) { return -1; }
+            }
+
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
-            for (const auto& stream : streams) {
+            // Hold a reference until all streams are served so that the input doesn't get flushed early
+            {
+                std::lock_guard<std::mutex> lck(refMtx);
+                sharedIn = base_type::_in;
+                refCount = streams.size() + 1;
+            }
+
+            for (int i = 0; i < streams.size(); i++) {
+                if (!streams[i]->share(base_type::_in->readBuf, count, releaseShared, this)) {
+                    // Drop the references of the streams that didn't get the buffer
+                    for (; i < streams.size(); i++) { releaseShared(this); }
+                    releaseShared(this);
+                    return -1;
+                }
+            }
+
+            for (const auto& stream : copyStreams) {
+                stream->reserve(count);
                 memcpy(stream->writeBuf, base_type::_in->readBuf, count * sizeof(T));
                 if (!stream->swap(count)) {
-                    base_type::_in->flush();
+                    releaseShared(this);
                     return -1;
                 }
             }
 
-            base_type::_in->flush();
+            releaseShared(this);
 
             return count;
         }
 
     protected:
+        void doStop() {
+            {
+                std::lock_guard<std::mutex> lck(refMtx);
+                stopping = true;
+            }
+            refCV.notify_all();
+            base_type::doStop();
+            stopping = false;
+        }
+
+        // Notifies under the lock, the destructor may free the splitter as soon as it gets the lock back
+        static void releaseShared(void* ctx) {
+            Splitter<T>* _this = (Splitter<T>*)ctx;
+            std::lock_guard<std::mutex> lck(_this->refMtx);
+            if (--_this->refCount) { return; }
+            _this->sharedIn->flush();
+            _this->refCV.notify_all();
+        }
+
         std::vector<stream<T>*> streams;
+        std::vector<stream<T>*> copyStreams;
+        bool sharing = false;
+
+        std::mutex refMtx;
+        std::condition_variable refCV;
+        int refCount = 0;
+        bool stopping = false;
+        stream<T>* sharedIn = NULL;
 
     };
 }
\ No newline at end of file
@@ -0,0 +1,318 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+#include "block.h"
+
+namespace dsp {
+    // Runs the run() function of blocks on a fixed pool of worker threads instead of one thread per block.
+    // A block is only run once all of its inputs have data and all of its outputs can be swapped,
+    // so that run() never blocks. This requires run() to do at most one read() per input and one
+    // swap() per output, which is the case for all blocks using the standard processing loop.
+    class Scheduler {
+    public:
+        struct BlockStats {
+            std::string name;
+            uint64_t runs;
+            double totalTime;   // Seconds
+            double maxTime;     // Seconds
+        };
+
+        ~Scheduler() {
+            stop();
+        }
+
+        // A thread count of 0 uses one thread per hardware thread
+        void start(int threadCount = 0) {
+            std::lock_guard<std::mutex> lck(ctrlMtx);
+            if (running) { return; }
+            if (threadCount <= 0) { threadCount = std::max<int>(std::thread::hardware_concurrency(), 1); }
+            running = true;
+            for (int i = 0; i < threadCount; i++) {
+                queues.push_back(new WorkQueue);
+            }
+            for (int i = 0; i < threadCount; i++) {
+                workers.push_back(std::thread(&Scheduler::worker, this, i));
+            }
+        }
+
+        // All blocks must have been removed before stopping the scheduler
+        void stop() {
+            std::lock_guard<std::mutex> lck(ctrlMtx);
+            if (!running) { return; }
+            {
+                std::lock_guard<std::mutex> lck2(sleepMtx);
+                running = false;
+            }
+            sleepCV.notify_all();
+            for (auto& w : workers) {
+                if (w.joinable()) { w.join(); }
+            }
+            workers.clear();
+            for (auto& q : queues) { delete q; }
+            queues.clear();
+        }
+
+        bool isRunning() {
+            return running;
+        }
+
+        int getThreadCount() {
+            return workers.size();
+        }
+
+        std::vector<BlockStats> getStats() {
+            std::lock_guard<std::mutex> lck(tasksMtx);
+            std::vector<BlockStats> stats;
+            for (auto& [blk, task] : tasks) {
+                BlockStats bs;
+                bs.name = task->name;
+                bs.runs = task->runs;
+                bs.totalTime = (double)task->totalTime / 1e9;
+                bs.maxTime = (double)task->maxTime / 1e9;
+                stats.push_back(bs);
+            }
+            return stats;
+        }
+
+    protected:
+        friend class block;
+
+        enum TaskState {
+            TASK_STATE_IDLE,
+            TASK_STATE_QUEUED,
+            TASK_STATE_RUNNING,
+            TASK_STATE_RERUN
+        };
+
+        struct Task {
+            Scheduler* sched;
+            block* blk;
+            std::string name;
+            std::atomic<int> state = TASK_STATE_IDLE;
+            std::atomic_bool removed = false;
+
+            // Execution time counters in nanoseconds
+            std::atomic<uint64_t> runs = 0;
+            std::atomic<uint64_t> totalTime = 0;
+            std::atomic<uint64_t> maxTime = 0;
+        };
+
+        struct WorkQueue {
+            std::mutex mtx;
+            std::deque<Task*> tasks;
+        };
+
+        void add(block* blk, const std::string& name) {
+            assert(running);
+            Task* task = new Task;
+            task->sched = this;
+            task->blk = blk;
+            task->name = name;
+            {
+                std::lock_guard<std::mutex> lck(tasksMtx);
+                tasks[blk] = task;
+            }
+
+            // Get notified of any change of the block's streams
+            for (auto& in : blk->inputs) { in->setReaderNotifier(notify, task); }
+            for (auto& out : blk->outputs) { out->setWriterNotifier(notify, task); }
+
+            // Data might already be waiting
+            notify(task);
+        }
+
+        void remove(block* blk) {
+            Task* task;
+            {
+                std::lock_guard<std::mutex> lck(tasksMtx);
+                auto it = tasks.find(blk);
+                if (it == tasks.end()) { return; }
+                task = it->second;
+                tasks.erase(it);
+            }
+
+            // Stop notifications and wait for any pending execution to be over
+            removing++;
+            task->removed = true;
+            for (auto& in : blk->inputs) { in->setReaderNotifier(NULL, NULL); }
+            for (auto& out : blk->outputs) { out->setWriterNotifier(NULL, NULL); }
+            {
+                std::unique_lock<std::mutex> lck(idleMtx);
+                idleCV.wait(lck, [task]() { return task->state == TASK_STATE_IDLE; });
+            }
+            removing--;
+            delete task;
+        }
+
+        static void notify(void* ctx) {
+            Task* task = (Task*)ctx;
+            int state = task->state.load();
+            while (true) {
+                if (state == TASK_STATE_IDLE) {
+                    if (task->state.compare_exchange_weak(state, TASK_STATE_QUEUED)) {
+                        task->sched->push(task);
+                        return;
+                    }
+                }
+                else if (state == TASK_STATE_RUNNING) {
+                    if (task->state.compare_exchange_weak(state, TASK_STATE_RERUN)) { return; }
+                }
+                else {
+                    // Already queued or already flagged to run again
+                    return;
+                }
+            }
+        }
+
+        static int& currentWorker() {
+            static thread_local int id = -1;
+            return id;
+        }
+
+        static Scheduler*& currentScheduler() {
+            static thread_local Scheduler* sched = NULL;
+            return sched;
+        }
+
+        void push(Task* task) {
+            // Keep the task on the current worker if possible, its data is most likely still in cache
+            int id = (currentScheduler() == this) ? currentWorker() : (nextQueue++ % queues.size());
+            {
+                std::lock_guard<std::mutex> lck(queues[id]->mtx);
+                queues[id]->tasks.push_back(task);
+            }
+            pending++;
+
+            // Wake up a worker if any is sleeping
+            if (sleeping.load()) {
+                std::lock_guard<std::mutex> lck(sleepMtx);
+                sleepCV.notify_one();
+            }
+        }
+
+        Task* pop(int id) {
+            int count = queues.size();
+            while (true) {
+                // Try the worker's own queue first, newest task first
+                {
+                    std::lock_guard<std::mutex> lck(queues[id]->mtx);
+                    if (!queues[id]->tasks.empty()) {
+                        Task* task = queues[id]->tasks.back();
+                        queues[id]->tasks.pop_back();
+                        pending--;
+                        return task;
+                    }
+                }
+
+                // Then steal the oldest task of the other workers
+                for (int i = 1; i < count; i++) {
+                    WorkQueue* q = queues[(id + i) % count];
+                    std::lock_guard<std::mutex> lck(q->mtx);
+                    if (!q->tasks.empty()) {
+                        Task* task = q->tasks.front();
+                        q->tasks.pop_front();
+                        pending--;
+                        return task;
+                    }
+                }
+
+                // Nothing to do, sleep until some work gets pushed
+                std::unique_lock<std::mutex> lck(sleepMtx);
+                sleeping++;
+                sleepCV.wait(lck, [this]() { return pending.load() > 0 || !running; });
+                sleeping--;
+                if (!running) { return NULL; }
+            }
+        }
+
+        void execute(Task* task) {
+            task->state = TASK_STATE_RUNNING;
+
+            if (!task->removed && isReady(task->blk)) {
+                auto start = std::chrono::high_resolution_clock::now();
+                task->blk->run();
+                uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+                task->runs++;
+                task->totalTime += time;
+                if (time > task->maxTime) { task->maxTime = time; }
+                if (task->blk->_profiler) {
+                    task->blk->runs++;
+                    task->blk->runTime += time;
+                }
+            }
+
+            // Once back to idle, the task may be deleted by remove() at any time and must not be touched
+            if (!task->removed) {
+                // If the task was notified while running or still has data to process (streams
+                // holding more than one block only notify once per block), queue it again
+                int expected = TASK_STATE_RUNNING;
+                if (!isReady(task->blk) && task->state.compare_exchange_strong(expected, TASK_STATE_IDLE)) {
+                    // It may have been removed in the meantime, the task can't be touched anymore but remove() can be woken up
+                    if (removing) { wakeRemove(); }
+                    return;
+                }
+                task->state = TASK_STATE_QUEUED;
+                push(task);
+                return;
+            }
+
+            // Let remove() know that the task is done
+            {
+                std::lock_guard<std::mutex> lck(idleMtx);
+                task->state = TASK_STATE_IDLE;
+            }
+            idleCV.notify_all();
+        }
+
+        void wakeRemove() {
+            // Taking the mutex makes sure remove() is either waiting or yet to check the state
+            { std::lock_guard<std::mutex> lck(idleMtx); }
+            idleCV.notify_all();
+        }
+
+        bool isReady(block* blk) {
+            for (auto& in : blk->inputs) {
+                if (!in->isReadable()) { return false; }
+            }
+            for (auto& out : blk->outputs) {
+                if (!out->isWritable()) { return false; }
+            }
+            return true;
+        }
+
+        void worker(int id) {
+            currentWorker() = id;
+            currentScheduler() = this;
+            while (true) {
+                Task* task = pop(id);
+                if (!task) { return; }
+                execute(task);
+            }
+        }
+
+        std::mutex ctrlMtx;
+        std::atomic_bool running = false;
+        std::vector<std::thread> workers;
+        std::vector<WorkQueue*> queues;
+        std::atomic<uint32_t> nextQueue = 0;
+
+        std::mutex sleepMtx;
+        std::condition_variable sleepCV;
+        std::atomic<int> pending = 0;
+        std::atomic<int> sleeping = 0;
+
+        std::mutex tasksMtx;
+        std::map<block*, Task*> tasks;
+
+        std::mutex idleMtx;
+        std::condition_variable idleCV;
+        std::atomic<int> removing = 0;
+    };
+}
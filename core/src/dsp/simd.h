@@ -0,0 +1,53 @@
+#pragma once
+
+// Helpers for the kernels that come with hand written SIMD variants picked at runtime.
+// DSP_SIMD_AVX2 marks the functions that may use AVX2 and FMA, they must only be called when cpuHasAVX2() returns true.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DSP_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DSP_SIMD_AVX2
+#else
+#define DSP_SIMD_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DSP_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace dsp::simd {
+#ifdef DSP_SIMD_X86
+    inline bool cpuHasAVX2() {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 0);
+        if (regs[0] < 7) { return false; }
+
+        // FMA and the OS saving the AVX registers
+        __cpuid(regs, 1);
+        bool fma = regs[2] & (1 << 12);
+        bool osxsave = regs[2] & (1 << 27);
+        if (!fma || !osxsave || (_xgetbv(0) & 6) != 6) { return false; }
+
+        __cpuidex(regs, 7, 0);
+        return regs[1] & (1 << 5);
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }
+#endif
+
+    // Tell the CPU that the thread is busy waiting, so that it backs off instead of hammering the shared cache line
+    inline void cpuRelax() {
+#if defined(DSP_SIMD_X86)
+        _mm_pause();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+        __yield();
+#elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+}
@@ -1,7 +1,9 @@
 #pragma once
 #include <string.h>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
+#include <chrono>
 #include <volk/volk.h>
 #include "buffer/buffer.h"
 
@@ -9,8 +11,15 @@
 #define STREAM_BUFFER_SIZE 1000000
 
 namespace dsp {
+    // Monotonic time in nanoseconds used by the profiling counters
+    inline uint64_t profilerTime() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     class untyped_stream {
     public:
+        virtual ~untyped_stream() {}
+
         virtual bool swap(int size) { return false; }
         virtual int read() { return -1; }
         virtual void flush() {}
@@ -18,14 +27,109 @@ namespace dsp {
         virtual void clearWriteStop() {}
         virtual void stopReader() {}
         virtual void clearReadStop() {}
+
+        // Non-blocking checks of whether read() and swap() would return immediately
+        virtual bool isReadable() { return true; }
+        virtual bool isWritable() { return true; }
+
+        // Profiling counters, all times are in nanoseconds
+        struct StreamStats {
+            uint64_t samplesWritten;
+            uint64_t samplesRead;
+            uint64_t blocksRead;
+            uint64_t readWaitTime;  // Time spent by the reader blocked in read()
+            uint64_t swapWaitTime;  // Time spent by the writer blocked in swap()
+            uint64_t residenceTime; // Sum over all blocks of the time between being written and being flushed
+        };
+
+        StreamStats getStats() {
+            StreamStats st;
+            st.samplesWritten = samplesWritten;
+            st.samplesRead = samplesRead;
+            st.blocksRead = blocksRead;
+            st.readWaitTime = readWaitTime;
+            st.swapWaitTime = swapWaitTime;
+            st.residenceTime = residenceTime;
+            return st;
+        }
+
+        // The profiling counters are only kept up to date while a profiler watches a block using the stream
+        void setProfiled(bool profiled) { profilers.fetch_add(profiled ? 1 : -1, std::memory_order_relaxed); }
+        inline bool isProfiled() { return profilers.load(std::memory_order_relaxed) > 0; }
+
+        // Maximum number of blocks waiting for the reader
+        virtual int getBlockCapacity() { return 1; }
+
+        // Set a function to call when data becomes available to the reader (NULL to remove)
+        void setReaderNotifier(void (*notify)(void* ctx), void* ctx) {
+            std::lock_guard<std::mutex> lck(notifyMtx);
+            readerNotify = notify;
+            readerNotifyCtx = ctx;
+            hasNotifier = (readerNotify || writerNotify);
+        }
+
+        // Set a function to call when the writer becomes allowed to swap (NULL to remove)
+        void setWriterNotifier(void (*notify)(void* ctx), void* ctx) {
+            std::lock_guard<std::mutex> lck(notifyMtx);
+            writerNotify = notify;
+            writerNotifyCtx = ctx;
+            hasNotifier = (readerNotify || writerNotify);
+        }
+
+    protected:
+        inline void notifyReader() {
+            if (!hasNotifier.load(std::memory_order_relaxed)) { return; }
+            std::lock_guard<std::mutex> lck(notifyMtx);
+            if (readerNotify) { readerNotify(readerNotifyCtx); }
+        }
+
+        inline void notifyWriter() {
+            if (!hasNotifier.load(std::memory_order_relaxed)) { return; }
+            std::lock_guard<std::mutex> lck(notifyMtx);
+            if (writerNotify) { writerNotify(writerNotifyCtx); }
+        }
+
+        // Wait on a condition variable, accounting for the time spent blocked when profiled
+        template <class Func>
+        inline void timedWait(std::condition_variable& cv, std::unique_lock<std::mutex>& lck, std::atomic<uint64_t>& waitTime, Func ready) {
+            if (ready()) { return; }
+            if (!isProfiled()) {
+                cv.wait(lck, ready);
+                return;
+            }
+            uint64_t start = profilerTime();
+            cv.wait(lck, ready);
+            waitTime += profilerTime() - start;
+        }
+
+        std::atomic<uint64_t> samplesWritten = 0;
+        std::atomic<uint64_t> samplesRead = 0;
+        std::atomic<uint64_t> blocksRead = 0;
+        std::atomic<uint64_t> readWaitTime = 0;
+        std::atomic<uint64_t> swapWaitTime = 0;
+        std::atomic<uint64_t> residenceTime = 0;
+        std::atomic<int> profilers = 0;
+
+    private:
+        std::mutex notifyMtx;
+        std::atomic_bool hasNotifier = false;
+        void (*readerNotify)(void* ctx) = NULL;
+        void* readerNotifyCtx = NULL;
+        void (*writerNotify)(void* ctx) = NULL;
+        void* writerNotifyCtx = NULL;
     };
 
     template <class T>
     class stream : public untyped_stream {
     public:
-        stream() {
-            writeBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
-            readBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+        stream() : stream(STREAM_BUFFER_SIZE) {}
+
+        // A buffer size of zero gives an adaptive stream whose buffers are only allocated by reserve()
+        explicit stream(int bufferSize) {
+            writeBuf = bufferSize ? buffer::alloc<T>(bufferSize) : NULL;
+            readBuf = bufferSize ? buffer::alloc<T>(bufferSize) : NULL;
+            writeCap = bufferSize;
+            readCap = bufferSize;
         }
 
         virtual ~stream() {
@@ -33,28 +137,72 @@ namespace dsp {
         }
 
         virtual void setBufferSize(int samples) {
+            dropShared();
             buffer::free(writeBuf);
             buffer::free(readBuf);
             writeBuf = buffer::alloc<T>(samples);
             readBuf = buffer::alloc<T>(samples);
+            writeCap = samples;
+            readCap = samples;
         }
 
+        // Make sure writeBuf can hold at least the given number of samples, growing it if needed.
+        // Must only be called by the writer, before writing to writeBuf. The content of writeBuf is lost when it grows.
+        virtual inline void reserve(int samples) {
+            buffer::reserve(writeBuf, writeCap, samples);
+        }
+
+        // Number of samples that can be written to writeBuf without calling reserve()
+        inline int getBufferSize() { return writeCap; }
+
         virtual inline bool swap(int size) {
             {
                 // Wait to either swap or stop
                 std::unique_lock<std::mutex> lck(swapMtx);
-                swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+                timedWait(swapCV, lck, swapWaitTime, [this] { return (canSwap || writerStop); });
 
                 // If writer was stopped, abandon operation
                 if (writerStop) { return false; }
 
                 // Swap buffers
                 dataSize = size;
-                T* temp = writeBuf;
-                writeBuf = readBuf;
-                readBuf = temp;
+                std::swap(writeBuf, readBuf);
+                std::swap(writeCap, readCap);
+                canSwap = false;
+            }
+            countWrite(size);
+
+            // Notify reader that some data is ready
+            {
+                std::lock_guard<std::mutex> lck(rdyMtx);
+                dataReady = true;
+            }
+            rdyCV.notify_all();
+            untyped_stream::notifyReader();
+
+            return true;
+        }
+
+        // Hand a buffer owned by the writer to the reader instead of swapping, the reader gets it as readBuf.
+        // The reader must not modify it. release(ctx) is called once the reader flushed it or it got reclaimed.
+        virtual inline bool share(T* buf, int size, void (*release)(void* ctx), void* ctx) {
+            {
+                // Wait to either swap or stop
+                std::unique_lock<std::mutex> lck(swapMtx);
+                timedWait(swapCV, lck, swapWaitTime, [this] { return (canSwap || writerStop); });
+
+                // If writer was stopped, abandon operation
+                if (writerStop) { return false; }
+
+                // Lend the buffer, keeping our own to give it back on flush
+                dataSize = size;
+                ownReadBuf = readBuf;
+                readBuf = buf;
+                releaseHandler = release;
+                releaseCtx = ctx;
                 canSwap = false;
             }
+            countWrite(size);
 
             // Notify reader that some data is ready
             {
@@ -62,32 +210,91 @@ namespace dsp {
                 dataReady = true;
             }
             rdyCV.notify_all();
+            untyped_stream::notifyReader();
 
             return true;
         }
 
+        // Stop notifying the owner of a shared buffer once the reader flushes it, for owners that go away first
+        void detachShared() {
+            std::lock_guard<std::mutex> lck(swapMtx);
+            if (!releaseHandler) { return; }
+            releaseHandler = [](void* ctx) {};
+            releaseCtx = NULL;
+        }
+
+        // Give back a shared buffer that the reader hasn't started reading yet
+        void reclaim() {
+            // Make sure the reader can't get it anymore
+            {
+                std::lock_guard<std::mutex> lck(rdyMtx);
+                if (!dataReady || dataTaken) { return; }
+                std::lock_guard<std::mutex> lck2(swapMtx);
+                if (!releaseHandler) { return; }
+                dataReady = false;
+            }
+            flush();
+        }
+
         virtual inline int read() {
             // Wait for data to be ready or to be stopped
             std::unique_lock<std::mutex> lck(rdyMtx);
-            rdyCV.wait(lck, [this] { return (dataReady || readerStop); });
+            timedWait(rdyCV, lck, readWaitTime, [this] { return (dataReady || readerStop); });
+            if (readerStop) { return -1; }
 
-            return (readerStop ? -1 : dataSize);
+            dataTaken = true;
+            if (isProfiled()) {
+                samplesRead += dataSize;
+                blocksRead++;
+            }
+            return dataSize;
         }
 
         virtual inline void flush() {
             // Clear data ready
             {
                 std::lock_guard<std::mutex> lck(rdyMtx);
+                if (dataReady && writtenAt) { residenceTime += profilerTime() - writtenAt; }
                 dataReady = false;
+                dataTaken = false;
             }
 
             // Notify writer that buffers can be swapped
+            void (*release)(void* ctx) = NULL;
+            void* ctx;
             {
                 std::lock_guard<std::mutex> lck(swapMtx);
+                if (releaseHandler) {
+                    readBuf = ownReadBuf;
+                    release = releaseHandler;
+                    ctx = releaseCtx;
+                    releaseHandler = NULL;
+                }
                 canSwap = true;
             }
 
+            // Give back the shared buffer if there was one
+            if (release) { release(ctx); }
+
             swapCV.notify_all();
+            untyped_stream::notifyWriter();
+        }
+
+        virtual bool isReadable() {
+            std::lock_guard<std::mutex> lck(rdyMtx);
+            return dataReady || readerStop;
+        }
+
+        virtual bool isWritable() {
+            std::lock_guard<std::mutex> lck(swapMtx);
+            return canSwap || writerStop;
+        }
+
+        // Wait for the reader to flush the last block, returns false if the writer got stopped first
+        bool waitFlushed() {
+            std::unique_lock<std::mutex> lck(swapMtx);
+            swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+            return !writerStop;
         }
 
         virtual void stopWriter() {
@@ -115,16 +322,49 @@ namespace dsp {
         }
 
         void free() {
+            dropShared();
             if (writeBuf) { buffer::free(writeBuf); }
             if (readBuf) { buffer::free(readBuf); }
             writeBuf = NULL;
             readBuf = NULL;
+            writeCap = 0;
+            readCap = 0;
         }
 
         T* writeBuf;
         T* readBuf;
 
+    protected:
+        // Used by derived streams that manage their own buffers
+        struct no_alloc_t {};
+        stream(no_alloc_t) {
+            writeBuf = NULL;
+            readBuf = NULL;
+        }
+
+        // Capacity of writeBuf and readBuf, the capacity of a shared buffer isn't tracked
+        int writeCap = 0;
+        int readCap = 0;
+
     private:
+        // A block written while not profiled gets no residence time
+        inline void countWrite(int size) {
+            if (!isProfiled()) {
+                writtenAt = 0;
+                return;
+            }
+            samplesWritten += size;
+            writtenAt = profilerTime();
+        }
+
+        // Give back a shared buffer that will never be flushed
+        void dropShared() {
+            if (!releaseHandler) { return; }
+            readBuf = ownReadBuf;
+            releaseHandler(releaseCtx);
+            releaseHandler = NULL;
+        }
+
         std::mutex swapMtx;
         std::condition_variable swapCV;
         bool canSwap = true;
@@ -137,5 +377,12 @@ namespace dsp {
         bool writerStop = false;
 
         int dataSize = 0;
+        uint64_t writtenAt = 0;
+
+        // Shared buffer lent by the writer
+        bool dataTaken = false;
+        T* ownReadBuf = NULL;
+        void (*releaseHandler)(void* ctx) = NULL;
+        void* releaseCtx = NULL;
     };
 }
\ No newline at end of file
@@ -27,6 +27,7 @@
 #include <gui/colormaps.h>
 #include <gui/widgets/snr_meter.h>
 #include <gui/tuner.h>
+#include <signal_path/profiler_interface.h>
 
 void MainWindow::init() {
     LoadingScreen::show("Initializing UI");
@@ -86,11 +87,19 @@ void MainWindow::init() {
 
     fft_in = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
     fft_out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
-    fftwPlan = fftwf_plan_dft_1d(fftSize, fft_in, fft_out, FFTW_FORWARD, FFTW_ESTIMATE);
+    fftwPlan = dsp::fft::planDFT(fftSize, fft_in, fft_out, FFTW_FORWARD);
 
     sigpath::iqFrontEnd.init(&dummyStream, 8000000, true, 1, false, 1024, 20.0, IQFrontEnd::FFTWindow::NUTTALL, acquireFFTBuffer, releaseFFTBuffer, this);
+    if (sigpath::scheduler.isRunning()) { sigpath::iqFrontEnd.setScheduler(&sigpath::scheduler); }
     sigpath::iqFrontEnd.start();
 
+    // Profile the DSP blocks if enabled and let other modules read the counters
+    core::configManager.acquire();
+    bool profile = core::configManager.conf["dspProfiling"];
+    core::configManager.release();
+    setProfiling(profile);
+    core::modComManager.registerInterface("core", PROFILER_IFACE_NAME, profilerInterfaceHandler, this);
+
     vfoCreatedHandler.handler = vfoAddedHandler;
     vfoCreatedHandler.ctx = this;
     sigpath::vfoManager.onVfoCreated.bindHandler(&vfoCreatedHandler);
@@ -523,6 +532,69 @@ void MainWindow::draw() {
             ImGui::Checkbox("WF Single Click", &gui::waterfall.VFOMoveSingleClick);
             ImGui::Checkbox("Lock Menu Order", &gui::menu.locked);
 
+            if (ImGui::Checkbox("DSP Profiling", &profiling)) {
+                setProfiling(profiling);
+                core::configManager.acquire();
+                core::configManager.conf["dspProfiling"] = profiling;
+                core::configManager.release(true);
+            }
+            if (profiling) {
+                ImGui::SameLine();
+                if (ImGui::Button("Reset##sdrpp_prof_reset")) {
+                    sigpath::profiler.reset();
+                }
+                if (ImGui::BeginTable("##sdrpp_prof_stats", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                    ImGui::TableSetupColumn("Block");
+                    ImGui::TableSetupColumn("MS/s");
+                    ImGui::TableSetupColumn("Busy %");
+                    ImGui::TableSetupColumn("Read %");
+                    ImGui::TableSetupColumn("Swap %");
+                    ImGui::TableSetupColumn("Queue %");
+                    ImGui::TableHeadersRow();
+                    for (auto& bp : sigpath::profiler.getProfiles()) {
+                        if (bp.elapsed <= 0.0) { continue; }
+                        double busy = std::max<double>(bp.runTime - bp.readWait - bp.swapWait, 0.0);
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::TextUnformatted(bp.name.c_str());
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::Text("%.2f", ((double)bp.samples / bp.elapsed) / 1e6);
+                        ImGui::TableSetColumnIndex(2);
+                        ImGui::Text("%.1f", 100.0 * busy / bp.elapsed);
+                        ImGui::TableSetColumnIndex(3);
+                        ImGui::Text("%.1f", 100.0 * bp.readWait / bp.elapsed);
+                        ImGui::TableSetColumnIndex(4);
+                        ImGui::Text("%.1f", 100.0 * bp.swapWait / bp.elapsed);
+                        ImGui::TableSetColumnIndex(5);
+                        ImGui::Text("%.1f", 100.0 * bp.inputOccupancy);
+                    }
+                    ImGui::EndTable();
+                }
+            }
+
+            if (sigpath::scheduler.isRunning()) {
+                ImGui::Text("DSP scheduler: %d threads", sigpath::scheduler.getThreadCount());
+                if (ImGui::BeginTable("##sdrpp_sched_stats", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                    ImGui::TableSetupColumn("Block");
+                    ImGui::TableSetupColumn("Runs");
+                    ImGui::TableSetupColumn("Avg (us)");
+                    ImGui::TableSetupColumn("Max (us)");
+                    ImGui::TableHeadersRow();
+                    for (auto& bs : sigpath::scheduler.getStats()) {
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::TextUnformatted(bs.name.c_str());
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::Text("%llu", (unsigned long long)bs.runs);
+                        ImGui::TableSetColumnIndex(2);
+                        ImGui::Text("%.1f", bs.runs ? (bs.totalTime * 1e6) / (double)bs.runs : 0.0);
+                        ImGui::TableSetColumnIndex(3);
+                        ImGui::Text("%.1f", bs.maxTime * 1e6);
+                    }
+                    ImGui::EndTable();
+                }
+            }
+
             ImGui::Spacing();
         }
 
@@ -671,6 +743,48 @@ void MainWindow::draw() {
     }
 }
 
+void MainWindow::setProfiling(bool enabled) {
+    profiling = enabled;
+    sigpath::iqFrontEnd.setProfiler(profiling ? &sigpath::profiler : NULL);
+}
+
+void MainWindow::profilerInterfaceHandler(int code, void* in, void* out, void* ctx) {
+    MainWindow* _this = (MainWindow*)ctx;
+    if (code == PROFILER_IFACE_CMD_GET_ENABLED) {
+        bool* _out = (bool*)out;
+        *_out = _this->profiling;
+    }
+    else if (code == PROFILER_IFACE_CMD_SET_ENABLED) {
+        bool* _in = (bool*)in;
+        _this->setProfiling(*_in);
+    }
+    else if (code == PROFILER_IFACE_CMD_RESET) {
+        sigpath::profiler.reset();
+    }
+    else if (code == PROFILER_IFACE_CMD_GET_JSON) {
+        std::string* _out = (std::string*)out;
+        json res;
+        res["enabled"] = _this->profiling;
+        res["blocks"] = json::array();
+        for (auto& bp : sigpath::profiler.getProfiles()) {
+            json blk;
+            blk["name"] = bp.name;
+            blk["elapsed"] = bp.elapsed;
+            blk["runs"] = bp.runs;
+            blk["samples"] = bp.samples;
+            blk["msps"] = (bp.elapsed > 0.0) ? ((double)bp.samples / bp.elapsed) / 1e6 : 0.0;
+            blk["run_time"] = bp.runTime;
+            blk["busy_time"] = std::max<double>(bp.runTime - bp.readWait - bp.swapWait, 0.0);
+            blk["read_wait"] = bp.readWait;
+            blk["swap_wait"] = bp.swapWait;
+            blk["input_occupancy"] = bp.inputOccupancy;
+            blk["output_occupancy"] = bp.outputOccupancy;
+            res["blocks"].push_back(blk);
+        }
+        *_out = res.dump();
+    }
+}
+
 void MainWindow::setPlayState(bool _playing) {
     if (_playing == playing) { return; }
     if (_playing) {
@@ -35,6 +35,8 @@ public:
 
 private:
     static void vfoAddedHandler(VFOManager::VFO* vfo, void* ctx);
+    static void profilerInterfaceHandler(int code, void* in, void* out, void* ctx);
+    void setProfiling(bool enabled);
 
     // FFT Variables
     int fftSize = 8192 * 8;
@@ -60,6 +62,7 @@ private:
     int tuningMode = tuner::TUNER_MODE_NORMAL;
     dsp::stream<dsp::complex_t> dummyStream;
     bool demoWindow = false;
+    bool profiling = false;
     int selectedWindow = 0;
 
     bool initComplete = false;
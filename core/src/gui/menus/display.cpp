@@ -18,6 +18,7 @@ namespace displaymenu {
     std::string colorMapNamesTxt = "";
     std::string colorMapAuthor = "";
     int selectedWindow = 0;
+    int selectedFFTMode = 0;
     int fftRate = 20;
     int uiScaleId = 0;
     bool restartRequired = false;
@@ -62,6 +63,11 @@ namespace displaymenu {
         IQFrontEnd::FFTWindow::NUTTALL
     };
 
+    const IQFrontEnd::FFTMode fftModeList[] = {
+        IQFrontEnd::FFTMode::DECIMATED,
+        IQFrontEnd::FFTMode::WELCH
+    };
+
     void updateFFTSpeeds() {
         gui::waterfall.setFFTHoldSpeed((float)fftHoldSpeed / ((float)fftRate * 10.0f));
         gui::waterfall.setFFTSmoothingSpeed(std::min<float>((float)fftSmoothingSpeed / (float)(fftRate * 10.0f), 1.0f));
@@ -106,6 +112,9 @@ namespace displaymenu {
         selectedWindow = std::clamp<int>((int)core::configManager.conf["fftWindow"], 0, (sizeof(fftWindowList) / sizeof(IQFrontEnd::FFTWindow)) - 1);
         sigpath::iqFrontEnd.setFFTWindow(fftWindowList[selectedWindow]);
 
+        selectedFFTMode = std::clamp<int>((int)core::configManager.conf["fftMode"], 0, (sizeof(fftModeList) / sizeof(IQFrontEnd::FFTMode)) - 1);
+        sigpath::iqFrontEnd.setFFTMode(fftModeList[selectedFFTMode]);
+
         gui::menu.locked = core::configManager.conf["lockMenuOrder"];
 
         fftHold = core::configManager.conf["fftHold"];
@@ -245,6 +254,15 @@ namespace displaymenu {
             core::configManager.release(true);
         }
 
+        ImGui::LeftLabel("FFT Averaging");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        if (ImGui::Combo("##sdrpp_fft_mode", &selectedFFTMode, "None\0Welch\0")) {
+            sigpath::iqFrontEnd.setFFTMode(fftModeList[selectedFFTMode]);
+            core::configManager.acquire();
+            core::configManager.conf["fftMode"] = selectedFFTMode;
+            core::configManager.release(true);
+        }
+
         if (colorMapNames.size() > 0) {
             ImGui::LeftLabel("Color Map");
             ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
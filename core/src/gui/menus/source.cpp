@@ -14,6 +14,7 @@ namespace sourcemenu {
     int decimationPower = 0;
     bool iqCorrection = false;
     bool invertIQ = false;
+    int channelizerId = 0;
 
     EventHandler<std::string> sourceRegisteredHandler;
     EventHandler<std::string> sourceUnregisterHandler;
@@ -52,6 +53,14 @@ namespace sourcemenu {
                                    "32\0"
                                    "64\0";
 
+    const int channelizerChannels[] = { 0, 16, 32, 64, 128, 256 };
+    const char* channelizerChannelsTxt = "Disabled\0"
+                                         "16 channels\0"
+                                         "32 channels\0"
+                                         "64 channels\0"
+                                         "128 channels\0"
+                                         "256 channels\0";
+
     void updateOffset() {
         if (offsetMode == OFFSET_MODE_CUSTOM) { effectiveOffset = customOffset; }
         else if (offsetMode == OFFSET_MODE_SPYVERTER) {
@@ -147,6 +156,12 @@ namespace sourcemenu {
         invertIQ = core::configManager.conf["invertIQ"];
         sigpath::iqFrontEnd.setDCBlocking(iqCorrection);
         sigpath::iqFrontEnd.setInvertIQ(invertIQ);
+        int channels = core::configManager.conf["channelizerChannels"];
+        channelizerId = 0;
+        for (int i = 0; i < std::size(channelizerChannels); i++) {
+            if (channelizerChannels[i] == channels) { channelizerId = i; }
+        }
+        sigpath::iqFrontEnd.setChannelizer(channelizerChannels[channelizerId]);
         updateOffset();
 
         refreshSources();
@@ -230,5 +245,14 @@ namespace sourcemenu {
             core::configManager.release(true);
         }
         if (running) { style::endDisabled(); }
+
+        ImGui::LeftLabel("Channelizer");
+        ImGui::SetNextItemWidth(itemWidth - ImGui::GetCursorPosX());
+        if (ImGui::Combo("##source_channelizer", &channelizerId, channelizerChannelsTxt)) {
+            sigpath::iqFrontEnd.setChannelizer(channelizerChannels[channelizerId]);
+            core::configManager.acquire();
+            core::configManager.conf["channelizerChannels"] = channelizerChannels[channelizerId];
+            core::configManager.release(true);
+        }
     }
 }
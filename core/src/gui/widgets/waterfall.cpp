@@ -62,31 +62,15 @@ inline void printAndScale(double freq, char* buf) {
     }
 }
 
-inline void doZoom(int offset, int width, int inSize, int outSize, float* in, float* out) {
-    // NOTE: REMOVE THAT SHIT, IT'S JUST A HACKY FIX
-    if (offset < 0) {
-        offset = 0;
-    }
-    if (width > 524288) {
-        width = 524288;
-    }
-
-    float factor = (float)width / (float)outSize;
-    float sFactor = ceilf(factor);
-    float uFactor;
-    float id = offset;
-    float maxVal;
-    int sId;
-    for (int i = 0; i < outSize; i++) {
-        maxVal = -INFINITY;
-        sId = (int)id;
-        uFactor = (sId + sFactor > inSize) ? sFactor - ((sId + sFactor) - inSize) : sFactor;
-        for (int j = 0; j < uFactor; j++) {
-            if (in[sId + j] > maxVal) { maxVal = in[sId + j]; }
-        }
-        out[i] = maxVal;
-        id += factor;
-    }
+// Rotate a ring of lines so that the given line becomes the first one
+inline void rotateLines(float* buf, int lineSize, int lineCount, int first) {
+    if (first == 0) { return; }
+    float* temp = new float[first * lineSize];
+    int moveCount = lineCount - first;
+    memcpy(temp, buf, first * lineSize * sizeof(float));
+    memmove(buf, &buf[first * lineSize], moveCount * lineSize * sizeof(float));
+    memcpy(&buf[moveCount * lineSize], temp, first * lineSize * sizeof(float));
+    delete[] temp;
 }
 
 namespace ImGui {
@@ -211,8 +195,15 @@ namespace ImGui {
             updateWaterfallTexture();
         }
         {
+            // The texture is a ring starting at the newest line. It's drawn as two quads split where the ring wraps,
+            // each clamped to its edge, so that the filtering doesn't blend the newest and oldest lines together.
             std::lock_guard<std::mutex> lck(texMtx);
-            window->DrawList->AddImage((void*)(intptr_t)textureId, wfMin, wfMax);
+            float top = texHeight ? ((float)texHead / (float)texHeight) : 0.0f;
+            float splitY = wfMin.y + (wfMax.y - wfMin.y) * (1.0f - top);
+            window->DrawList->AddImage((void*)(intptr_t)textureId, wfMin, ImVec2(wfMax.x, splitY), ImVec2(0.0f, top), ImVec2(1.0f, 1.0f));
+            if (texHead) {
+                window->DrawList->AddImage((void*)(intptr_t)textureId, ImVec2(wfMin.x, splitY), wfMax, ImVec2(0.0f, 0.0f), ImVec2(1.0f, top));
+            }
         }
         
         ImVec2 mPos = ImGui::GetMousePos();
@@ -568,28 +559,13 @@ namespace ImGui {
         int vfoMaxOffset = std::clamp<int>(((vfoMaxFreq / (wholeBandwidth / 2.0)) * (double)(rawFFTSize / 2)) + (rawFFTSize / 2), 0, rawFFTSize);
         int vfoMaxSideOffset = std::clamp<int>(((vfoMaxSizeFreq / (wholeBandwidth / 2.0)) * (double)(rawFFTSize / 2)) + (rawFFTSize / 2), 0, rawFFTSize);
 
-        double avg = 0;
-        float max = -INFINITY;
-        int avgCount = 0;
-
-        // Calculate Left average
-        for (int i = vfoMinSideOffset; i < vfoMinOffset; i++) {
-            avg += fftLine[i];
-            avgCount++;
-        }
-
-        // Calculate Right average
-        for (int i = vfoMaxOffset + 1; i < vfoMaxSideOffset; i++) {
-            avg += fftLine[i];
-            avgCount++;
-        }
-
-        avg /= (double)(avgCount);
-
-        // Calculate max
-        for (int i = vfoMinOffset; i <= vfoMaxOffset; i++) {
-            if (fftLine[i] > max) { max = fftLine[i]; }
-        }
+        // Average of the noise on both sides of the VFO and peak inside of it
+        int leftCount = std::max<int>(vfoMinOffset - vfoMinSideOffset, 0);
+        int rightCount = std::max<int>(vfoMaxSideOffset - (vfoMaxOffset + 1), 0);
+        double avg = (double)dsp::math::reduce(&fftLine[vfoMinSideOffset], leftCount, dsp::math::REDUCE_MEAN) * (double)leftCount;
+        avg += (double)dsp::math::reduce(&fftLine[vfoMaxOffset + 1], rightCount, dsp::math::REDUCE_MEAN) * (double)rightCount;
+        avg /= (double)(leftCount + rightCount);
+        float max = dsp::math::reduce(&fftLine[vfoMinOffset], std::min<int>(vfoMaxOffset, rawFFTSize - 1) - vfoMinOffset + 1, dsp::math::REDUCE_MAX);
 
         strength = max;
         snr = max - avg;
@@ -601,6 +577,7 @@ namespace ImGui {
         if (!waterfallVisible || rawFFTs == NULL) {
             return;
         }
+        std::lock_guard<std::recursive_mutex> lck(latestFFTMtx);
         double offsetRatio = viewOffset / (wholeBandwidth / 2.0);
         int drawDataSize;
         int drawDataStart;
@@ -613,7 +590,10 @@ namespace ImGui {
             for (int i = 0; i < count; i++) {
                 drawDataSize = (viewBandwidth / wholeBandwidth) * rawFFTSize;
                 drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
-                doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[((i + currentFFTLine) % waterfallHeight) * rawFFTSize], tempData);
+                int mipSize;
+                float* mip = getMipLine((i + currentFFTLine) % waterfallHeight, drawDataStart, drawDataSize, mipSize);
+                zoomReducer.plan(drawDataStart, drawDataSize, mipSize, dataWidth);
+                zoomReducer.process(mip, tempData);
                 for (int j = 0; j < dataWidth; j++) {
                     pixel = (std::clamp<float>(tempData[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
                     waterfallFb[(i * dataWidth) + j] = waterfallPallet[(int)(pixel * (WATERFALL_RESOLUTION - 1))];
@@ -627,6 +607,10 @@ namespace ImGui {
             }
         }
         delete[] tempData;
+
+        // The whole framebuffer was redrawn starting from the first row
+        fbHead = 0;
+        fbFullUpload = true;
         waterfallUpdate = true;
     }
 
@@ -702,12 +686,33 @@ namespace ImGui {
     }
 
     void WaterFall::updateWaterfallTexture() {
-        std::lock_guard<std::mutex> lck(texMtx);
+        std::lock_guard<std::recursive_mutex> lck(latestFFTMtx);
+        std::lock_guard<std::mutex> lck2(texMtx);
         glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dataWidth, waterfallHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+
+        if (fbFullUpload || texWidth != dataWidth || texHeight != waterfallHeight) {
+            // Re-create the whole texture
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dataWidth, waterfallHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+            texWidth = dataWidth;
+            texHeight = waterfallHeight;
+            fbFullUpload = false;
+        }
+        else if (fbPendingLines) {
+            // Only upload the new lines, they are contiguous unless they wrap around the end of the ring
+            int count = std::min<int>(fbPendingLines, texHeight);
+            int first = std::min<int>(count, texHeight - fbHead);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, fbHead, texWidth, first, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)&waterfallFb[fbHead * texWidth]);
+            if (count > first) {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texWidth, count - first, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+            }
+        }
+
+        fbPendingLines = 0;
+        texHead = fbHead;
     }
 
     void WaterFall::onPositionChange() {
@@ -739,20 +744,15 @@ namespace ImGui {
             // Raw FFT resize
             fftLines = std::min<int>(fftLines, waterfallHeight) - 1;
             if (rawFFTs != NULL) {
-                if (currentFFTLine != 0) {
-                    float* tempWF = new float[currentFFTLine * rawFFTSize];
-                    int moveCount = lastWaterfallHeight - currentFFTLine;
-                    memcpy(tempWF, rawFFTs, currentFFTLine * rawFFTSize * sizeof(float));
-                    memmove(rawFFTs, &rawFFTs[currentFFTLine * rawFFTSize], moveCount * rawFFTSize * sizeof(float));
-                    memcpy(&rawFFTs[moveCount * rawFFTSize], tempWF, currentFFTLine * rawFFTSize * sizeof(float));
-                    delete[] tempWF;
-                }
+                rotateLines(rawFFTs, rawFFTSize, lastWaterfallHeight, currentFFTLine);
+                if (fftMips != NULL) { rotateLines(fftMips, mipLineSize, lastWaterfallHeight, currentFFTLine); }
                 currentFFTLine = 0;
                 rawFFTs = (float*)realloc(rawFFTs, waterfallHeight * rawFFTSize * sizeof(float));
             }
             else {
                 rawFFTs = (float*)malloc(waterfallHeight * rawFFTSize * sizeof(float));
             }
+            fftMips = (float*)realloc(fftMips, std::max<int>(1, waterfallHeight * mipLineSize) * sizeof(float));
             // ==============
         }
 
@@ -781,6 +781,9 @@ namespace ImGui {
             delete[] waterfallFb;
             waterfallFb = new uint32_t[dataWidth * waterfallHeight];
             memset(waterfallFb, 0, dataWidth * waterfallHeight * sizeof(uint32_t));
+            fbHead = 0;
+            fbPendingLines = 0;
+            fbFullUpload = true;
         }
         for (int i = 0; i < dataWidth; i++) {
             latestFFT[i] = -1000.0f; // Hide everything
@@ -894,19 +897,28 @@ namespace ImGui {
         int drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
 
         if (waterfallVisible) {
-            doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[currentFFTLine * rawFFTSize], latestFFT);
-            memmove(&waterfallFb[dataWidth], waterfallFb, dataWidth * (waterfallHeight - 1) * sizeof(uint32_t));
+            buildMips(currentFFTLine);
+            int mipSize;
+            float* mip = getMipLine(currentFFTLine, drawDataStart, drawDataSize, mipSize);
+            zoomReducer.plan(drawDataStart, drawDataSize, mipSize, dataWidth);
+            zoomReducer.process(mip, latestFFT);
+
+            // Write the new line over the oldest one instead of scrolling the whole framebuffer
+            fbHead = (fbHead + waterfallHeight - 1) % waterfallHeight;
+            uint32_t* line = &waterfallFb[fbHead * dataWidth];
             float pixel;
             float dataRange = waterfallMax - waterfallMin;
             for (int j = 0; j < dataWidth; j++) {
                 pixel = (std::clamp<float>(latestFFT[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
                 int id = (int)(pixel * (WATERFALL_RESOLUTION - 1));
-                waterfallFb[j] = waterfallPallet[id];
+                line[j] = waterfallPallet[id];
             }
+            fbPendingLines = std::min<int>(fbPendingLines + 1, waterfallHeight);
             waterfallUpdate = true;
         }
         else {
-            doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, rawFFTs, latestFFT);
+            zoomReducer.plan(drawDataStart, drawDataSize, rawFFTSize, dataWidth);
+            zoomReducer.process(rawFFTs, latestFFT);
             fftLines = 1;
         }
 
@@ -1143,9 +1155,64 @@ namespace ImGui {
         }
         fftLines = 0;
         memset(rawFFTs, 0, rawFFTSize * waterfallHeight * sizeof(float));
+
+        // Re-create the pyramid for the new size
+        updateMipLayout();
+        fftMips = (float*)realloc(fftMips, std::max<int>(1, mipLineSize * wfSize) * sizeof(float));
+        memset(fftMips, 0, mipLineSize * waterfallHeight * sizeof(float));
+
         updateWaterfallFb();
     }
 
+    void WaterFall::updateMipLayout() {
+        mipOffsets.clear();
+        mipLineSize = 0;
+        mipFirstLevel = 1;
+        while ((rawFFTSize >> mipFirstLevel) > WATERFALL_MIP_MAX_SIZE) { mipFirstLevel++; }
+        for (int size = rawFFTSize >> mipFirstLevel; size >= WATERFALL_MIP_MIN_SIZE; size /= 2) {
+            mipOffsets.push_back(mipLineSize);
+            mipLineSize += size;
+        }
+    }
+
+    void WaterFall::buildMips(int line) {
+        if (mipOffsets.empty()) { return; }
+
+        // The first kept level takes the maximum of each group of bins of the raw FFT
+        float* in = &rawFFTs[line * rawFFTSize];
+        float* out = &fftMips[line * mipLineSize];
+        int group = 1 << mipFirstLevel;
+        int outSize = rawFFTSize >> mipFirstLevel;
+        for (int i = 0; i < outSize; i++) {
+            out[i] = dsp::math::reduce(&in[i * group], group, dsp::math::REDUCE_MAX);
+        }
+
+        // Each following level keeps the maximum of each pair of bins of the level above
+        for (int l = 1; l < (int)mipOffsets.size(); l++) {
+            in = out;
+            out = &fftMips[(line * mipLineSize) + mipOffsets[l]];
+            outSize /= 2;
+            for (int i = 0; i < outSize; i++) {
+                out[i] = std::max<float>(in[2 * i], in[(2 * i) + 1]);
+            }
+        }
+    }
+
+    float* WaterFall::getMipLine(int line, int& offset, int& width, int& size) {
+        // Use the smallest level that still has at least one bin per pixel, if it's kept
+        int levels = mipOffsets.empty() ? 0 : mipFirstLevel + (int)mipOffsets.size() - 1;
+        int level = 0;
+        while (level < levels && (width >> (level + 1)) >= dataWidth) { level++; }
+        if (level < mipFirstLevel) {
+            size = rawFFTSize;
+            return &rawFFTs[line * rawFFTSize];
+        }
+        offset /= (1 << level);
+        width >>= level;
+        size = rawFFTSize >> level;
+        return &fftMips[(line * mipLineSize) + mipOffsets[level - mipFirstLevel]];
+    }
+
     void WaterFall::setBandPlanPos(int pos) {
         bandPlanPos = pos;
     }
@@ -1389,6 +1456,7 @@ namespace ImGui {
         waterfallVisible = true;
         onResize();
         memset(rawFFTs, 0, waterfallHeight * rawFFTSize * sizeof(float));
+        memset(fftMips, 0, waterfallHeight * mipLineSize * sizeof(float));
         updateWaterfallFb();
         buf_mtx.unlock();
     }
@@ -5,11 +5,18 @@
 #include <imgui/imgui.h>
 #include <imgui/imgui_internal.h>
 #include <utils/event.h>
+#include <dsp/math/reduce.h>
 
 #include <utils/opengl_include_code.h>
 
 #define WATERFALL_RESOLUTION 1000000
 
+// Size under which no more levels of the FFT history pyramid are built
+#define WATERFALL_MIP_MIN_SIZE 256
+
+// Size of the largest level of the pyramid that's kept, so that it takes a bounded amount of memory per line
+#define WATERFALL_MIP_MAX_SIZE 4096
+
 namespace ImGui {
     class WaterfallVFO {
     public:
@@ -227,6 +234,9 @@ namespace ImGui {
         void onPositionChange();
         void onResize();
         void updateWaterfallFb();
+        void updateMipLayout();
+        void buildMips(int line);
+        float* getMipLine(int line, int& offset, int& width, int& size);
         void updateWaterfallTexture();
         void updateAllVFOs(bool checkRedrawRequired = false);
         bool calculateVFOSignalInfo(float* fftLine, WaterfallVFO* vfo, float& strength, float& snr);
@@ -290,7 +300,27 @@ namespace ImGui {
         int currentFFTLine = 0;
         int fftLines = 0;
 
+        // Pyramid of max-decimated copies of each raw FFT line, level k holding rawFFTSize >> k bins.
+        // Zoomed out views read from the smallest level that still has enough bins instead of the raw FFT.
+        // Only the levels of at most WATERFALL_MIP_MAX_SIZE bins are kept, the others are read from the raw FFT.
+        float* fftMips = NULL;
+        int mipLineSize = 0;
+        int mipFirstLevel = 1;
+        std::vector<int> mipOffsets; // Offset of levels mipFirstLevel and up in a line of fftMips
+
+        // Reduction of the visible bins to dataWidth pixels, only used under latestFFTMtx
+        dsp::math::BinReducer zoomReducer;
+
+        // The waterfall framebuffer is a ring of lines, the newest one being at row fbHead.
+        // Only the lines written since the last upload are sent to the texture, which is drawn
+        // with a UV offset so that the wraparound doesn't need any copy.
         uint32_t* waterfallFb;
+        int fbHead = 0;
+        int fbPendingLines = 0;
+        bool fbFullUpload = true;
+        int texHead = 0;
+        int texWidth = 0;
+        int texHeight = 0;
 
         bool draggingFW = false;
         int FFTAreaHeight;
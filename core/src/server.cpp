@@ -8,72 +8,40 @@
 #include <signal_path/signal_path.h>
 #include <gui/smgui.h>
 #include <utils/optionlist.h>
-#include "dsp/compression/sample_stream_compressor.h"
-#include "dsp/sink/handler_sink.h"
-#include <zstd.h>
+#include "server_session.h"
 
 namespace server {
-    dsp::stream<dsp::complex_t> dummyInput;
-    dsp::compression::SampleStreamCompressor comp;
-    dsp::sink::Handler<uint8_t> hnd;
-    net::Conn client;
-    uint8_t* rbuf = NULL;
-    uint8_t* sbuf = NULL;
-    uint8_t* bbuf = NULL;
-
-    PacketHeader* r_pkt_hdr = NULL;
-    uint8_t* r_pkt_data = NULL;
-    CommandHeader* r_cmd_hdr = NULL;
-    uint8_t* r_cmd_data = NULL;
-
-    PacketHeader* s_pkt_hdr = NULL;
-    uint8_t* s_pkt_data = NULL;
-    CommandHeader* s_cmd_hdr = NULL;
-    uint8_t* s_cmd_data = NULL;
-
-    PacketHeader* bb_pkt_hdr = NULL;
-    uint8_t* bb_pkt_data = NULL;
+    net::Listener listener;
 
-    SmGui::DrawListElem dummyElem;
+    std::vector<Session*> sessions;
+    std::mutex sessionsMtx;
+    int nextSessionId = 0;
+    int maxClients = 8;
 
-    ZSTD_CCtx* cctx;
+    // Held while the source is controlled or its menu is rendered, this is shared by all clients
+    std::recursive_mutex uiMtx;
+    SmGui::DrawListElem dummyElem;
 
-    net::Listener listener;
+    float* fftBuf = NULL;
+    int fftSize = SERVER_DEFAULT_FFT_SIZE;
+    double fftRate = SERVER_IDLE_FFT_RATE;
 
     OptionList<std::string, std::string> sourceList;
     int sourceId = 0;
-    bool running = false;
-    bool compression = false;
+    int sourceUsers = 0;
     double sampleRate = 1000000.0;
+    double frequency = 0.0;
+
+    dsp::stream<dsp::complex_t> dummyInput;
 
     int main() {
         flog::info("=====| SERVER MODE |=====");
 
-        // Init DSP
-        comp.init(&dummyInput, dsp::compression::PCM_TYPE_I8);
-        hnd.init(&comp.out, _testServerHandler, NULL);
-        rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        sbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        bbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        comp.start();
-        hnd.start();
-
-        // Initialize headers
-        r_pkt_hdr = (PacketHeader*)rbuf;
-        r_pkt_data = &rbuf[sizeof(PacketHeader)];
-        r_cmd_hdr = (CommandHeader*)r_pkt_data;
-        r_cmd_data = &rbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-
-        s_pkt_hdr = (PacketHeader*)sbuf;
-        s_pkt_data = &sbuf[sizeof(PacketHeader)];
-        s_cmd_hdr = (CommandHeader*)s_pkt_data;
-        s_cmd_data = &sbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-
-        bb_pkt_hdr = (PacketHeader*)bbuf;
-        bb_pkt_data = &bbuf[sizeof(PacketHeader)];
-
-        // Initialize compressor
-        cctx = ZSTD_createCCtx();
+        // Init DSP, the clients get the baseband, VFOs and FFT from the IQ frontend
+        fftBuf = new float[SERVER_MAX_FFT_SIZE];
+        sigpath::iqFrontEnd.init(&dummyInput, sampleRate, false, 1, false, fftSize, fftRate, IQFrontEnd::FFTWindow::NUTTALL, _acquireFFTBuffer, _releaseFFTBuffer, NULL);
+        if (sigpath::scheduler.isRunning()) { sigpath::iqFrontEnd.setScheduler(&sigpath::scheduler); }
+        sigpath::iqFrontEnd.start();
 
         // Load config
         core::configManager.acquire();
@@ -151,19 +119,43 @@ namespace server {
         // TODO: Use command line option
         std::string host = (std::string)core::args["addr"];
         int port = (int)core::args["port"];
+        maxClients = std::max<int>((int)core::args["clients"], 1);
         listener = net::listen(host, port);
         listener->acceptAsync(_clientHandler, NULL);
 
-        flog::info("Ready, listening on {0}:{1}", host, port);
-        while(1) { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+        flog::info("Ready, listening on {0}:{1} (up to {2} clients)", host, port, maxClients);
+        while(1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            // Free the sessions of the clients that left, outside of the lock since it waits for their threads
+            std::vector<Session*> closed;
+            {
+                std::lock_guard<std::mutex> lck(sessionsMtx);
+                for (auto it = sessions.begin(); it != sessions.end();) {
+                    if ((*it)->isOpen()) { it++; continue; }
+                    closed.push_back(*it);
+                    it = sessions.erase(it);
+                }
+            }
+            for (auto& session : closed) {
+                delete session;
+                flog::info("Client disconnected");
+            }
+            if (!closed.empty()) { updateFFTRate(); }
+        }
 
         return 0;
     }
 
     void _clientHandler(net::Conn conn, void* ctx) {
-        // Reject if someone else is already connected
-        if (client && client->isOpen()) {
-            flog::info("REJECTED Connection from {0}:{1}, another client is already connected.", "TODO", "TODO");
+        // Reject if the server is full
+        int count;
+        {
+            std::lock_guard<std::mutex> lck(sessionsMtx);
+            count = sessions.size();
+        }
+        if (count >= maxClients) {
+            flog::info("REJECTED Connection from {0}:{1}, the server already has {2} clients.", "TODO", "TODO", count);
             
             // Issue a disconnect command to the client
             uint8_t buf[sizeof(PacketHeader) + sizeof(CommandHeader)];
@@ -185,126 +177,83 @@ namespace server {
         }
 
         flog::info("Connection from {0}:{1}", "TODO", "TODO");
-        client = std::move(conn);
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
-
-        // Perform settings reset
-        sigpath::sourceManager.stop();
-        comp.setPCMType(dsp::compression::PCM_TYPE_I16);
-        compression = false;
-
-        sendSampleRate(sampleRate);
-
-        // TODO: Wait otherwise someone else could connect
+        Session* session = new Session(std::move(conn), nextSessionId++);
+        {
+            std::lock_guard<std::mutex> lck(sessionsMtx);
+            sessions.push_back(session);
+        }
 
         listener->acceptAsync(_clientHandler, NULL);
     }
 
-    void _packetHandler(int count, uint8_t* buf, void* ctx) {
-        PacketHeader* hdr = (PacketHeader*)buf;
-
-        // Read the rest of the data (TODO: CHECK SIZE OR SHIT WILL BE FUCKED + ADD TIMEOUT)
-        int len = 0;
-        int read = 0;
-        int goal = hdr->size - sizeof(PacketHeader);
-        while (len < goal) {
-            read = client->read(goal - len, &buf[sizeof(PacketHeader) + len]);
-            if (read < 0) { return; };
-            len += read;
-        }
+    float* _acquireFFTBuffer(void* ctx) {
+        return fftBuf;
+    }
 
-        // Parse and process
-        if (hdr->type == PACKET_TYPE_COMMAND && hdr->size >= sizeof(PacketHeader) + sizeof(CommandHeader)) {
-            CommandHeader* chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
-            commandHandler((Command)chdr->cmd, &buf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
-        }
-        else {
-            sendError(ERROR_INVALID_PACKET);
+    void _releaseFFTBuffer(void* ctx) {
+        // Called from the FFT thread, so the size can't change in the meantime. The sessions only copy the line.
+        int size = std::min<int>(sigpath::iqFrontEnd.getFFTSize(), SERVER_MAX_FFT_SIZE);
+        std::lock_guard<std::mutex> lck(sessionsMtx);
+        for (auto& session : sessions) {
+            session->pushFFT(fftBuf, size, fftRate);
         }
+    }
 
-        // Start another async read
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
+    double getSampleRate() {
+        return sampleRate;
     }
 
-    void _testServerHandler(uint8_t* data, int count, void* ctx) {
-        // Compress data if needed and fill out header fields
-        if (compression) {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_COMPRESSED;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + (uint32_t)ZSTD_compressCCtx(cctx, &bbuf[sizeof(PacketHeader)], SERVER_MAX_PACKET_SIZE-sizeof(PacketHeader), data, count, 1);
-        }
-        else {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + count;
-            memcpy(&bbuf[sizeof(PacketHeader)], data, count);
+    double getFrequency() {
+        return frequency;
+    }
+
+    void tune(double freq) {
+        std::lock_guard<std::recursive_mutex> uiLck(uiMtx);
+        double delta = freq - frequency;
+        sigpath::sourceManager.tune(freq);
+        frequency = freq;
+
+        // Keep the VFOs of all clients on their frequency and let the clients know about the new center.
+        // The sessions only queue the notification, so a slow client doesn't hold up the others.
+        std::lock_guard<std::mutex> lck(sessionsMtx);
+        for (auto& session : sessions) {
+            session->retuned(delta);
+            session->sendCenterFrequency(frequency);
         }
+    }
 
-        // Write to network
-        if (client && client->isOpen()) { client->write(bb_pkt_hdr->size, bbuf); }
+    void acquireSource() {
+        std::lock_guard<std::recursive_mutex> lck(uiMtx);
+        if (!sourceUsers++) { sigpath::sourceManager.start(); }
     }
 
-    void setInput(dsp::stream<dsp::complex_t>* stream) {
-        comp.setInput(stream);
+    void releaseSource() {
+        std::lock_guard<std::recursive_mutex> lck(uiMtx);
+        if (!--sourceUsers) { sigpath::sourceManager.stop(); }
     }
 
-    void commandHandler(Command cmd, uint8_t* data, int len) {
-        if (cmd == COMMAND_GET_UI) {
-            sendUI(COMMAND_GET_UI, "", dummyElem);
-        }
-        else if (cmd == COMMAND_UI_ACTION && len >= 3) {
-            // Check if sending back data is needed
-            int i = 0;
-            bool sendback = data[i++];
-            len--;
-            
-            // Load id
-            SmGui::DrawListElem diffId;
-            int count = SmGui::DrawList::loadItem(diffId, &data[i], len);
-            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
-            if (diffId.type != SmGui::DRAW_LIST_ELEM_TYPE_STRING) { sendError(ERROR_INVALID_ARGUMENT); return; } 
-            i += count;
-            len -= count;
-
-            // Load value
-            SmGui::DrawListElem diffValue;
-            count = SmGui::DrawList::loadItem(diffValue, &data[i], len);
-            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
-            i += count;
-            len -= count;
-
-            // Render and send back
-            if (sendback) {
-                sendUI(COMMAND_UI_ACTION, diffId.str, diffValue);
-            }
-            else {
-                renderUI(NULL, diffId.str, diffValue);
-            }
-        }
-        else if (cmd == COMMAND_START) {
-            sigpath::sourceManager.start();
-            running = true;
-        }
-        else if (cmd == COMMAND_STOP) {
-            sigpath::sourceManager.stop();
-            running = false;
-        }
-        else if (cmd == COMMAND_SET_FREQUENCY && len == 8) {
-            sigpath::sourceManager.tune(*(double*)data);
-            sendCommandAck(COMMAND_SET_FREQUENCY, 0);
-        }
-        else if (cmd == COMMAND_SET_SAMPLE_TYPE && len == 1) {
-            dsp::compression::PCMType type = (dsp::compression::PCMType)*(uint8_t*)data;
-            comp.setPCMType(type);
-        }
-        else if (cmd == COMMAND_SET_COMPRESSION && len == 1) {
-            compression = *(uint8_t*)data;
-        }
-        else {
-            flog::error("Invalid Command: {0} (len = {1})", (int)cmd, len);
-            sendError(ERROR_INVALID_COMMAND);
+    void setFFTSize(int size) {
+        std::lock_guard<std::mutex> lck(sessionsMtx);
+        if (size == fftSize) { return; }
+        fftSize = size;
+        sigpath::iqFrontEnd.setFFTSize(fftSize);
+    }
+
+    void updateFFTRate() {
+        // The FFT runs at the highest rate asked by a client, slowly if none wants it
+        std::lock_guard<std::mutex> lck(sessionsMtx);
+        double rate = 0.0;
+        for (auto& session : sessions) {
+            rate = std::max<double>(rate, session->getFFTRate());
         }
+        if (rate <= 0.0) { rate = SERVER_IDLE_FFT_RATE; }
+        if (rate == fftRate) { return; }
+        fftRate = rate;
+        sigpath::iqFrontEnd.setFFTRate(fftRate);
     }
 
     void drawMenu() {
+        bool running = (sourceUsers > 0);
         if (running) { SmGui::BeginDisabled(); }
         SmGui::FillWidth();
         SmGui::ForceSync();
@@ -320,8 +269,9 @@ namespace server {
     }
 
     void renderUI(SmGui::DrawList* dl, std::string diffId, SmGui::DrawListElem diffValue) {
-        // If we're recording and there's an action, render once with the action and record without
+        std::lock_guard<std::recursive_mutex> lck(uiMtx);
 
+        // If we're recording and there's an action, render once with the action and record without
         if (dl && !diffId.empty()) {
             SmGui::setDiff(diffId, diffValue);
             drawMenu();
@@ -339,49 +289,11 @@ namespace server {
         }
     }
 
-    void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
-        // Render UI
-        SmGui::DrawList dl;
-        renderUI(&dl, diffId, diffValue);
-
-        // Create response
-        int size = dl.getSize();
-        dl.store(s_cmd_data, size);
-
-        // Send to network
-        sendCommandAck(originCmd, size);
-    }
-
-    void sendError(Error err) {
-        PacketHeader* hdr = (PacketHeader*)sbuf;
-        s_pkt_data[0] = err;
-        sendPacket(PACKET_TYPE_ERROR, 1);
-    }
-
-    void sendSampleRate(double sampleRate) {
-        *(double*)s_cmd_data = sampleRate;
-        sendCommand(COMMAND_SET_SAMPLERATE, sizeof(double));
-    }
-
     void setInputSampleRate(double samplerate) {
         sampleRate = samplerate;
-        if (!client || !client->isOpen()) { return; }
-        sendSampleRate(sampleRate);
-    }
-
-    void sendPacket(PacketType type, int len) {
-        s_pkt_hdr->type = type;
-        s_pkt_hdr->size = sizeof(PacketHeader) + len;
-        client->write(s_pkt_hdr->size, sbuf);
-    }
-
-    void sendCommand(Command cmd, int len) {
-        s_cmd_hdr->cmd = cmd;
-        sendPacket(PACKET_TYPE_COMMAND, sizeof(CommandHeader) + len);
-    }
-
-    void sendCommandAck(Command cmd, int len) {
-        s_cmd_hdr->cmd = cmd;
-        sendPacket(PACKET_TYPE_COMMAND_ACK, sizeof(CommandHeader) + len);
+        std::lock_guard<std::mutex> lck(sessionsMtx);
+        for (auto& session : sessions) {
+            session->sendSampleRate(sampleRate);
+        }
     }
 }
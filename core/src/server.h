@@ -4,24 +4,30 @@
 #include <dsp/types.h>
 #include <server_protocol.h>
 
+// The FFT is computed once and shared by the clients, each one receiving lines at its own rate
+#define SERVER_DEFAULT_FFT_SIZE 8192
+#define SERVER_MAX_FFT_SIZE     (1 << 20)
+#define SERVER_MAX_FFT_RATE     200.0
+#define SERVER_IDLE_FFT_RATE    1.0
+
 namespace server {
-    void setInput(dsp::stream<dsp::complex_t>* stream);
     int main();
 
     void _clientHandler(net::Conn conn, void* ctx);
-    void _packetHandler(int count, uint8_t* buf, void* ctx);
-    void _testServerHandler(uint8_t* data, int count, void* ctx);
+    float* _acquireFFTBuffer(void* ctx);
+    void _releaseFFTBuffer(void* ctx);
 
     void drawMenu();
 
-    void commandHandler(Command cmd, uint8_t* data, int len);
     void renderUI(SmGui::DrawList* dl, std::string diffId, SmGui::DrawListElem diffValue);
-    void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue);
-    void sendError(Error err);
-    void sendSampleRate(double sampleRate);
     void setInputSampleRate(double samplerate);
 
-    void sendPacket(PacketType type, int len);
-    void sendCommand(Command cmd, int len);
-    void sendCommandAck(Command cmd, int len);
+    // State shared by all clients, used by the sessions
+    double getSampleRate();
+    double getFrequency();
+    void tune(double freq);
+    void acquireSource();
+    void releaseSource();
+    void setFFTSize(int size);
+    void updateFFTRate();
 }
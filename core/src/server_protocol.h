@@ -14,7 +14,8 @@ namespace server {
         PACKET_TYPE_BASEBAND_COMPRESSED,
         PACKET_TYPE_VFO,
         PACKET_TYPE_FFT,
-        PACKET_TYPE_ERROR
+        PACKET_TYPE_ERROR,
+        PACKET_TYPE_BASEBAND_STREAM
     };
 
     enum Command {
@@ -27,17 +28,32 @@ namespace server {
         COMMAND_GET_SAMPLERATE,
         COMMAND_SET_SAMPLE_TYPE,
         COMMAND_SET_COMPRESSION,
+        COMMAND_SET_BASEBAND,
+        COMMAND_ADD_VFO,
+        COMMAND_REMOVE_VFO,
+        COMMAND_SET_VFO_OFFSET,
+        COMMAND_SET_VFO_SAMPLERATE,
+        COMMAND_SET_FFT,
 
         // Server to client
         COMMAND_SET_SAMPLERATE = 0x80,
-        COMMAND_DISCONNECT
+        COMMAND_DISCONNECT,
+        COMMAND_SET_CENTER_FREQUENCY
     };
 
     enum Error {
         ERROR_NONE = 0x00,
         ERROR_INVALID_PACKET,
         ERROR_INVALID_COMMAND,
-        ERROR_INVALID_ARGUMENT
+        ERROR_INVALID_ARGUMENT,
+        ERROR_TOO_MANY_VFOS
+    };
+
+    // Argument of COMMAND_SET_COMPRESSION, older clients only know the first two
+    enum Compression {
+        COMPRESSION_NONE,
+        COMPRESSION_BLOCK,  // Every packet is a standalone zstd frame
+        COMPRESSION_STREAM  // The packets of a stream continue the same zstd stream, see StreamHeader
     };
     
 #pragma pack(push, 1)
@@ -49,5 +65,38 @@ namespace server {
     struct CommandHeader {
         uint32_t cmd;
     };
+
+    // Argument of COMMAND_ADD_VFO, COMMAND_SET_VFO_OFFSET and COMMAND_SET_VFO_SAMPLERATE,
+    // the VFO id is chosen by the client
+    struct VFOCommand {
+        uint32_t id;
+        double sampleRate;
+        double bandwidth;
+        double offset;
+    };
+
+    // Argument of COMMAND_SET_FFT, a rate of zero stops the FFT packets.
+    // The FFT size is shared by all clients, a PACKET_TYPE_FFT only holds the bins in dB as floats.
+    struct FFTCommand {
+        uint32_t size;
+        double rate;
+    };
+
+    // Start of the data of a PACKET_TYPE_VFO, followed by the samples in the same format as the baseband
+    struct VFOHeader {
+        uint32_t id;
+        uint8_t compressed; // Compression used for the packet
+    };
+
+    // Start of the data of a PACKET_TYPE_BASEBAND_STREAM or a COMPRESSION_STREAM VFO packet.
+    // The zstd data continues the stream of the previous packet of the same stream unless reset is set,
+    // the other fields let the client show how well compression is doing.
+    struct StreamHeader {
+        uint8_t reset;
+        int8_t level;          // zstd level the packet was compressed with
+        uint32_t rawSize;      // Size of the data once decompressed
+        uint32_t compressTime; // Time spent compressing the packet in microseconds
+        uint32_t dropped;      // Blocks dropped by the server because the link or the compression couldn't keep up
+    };
 #pragma pack(pop)
 }
\ No newline at end of file
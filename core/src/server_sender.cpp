@@ -0,0 +1,241 @@
+#include "server_sender.h"
+#include <utils/flog.h>
+#include <algorithm>
+
+namespace server {
+    // Largest packet of samples, the output of the compressor for a full stream buffer once run through zstd
+    static const size_t SAMPLE_PACKET_SIZE = sizeof(PacketHeader) + sizeof(VFOHeader) + sizeof(StreamHeader) + ZSTD_COMPRESSBOUND(STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) + 8);
+
+    SampleSender::~SampleSender() {
+        if (!_init) { return; }
+        stop();
+        ZSTD_freeCCtx(cctx);
+        delete[] buf;
+    }
+
+    void SampleSender::init(net::ConnClass* conn, dsp::stream<dsp::complex_t>* in, dsp::compression::PCMType pcmType, bool vfo, uint32_t id) {
+        this->conn = conn;
+        this->vfo = vfo;
+        this->id = id;
+        cctx = ZSTD_createCCtx();
+        buf = new uint8_t[SAMPLE_PACKET_SIZE];
+        comp.init(in, pcmType);
+        hnd.init(&comp.out, _handler, this);
+        _init = true;
+    }
+
+    void SampleSender::start() {
+        if (running) { return; }
+        stopWorker = false;
+        periodStart = std::chrono::steady_clock::now();
+        workerThread = std::thread(&SampleSender::worker, this);
+        comp.start();
+        hnd.start();
+        running = true;
+    }
+
+    void SampleSender::stop() {
+        if (!running) { return; }
+        comp.stop();
+        hnd.stop();
+        {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            stopWorker = true;
+        }
+        queueCnd.notify_all();
+        if (workerThread.joinable()) { workerThread.join(); }
+
+        // The stream starts over if the sender is restarted
+        queueStart = 0;
+        queueCount = 0;
+        resetStream = true;
+        running = false;
+    }
+
+    void SampleSender::setPCMType(dsp::compression::PCMType pcmType) {
+        comp.setPCMType(pcmType);
+    }
+
+    void SampleSender::setCompression(Compression compression) {
+        std::lock_guard<std::mutex> lck(queueMtx);
+        this->compression = compression;
+    }
+
+    void SampleSender::setEnabled(bool enabled) {
+        std::lock_guard<std::mutex> lck(queueMtx);
+        this->enabled = enabled;
+    }
+
+    void SampleSender::_handler(uint8_t* data, int count, void* ctx) {
+        SampleSender* _this = (SampleSender*)ctx;
+        {
+            std::lock_guard<std::mutex> lck(_this->queueMtx);
+            if (!_this->enabled) { return; }
+
+            // Never wait for the worker, the block is lost if it's too far behind
+            if (_this->queueCount >= SERVER_SEND_QUEUE_SIZE) {
+                _this->dropped++;
+                return;
+            }
+            std::vector<uint8_t>& block = _this->queue[(_this->queueStart + _this->queueCount) % SERVER_SEND_QUEUE_SIZE];
+            block.assign(data, data + count);
+            _this->queueCount++;
+        }
+        _this->queueCnd.notify_one();
+    }
+
+    void SampleSender::worker() {
+        std::vector<uint8_t> block;
+        Compression lastCompression = COMPRESSION_NONE;
+        while (true) {
+            // Take the oldest block, the buffers are swapped to avoid a copy
+            Compression compression;
+            {
+                std::unique_lock<std::mutex> lck(queueMtx);
+                queueCnd.wait(lck, [=]() { return queueCount > 0 || stopWorker; });
+                if (stopWorker) { return; }
+                std::swap(block, queue[queueStart]);
+                queueStart = (queueStart + 1) % SERVER_SEND_QUEUE_SIZE;
+                maxDepth = std::max<int>(maxDepth, queueCount--);
+                compression = this->compression;
+            }
+
+            // The client only expects a new zstd stream when switching to it
+            if (compression == COMPRESSION_STREAM && lastCompression != COMPRESSION_STREAM) { resetStream = true; }
+            lastCompression = compression;
+
+            send(block, compression);
+            adaptLevel(compression);
+        }
+    }
+
+    bool SampleSender::send(const std::vector<uint8_t>& data, Compression compression) {
+        // VFO packets start with the ID of the VFO
+        PacketHeader* hdr = (PacketHeader*)buf;
+        uint8_t* dst = &buf[sizeof(PacketHeader)];
+        if (vfo) {
+            VFOHeader* vhdr = (VFOHeader*)dst;
+            vhdr->id = id;
+            vhdr->compressed = compression;
+            dst += sizeof(VFOHeader);
+            hdr->type = PACKET_TYPE_VFO;
+        }
+        else if (compression == COMPRESSION_STREAM) {
+            hdr->type = PACKET_TYPE_BASEBAND_STREAM;
+        }
+        else {
+            hdr->type = (compression == COMPRESSION_BLOCK) ? PACKET_TYPE_BASEBAND_COMPRESSED : PACKET_TYPE_BASEBAND;
+        }
+
+        // Compress data if needed
+        size_t len = data.size();
+        auto compStart = std::chrono::steady_clock::now();
+        if (compression == COMPRESSION_STREAM) {
+            StreamHeader* shdr = (StreamHeader*)dst;
+            dst += sizeof(StreamHeader);
+            len = compressStream(data, dst, SAMPLE_PACKET_SIZE - (dst - buf), shdr);
+            if (!len) { return false; }
+        }
+        else if (compression == COMPRESSION_BLOCK) {
+            len = ZSTD_compressCCtx(cctx, dst, SAMPLE_PACKET_SIZE - (dst - buf), data.data(), data.size(), level);
+            if (ZSTD_isError(len)) { return false; }
+        }
+        else {
+            memcpy(dst, data.data(), len);
+        }
+        compressTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - compStart).count();
+        hdr->size = (dst - buf) + len;
+
+        // Write to network, this only takes long once the link is full
+        auto sendStart = std::chrono::steady_clock::now();
+        bool ok = conn->isOpen() && conn->write(hdr->size, buf);
+        sendTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - sendStart).count();
+        rawBytes += data.size();
+        compressedBytes += hdr->size;
+        return ok;
+    }
+
+    size_t SampleSender::compressStream(const std::vector<uint8_t>& data, uint8_t* dst, size_t dstSize, StreamHeader* shdr) {
+        auto start = std::chrono::steady_clock::now();
+        shdr->reset = resetStream;
+        if (resetStream) {
+            ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+            streamLevel = level;
+            resetStream = false;
+        }
+        shdr->level = streamLevel;
+
+        // Flushing keeps the window for the next packet while letting the client decode this one right away,
+        // the frame is only ended when the level has to change since it can't within a frame
+        bool endFrame = (level != streamLevel);
+        ZSTD_inBuffer in = { data.data(), data.size(), 0 };
+        ZSTD_outBuffer out = { dst, dstSize, 0 };
+        size_t ret;
+        do {
+            ret = ZSTD_compressStream2(cctx, &out, &in, endFrame ? ZSTD_e_end : ZSTD_e_flush);
+        } while (!ZSTD_isError(ret) && ret && out.pos < out.size);
+
+        // The client can't follow the stream after a failed packet, start a new one
+        if (ZSTD_isError(ret) || ret) {
+            flog::error("Could not compress samples: {0}", ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "output full");
+            resetStream = true;
+            return 0;
+        }
+        if (endFrame) {
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+            streamLevel = level;
+        }
+
+        shdr->rawSize = data.size();
+        shdr->compressTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        shdr->dropped = dropped;
+        return out.pos;
+    }
+
+    void SampleSender::adaptLevel(Compression compression) {
+        auto now = std::chrono::steady_clock::now();
+        double period = std::chrono::duration<double>(now - periodStart).count();
+        if (period < SERVER_ADAPT_INTERVAL) { return; }
+        uint32_t totalDropped = dropped;
+        uint32_t newDrops = totalDropped - periodDropStart;
+
+        // The write time over the period is the rate of the data over the measured throughput of the link
+        double compressLoad = compressTime / period;
+        double linkLoad = sendTime / period;
+        bool backlog = newDrops || maxDepth > SERVER_SEND_QUEUE_SIZE / 2;
+        int newLevel = level;
+        if (compression == COMPRESSION_NONE) {
+            // Nothing to adapt
+        }
+        else if (backlog) {
+            // Falling behind, compress harder if the link is the limit and faster otherwise
+            newLevel += (linkLoad > compressLoad) ? 1 : -1;
+        }
+        else if (compressLoad > 0.5) {
+            // Keeping up, but at too high a CPU cost
+            newLevel--;
+        }
+        else if (linkLoad > 0.5 && compressLoad < 0.25) {
+            // The link is getting full and there is CPU to spare
+            newLevel++;
+        }
+        newLevel = std::clamp<int>(newLevel, SERVER_MIN_ZSTD_LEVEL, SERVER_MAX_ZSTD_LEVEL);
+
+        if (newLevel != level) {
+            double ratio = compressedBytes ? (double)rawBytes / (double)compressedBytes : 0.0;
+            flog::debug("{0} {1}: zstd level {2} -> {3} (ratio {4}, compression load {5}, link load {6}, {7} dropped)",
+                        vfo ? "VFO" : "Baseband", id, level, newLevel, ratio, compressLoad, linkLoad, newDrops);
+            level = newLevel;
+        }
+
+        // Start a new period
+        periodStart = now;
+        compressTime = 0.0;
+        sendTime = 0.0;
+        rawBytes = 0;
+        compressedBytes = 0;
+        maxDepth = 0;
+        periodDropStart = totalDropped;
+    }
+}
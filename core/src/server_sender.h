@@ -0,0 +1,84 @@
+#pragma once
+#include <utils/networking.h>
+#include <dsp/stream.h>
+#include <dsp/types.h>
+#include <dsp/compression/sample_stream_compressor.h>
+#include <dsp/sink/handler_sink.h>
+#include <server_protocol.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <zstd.h>
+
+// Blocks waiting to be compressed and sent, more are dropped so that the DSP never waits on the network
+#define SERVER_SEND_QUEUE_SIZE      8
+
+// Range of the zstd level, adapted to the link and the CPU load while sending
+#define SERVER_MIN_ZSTD_LEVEL       -5
+#define SERVER_MAX_ZSTD_LEVEL       9
+#define SERVER_DEFAULT_ZSTD_LEVEL   1
+#define SERVER_ADAPT_INTERVAL       1.0
+
+namespace server {
+    // Compresses a sample stream and sends it to a client from its own thread, either the baseband or a VFO
+    class SampleSender {
+    public:
+        ~SampleSender();
+
+        void init(net::ConnClass* conn, dsp::stream<dsp::complex_t>* in, dsp::compression::PCMType pcmType, bool vfo = false, uint32_t id = 0);
+        void start();
+        void stop();
+
+        void setPCMType(dsp::compression::PCMType pcmType);
+        void setCompression(Compression compression);
+
+        // Samples are discarded while disabled
+        void setEnabled(bool enabled);
+
+    private:
+        static void _handler(uint8_t* data, int count, void* ctx);
+        void worker();
+        bool send(const std::vector<uint8_t>& data, Compression compression);
+        size_t compressStream(const std::vector<uint8_t>& data, uint8_t* dst, size_t dstSize, StreamHeader* shdr);
+        void adaptLevel(Compression compression);
+
+        net::ConnClass* conn = NULL;
+        bool vfo = false;
+        uint32_t id = 0;
+        dsp::compression::SampleStreamCompressor comp;
+        dsp::sink::Handler<uint8_t> hnd;
+        bool _init = false;
+        bool running = false;
+
+        // Ring of blocks between the DSP and the worker
+        std::vector<uint8_t> queue[SERVER_SEND_QUEUE_SIZE];
+        int queueStart = 0;
+        int queueCount = 0;
+        bool enabled = true;
+        bool stopWorker = false;
+        Compression compression = COMPRESSION_NONE;
+        std::mutex queueMtx;
+        std::condition_variable queueCnd;
+        std::thread workerThread;
+        std::atomic<uint32_t> dropped = 0;
+
+        // Only used by the worker
+        ZSTD_CCtx* cctx = NULL;
+        uint8_t* buf = NULL;
+        bool resetStream = true;
+        int level = SERVER_DEFAULT_ZSTD_LEVEL;
+        int streamLevel = SERVER_DEFAULT_ZSTD_LEVEL; // Level of the zstd frame being sent, it can only change between frames
+
+        // Measured since the last adaptation of the level
+        std::chrono::steady_clock::time_point periodStart;
+        double compressTime = 0.0;
+        double sendTime = 0.0;
+        size_t rawBytes = 0;
+        size_t compressedBytes = 0;
+        int maxDepth = 0;
+        uint32_t periodDropStart = 0;
+    };
+}
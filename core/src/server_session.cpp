@@ -0,0 +1,395 @@
+#include "server_session.h"
+#include "server.h"
+#include <signal_path/signal_path.h>
+#include <utils/flog.h>
+#include <math.h>
+
+namespace server {
+    Session::Session(net::Conn conn, int id) {
+        this->conn = std::move(conn);
+        _id = id;
+
+        rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+        sbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+        fbuf = new uint8_t[sizeof(PacketHeader) + SERVER_MAX_FFT_SIZE * sizeof(float)];
+
+        // Initialize headers
+        s_pkt_hdr = (PacketHeader*)sbuf;
+        s_pkt_data = &sbuf[sizeof(PacketHeader)];
+        s_cmd_hdr = (CommandHeader*)s_pkt_data;
+        s_cmd_data = &sbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
+
+        // The baseband sender is always there, its stream only gets bound to the IQ frontend when needed
+        baseband.init(this->conn.get(), &basebandStream, pcmType);
+        baseband.start();
+
+        notifyThread = std::thread(&Session::notifyWorker, this);
+        sendSampleRate(server::getSampleRate());
+        sendCenterFrequency(server::getFrequency());
+
+        this->conn->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, this);
+    }
+
+    Session::~Session() {
+        // Closing first waits for the command being processed and unblocks the senders
+        conn->close();
+        {
+            std::lock_guard<std::mutex> lck(notifyMtx);
+            stopNotify = true;
+        }
+        notifyCnd.notify_all();
+        if (notifyThread.joinable()) { notifyThread.join(); }
+
+        // Stop the streams
+        bool wasRunning = running;
+        running = false;
+        updateBaseband();
+        baseband.stop();
+        std::vector<uint32_t> ids;
+        for (auto& [id, vfo] : vfos) { ids.push_back(id); }
+        for (auto& id : ids) { removeVFO(id); }
+
+        if (wasRunning) { server::releaseSource(); }
+
+        delete[] rbuf;
+        delete[] sbuf;
+        delete[] fbuf;
+    }
+
+    bool Session::isOpen() {
+        return conn && conn->isOpen() && !dropped;
+    }
+
+    void Session::sendSampleRate(double sampleRate) {
+        {
+            std::lock_guard<std::mutex> lck(notifyMtx);
+            pendingSampleRate = sampleRate;
+            sampleRatePending = true;
+        }
+        notifyCnd.notify_one();
+    }
+
+    void Session::sendCenterFrequency(double frequency) {
+        {
+            std::lock_guard<std::mutex> lck(notifyMtx);
+            pendingFrequency = frequency;
+            frequencyPending = true;
+        }
+        notifyCnd.notify_one();
+    }
+
+    void Session::retuned(double delta) {
+        std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+        for (auto& [id, vfo] : vfos) {
+            vfo->offset -= delta;
+            sigpath::iqFrontEnd.setVFOOffset(vfo->name, vfo->offset);
+        }
+    }
+
+    double Session::getFFTRate() {
+        return fftRate;
+    }
+
+    void Session::pushFFT(const float* data, int size, double serverRate) {
+        // Only send the share of the lines that matches the rate of this client
+        double rate = fftRate;
+        if (rate <= 0.0 || serverRate <= 0.0) { return; }
+        fftPhase += rate / serverRate;
+        if (fftPhase < 1.0) { return; }
+        fftPhase = std::min<double>(fftPhase - 1.0, 1.0);
+
+        // Never wait for the notification thread, the line is lost if the client is too far behind
+        {
+            std::lock_guard<std::mutex> lck(notifyMtx);
+            if (fftQueueCount >= SERVER_FFT_QUEUE_SIZE) {
+                return;
+            }
+            std::vector<float>& line = fftQueue[(fftQueueStart + fftQueueCount) % SERVER_FFT_QUEUE_SIZE];
+            line.assign(data, data + size);
+            fftQueueCount++;
+        }
+        notifyCnd.notify_one();
+    }
+
+    void Session::notifyWorker() {
+        std::vector<float> line;
+        while (true) {
+            // Take whatever is pending, the buffers of the FFT lines are swapped to avoid a copy
+            bool sendSR, sendFreq;
+            double sr, freq;
+            line.clear();
+            {
+                std::unique_lock<std::mutex> lck(notifyMtx);
+                notifyCnd.wait(lck, [this]() { return sampleRatePending || frequencyPending || fftQueueCount || stopNotify; });
+                if (stopNotify) { return; }
+                sendSR = sampleRatePending;
+                sendFreq = frequencyPending;
+                sr = pendingSampleRate;
+                freq = pendingFrequency;
+                sampleRatePending = false;
+                frequencyPending = false;
+                if (fftQueueCount) {
+                    std::swap(line, fftQueue[fftQueueStart]);
+                    fftQueueStart = (fftQueueStart + 1) % SERVER_FFT_QUEUE_SIZE;
+                    fftQueueCount--;
+                }
+            }
+
+            if (sendSR) {
+                std::lock_guard<std::mutex> lck(sendMtx);
+                *(double*)s_cmd_data = sr;
+                sendCommand(COMMAND_SET_SAMPLERATE, sizeof(double));
+            }
+            if (sendFreq) {
+                std::lock_guard<std::mutex> lck(sendMtx);
+                *(double*)s_cmd_data = freq;
+                sendCommand(COMMAND_SET_CENTER_FREQUENCY, sizeof(double));
+            }
+            if (!line.empty()) {
+                PacketHeader* hdr = (PacketHeader*)fbuf;
+                hdr->type = PACKET_TYPE_FFT;
+                hdr->size = sizeof(PacketHeader) + line.size() * sizeof(float);
+                memcpy(&fbuf[sizeof(PacketHeader)], line.data(), line.size() * sizeof(float));
+                if (conn->isOpen()) { conn->write(hdr->size, fbuf); }
+            }
+        }
+    }
+
+    void Session::_packetHandler(int count, uint8_t* buf, void* ctx) {
+        Session* _this = (Session*)ctx;
+        PacketHeader* hdr = (PacketHeader*)buf;
+
+        // Drop the client if the size doesn't make sense, there's no way to find the next packet
+        if (hdr->size < sizeof(PacketHeader) || hdr->size > SERVER_MAX_PACKET_SIZE) {
+            flog::error("Client {0} sent a packet of invalid size ({1} bytes), disconnecting", _this->_id, hdr->size);
+            _this->dropped = true;
+            return;
+        }
+
+        // Read the rest of the data
+        int len = 0;
+        int read = 0;
+        int goal = hdr->size - sizeof(PacketHeader);
+        while (len < goal) {
+            read = _this->conn->read(goal - len, &buf[sizeof(PacketHeader) + len]);
+            if (read < 0) { return; };
+            len += read;
+        }
+
+        // Parse and process
+        if (hdr->type == PACKET_TYPE_COMMAND && hdr->size >= sizeof(PacketHeader) + sizeof(CommandHeader)) {
+            CommandHeader* chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
+            _this->commandHandler((Command)chdr->cmd, &buf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
+        }
+        else {
+            _this->sendError(ERROR_INVALID_PACKET);
+        }
+
+        // Start another async read
+        _this->conn->readAsync(sizeof(PacketHeader), _this->rbuf, _packetHandler, _this);
+    }
+
+    void Session::commandHandler(Command cmd, uint8_t* data, int len) {
+        if (cmd == COMMAND_GET_UI) {
+            sendUI(COMMAND_GET_UI, "", SmGui::DrawListElem());
+        }
+        else if (cmd == COMMAND_UI_ACTION && len >= 3) {
+            // Check if sending back data is needed
+            int i = 0;
+            bool sendback = data[i++];
+            len--;
+
+            // Load id
+            SmGui::DrawListElem diffId;
+            int count = SmGui::DrawList::loadItem(diffId, &data[i], len);
+            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
+            if (diffId.type != SmGui::DRAW_LIST_ELEM_TYPE_STRING) { sendError(ERROR_INVALID_ARGUMENT); return; }
+            i += count;
+            len -= count;
+
+            // Load value
+            SmGui::DrawListElem diffValue;
+            count = SmGui::DrawList::loadItem(diffValue, &data[i], len);
+            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
+            i += count;
+            len -= count;
+
+            // Render and send back
+            if (sendback) {
+                sendUI(COMMAND_UI_ACTION, diffId.str, diffValue);
+            }
+            else {
+                server::renderUI(NULL, diffId.str, diffValue);
+            }
+        }
+        else if (cmd == COMMAND_START) {
+            if (running) { return; }
+            server::acquireSource();
+            running = true;
+            updateBaseband();
+
+            // The VFOs keep running until removed, but their samples are only wanted while the client is started
+            std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+            for (auto& [id, vfo] : vfos) { vfo->sender.setEnabled(true); }
+        }
+        else if (cmd == COMMAND_STOP) {
+            if (!running) { return; }
+            running = false;
+            updateBaseband();
+            {
+                std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+                for (auto& [id, vfo] : vfos) { vfo->sender.setEnabled(false); }
+            }
+            server::releaseSource();
+        }
+        else if (cmd == COMMAND_SET_FREQUENCY && len == 8) {
+            server::tune(*(double*)data);
+            std::lock_guard<std::mutex> lck(sendMtx);
+            sendCommandAck(COMMAND_SET_FREQUENCY, 0);
+        }
+        else if (cmd == COMMAND_SET_SAMPLE_TYPE && len == 1 && data[0] <= dsp::compression::PCM_TYPE_RICE12) {
+            std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+            pcmType = (dsp::compression::PCMType)data[0];
+            baseband.setPCMType(pcmType);
+            for (auto& [id, vfo] : vfos) { vfo->sender.setPCMType(pcmType); }
+        }
+        else if (cmd == COMMAND_SET_COMPRESSION && len == 1 && data[0] <= COMPRESSION_STREAM) {
+            std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+            compression = (Compression)data[0];
+            baseband.setCompression(compression);
+            for (auto& [id, vfo] : vfos) { vfo->sender.setCompression(compression); }
+        }
+        else if (cmd == COMMAND_SET_BASEBAND && len == 1) {
+            basebandEnabled = data[0];
+            updateBaseband();
+        }
+        else if (cmd == COMMAND_ADD_VFO && len == sizeof(VFOCommand)) {
+            Error err = addVFO(*(VFOCommand*)data);
+            std::lock_guard<std::mutex> lck(sendMtx);
+            s_cmd_data[0] = err;
+            sendCommandAck(COMMAND_ADD_VFO, 1);
+        }
+        else if (cmd == COMMAND_REMOVE_VFO && len == sizeof(uint32_t)) {
+            removeVFO(*(uint32_t*)data);
+        }
+        else if (cmd == COMMAND_SET_VFO_OFFSET && len == sizeof(VFOCommand)) {
+            VFOCommand* vcmd = (VFOCommand*)data;
+            std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+            if (vfos.find(vcmd->id) == vfos.end() || !std::isfinite(vcmd->offset)) { sendError(ERROR_INVALID_ARGUMENT); return; }
+            VFO* vfo = vfos[vcmd->id];
+            vfo->offset = vcmd->offset;
+            sigpath::iqFrontEnd.setVFOOffset(vfo->name, vfo->offset);
+        }
+        else if (cmd == COMMAND_SET_VFO_SAMPLERATE && len == sizeof(VFOCommand)) {
+            VFOCommand* vcmd = (VFOCommand*)data;
+            std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+            bool valid = vcmd->sampleRate > 0.0 && vcmd->sampleRate <= server::getSampleRate() && vcmd->bandwidth > 0.0 && vcmd->bandwidth <= vcmd->sampleRate;
+            if (vfos.find(vcmd->id) == vfos.end() || !valid) { sendError(ERROR_INVALID_ARGUMENT); return; }
+            sigpath::iqFrontEnd.setVFOSamplerate(vfos[vcmd->id]->name, vcmd->sampleRate, vcmd->bandwidth);
+        }
+        else if (cmd == COMMAND_SET_FFT && len == sizeof(FFTCommand)) {
+            FFTCommand* fcmd = (FFTCommand*)data;
+            if (fcmd->size < 2 || fcmd->size > SERVER_MAX_FFT_SIZE || !(fcmd->rate >= 0.0 && fcmd->rate <= SERVER_MAX_FFT_RATE)) {
+                sendError(ERROR_INVALID_ARGUMENT);
+                return;
+            }
+            fftRate = fcmd->rate;
+            if (fcmd->rate > 0.0) { server::setFFTSize(fcmd->size); }
+            server::updateFFTRate();
+        }
+        else {
+            flog::error("Invalid Command: {0} (len = {1})", (int)cmd, len);
+            sendError(ERROR_INVALID_COMMAND);
+        }
+    }
+
+    void Session::updateBaseband() {
+        // Only take samples from the splitter while the client is started
+        bool enabled = running && basebandEnabled;
+        if (enabled == basebandBound) { return; }
+        if (enabled) {
+            sigpath::iqFrontEnd.bindIQStream(&basebandStream);
+        }
+        else {
+            sigpath::iqFrontEnd.unbindIQStream(&basebandStream);
+        }
+        basebandBound = enabled;
+    }
+
+    Error Session::addVFO(const VFOCommand& cmd) {
+        std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+        if (vfos.find(cmd.id) != vfos.end()) { return ERROR_INVALID_ARGUMENT; }
+        if (vfos.size() >= SERVER_MAX_CLIENT_VFOS) { return ERROR_TOO_MANY_VFOS; }
+        bool valid = cmd.sampleRate > 0.0 && cmd.sampleRate <= server::getSampleRate() && cmd.bandwidth > 0.0 && cmd.bandwidth <= cmd.sampleRate && std::isfinite(cmd.offset);
+        if (!valid) { return ERROR_INVALID_ARGUMENT; }
+
+        // Create the DDC in the IQ frontend and send its output
+        VFO* vfo = new VFO;
+        vfo->id = cmd.id;
+        vfo->name = "Client " + std::to_string(_id) + " VFO " + std::to_string(cmd.id);
+        vfo->offset = cmd.offset;
+        dsp::channel::RxVFO* rxvfo = sigpath::iqFrontEnd.addVFO(vfo->name, cmd.sampleRate, cmd.bandwidth, cmd.offset);
+        if (!rxvfo) {
+            delete vfo;
+            return ERROR_INVALID_ARGUMENT;
+        }
+        vfo->sender.init(conn.get(), &rxvfo->out, pcmType, true, cmd.id);
+        vfo->sender.setCompression(compression);
+        vfo->sender.setEnabled(running);
+        vfo->sender.start();
+        vfos[cmd.id] = vfo;
+
+        flog::info("Client {0} added a {1} Hz VFO at offset {2} Hz", _id, cmd.sampleRate, cmd.offset);
+        return ERROR_NONE;
+    }
+
+    void Session::removeVFO(uint32_t id) {
+        std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+        if (vfos.find(id) == vfos.end()) { return; }
+        VFO* vfo = vfos[id];
+        vfos.erase(id);
+
+        // The sender reads from the VFO, so it has to be stopped before the VFO is deleted
+        vfo->sender.stop();
+        sigpath::iqFrontEnd.removeVFO(vfo->name);
+        delete vfo;
+    }
+
+    void Session::sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
+        // Render UI
+        SmGui::DrawList dl;
+        server::renderUI(&dl, diffId, diffValue);
+
+        // Create response
+        std::lock_guard<std::mutex> lck(sendMtx);
+        int size = dl.getSize();
+        dl.store(s_cmd_data, size);
+
+        // Send to network
+        sendCommandAck(originCmd, size);
+    }
+
+    void Session::sendError(Error err) {
+        std::lock_guard<std::mutex> lck(sendMtx);
+        s_pkt_data[0] = err;
+        sendPacket(PACKET_TYPE_ERROR, 1);
+    }
+
+    // The functions below must be called with sendMtx locked
+
+    void Session::sendPacket(PacketType type, int len) {
+        s_pkt_hdr->type = type;
+        s_pkt_hdr->size = sizeof(PacketHeader) + len;
+        conn->write(s_pkt_hdr->size, sbuf);
+    }
+
+    void Session::sendCommand(Command cmd, int len) {
+        s_cmd_hdr->cmd = cmd;
+        sendPacket(PACKET_TYPE_COMMAND, sizeof(CommandHeader) + len);
+    }
+
+    void Session::sendCommandAck(Command cmd, int len) {
+        s_cmd_hdr->cmd = cmd;
+        sendPacket(PACKET_TYPE_COMMAND_ACK, sizeof(CommandHeader) + len);
+    }
+}
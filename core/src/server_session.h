@@ -0,0 +1,108 @@
+#pragma once
+#include <utils/networking.h>
+#include <dsp/stream.h>
+#include <dsp/types.h>
+#include <dsp/channel/rx_vfo.h>
+#include <server_protocol.h>
+#include <server_sender.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#define SERVER_MAX_CLIENT_VFOS  16
+
+// FFT lines waiting to be sent, more are dropped so that the FFT thread never waits on the network
+#define SERVER_FFT_QUEUE_SIZE   4
+
+namespace server {
+    // One connected client along with the streams it asked for
+    class Session {
+    public:
+        Session(net::Conn conn, int id);
+        ~Session();
+
+        bool isOpen();
+
+        // Only queued, the notification thread sends the latest value
+        void sendSampleRate(double sampleRate);
+        void sendCenterFrequency(double frequency);
+
+        // Move the VFOs by the opposite of a retune so that they stay on the same frequency
+        void retuned(double delta);
+
+        // Rate of FFT lines the client asked for, 0 if none
+        double getFFTRate();
+
+        // Called with every line of the server FFT, queues it if due for the rate asked by the client
+        void pushFFT(const float* data, int size, double serverRate);
+
+    private:
+        // DDC of the IQ frontend asked for by the client
+        struct VFO {
+            uint32_t id;
+            std::string name;
+            double offset;
+            SampleSender sender;
+        };
+
+        static void _packetHandler(int count, uint8_t* buf, void* ctx);
+        void commandHandler(Command cmd, uint8_t* data, int len);
+        void notifyWorker();
+
+        void updateBaseband();
+        Error addVFO(const VFOCommand& cmd);
+        void removeVFO(uint32_t id);
+
+        void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue);
+        void sendError(Error err);
+        void sendPacket(PacketType type, int len);
+        void sendCommand(Command cmd, int len);
+        void sendCommandAck(Command cmd, int len);
+
+        net::Conn conn;
+        int _id;
+        std::atomic<bool> dropped = false; // The connection can't be closed from its own read thread
+
+        uint8_t* rbuf = NULL;
+        uint8_t* sbuf = NULL;
+        uint8_t* fbuf = NULL;
+        std::mutex sendMtx; // Held while the command buffer is in use
+
+        PacketHeader* s_pkt_hdr = NULL;
+        uint8_t* s_pkt_data = NULL;
+        CommandHeader* s_cmd_hdr = NULL;
+        uint8_t* s_cmd_data = NULL;
+
+        // Streams
+        dsp::stream<dsp::complex_t> basebandStream;
+        SampleSender baseband;
+        bool basebandEnabled = true; // The full baseband is sent by default for compatibility with older clients
+        bool basebandBound = false;
+        std::map<uint32_t, VFO*> vfos;
+        std::recursive_mutex vfoMtx;
+        dsp::compression::PCMType pcmType = dsp::compression::PCM_TYPE_I16;
+        Compression compression = COMPRESSION_NONE;
+
+        // FFT
+        std::atomic<double> fftRate = 0.0;
+        double fftPhase = 0.0;
+
+        // Sent by the notification thread, so that neither the DSP nor the other clients wait on this one
+        std::thread notifyThread;
+        std::mutex notifyMtx;
+        std::condition_variable notifyCnd;
+        bool stopNotify = false;
+        bool sampleRatePending = false;
+        double pendingSampleRate = 0.0;
+        bool frequencyPending = false;
+        double pendingFrequency = 0.0;
+        std::vector<float> fftQueue[SERVER_FFT_QUEUE_SIZE];
+        int fftQueueStart = 0;
+        int fftQueueCount = 0;
+
+        std::atomic<bool> running = false;
+    };
+}
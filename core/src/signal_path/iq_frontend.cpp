@@ -8,10 +8,15 @@
 IQFrontEnd::~IQFrontEnd() {
     if (!_init) { return; }
     stop();
-    dsp::buffer::free(fftWindowBuf);
-    fftwf_destroy_plan(fftwPlan);
-    fftwf_free(fftInBuf);
-    fftwf_free(fftOutBuf);
+
+    // Wait for the planner to be done before freeing the plan
+    {
+        std::lock_guard<std::mutex> lck(plannerMtx);
+        plannerStop = true;
+    }
+    plannerCV.notify_all();
+    if (plannerThread.joinable()) { plannerThread.join(); }
+    destroyFFTPlan(fftPlan);
 }
 
 void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool buffering, int decimRatio, bool dcBlocking, int fftSize, double fftRate, FFTWindow fftWindow, float* (*acquireFFTBuffer)(void* ctx), void (*releaseFFTBuffer)(void* ctx), void* fftCtx) {
@@ -37,32 +42,22 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
     preproc.addBlock(&decim, _decimRatio > 1);
     preproc.addBlock(&dcBlock, dcBlocking);
     preproc.addBlock(&conjugate, false); // TODO: Replace by parameter
+    preproc.setFused(true);
 
     split.init(preproc.out);
+    split.setSharing(true);
 
-    // TODO: Do something to avoid basically repeating this code twice
-    int skip;
-    genReshapeParams(effectiveSr, _fftSize, _fftRate, skip, _nzFFTSize);
-    reshape.init(&fftIn, fftSize, skip);
-    fftSink.init(&reshape.out, handler, this);
-
-    fftWindowBuf = dsp::buffer::alloc<float>(_nzFFTSize);
-    if (_fftWindow == FFTWindow::RECTANGULAR) {
-        for (int i = 0; i < _nzFFTSize; i++) { fftWindowBuf[i] = 0; }
-    }
-    else if (_fftWindow == FFTWindow::BLACKMAN) {
-        for (int i = 0; i < _nzFFTSize; i++) { fftWindowBuf[i] = dsp::window::blackman(i, _nzFFTSize); }
-    }
-    else if (_fftWindow == FFTWindow::NUTTALL) {
-        for (int i = 0; i < _nzFFTSize; i++) { fftWindowBuf[i] = dsp::window::nuttall(i, _nzFFTSize); }
-    }
-
-    fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+    // The channelizer only gets bound to the splitter once enabled
+    channelizer.init(&chanIn, CHANNELIZER_DEFAULT_CHANNEL_COUNT);
 
-    // Clear the rest of the FFT input buffer
-    dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
+    // Start with whatever plan can be made right away, the planner thread measures a better one if needed
+    FFTParams params = { effectiveSr, _fftSize, _fftRate, _fftWindow, _fftMode };
+    fftPlan = createFFTPlan(params);
+    _nzFFTSize = fftPlan->nzSize;
+    reshape.init(&fftIn, fftPlan->keep, fftPlan->skip);
+    fftSink.init(&reshape.out, handler, this);
+    plannerThread = std::thread(&IQFrontEnd::plannerWorker, this);
+    if (!fftPlan->measured) { updateFFTPath(); }
 
     split.bindStream(&fftIn);
 
@@ -74,6 +69,8 @@ void IQFrontEnd::setInput(dsp::stream<dsp::complex_t>* in) {
 }
 
 void IQFrontEnd::setSampleRate(double sampleRate) {
+    std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+
     // Temp stop the necessary blocks
     dcBlock.tempStop();
     for (auto& [name, vfo] : vfos) {
@@ -84,8 +81,11 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
     _sampleRate = sampleRate;
     effectiveSr = _sampleRate / _decimRatio;
     dcBlock.setRate(genDCBlockRate(effectiveSr));
+
+    // The channel spacing changed as well, so the VFOs may need to move to another channel
     for (auto& [name, vfo] : vfos) {
-        vfo->setInSamplerate(effectiveSr);
+        unrouteVFO(name);
+        routeVFO(name);
     }
 
     // Reconfigure the FFT
@@ -129,8 +129,8 @@ void IQFrontEnd::setInvertIQ(bool enabled) {
     preproc.setBlockEnabled(&conjugate, enabled, [=](dsp::stream<dsp::complex_t>* out){ split.setInput(out); });
 }
 
-void IQFrontEnd::bindIQStream(dsp::stream<dsp::complex_t>* stream) {
-    split.bindStream(stream);
+void IQFrontEnd::bindIQStream(dsp::stream<dsp::complex_t>* stream, bool privateCopy) {
+    split.bindStream(stream, privateCopy);
 }
 
 void IQFrontEnd::unbindIQStream(dsp::stream<dsp::complex_t>* stream) {
@@ -138,20 +138,25 @@ void IQFrontEnd::unbindIQStream(dsp::stream<dsp::complex_t>* stream) {
 }
 
 dsp::channel::RxVFO* IQFrontEnd::addVFO(std::string name, double sampleRate, double bandwidth, double offset) {
+    std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+
     // Make sure no other VFO with that name already exists
     if (vfos.find(name) != vfos.end()) {
         flog::error("[IQFrontEnd] Tried to add VFO with existing name.");
         return NULL;
     }
 
-    // Create VFO and its input stream
-    dsp::stream<dsp::complex_t>* vfoIn = new dsp::stream<dsp::complex_t>;
+    // Create VFO and its input stream, the stream's buffers are sized by whichever block feeds it
+    dsp::stream<dsp::complex_t>* vfoIn = new dsp::stream<dsp::complex_t>(0);
     dsp::channel::RxVFO* vfo = new dsp::channel::RxVFO(vfoIn, effectiveSr, sampleRate, bandwidth, offset);
+    if (_scheduler) { vfo->setScheduler(_scheduler, "VFO " + name); }
+    if (_profiler) { vfo->setProfiler(_profiler, "VFO " + name); }
 
     // Register them
     vfoStreams[name] = vfoIn;
     vfos[name] = vfo;
-    bindIQStream(vfoIn);
+    vfoParams[name] = { bandwidth, offset, false, 0 };
+    routeVFO(name);
 
     // Start VFO
     vfo->start();
@@ -160,6 +165,8 @@ dsp::channel::RxVFO* IQFrontEnd::addVFO(std::string name, double sampleRate, dou
 }
 
 void IQFrontEnd::removeVFO(std::string name) {
+    std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+
     // Make sure that a VFO with that name exists
     if (vfos.find(name) == vfos.end()) {
         flog::error("[IQFrontEnd] Tried to remove a VFO that doesn't exist.");
@@ -172,16 +179,108 @@ void IQFrontEnd::removeVFO(std::string name) {
 
     // Stop the VFO
     vfo->stop();
+    vfo->setProfiler(NULL);
 
-    unbindIQStream(vfoIn);
+    unrouteVFO(name);
     vfoStreams.erase(name);
     vfos.erase(name);
+    vfoParams.erase(name);
 
     // Delete the VFO and its input stream
     delete vfo;
     delete vfoIn;
 }
 
+void IQFrontEnd::setVFOOffset(std::string name, double offset) {
+    std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to set the offset of a VFO that doesn't exist.");
+        return;
+    }
+    vfoParams[name].offset = offset;
+    updateVFORoute(name);
+}
+
+void IQFrontEnd::setVFOBandwidth(std::string name, double bandwidth) {
+    std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to set the bandwidth of a VFO that doesn't exist.");
+        return;
+    }
+    vfoParams[name].bandwidth = bandwidth;
+    vfos[name]->setBandwidth(bandwidth);
+    updateVFORoute(name);
+}
+
+void IQFrontEnd::setVFOSamplerate(std::string name, double sampleRate, double bandwidth) {
+    std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to set the samplerate of a VFO that doesn't exist.");
+        return;
+    }
+    vfoParams[name].bandwidth = bandwidth;
+    vfos[name]->setOutSamplerate(sampleRate, bandwidth);
+    updateVFORoute(name);
+}
+
+void IQFrontEnd::setChannelizer(int channelCount) {
+    std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+    if (channelCount == _channelCount) { return; }
+
+    // Detach all VFOs from their current input
+    for (auto& [name, vfo] : vfos) {
+        unrouteVFO(name);
+    }
+
+    // Enable, reconfigure or disable the channelizer
+    if (channelCount) {
+        channelizer.setChannelCount(channelCount);
+        if (!_channelCount) {
+            split.bindStream(&chanIn);
+            channelizer.start();
+        }
+    }
+    else {
+        channelizer.stop();
+        split.unbindStream(&chanIn);
+    }
+    _channelCount = channelCount;
+
+    // Attach them to their new input
+    for (auto& [name, vfo] : vfos) {
+        routeVFO(name);
+    }
+}
+
+void IQFrontEnd::setScheduler(dsp::Scheduler* sched) {
+    _scheduler = sched;
+    split.setScheduler(_scheduler, "IQ Splitter");
+    channelizer.setScheduler(_scheduler, "Channelizer");
+    {
+        std::lock_guard<std::recursive_mutex> lck(fftMtx);
+        fftSink.setScheduler(_scheduler, "FFT");
+    }
+    for (auto& [name, vfo] : vfos) {
+        vfo->setScheduler(_scheduler, "VFO " + name);
+    }
+}
+
+void IQFrontEnd::setProfiler(dsp::Profiler* prof) {
+    std::lock_guard<std::recursive_mutex> lck(vfoMtx);
+    _profiler = prof;
+    inBuf.setProfiler(_profiler, "Input Buffer");
+    decim.setProfiler(_profiler, "Decimator");
+    dcBlock.setProfiler(_profiler, "DC Blocker");
+    conjugate.setProfiler(_profiler, "IQ Inverter");
+    split.setProfiler(_profiler, "IQ Splitter");
+    channelizer.setProfiler(_profiler, "Channelizer");
+    reshape.setProfiler(_profiler, "FFT Reshaper");
+    fftSink.setProfiler(_profiler, "FFT");
+    for (auto& [name, vfo] : vfos) {
+        vfo->setProfiler(_profiler, "VFO " + name);
+    }
+}
+
 void IQFrontEnd::setFFTSize(int size) {
     _fftSize = size;
     updateFFTPath(true);
@@ -197,6 +296,15 @@ void IQFrontEnd::setFFTWindow(FFTWindow fftWindow) {
     updateFFTPath();
 }
 
+void IQFrontEnd::setFFTMode(FFTMode fftMode) {
+    _fftMode = fftMode;
+    updateFFTPath();
+}
+
+int IQFrontEnd::getFFTSize() {
+    return fftPlan->size;
+}
+
 void IQFrontEnd::flushInputBuffer() {
     inBuf.flush();
 }
@@ -211,12 +319,16 @@ void IQFrontEnd::start() {
     // Start IQ splitter
     split.start();
 
+    // Start the channelizer if used
+    if (_channelCount) { channelizer.start(); }
+
     // Start all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->start();
     }
 
     // Start FFT chain
+    std::lock_guard<std::recursive_mutex> lck(fftMtx);
     reshape.start();
     fftSink.start();
 }
@@ -231,12 +343,16 @@ void IQFrontEnd::stop() {
     // Stop IQ splitter
     split.stop();
 
+    // Stop the channelizer
+    channelizer.stop();
+
     // Stop all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->stop();
     }
 
     // Stop FFT chain
+    std::lock_guard<std::recursive_mutex> lck(fftMtx);
     reshape.stop();
     fftSink.stop();
 }
@@ -245,65 +361,256 @@ double IQFrontEnd::getEffectiveSamplerate() {
     return effectiveSr;
 }
 
-void IQFrontEnd::handler(dsp::complex_t* data, int count, void* ctx) {
-    IQFrontEnd* _this = (IQFrontEnd*)ctx;
+bool IQFrontEnd::selectChannel(const VFOParams& params, int& channel) {
+    if (!_channelCount) { return false; }
+
+    // Channel k covers [k - 1/2, k + 1/2) channel spacings, so that each offset of the band [-sr/2, sr/2) maps to
+    // exactly one channel. The negative ones wrap around to the upper half of the outputs.
+    double spacing = effectiveSr / (double)_channelCount;
+    int signedChannel = floor((params.offset / spacing) + 0.5);
+    if (signedChannel < -(_channelCount / 2) || signedChannel >= _channelCount / 2) { return false; }
+    channel = (signedChannel + _channelCount) % _channelCount;
+
+    // The whole VFO band has to fit in the alias-free part of the channel and in the input band, a VFO crossing either
+    // edge is fed from the full band instead
+    double low = params.offset - (params.bandwidth / 2.0);
+    double high = params.offset + (params.bandwidth / 2.0);
+    if (low < -effectiveSr / 2.0 || high > effectiveSr / 2.0) { return false; }
+    double center = (double)signedChannel * spacing;
+    double passband = dsp::channel::Channelizer::PASSBAND * spacing;
+    return low >= center - passband && high <= center + passband;
+}
 
-    // Apply window
-    volk_32fc_32f_multiply_32fc((lv_32fc_t*)_this->fftInBuf, (lv_32fc_t*)data, _this->fftWindowBuf, _this->_nzFFTSize);
+double IQFrontEnd::getChannelCenter(int channel) {
+    int signedChannel = (channel >= _channelCount / 2) ? channel - _channelCount : channel;
+    return (double)signedChannel * effectiveSr / (double)_channelCount;
+}
 
-    // Execute FFT
-    fftwf_execute(_this->fftwPlan);
+void IQFrontEnd::routeVFO(const std::string& name) {
+    VFOParams& params = vfoParams[name];
+    dsp::stream<dsp::complex_t>* vfoIn = vfoStreams[name];
+    dsp::channel::RxVFO* vfo = vfos[name];
 
-    // Aquire buffer
-    float* fftBuf = _this->_acquireFFTBuffer(_this->_fftCtx);
+    // Feed the VFO from its channel if it fits in one, from the full band otherwise
+    params.channelized = selectChannel(params, params.channel);
+    if (params.channelized) {
+        vfo->setInSamplerate(effectiveSr * 2.0 / (double)_channelCount);
+        vfo->setOffset(params.offset - getChannelCenter(params.channel));
+        channelizer.bindChannel(params.channel, vfoIn);
+    }
+    else {
+        vfo->setInSamplerate(effectiveSr);
+        vfo->setOffset(params.offset);
+        split.bindStream(vfoIn);
+    }
+}
 
-    // Convert the complex output of the FFT to dB amplitude
-    if (fftBuf) {
-        volk_32fc_s32f_power_spectrum_32f(fftBuf, (lv_32fc_t*)_this->fftOutBuf, _this->_fftSize, _this->_fftSize);
+void IQFrontEnd::unrouteVFO(const std::string& name) {
+    if (vfoParams[name].channelized) {
+        channelizer.unbindChannel(vfoStreams[name]);
+    }
+    else {
+        split.unbindStream(vfoStreams[name]);
     }
+}
+
+void IQFrontEnd::updateVFORoute(const std::string& name) {
+    VFOParams& params = vfoParams[name];
+    int channel = 0;
+    bool channelized = selectChannel(params, channel);
 
-    // Release buffer
-    _this->_releaseFFTBuffer(_this->_fftCtx);
+    // If the VFO stays on the same input, only its offset has to change
+    if (channelized == params.channelized && (!channelized || channel == params.channel)) {
+        double center = channelized ? getChannelCenter(channel) : 0.0;
+        vfos[name]->setOffset(params.offset - center);
+        return;
+    }
+
+    unrouteVFO(name);
+    routeVFO(name);
+}
+
+void IQFrontEnd::handler(dsp::complex_t* data, int count, void* ctx) {
+    IQFrontEnd* _this = (IQFrontEnd*)ctx;
+    FFTPlan* p = _this->fftPlan;
+
+    // Apply window to the segments of the next frame of the batch, there's only one unless averaging
+    for (int i = 0; i < p->segments; i++) {
+        fftwf_complex* segment = &p->in[(_this->fftBatchFill * p->segments + i) * p->size];
+        volk_32fc_32f_multiply_32fc((lv_32fc_t*)segment, (lv_32fc_t*)&data[i * p->hop], p->window, p->nzSize);
+    }
+    if (++_this->fftBatchFill < p->batch) { return; }
+    _this->fftBatchFill = 0;
+
+    // Execute FFT
+    fftwf_execute(p->plan);
+
+    for (int i = 0; i < p->batch; i++) {
+        // Aquire buffer
+        float* fftBuf = _this->_acquireFFTBuffer(_this->_fftCtx);
+
+        // Convert the complex output of the FFT to dB amplitude
+        fftwf_complex* out = &p->out[i * p->segments * p->size];
+        if (fftBuf && p->segments == 1) {
+            volk_32fc_s32f_power_spectrum_32f(fftBuf, (lv_32fc_t*)out, p->size, p->size);
+        }
+        else if (fftBuf) {
+            // Average the power of the segments, then convert to dB with the same scaling as a single FFT
+            volk_32fc_magnitude_squared_32f(fftBuf, (lv_32fc_t*)out, p->size);
+            for (int j = 1; j < p->segments; j++) {
+                volk_32fc_magnitude_squared_32f(p->power, (lv_32fc_t*)&out[j * p->size], p->size);
+                volk_32f_x2_add_32f(fftBuf, fftBuf, p->power, p->size);
+            }
+            volk_32f_s32f_multiply_32f(fftBuf, fftBuf, 1.0f / ((float)p->segments * (float)p->size * (float)p->size), p->size);
+            volk_32f_log2_32f(fftBuf, fftBuf, p->size);
+            volk_32f_s32f_multiply_32f(fftBuf, fftBuf, 10.0f * log10f(2.0f), p->size);
+        }
+
+        // Release buffer
+        _this->_releaseFFTBuffer(_this->_fftCtx);
+    }
 }
 
 void IQFrontEnd::updateFFTPath(bool updateWaterfall) {
-    // Temp stop branch
-    reshape.tempStop();
-    fftSink.tempStop();
+    // Only hand the new settings to the planner thread, the current plan stays in use until the new one is ready
+    {
+        std::lock_guard<std::mutex> lck(plannerMtx);
+        plannerParams = { effectiveSr, _fftSize, _fftRate, _fftWindow, _fftMode };
+        planRequested = true;
+        planWaterfall |= updateWaterfall;
+    }
+    plannerCV.notify_all();
+}
 
-    // Update reshaper settings
-    int skip;
-    genReshapeParams(effectiveSr, _fftSize, _fftRate, skip, _nzFFTSize);
-    reshape.setKeep(_nzFFTSize);
-    reshape.setSkip(skip);
+IQFrontEnd::FFTPlan* IQFrontEnd::createFFTPlan(const FFTParams& params) {
+    FFTPlan* p = new FFTPlan;
+    p->size = params.size;
+    genReshapeParams(params.sampleRate, params.size, params.rate, p->skip, p->nzSize);
+    p->keep = p->nzSize;
+    p->segments = 1;
+    p->hop = p->nzSize;
+
+    // With Welch averaging, the frames cover as many overlapping segments as fit in the frame interval
+    if (params.mode == FFTMode::WELCH) {
+        int fftInterval = p->nzSize + p->skip;
+        p->hop = std::max<int>(p->nzSize / 2, 1);
+        p->segments = genWelchSegments(p->size, p->hop, p->nzSize, fftInterval);
+        p->keep = p->nzSize + (p->segments - 1) * p->hop;
+        p->skip = fftInterval - p->keep;
+    }
 
-    // Update window
-    dsp::buffer::free(fftWindowBuf);
-    fftWindowBuf = dsp::buffer::alloc<float>(_nzFFTSize);
-    if (_fftWindow == FFTWindow::RECTANGULAR) {
-        for (int i = 0; i < _nzFFTSize; i++) { fftWindowBuf[i] = 1.0f * ((i % 2) ? -1.0f : 1.0f); }
+    // Averaged frames are already several FFTs, so they aren't batched any further
+    p->batch = (p->segments > 1) ? 1 : genBatchSize(params.size, params.rate);
+
+    // Generate window, the alternating sign moves DC to the center of the spectrum
+    p->window = dsp::buffer::alloc<float>(p->nzSize);
+    if (params.window == FFTWindow::RECTANGULAR) {
+        for (int i = 0; i < p->nzSize; i++) { p->window[i] = 1.0f * ((i % 2) ? -1.0f : 1.0f); }
+    }
+    else if (params.window == FFTWindow::BLACKMAN) {
+        for (int i = 0; i < p->nzSize; i++) { p->window[i] = dsp::window::blackman(i, p->nzSize) * ((i % 2) ? -1.0f : 1.0f); }
+    }
+    else if (params.window == FFTWindow::NUTTALL) {
+        for (int i = 0; i < p->nzSize; i++) { p->window[i] = dsp::window::nuttall(i, p->nzSize) * ((i % 2) ? -1.0f : 1.0f); }
     }
-    else if (_fftWindow == FFTWindow::BLACKMAN) {
-        for (int i = 0; i < _nzFFTSize; i++) { fftWindowBuf[i] = dsp::window::blackman(i, _nzFFTSize) * ((i % 2) ? -1.0f : 1.0f); }
+
+    // Create plan, a measured plan is only used if it can come from the wisdom
+    int count = p->batch * p->segments;
+    p->power = (p->segments > 1) ? dsp::buffer::alloc<float>(p->size) : NULL;
+    p->in = (fftwf_complex*)fftwf_malloc(p->size * count * sizeof(fftwf_complex));
+    p->out = (fftwf_complex*)fftwf_malloc(p->size * count * sizeof(fftwf_complex));
+    unsigned int flags = dsp::fft::getEffortFlags();
+    p->plan = NULL;
+    p->measured = true;
+    if (!(flags & FFTW_ESTIMATE)) {
+        p->plan = dsp::fft::planBatchDFT(p->size, count, p->in, p->out, FFTW_FORWARD, flags | FFTW_WISDOM_ONLY);
+    }
+    if (!p->plan) {
+        p->plan = dsp::fft::planBatchDFT(p->size, count, p->in, p->out, FFTW_FORWARD, FFTW_ESTIMATE);
+        p->measured = (flags & FFTW_ESTIMATE) != 0;
     }
-    else if (_fftWindow == FFTWindow::NUTTALL) {
-        for (int i = 0; i < _nzFFTSize; i++) { fftWindowBuf[i] = dsp::window::nuttall(i, _nzFFTSize) * ((i % 2) ? -1.0f : 1.0f); }
+
+    // Clear the zero padding of every segment
+    for (int i = 0; i < count; i++) {
+        dsp::buffer::clear(p->in, p->size - p->nzSize, i * p->size + p->nzSize);
     }
 
-    // Update FFT plan
-    fftwf_free(fftInBuf);
-    fftwf_free(fftOutBuf);
-    fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+    return p;
+}
+
+void IQFrontEnd::destroyFFTPlan(FFTPlan* plan) {
+    if (!plan) { return; }
+    dsp::fft::destroyPlan(plan->plan);
+    dsp::buffer::free(plan->window);
+    dsp::buffer::free(plan->power);
+    fftwf_free(plan->in);
+    fftwf_free(plan->out);
+    delete plan;
+}
+
+void IQFrontEnd::applyFFTPlan(FFTPlan* plan, bool updateWaterfall) {
+    std::lock_guard<std::recursive_mutex> lck(fftMtx);
 
-    // Clear the rest of the FFT input buffer
-    dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
+    // Temp stop branch
+    reshape.tempStop();
+    fftSink.tempStop();
+
+    // Swap the plan and update reshaper settings
+    FFTPlan* old = fftPlan;
+    fftPlan = plan;
+    fftBatchFill = 0;
+    _nzFFTSize = plan->nzSize;
+    reshape.setKeep(plan->keep);
+    reshape.setSkip(plan->skip);
 
     // Update waterfall (TODO: This is annoying, it makes this module non testable and will constantly clear the waterfall for any reason)
-    if (updateWaterfall) { gui::waterfall.setRawFFTSize(_fftSize); }
+    if (updateWaterfall && !core::args["server"].b() && !core::isBatchMode()) { gui::waterfall.setRawFFTSize(plan->size); }
 
     // Restart branch
     reshape.tempStart();
     fftSink.tempStart();
-}
\ No newline at end of file
+
+    destroyFFTPlan(old);
+}
+
+void IQFrontEnd::plannerWorker() {
+    std::unique_lock<std::mutex> lck(plannerMtx);
+    while (true) {
+        plannerCV.wait(lck, [this]() { return planRequested || plannerStop; });
+        if (plannerStop) { return; }
+        FFTParams params = plannerParams;
+        bool updateWaterfall = planWaterfall;
+        planRequested = false;
+        planWaterfall = false;
+        lck.unlock();
+
+        // Switch to the new settings right away
+        FFTPlan* plan = createFFTPlan(params);
+        bool measured = plan->measured;
+        int count = plan->batch * plan->segments;
+        applyFFTPlan(plan, updateWaterfall);
+
+        // Then measure a plan if the wisdom didn't have one, unless the settings changed in the meantime.
+        // The measurement is time limited since the other FFTs can't be planned in the meantime.
+        if (!measured) {
+            flog::info("Measuring the FFT plan for {0} points, {1} per execution", params.size, count);
+            if (!dsp::fft::measureBatchDFT(params.size, count, FFTW_FORWARD)) {
+                flog::warn("Could not measure the FFT plan, keeping the estimated one");
+            }
+            else {
+                lck.lock();
+                bool stale = planRequested || plannerStop;
+                lck.unlock();
+                FFTPlan* measuredPlan = stale ? NULL : createFFTPlan(params);
+                if (measuredPlan && measuredPlan->measured) {
+                    applyFFTPlan(measuredPlan, false);
+                }
+                else {
+                    destroyFFTPlan(measuredPlan);
+                }
+            }
+        }
+
+        lck.lock();
+    }
+}
@@ -6,9 +6,17 @@
 #include "../dsp/chain.h"
 #include "../dsp/routing/splitter.h"
 #include "../dsp/channel/rx_vfo.h"
+#include "../dsp/channel/channelizer.h"
 #include "../dsp/sink/handler_sink.h"
 #include "../dsp/math/conjugate.h"
-#include <fftw3.h>
+#include "../dsp/fft/planner.h"
+#include <thread>
+#include <condition_variable>
+
+// Above this FFT rate, several frames are transformed per FFT execution so that it runs about this many times per second
+#define IQ_FRONTEND_FFT_BATCH_RATE          30.0
+#define IQ_FRONTEND_FFT_MAX_BATCH           8
+#define IQ_FRONTEND_FFT_MAX_BATCH_SAMPLES   (1 << 20)
 
 class IQFrontEnd {
 public:
@@ -20,6 +28,12 @@ public:
         NUTTALL
     };
 
+    // How the frames are taken from the input when it has more samples than the FFT rate needs
+    enum FFTMode {
+        DECIMATED,  // One FFT per frame, the samples in between frames are skipped
+        WELCH       // Power average of FFTs over 50% overlapping segments, using all of the input
+    };
+
     void init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool buffering, int decimRatio, bool dcBlocking, int fftSize, double fftRate, FFTWindow fftWindow, float* (*acquireFFTBuffer)(void* ctx), void (*releaseFFTBuffer)(void* ctx), void* fftCtx);
 
     void setInput(dsp::stream<dsp::complex_t>* in);
@@ -31,15 +45,32 @@ public:
     void setInvertIQ(bool enabled);
     void setDCBlocking(bool enabled);
 
-    void bindIQStream(dsp::stream<dsp::complex_t>* stream);
+    // The stream gets the splitter's own buffer, readers that modify the samples in place need a private copy
+    void bindIQStream(dsp::stream<dsp::complex_t>* stream, bool privateCopy = false);
     void unbindIQStream(dsp::stream<dsp::complex_t>* stream);
 
     dsp::channel::RxVFO* addVFO(std::string name, double sampleRate, double bandwidth, double offset);
     void removeVFO(std::string name);
+    void setVFOOffset(std::string name, double offset);
+    void setVFOBandwidth(std::string name, double bandwidth);
+    void setVFOSamplerate(std::string name, double sampleRate, double bandwidth);
+
+    // Feed the VFOs that fit in a channel from a polyphase channelizer instead of the full band, 0 channels disables it
+    void setChannelizer(int channelCount);
+
+    // Run the splitter, FFT sink and VFOs on a shared scheduler instead of their own threads
+    void setScheduler(dsp::Scheduler* sched);
+
+    // Record the execution counters of all blocks in a profiler (NULL to stop profiling)
+    void setProfiler(dsp::Profiler* prof);
 
     void setFFTSize(int size);
     void setFFTRate(double rate);
     void setFFTWindow(FFTWindow fftWindow);
+    void setFFTMode(FFTMode fftMode);
+
+    // Size of the lines written to the FFT buffers, only stable when called from the buffer callbacks
+    int getFFTSize();
 
     void flushInputBuffer();
 
@@ -49,8 +80,50 @@ public:
     double getEffectiveSamplerate();
 
 protected:
+    struct FFTParams {
+        double sampleRate;
+        int size;
+        double rate;
+        FFTWindow window;
+        FFTMode mode;
+    };
+
+    // Everything the FFT handler works with, replaced as a whole when the settings change
+    struct FFTPlan {
+        int size;
+        int nzSize;
+        int keep;       // Samples per frame
+        int skip;
+        int segments;   // Segments averaged per frame
+        int hop;        // Distance between two segments
+        int batch;      // Frames transformed per execution
+        bool measured; // False if planned with FFTW_ESTIMATE while waiting for a measured plan
+        float* window;
+        float* power;   // Scratch for the power of a segment
+        fftwf_complex* in;
+        fftwf_complex* out;
+        fftwf_plan plan;
+    };
+
     static void handler(dsp::complex_t* data, int count, void* ctx);
     void updateFFTPath(bool updateWaterfall = false);
+    static FFTPlan* createFFTPlan(const FFTParams& params);
+    static void destroyFFTPlan(FFTPlan* plan);
+    void applyFFTPlan(FFTPlan* plan, bool updateWaterfall);
+    void plannerWorker();
+
+    struct VFOParams {
+        double bandwidth;
+        double offset;
+        bool channelized;
+        int channel; // Index of the channelizer output, from 0 to channelCount - 1
+    };
+
+    bool selectChannel(const VFOParams& params, int& channel);
+    double getChannelCenter(int channel);
+    void routeVFO(const std::string& name);
+    void unrouteVFO(const std::string& name);
+    void updateVFORoute(const std::string& name);
 
     static inline double genDCBlockRate(double sampleRate) {
         return 50.0 / sampleRate;
@@ -62,6 +135,18 @@ protected:
         skip = fftInterval - nzSampCount;
     }
 
+    static inline int genBatchSize(int size, double rate) {
+        int batch = std::clamp<int>(rate / IQ_FRONTEND_FFT_BATCH_RATE, 1, IQ_FRONTEND_FFT_MAX_BATCH);
+        while (batch > 1 && size * batch > IQ_FRONTEND_FFT_MAX_BATCH_SAMPLES) { batch--; }
+        return batch;
+    }
+
+    // Segments that fit in one frame interval, within the memory limit of a batch
+    static inline int genWelchSegments(int size, int hop, int nzSampCount, int fftInterval) {
+        int segments = std::max<int>((fftInterval - nzSampCount) / hop + 1, 1);
+        return std::clamp<int>(segments, 1, std::max<int>(IQ_FRONTEND_FFT_MAX_BATCH_SAMPLES / size, 1));
+    }
+
     // Input buffer
     dsp::buffer::SampleFrameBuffer<dsp::complex_t> inBuf;
 
@@ -79,9 +164,15 @@ protected:
     dsp::buffer::Reshaper<dsp::complex_t> reshape;
     dsp::sink::Handler<dsp::complex_t> fftSink;
 
+    // Channelizer
+    dsp::stream<dsp::complex_t> chanIn;
+    dsp::channel::Channelizer channelizer;
+
     // VFOs
     std::map<std::string, dsp::stream<dsp::complex_t>*> vfoStreams;
     std::map<std::string, dsp::channel::RxVFO*> vfos;
+    std::map<std::string, VFOParams> vfoParams;
+    std::recursive_mutex vfoMtx;
 
     // Parameters
     double _sampleRate;
@@ -89,16 +180,28 @@ protected:
     int _fftSize;
     double _fftRate;
     FFTWindow _fftWindow;
+    FFTMode _fftMode = FFTMode::DECIMATED;
     float* (*_acquireFFTBuffer)(void* ctx);
     void (*_releaseFFTBuffer)(void* ctx);
     void* _fftCtx;
+    dsp::Scheduler* _scheduler = NULL;
+    dsp::Profiler* _profiler = NULL;
+    int _channelCount = 0;
 
     // Processing data
     int _nzFFTSize;
-    float* fftWindowBuf;
-    fftwf_complex *fftInBuf, *fftOutBuf;
-    fftwf_plan fftwPlan;
-    float* fftDbOut;
+    FFTPlan* fftPlan = NULL;
+    int fftBatchFill = 0;
+    std::recursive_mutex fftMtx; // Held while starting, stopping or replacing the FFT branch
+
+    // Plans are made by their own thread, measuring a large FFT can take seconds
+    std::thread plannerThread;
+    std::mutex plannerMtx;
+    std::condition_variable plannerCV;
+    FFTParams plannerParams;
+    bool planRequested = false;
+    bool planWaterfall = false;
+    bool plannerStop = false;
 
     double effectiveSr;
 
@@ -0,0 +1,11 @@
+#pragma once
+
+// Name of the module interface exposing the DSP profiler
+#define PROFILER_IFACE_NAME     "dsp_profiler"
+
+enum {
+    PROFILER_IFACE_CMD_GET_ENABLED, // out: bool*
+    PROFILER_IFACE_CMD_SET_ENABLED, // in: bool*
+    PROFILER_IFACE_CMD_RESET,
+    PROFILER_IFACE_CMD_GET_JSON     // out: std::string*, counters of all profiled blocks
+};
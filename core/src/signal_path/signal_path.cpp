@@ -1,6 +1,8 @@
 #include <signal_path/signal_path.h>
 
 namespace sigpath {
+    dsp::Scheduler scheduler;
+    dsp::Profiler profiler;
     IQFrontEnd iqFrontEnd;
     VFOManager vfoManager;
     SourceManager sourceManager;
@@ -3,9 +3,13 @@
 #include "vfo_manager.h"
 #include "source.h"
 #include "sink.h"
+#include "../dsp/scheduler.h"
+#include "../dsp/profiler.h"
 #include <module.h>
 
 namespace sigpath {
+    SDRPP_EXPORT dsp::Scheduler scheduler;
+    SDRPP_EXPORT dsp::Profiler profiler;
     SDRPP_EXPORT IQFrontEnd iqFrontEnd;
     SDRPP_EXPORT VFOManager vfoManager;
     SDRPP_EXPORT SourceManager sourceManager;
@@ -1,4 +1,3 @@
-#include <server.h>
 #include <signal_path/source.h>
 #include <utils/flog.h>
 #include <signal_path/signal_path.h>
@@ -50,13 +49,7 @@ void SourceManager::selectSource(std::string name) {
     selectedHandler = sources[name];
     selectedHandler->selectHandler(selectedHandler->ctx);
     selectedName = name;
-    if (core::args["server"].b()) {
-        server::setInput(selectedHandler->stream);
-    }
-    else {
-        sigpath::iqFrontEnd.setInput(selectedHandler->stream);
-    }
-    // Set server input here
+    sigpath::iqFrontEnd.setInput(selectedHandler->stream);
 }
 
 void SourceManager::showSelectedMenu() {
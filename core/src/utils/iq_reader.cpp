@@ -0,0 +1,36 @@
+#include "iq_reader.h"
+#include "wav_reader.h"
+#include "sigmf.h"
+#include <utils/flog.h>
+
+IQReader* IQReader::open(const std::string& path) {
+    IQReader* reader;
+    bool isSigMF = path.find(SIGMF_DATA_EXTENSION) != std::string::npos || path.find(SIGMF_META_EXTENSION) != std::string::npos;
+    if (isSigMF) {
+        reader = new sigmf::Reader(path);
+    }
+    else {
+        WavReader* wav = new WavReader(path);
+        if (wav->isValid() && wav->getChannelCount() != 2) {
+            flog::error("'{0}' is not an IQ recording, it has {1} channels", path, wav->getChannelCount());
+            delete wav;
+            return NULL;
+        }
+        reader = wav;
+    }
+
+    if (!reader->isValid() || !reader->getSampleRate()) {
+        reader->close();
+        delete reader;
+        return NULL;
+    }
+
+    // Nothing could be played back, and the users of the reader count on there being at least one frame
+    if (!reader->getFrameCount()) {
+        flog::error("'{0}' doesn't contain any samples", path);
+        reader->close();
+        delete reader;
+        return NULL;
+    }
+    return reader;
+}
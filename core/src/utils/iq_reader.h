@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <dsp/types.h>
+
+// Recording of complex samples read out of a file, whatever its format
+class IQReader {
+public:
+    // Part of the recording with the same frequency and samplerate
+    struct Capture {
+        uint64_t frame;
+        double frequency;   // 0 if unknown
+        double sampleRate;
+    };
+
+    virtual ~IQReader() {}
+
+    virtual bool isValid() = 0;
+    virtual double getSampleRate() = 0;
+    virtual uint64_t getFrameCount() = 0;
+
+    // Convert frames to complex samples, returns how many were read
+    virtual int read(uint64_t frame, dsp::complex_t* out, int count) = 0;
+
+    // Start reading the given frames from disk ahead of time
+    virtual void prefetch(uint64_t frame, uint64_t count) {}
+
+    virtual void close() = 0;
+
+    // For formats whose header may not say the samples are float
+    virtual void setForceFloat(bool force) {}
+
+    // Formats that can't record changes have a single capture covering the whole file
+    virtual int getCaptureCount() { return 1; }
+    virtual Capture getCapture(int id) { return { 0, 0.0, getSampleRate() }; }
+    virtual int findCapture(uint64_t frame) { return 0; }
+
+    // Time at which a frame was recorded in seconds since epoch, negative if unknown
+    virtual double getTime(uint64_t frame) { return -1.0; }
+
+    // Frame recorded at the given time, only valid if the recording has timestamps
+    virtual uint64_t findFrame(double time) { return 0; }
+
+    // Open a wav or SigMF recording depending on the extension, NULL if it isn't a valid IQ recording or is empty
+    static IQReader* open(const std::string& path);
+};
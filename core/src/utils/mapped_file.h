@@ -0,0 +1,104 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file, the OS pages it in as it gets read
+class MappedFile {
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) { return false; }
+        LARGE_INTEGER fsize;
+        if (!GetFileSizeEx(file, &fsize) || !fsize.QuadPart) {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) {
+            close();
+            return false;
+        }
+        data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data) {
+            close();
+            return false;
+        }
+        size = fsize.QuadPart;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { return false; }
+        struct stat st;
+        if (fstat(fd, &st) || !st.st_size) {
+            close();
+            return false;
+        }
+        void* ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) {
+            close();
+            return false;
+        }
+        data = (const uint8_t*)ptr;
+        size = st.st_size;
+        madvise(ptr, size, MADV_SEQUENTIAL);
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data) { UnmapViewOfFile(data); }
+        if (mapping) { CloseHandle(mapping); }
+        if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data) { munmap((void*)data, size); }
+        if (fd >= 0) { ::close(fd); }
+        fd = -1;
+#endif
+        data = NULL;
+        size = 0;
+    }
+
+    bool isOpen() { return data != NULL; }
+    const uint8_t* getData() { return data; }
+    uint64_t getSize() { return size; }
+
+    // Ask the OS to start reading a range that will be needed soon
+    void willNeed(uint64_t offset, uint64_t len) {
+        if (offset >= size) { return; }
+        len = std::min<uint64_t>(len, size - offset);
+#ifndef _WIN32
+        // The address must be page aligned
+        uint64_t pageSize = sysconf(_SC_PAGESIZE);
+        uint64_t aligned = offset & ~(pageSize - 1);
+        madvise((void*)(data + aligned), len + (offset - aligned), MADV_WILLNEED);
+#endif
+    }
+
+private:
+    const uint8_t* data = NULL;
+    uint64_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
@@ -3,6 +3,10 @@
 #if defined(_WIN32)
 #include <windows.h>
 #include <GL/gl.h>
+// Only OpenGL 1.1 is declared on Windows
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
 #elif defined(__APPLE__)
 #include <OpenGL/gl.h>
 #elif defined(__ANDROID__)
@@ -0,0 +1,451 @@
+#include "sigmf.h"
+#include <volk/volk.h>
+#include <stdexcept>
+#include <filesystem>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <json.hpp>
+#include <dsp/buffer/buffer.h>
+#include <dsp/stream.h>
+#include <dsp/convert/sample_format.h>
+#include <utils/flog.h>
+#include <version.h>
+
+using nlohmann::json;
+
+namespace sigmf {
+    const char* SAMP_TYPE_NAMES[] = { "u8", "i8", "i16", "i32", "f32" };
+    const int SAMP_TYPE_SIZES[] = { 1, 1, 2, 4, 4 };
+
+    std::string getDataType(SampleType type, bool complex) {
+        std::string name = std::string(complex ? "c" : "r") + SAMP_TYPE_NAMES[type];
+        if (SAMP_TYPE_SIZES[type] > 1) { name += "_le"; }
+        return name;
+    }
+
+    bool parseDataType(const std::string& name, SampleType& type, bool& complex) {
+        if (name.empty() || (name[0] != 'c' && name[0] != 'r')) { return false; }
+        complex = (name[0] == 'c');
+        for (int i = 0; i <= SAMP_TYPE_FLOAT32; i++) {
+            std::string base = std::string(1, name[0]) + SAMP_TYPE_NAMES[i];
+            if (name == base || (SAMP_TYPE_SIZES[i] > 1 && name == base + "_le")) {
+                type = (SampleType)i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Days since epoch of a date of the proleptic Gregorian calendar and the other way around,
+    // from http://howardhinnant.github.io/date_algorithms.html
+    static int64_t daysFromCivil(int64_t y, int m, int d) {
+        y -= m <= 2;
+        int64_t era = (y >= 0 ? y : y - 399) / 400;
+        int64_t yoe = y - era * 400;
+        int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    static void civilFromDays(int64_t z, int64_t& y, int& m, int& d) {
+        z += 719468;
+        int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        int64_t doe = z - era * 146097;
+        int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int64_t mp = (5 * doy + 2) / 153;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y = yoe + era * 400 + (m <= 2);
+    }
+
+    std::string formatTime(double time) {
+        int64_t ms = llround(time * 1000.0);
+        int64_t secs = (ms >= 0 ? ms : ms - 999) / 1000;
+        ms -= secs * 1000;
+        int64_t days = (secs >= 0 ? secs : secs - 86399) / 86400;
+        int64_t sod = secs - days * 86400;
+        int64_t y;
+        int m, d;
+        civilFromDays(days, y, m, d);
+        char buf[64];
+        sprintf(buf, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", (int)y, m, d, (int)(sod / 3600), (int)((sod / 60) % 60), (int)(sod % 60), (int)ms);
+        return buf;
+    }
+
+    bool parseTime(const std::string& str, double& time) {
+        int y, m, d, hh, mm, len = 0;
+        double ss;
+        if (sscanf(str.c_str(), "%d-%d-%dT%d:%d:%lf%n", &y, &m, &d, &hh, &mm, &ss, &len) != 6) { return false; }
+
+        // UTC unless an offset is given
+        double offset = 0.0;
+        const char* tz = str.c_str() + len;
+        int oh, om;
+        if ((tz[0] == '+' || tz[0] == '-') && sscanf(tz + 1, "%d:%d", &oh, &om) == 2) {
+            offset = (oh * 3600.0 + om * 60.0) * (tz[0] == '+' ? 1.0 : -1.0);
+        }
+
+        time = daysFromCivil(y, m, d) * 86400.0 + hh * 3600.0 + mm * 60.0 + ss - offset;
+        return true;
+    }
+
+    static double now() {
+        return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    Writer::Writer(int channels, bool complex, SampleType type) {
+        if (channels < 1) { throw std::runtime_error("Channel count must be greater or equal to 1"); }
+        _channels = channels;
+        _complex = complex;
+        _type = type;
+    }
+
+    Writer::~Writer() { close(); }
+
+    bool Writer::open(std::string path) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        if (file.is_open()) { close(); }
+        if (_samplerate <= 0.0) { return false; }
+
+        // Reset work values
+        samplesWritten = 0;
+        lastMetaWrite = 0;
+        captures.clear();
+        index.clear();
+        componentsPerSamp = _channels * (_complex ? 2 : 1);
+        bytesPerSamp = componentsPerSamp * SAMP_TYPE_SIZES[_type];
+        indexInterval = std::max<uint64_t>(1, llround(_samplerate * SIGMF_INDEX_INTERVAL));
+        metaInterval = std::max<uint64_t>(1, llround(_samplerate * SIGMF_META_INTERVAL));
+
+        // Float samples are written as they are
+        if (_type != SAMP_TYPE_FLOAT32) { buf = dsp::buffer::alloc<int32_t>(STREAM_BUFFER_SIZE * componentsPerSamp); }
+
+        // Open the data file, there is no header so its size is only limited by the file system
+        file.open(path + SIGMF_DATA_EXTENSION, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            dsp::buffer::free(buf);
+            buf = NULL;
+            return false;
+        }
+
+        // Write the metadata right away so that the recording is usable even if never closed
+        metaPath = path + SIGMF_META_EXTENSION;
+        addCapture(now());
+        writeMeta();
+
+        return true;
+    }
+
+    bool Writer::isOpen() {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        return file.is_open();
+    }
+
+    void Writer::close() {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        if (!file.is_open()) { return; }
+        file.close();
+        writeMeta();
+        dsp::buffer::free(buf);
+        buf = NULL;
+    }
+
+    void Writer::setChannels(int channels) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        if (file.is_open()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        if (channels < 1) { throw std::runtime_error("Channel count must be greater or equal to 1"); }
+        _channels = channels;
+    }
+
+    void Writer::setComplex(bool complex) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        if (file.is_open()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        _complex = complex;
+    }
+
+    void Writer::setSampleType(SampleType type) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        if (file.is_open()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        _type = type;
+    }
+
+    void Writer::setSamplerate(double samplerate) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        if (samplerate <= 0.0) { throw std::runtime_error("Samplerate must be non-zero"); }
+        if (samplerate == _samplerate) { return; }
+        _samplerate = samplerate;
+        captureNeeded = file.is_open();
+    }
+
+    void Writer::setFrequency(double frequency) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        if (frequency == _frequency) { return; }
+        _frequency = frequency;
+        captureNeeded = file.is_open();
+    }
+
+    void Writer::write(float* samples, int count, double time) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        if (!file.is_open()) { return; }
+
+        // Unless told otherwise, the samples are assumed to have just been received, which dates the first one of
+        // the block. The first block also gives the recording its actual start time.
+        double blockTime = (time >= 0.0) ? time : now() - (count / _samplerate);
+        if (captureNeeded || !samplesWritten) { addCapture(blockTime); }
+        while (index.size() * indexInterval < samplesWritten + count) {
+            index.push_back(blockTime + ((double)(index.size() * indexInterval) - (double)samplesWritten) / _samplerate);
+        }
+
+        // Convert to the sample type
+        int tcount = count * componentsPerSamp;
+        switch (_type) {
+        case SAMP_TYPE_UINT8:
+            for (int i = 0; i < tcount; i++) {
+                ((uint8_t*)buf)[i] = std::clamp<float>((samples[i] * 127.0f) + 128.0f, 0.0f, 255.0f);
+            }
+            break;
+        case SAMP_TYPE_INT8:
+            volk_32f_s32f_convert_8i((int8_t*)buf, samples, 127.0f, tcount);
+            break;
+        case SAMP_TYPE_INT16:
+            volk_32f_s32f_convert_16i((int16_t*)buf, samples, 32767.0f, tcount);
+            break;
+        case SAMP_TYPE_INT32:
+            volk_32f_s32f_convert_32i((int32_t*)buf, samples, 2147483647.0f, tcount);
+            break;
+        default:
+            break;
+        }
+        file.write((char*)((_type == SAMP_TYPE_FLOAT32) ? samples : buf), count * bytesPerSamp);
+        samplesWritten += count;
+
+        // Keep the metadata on disk reasonably up to date
+        if (samplesWritten - lastMetaWrite >= metaInterval) {
+            writeMeta();
+            lastMetaWrite = samplesWritten;
+        }
+    }
+
+    void Writer::addCapture(double time) {
+        captureNeeded = false;
+        Capture cap = { samplesWritten, _frequency, _samplerate, time };
+
+        // Nothing was recorded since the last change
+        if (!captures.empty() && captures.back().sampleStart == samplesWritten) {
+            captures.back() = cap;
+            return;
+        }
+        captures.push_back(cap);
+    }
+
+    void Writer::writeMeta() {
+        json meta;
+        meta["global"]["core:datatype"] = getDataType(_type, _complex);
+        meta["global"]["core:sample_rate"] = captures.empty() ? _samplerate : captures[0].sampleRate;
+        meta["global"]["core:version"] = "1.0.0";
+        meta["global"]["core:recorder"] = "SDR++ v" VERSION_STR;
+        if (_channels > 1) { meta["global"]["core:num_channels"] = _channels; }
+        meta["global"]["core:extensions"] = json::array({ { { "name", "sdrpp" }, { "version", "1.0.0" }, { "optional", true } } });
+
+        // Index relative to the first capture, rounded to the millisecond to keep it short
+        if (!captures.empty()) {
+            json times = json::array();
+            for (double t : index) { times.push_back(round((t - captures[0].time) * 1000.0) / 1000.0); }
+            meta["global"]["sdrpp:index_interval"] = indexInterval;
+            meta["global"]["sdrpp:index"] = times;
+        }
+
+        meta["captures"] = json::array();
+        for (const auto& cap : captures) {
+            json c;
+            c["core:sample_start"] = cap.sampleStart;
+            if (cap.frequency) { c["core:frequency"] = cap.frequency; }
+            c["core:datetime"] = formatTime(cap.time);
+            c["sdrpp:sample_rate"] = cap.sampleRate;
+            meta["captures"].push_back(c);
+        }
+        meta["annotations"] = json::array();
+
+        // Replace the old file only once the new one is complete
+        std::string tmpPath = metaPath + ".tmp";
+        {
+            std::ofstream metaFile(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+            metaFile << meta.dump(4);
+            metaFile.close();
+            if (metaFile.fail()) {
+                flog::error("Could not write SigMF metadata '{0}'", tmpPath);
+                return;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, metaPath, ec);
+        if (ec) { flog::error("Could not replace SigMF metadata '{0}': {1}", metaPath, ec.message()); }
+    }
+
+    Reader::Reader(std::string path) {
+        // Accept the path of either file
+        std::string stem = path;
+        for (const char* ext : { SIGMF_DATA_EXTENSION, SIGMF_META_EXTENSION }) {
+            size_t len = strlen(ext);
+            if (stem.size() > len && stem.compare(stem.size() - len, len, ext) == 0) {
+                stem = stem.substr(0, stem.size() - len);
+                break;
+            }
+        }
+
+        std::ifstream metaFile(stem + SIGMF_META_EXTENSION);
+        if (!metaFile.is_open()) {
+            flog::error("Could not open SigMF metadata of '{0}'", stem);
+            return;
+        }
+        std::stringstream ss;
+        ss << metaFile.rdbuf();
+
+        // Load the metadata, any field of the wrong type throws
+        try {
+            json meta = json::parse(ss.str());
+            const json& global = meta.at("global");
+
+            // Only complex single channel recordings can be played
+            bool complex;
+            if (!parseDataType(global.at("core:datatype"), type, complex)) {
+                flog::error("Unsupported SigMF datatype");
+                return;
+            }
+            int channels = global.value("core:num_channels", 1);
+            if (!complex || channels != 1) {
+                flog::error("Only single channel complex SigMF recordings are supported");
+                return;
+            }
+            sampleRate = global.value("core:sample_rate", 0.0);
+            frameSize = 2 * SAMP_TYPE_SIZES[type];
+
+            // Captures, the first one always starts at the beginning
+            for (const auto& c : meta.value("captures", json::array())) {
+                sigmf::Capture cap = { c.value("core:sample_start", (uint64_t)0), c.value("core:frequency", 0.0), c.value("sdrpp:sample_rate", sampleRate), -1.0 };
+                if (!parseTime(c.value("core:datetime", ""), cap.time)) { cap.time = -1.0; }
+                captures.push_back(cap);
+            }
+            std::sort(captures.begin(), captures.end(), [](const sigmf::Capture& a, const sigmf::Capture& b) { return a.sampleStart < b.sampleStart; });
+            if (captures.empty() || captures[0].sampleStart) { captures.insert(captures.begin(), { 0, 0.0, sampleRate, -1.0 }); }
+            for (const auto& cap : captures) {
+                if (cap.sampleRate > 0.0) { continue; }
+                flog::error("Invalid SigMF samplerate");
+                return;
+            }
+
+            // Time index, only usable if the first capture has a time
+            if (captures[0].time >= 0.0 && global.contains("sdrpp:index")) {
+                indexInterval = global.value("sdrpp:index_interval", (uint64_t)0);
+                for (double t : global["sdrpp:index"]) { index.push_back(captures[0].time + t); }
+                if (!indexInterval) { index.clear(); }
+            }
+        }
+        catch (const std::exception& e) {
+            flog::error("Invalid SigMF metadata: {0}", e.what());
+            return;
+        }
+
+        // Map the samples
+        if (!file.open(stem + SIGMF_DATA_EXTENSION)) {
+            flog::error("Could not open SigMF data of '{0}'", stem);
+            return;
+        }
+        frameCount = file.getSize() / frameSize;
+        valid = true;
+    }
+
+    int Reader::read(uint64_t frame, dsp::complex_t* out, int count) {
+        if (frame >= frameCount) { return 0; }
+        count = std::min<uint64_t>(count, frameCount - frame);
+        const uint8_t* in = file.getData() + frame * frameSize;
+        switch (type) {
+        case SAMP_TYPE_UINT8:
+            dsp::convert::u8ToComplex(count, in, out, 128.0f, 1.0f / 127.0f);
+            break;
+        case SAMP_TYPE_INT8:
+            dsp::convert::s8ToComplex(count, (const int8_t*)in, out, 0.0f, 1.0f / 128.0f);
+            break;
+        case SAMP_TYPE_INT16:
+            dsp::convert::s16ToComplex(count, (const int16_t*)in, out, 0.0f, 1.0f / 32768.0f);
+            break;
+        case SAMP_TYPE_INT32:
+            dsp::convert::s32ToComplex(count, (const int32_t*)in, out, 0.0f, 1.0f / 2147483648.0f);
+            break;
+        case SAMP_TYPE_FLOAT32:
+            memcpy(out, in, count * sizeof(dsp::complex_t));
+            break;
+        }
+        return count;
+    }
+
+    void Reader::prefetch(uint64_t frame, uint64_t count) {
+        file.willNeed(frame * frameSize, count * frameSize);
+    }
+
+    void Reader::close() {
+        file.close();
+    }
+
+    IQReader::Capture Reader::getCapture(int id) {
+        const sigmf::Capture& cap = captures[id];
+        return { cap.sampleStart, cap.frequency, cap.sampleRate };
+    }
+
+    int Reader::findCapture(uint64_t frame) {
+        auto it = std::upper_bound(captures.begin(), captures.end(), frame, [](uint64_t f, const sigmf::Capture& c) { return f < c.sampleStart; });
+        return std::max<int>(0, std::distance(captures.begin(), it) - 1);
+    }
+
+    double Reader::getTime(uint64_t frame) {
+        // Interpolate between the two closest index entries
+        if (!index.empty()) {
+            size_t i = std::min<size_t>(frame / indexInterval, index.size() - 1);
+            double frac = ((double)frame - (double)(i * indexInterval)) / indexInterval;
+            if (i + 1 < index.size()) { return index[i] + (index[i + 1] - index[i]) * frac; }
+            return index[i] + frac * indexInterval / captures[findCapture(frame)].sampleRate;
+        }
+
+        // Otherwise count from the start of the capture
+        const sigmf::Capture& cap = captures[findCapture(frame)];
+        if (cap.time < 0.0) { return -1.0; }
+        return cap.time + (frame - cap.sampleStart) / cap.sampleRate;
+    }
+
+    uint64_t Reader::findFrame(double time) {
+        double frame = 0.0;
+        if (!index.empty()) {
+            // The entries are evenly spaced unless samples were lost, so the guess is at most a few entries off
+            int64_t last = index.size() - 1;
+            double span = index[last] - index[0];
+            int64_t i = (span > 0.0) ? (int64_t)((time - index[0]) * last / span) : 0;
+            i = std::clamp<int64_t>(i, 0, last);
+            while (i > 0 && index[i] > time) { i--; }
+            while (i < last && index[i + 1] <= time) { i++; }
+
+            // Inverse of the interpolation done by getTime()
+            // Entries with the same time, or going back in time, give the frame of the lower one
+            double offset = std::max<double>(time - index[i], 0.0);
+            if (i < last) {
+                double step = index[i + 1] - index[i];
+                frame = (step > 0.0) ? (i + std::min<double>(offset / step, 1.0)) * indexInterval : i * indexInterval;
+            }
+            else {
+                frame = i * indexInterval + offset * captures[findCapture(i * indexInterval)].sampleRate;
+            }
+        }
+        else {
+            // Count from the start of the last capture started before that time
+            for (const auto& cap : captures) {
+                if (cap.time < 0.0 || cap.time > time) { continue; }
+                frame = cap.sampleStart + (time - cap.time) * cap.sampleRate;
+            }
+        }
+        return std::min<double>(frame, frameCount ? frameCount - 1 : 0);
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <stdint.h>
+#include "iq_reader.h"
+#include "mapped_file.h"
+
+#define SIGMF_DATA_EXTENSION    ".sigmf-data"
+#define SIGMF_META_EXTENSION    ".sigmf-meta"
+
+// Seconds of samples between the timestamps of the index
+#define SIGMF_INDEX_INTERVAL    1.0
+
+// Seconds of samples between rewrites of the metadata while recording, so that a crash loses little of it
+#define SIGMF_META_INTERVAL     10.0
+
+// SigMF recordings (https://github.com/sigmf/SigMF), the samples are stored raw in the .sigmf-data file and
+// everything else in the .sigmf-meta JSON file. Frequency and samplerate changes start a new capture, the samplerate
+// of each capture being kept in "sdrpp:sample_rate". "sdrpp:index" holds the time at which every
+// "sdrpp:index_interval" samples were recorded, relative to the first capture, for seeking by time.
+namespace sigmf {
+    enum SampleType {
+        SAMP_TYPE_UINT8,
+        SAMP_TYPE_INT8,
+        SAMP_TYPE_INT16,
+        SAMP_TYPE_INT32,
+        SAMP_TYPE_FLOAT32
+    };
+
+    struct Capture {
+        uint64_t sampleStart;
+        double frequency;
+        double sampleRate;
+        double time;        // Seconds since epoch, negative if unknown
+    };
+
+    // Name of the SigMF datatype ("cf32_le", "ri16_le", ...)
+    std::string getDataType(SampleType type, bool complex);
+
+    // Parse a datatype, only little endian and 8 bit types are supported
+    bool parseDataType(const std::string& name, SampleType& type, bool& complex);
+
+    // ISO 8601 UTC time as used by core:datetime
+    std::string formatTime(double time);
+    bool parseTime(const std::string& str, double& time);
+
+    class Writer {
+    public:
+        Writer(int channels = 1, bool complex = true, SampleType type = SAMP_TYPE_INT16);
+        ~Writer();
+
+        // The extensions are added to the path
+        bool open(std::string path);
+        bool isOpen();
+        void close();
+
+        void setChannels(int channels);
+        void setComplex(bool complex);
+        void setSampleType(SampleType type);
+
+        // Can also be called while recording, a new capture then starts at the next sample written
+        void setSamplerate(double samplerate);
+        void setFrequency(double frequency);
+
+        size_t getSamplesWritten() { return samplesWritten; }
+
+        // Interleaved channels, count being the number of samples of each channel. The time of the first sample is
+        // only needed if they weren't just received, otherwise it is taken from the clock.
+        void write(float* samples, int count, double time = -1.0);
+
+    private:
+        void addCapture(double time);
+        void writeMeta();
+
+        std::recursive_mutex mtx;
+        std::ofstream file;
+        std::string metaPath;
+
+        int _channels;
+        bool _complex;
+        SampleType _type;
+        double _samplerate = 0.0;
+        double _frequency = 0.0;
+        bool captureNeeded = false;
+        int componentsPerSamp;
+        size_t bytesPerSamp;
+
+        std::vector<Capture> captures;
+        std::vector<double> index;
+        uint64_t indexInterval;
+        uint64_t lastMetaWrite = 0;
+        uint64_t metaInterval;
+
+        void* buf = NULL;
+        size_t samplesWritten = 0;
+    };
+
+    class Reader : public IQReader {
+    public:
+        // Path of either file or without extension
+        Reader(std::string path);
+
+        bool isValid() { return valid; }
+        double getSampleRate() { return sampleRate; }
+        uint64_t getFrameCount() { return frameCount; }
+        int read(uint64_t frame, dsp::complex_t* out, int count);
+        void prefetch(uint64_t frame, uint64_t count);
+        void close();
+
+        int getCaptureCount() { return captures.size(); }
+        IQReader::Capture getCapture(int id);
+        int findCapture(uint64_t frame);
+        double getTime(uint64_t frame);
+        uint64_t findFrame(double time);
+
+    private:
+        bool valid = false;
+        MappedFile file;
+        SampleType type;
+        int frameSize;
+        double sampleRate = 0.0;
+        uint64_t frameCount = 0;
+        std::vector<sigmf::Capture> captures;
+        std::vector<double> index;
+        uint64_t indexInterval = 0;
+    };
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include "mapped_file.h"
+#include "iq_reader.h"
+#include <dsp/types.h>
+#include <dsp/convert/sample_format.h>
+
+#define WAV_SIGNATURE       "RIFF"
+#define WAV_TYPE            "WAVE"
+#define WAV_FORMAT_MARK     "fmt "
+#define WAV_DATA_MARK       "data"
+#define WAV_SAMPLE_TYPE_PCM 1
+#define WAV_SAMPLE_TYPE_FLOAT 3
+
+enum SampleFormat {
+    SAMPLE_FORMAT_U8,
+    SAMPLE_FORMAT_S16,
+    SAMPLE_FORMAT_S32,
+    SAMPLE_FORMAT_F32
+};
+
+// Maps the file and reads the samples straight out of the mapping
+class WavReader : public IQReader {
+public:
+    WavReader(std::string path) {
+        valid = false;
+        if (!file.open(path)) { return; }
+        const uint8_t* data = file.getData();
+        uint64_t size = file.getSize();
+        if (size < sizeof(RiffHeader_t)) { return; }
+        RiffHeader_t* riff = (RiffHeader_t*)data;
+        if (memcmp(riff->signature, WAV_SIGNATURE, 4) != 0) { return; }
+        if (memcmp(riff->fileType, WAV_TYPE, 4) != 0) { return; }
+
+        // Find the format and data chunks
+        bool fmtFound = false;
+        uint64_t pos = sizeof(RiffHeader_t);
+        while (pos + sizeof(ChunkHeader_t) <= size) {
+            ChunkHeader_t* chunk = (ChunkHeader_t*)&data[pos];
+            pos += sizeof(ChunkHeader_t);
+            if (!memcmp(chunk->id, WAV_FORMAT_MARK, 4)) {
+                if (chunk->size < sizeof(FormatHeader_t) || pos + sizeof(FormatHeader_t) > size) { return; }
+                memcpy(&hdr, &data[pos], sizeof(FormatHeader_t));
+                fmtFound = true;
+            }
+            else if (!memcmp(chunk->id, WAV_DATA_MARK, 4)) {
+                // A file that wasn't closed properly has no data size and the size of a file over 4GB doesn't fit,
+                // in both cases use everything until the end
+                dataOffset = pos;
+                bool sizeValid = chunk->size && chunk->size <= size - pos && size - pos <= 0xFFFFFFFF;
+                dataSize = sizeValid ? chunk->size : (size - pos);
+                break;
+            }
+            pos += chunk->size + (chunk->size & 1);
+        }
+        if (!fmtFound || !dataOffset || !hdr.channelCount) { return; }
+
+        // Sample format given by the header
+        if (hdr.sampleType == WAV_SAMPLE_TYPE_FLOAT && hdr.bitDepth == 32) { fileFormat = SAMPLE_FORMAT_F32; }
+        else if (hdr.sampleType == WAV_SAMPLE_TYPE_PCM && hdr.bitDepth == 8) { fileFormat = SAMPLE_FORMAT_U8; }
+        else if (hdr.sampleType == WAV_SAMPLE_TYPE_PCM && hdr.bitDepth == 16) { fileFormat = SAMPLE_FORMAT_S16; }
+        else if (hdr.sampleType == WAV_SAMPLE_TYPE_PCM && hdr.bitDepth == 32) { fileFormat = SAMPLE_FORMAT_S32; }
+        else { return; }
+        format = fileFormat;
+        valid = true;
+    }
+
+    uint16_t getBitDepth() {
+        return hdr.bitDepth;
+    }
+
+    uint16_t getChannelCount() {
+        return hdr.channelCount;
+    }
+
+    double getSampleRate() {
+        return hdr.sampleRate;
+    }
+
+    SampleFormat getFormat() {
+        return format;
+    }
+
+    // For files whose header doesn't say the samples are float
+    void setForceFloat(bool force) {
+        format = force ? SAMPLE_FORMAT_F32 : fileFormat;
+    }
+
+    bool isValid() {
+        return valid;
+    }
+
+    uint64_t getFrameCount() {
+        return dataSize / getFrameSize(format);
+    }
+
+    // Samples of the given frame, valid until the file is closed
+    const uint8_t* getFrames(uint64_t frame) {
+        return file.getData() + dataOffset + frame * getFrameSize(format);
+    }
+
+    // Convert frames to complex samples, returns how many were read
+    int read(uint64_t frame, dsp::complex_t* out, int count) {
+        uint64_t frameCount = getFrameCount();
+        if (frame >= frameCount) { return 0; }
+        count = std::min<uint64_t>(count, frameCount - frame);
+        const uint8_t* in = getFrames(frame);
+        switch (format) {
+        case SAMPLE_FORMAT_U8:
+            dsp::convert::u8ToComplex(count, in, out, 128.0f, 1.0f / 127.0f);
+            break;
+        case SAMPLE_FORMAT_S16:
+            dsp::convert::s16ToComplex(count, (const int16_t*)in, out, 0.0f, 1.0f / 32768.0f);
+            break;
+        case SAMPLE_FORMAT_S32:
+            dsp::convert::s32ToComplex(count, (const int32_t*)in, out, 0.0f, 1.0f / 2147483648.0f);
+            break;
+        case SAMPLE_FORMAT_F32:
+            memcpy(out, in, count * sizeof(dsp::complex_t));
+            break;
+        }
+        return count;
+    }
+
+    // Start reading the given frames from disk ahead of time
+    void prefetch(uint64_t frame, uint64_t count) {
+        file.willNeed(dataOffset + frame * getFrameSize(format), count * getFrameSize(format));
+    }
+
+    static int getFrameSize(SampleFormat format) {
+        switch (format) {
+        case SAMPLE_FORMAT_U8:
+            return 2;
+        case SAMPLE_FORMAT_S16:
+            return 4;
+        default:
+            return 8;
+        }
+    }
+
+    void close() {
+        file.close();
+    }
+
+private:
+#pragma pack(push, 1)
+    struct RiffHeader_t {
+        char signature[4];           // "RIFF"
+        uint32_t fileSize;           // data bytes + sizeof(WavHeader_t) - 8
+        char fileType[4];            // "WAVE"
+    };
+
+    struct ChunkHeader_t {
+        char id[4];
+        uint32_t size;
+    };
+
+    struct FormatHeader_t {
+        uint16_t sampleType;         // PCM (1) or float (3)
+        uint16_t channelCount;
+        uint32_t sampleRate;
+        uint32_t bytesPerSecond;
+        uint16_t bytesPerSample;
+        uint16_t bitDepth;
+    };
+#pragma pack(pop)
+
+    bool valid = false;
+    MappedFile file;
+    FormatHeader_t hdr = {};
+    SampleFormat fileFormat = SAMPLE_FORMAT_S16;
+    SampleFormat format = SAMPLE_FORMAT_S16;
+    uint64_t dataOffset = 0;
+    uint64_t dataSize = 0;
+};
@@ -86,6 +86,7 @@ public:
 
         afChain.addBlock(&resamp, true);
         afChain.addBlock(&deemp, false);
+        afChain.setFused(true);
 
         // Initialize the sink
         srChangeHandler.ctx = this;
@@ -0,0 +1,239 @@
+#include <bookmark_store.h>
+#include <utils/flog.h>
+#include <json.hpp>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <math.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+
+using nlohmann::json;
+
+void BookmarkStore::clear() {
+    lists.clear();
+}
+
+void BookmarkStore::setList(const std::string& list, bool show) {
+    lists[list].show = show;
+}
+
+void BookmarkStore::renameList(const std::string& list, const std::string& newName) {
+    auto node = lists.extract(list);
+    if (node.empty()) { return; }
+    node.key() = newName;
+    for (auto& [name, wbm] : node.mapped().bookmarks) { wbm.listName = newName; }
+    lists.insert(std::move(node));
+}
+
+void BookmarkStore::removeList(const std::string& list) {
+    lists.erase(list);
+}
+
+void BookmarkStore::set(const std::string& list, const std::string& name, const FrequencyBookmark& bm) {
+    List& l = lists[list];
+    WaterfallBookmark& wbm = l.bookmarks[name];
+    wbm.listName = list;
+    wbm.bookmarkName = name;
+    wbm.bookmark = bm;
+    wbm.bookmark.selected = false;
+    l.dirty = true;
+}
+
+void BookmarkStore::remove(const std::string& list, const std::string& name) {
+    auto it = lists.find(list);
+    if (it == lists.end()) { return; }
+    if (it->second.bookmarks.erase(name)) { it->second.dirty = true; }
+}
+
+void BookmarkStore::query(double low, double high, std::vector<const WaterfallBookmark*>& out) {
+    for (auto& [name, list] : lists) {
+        if (!list.show) { continue; }
+        if (list.dirty) { rebuild(list); }
+        queryTree(list.nodes, 0, list.nodes.size(), low, high, out);
+    }
+}
+
+int BookmarkStore::maxNameLength() {
+    int len = 0;
+    for (auto& [name, list] : lists) {
+        if (!list.show) { continue; }
+        if (list.dirty) { rebuild(list); }
+        len = std::max<int>(len, list.maxNameLength);
+    }
+    return len;
+}
+
+void BookmarkStore::rebuild(List& list) {
+    list.nodes.clear();
+    list.nodes.reserve(list.bookmarks.size());
+    list.maxNameLength = 0;
+    for (auto& [name, wbm] : list.bookmarks) {
+        double halfBw = std::max<double>(wbm.bookmark.bandwidth, 0.0) / 2.0;
+        list.nodes.push_back({ wbm.bookmark.frequency - halfBw, wbm.bookmark.frequency + halfBw, 0.0, &wbm });
+        list.maxNameLength = std::max<int>(list.maxNameLength, name.size());
+    }
+    std::sort(list.nodes.begin(), list.nodes.end(), [](const Node& a, const Node& b) { return a.low < b.low; });
+    buildTree(list.nodes, 0, list.nodes.size());
+    list.dirty = false;
+}
+
+// The node in the middle of a range is the root of that range, each half being its subtrees
+double BookmarkStore::buildTree(std::vector<Node>& nodes, int begin, int end) {
+    if (begin >= end) { return -INFINITY; }
+    int mid = (begin + end) / 2;
+    double maxHigh = std::max<double>(nodes[mid].high, std::max<double>(buildTree(nodes, begin, mid), buildTree(nodes, mid + 1, end)));
+    nodes[mid].maxHigh = maxHigh;
+    return maxHigh;
+}
+
+void BookmarkStore::queryTree(const std::vector<Node>& nodes, int begin, int end, double low, double high, std::vector<const WaterfallBookmark*>& out) {
+    if (begin >= end) { return; }
+    int mid = (begin + end) / 2;
+    const Node& node = nodes[mid];
+
+    // Nothing in this subtree reaches the range
+    if (node.maxHigh < low) { return; }
+
+    queryTree(nodes, begin, mid, low, high, out);
+
+    // Everything after this node starts past the range
+    if (node.low > high) { return; }
+    if (node.high >= low) { out.push_back(node.bm); }
+
+    queryTree(nodes, mid + 1, end, low, high, out);
+}
+
+static bool equalsNoCase(const std::string& a, const char* b) {
+    size_t len = strlen(b);
+    if (a.size() != len) { return false; }
+    for (size_t i = 0; i < len; i++) {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) { return false; }
+    }
+    return true;
+}
+
+bool BookmarkStore::readFile(const std::string& path, const char* const* modeNames, int modeCount, std::vector<std::pair<std::string, FrequencyBookmark>>& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        flog::error("Could not open bookmark file '{0}'", path);
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    std::string data = ss.str();
+
+    // JSON exports always start with an object, anything else is treated as CSV
+    size_t first = data.find_first_not_of(" \t\r\n");
+    if (first != std::string::npos && data[first] == '{') {
+        return readJSON(data, out);
+    }
+    return readCSV(data, modeNames, modeCount, out);
+}
+
+bool BookmarkStore::readJSON(const std::string& data, std::vector<std::pair<std::string, FrequencyBookmark>>& out) {
+    json bookmarks;
+    try {
+        bookmarks = json::parse(data);
+    }
+    catch (const std::exception& e) {
+        flog::error("Bookmark file is not valid JSON: {0}", e.what());
+        return false;
+    }
+
+    if (!bookmarks.contains("bookmarks")) {
+        flog::error("File does not contains any bookmarks");
+        return false;
+    }
+    if (!bookmarks["bookmarks"].is_object()) {
+        flog::error("Bookmark attribute is invalid");
+        return false;
+    }
+
+    out.reserve(out.size() + bookmarks["bookmarks"].size());
+    for (auto& [name, bm] : bookmarks["bookmarks"].items()) {
+        if (!bm.is_object() || !bm["frequency"].is_number() || !bm["bandwidth"].is_number() || !bm["mode"].is_number_integer()) {
+            flog::warn("Bookmark '{0}' is invalid, skipping", name);
+            continue;
+        }
+        FrequencyBookmark fbm;
+        fbm.frequency = bm["frequency"];
+        fbm.bandwidth = bm["bandwidth"];
+        fbm.mode = bm["mode"];
+        fbm.selected = false;
+        out.push_back({ name, fbm });
+    }
+    return true;
+}
+
+bool BookmarkStore::readCSV(const std::string& data, const char* const* modeNames, int modeCount, std::vector<std::pair<std::string, FrequencyBookmark>>& out) {
+    std::vector<std::string> fields;
+    std::string field;
+    size_t pos = 0;
+    int lineNum = 0;
+    while (pos < data.size()) {
+        // Split the line into fields, quoted fields may contain commas and doubled quotes
+        fields.clear();
+        field.clear();
+        bool quoted = false;
+        lineNum++;
+        for (; pos < data.size(); pos++) {
+            char c = data[pos];
+            if (quoted) {
+                if (c != '"') { field += c; }
+                else if (pos + 1 < data.size() && data[pos + 1] == '"') { field += '"'; pos++; }
+                else { quoted = false; }
+            }
+            else if (c == '"') { quoted = true; }
+            else if (c == ',') { fields.push_back(field); field.clear(); }
+            else if (c == '\n') { pos++; break; }
+            else if (c != '\r') { field += c; }
+        }
+        fields.push_back(field);
+
+        // Skip empty lines and comments
+        if (fields.size() == 1 && fields[0].empty()) { continue; }
+        if (!fields[0].empty() && fields[0][0] == '#') { continue; }
+
+        FrequencyBookmark fbm;
+        fbm.bandwidth = 0;
+        fbm.mode = modeCount - 1;
+        fbm.selected = false;
+
+        // The frequency is required, a first line without one is a header
+        char* end;
+        fbm.frequency = (fields.size() >= 2) ? strtod(fields[1].c_str(), &end) : 0.0;
+        if (fields.size() < 2 || fields[0].empty() || fields[1].empty() || *end) {
+            if (lineNum > 1) { flog::warn("Invalid bookmark on line {0}, skipping", lineNum); }
+            continue;
+        }
+        if (fields.size() >= 3 && !fields[2].empty()) {
+            fbm.bandwidth = strtod(fields[2].c_str(), &end);
+            if (*end) {
+                flog::warn("Invalid bandwidth on line {0}, skipping", lineNum);
+                continue;
+            }
+        }
+        if (fields.size() >= 4 && !fields[3].empty()) {
+            int mode = strtol(fields[3].c_str(), &end, 10);
+            if (*end) {
+                mode = -1;
+                for (int i = 0; i < modeCount; i++) {
+                    if (equalsNoCase(fields[3], modeNames[i])) {
+                        mode = i;
+                        break;
+                    }
+                }
+            }
+            if (mode < 0 || mode >= modeCount) {
+                flog::warn("Invalid mode on line {0}, skipping", lineNum);
+                continue;
+            }
+            fbm.mode = mode;
+        }
+
+        out.push_back({ fields[0], fbm });
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+struct FrequencyBookmark {
+    double frequency;
+    double bandwidth;
+    int mode;
+    bool selected;
+};
+
+struct WaterfallBookmark {
+    std::string listName;
+    std::string bookmarkName;
+    FrequencyBookmark bookmark;
+};
+
+// Bookmarks of every list, indexed by the band they cover so that only the ones in view are visited when drawing.
+// Each list keeps its own index, sorted by lower edge with the highest upper edge of every subtree of an implicit
+// binary tree over it. Edits only mark the list dirty, the index is rebuilt on the next query.
+class BookmarkStore {
+public:
+    void clear();
+
+    // Create a list or change its visibility
+    void setList(const std::string& list, bool show);
+    void renameList(const std::string& list, const std::string& newName);
+    void removeList(const std::string& list);
+
+    // Add or replace a bookmark
+    void set(const std::string& list, const std::string& name, const FrequencyBookmark& bm);
+    void remove(const std::string& list, const std::string& name);
+
+    // Append the bookmarks of the shown lists overlapping [low, high], sorted by lower edge within each list
+    void query(double low, double high, std::vector<const WaterfallBookmark*>& out);
+
+    // Length of the longest name of the shown lists, used to widen the query so that labels are not cut off
+    int maxNameLength();
+
+    // Read bookmarks from a JSON export ({"bookmarks": {name: {...}}}) or a CSV file (name,frequency[,bandwidth[,mode]]).
+    // Modes can be given by index or by name. Returns false if the file could not be read at all.
+    static bool readFile(const std::string& path, const char* const* modeNames, int modeCount, std::vector<std::pair<std::string, FrequencyBookmark>>& out);
+
+private:
+    struct Node {
+        double low;
+        double high;
+        double maxHigh;
+        const WaterfallBookmark* bm;
+    };
+
+    struct List {
+        bool show = true;
+        bool dirty = false;
+        int maxNameLength = 0;
+        std::map<std::string, WaterfallBookmark> bookmarks;
+        std::vector<Node> nodes;
+    };
+
+    static void rebuild(List& list);
+    static double buildTree(std::vector<Node>& nodes, int begin, int end);
+    static void queryTree(const std::vector<Node>& nodes, int begin, int end, double low, double high, std::vector<const WaterfallBookmark*>& out);
+    static bool readJSON(const std::string& data, std::vector<std::pair<std::string, FrequencyBookmark>>& out);
+    static bool readCSV(const std::string& data, const char* const* modeNames, int modeCount, std::vector<std::pair<std::string, FrequencyBookmark>>& out);
+
+    std::map<std::string, List> lists;
+};
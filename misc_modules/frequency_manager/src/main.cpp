@@ -13,6 +13,7 @@
 #include <utils/freq_formatting.h>
 #include <gui/dialogs/dialog_box.h>
 #include <fstream>
+#include <bookmark_store.h>
 
 SDRPP_MOD_INFO{
     /* Name:            */ "frequency_manager",
@@ -22,19 +23,6 @@ SDRPP_MOD_INFO{
     /* Max instances    */ 1
 };
 
-struct FrequencyBookmark {
-    double frequency;
-    double bandwidth;
-    int mode;
-    bool selected;
-};
-
-struct WaterfallBookmark {
-    std::string listName;
-    std::string bookmarkName;
-    FrequencyBookmark bookmark;
-};
-
 ConfigManager config;
 
 const char* demodModeList[] = {
@@ -48,6 +36,8 @@ const char* demodModeList[] = {
     "RAW"
 };
 
+const int demodModeCount = sizeof(demodModeList) / sizeof(demodModeList[0]);
+
 const char* demodModeListTxt = "NFM\0WFM\0AM\0DSB\0USB\0CW\0LSB\0RAW\0";
 
 enum {
@@ -71,7 +61,7 @@ public:
 
         refreshLists();
         loadByName(selList);
-        refreshWaterfallBookmarks();
+        loadWaterfallBookmarks();
 
         fftRedrawHandler.ctx = this;
         fftRedrawHandler.handler = fftRedraw;
@@ -175,12 +165,14 @@ private:
                 open = false;
 
                 // If editing, delete the original one
-                if (editOpen) {
+                std::vector<std::string> changed = { editedBookmarkName };
+                if (editOpen && firstEditedBookmarkName != editedBookmarkName) {
                     bookmarks.erase(firstEditedBookmarkName);
+                    changed.push_back(firstEditedBookmarkName);
                 }
                 bookmarks[editedBookmarkName] = editedBookmark;
 
-                saveByName(selectedListName);
+                saveBookmarks(changed);
             }
             if (applyDisabled) { style::endDisabled(); }
             ImGui::SameLine();
@@ -221,12 +213,13 @@ private:
                 if (renameListOpen) {
                     config.conf["lists"][editedListName] = config.conf["lists"][firstEditedListName];
                     config.conf["lists"].erase(firstEditedListName);
+                    waterfallBookmarks.renameList(firstEditedListName, editedListName);
                 }
                 else {
                     config.conf["lists"][editedListName]["showOnWaterfall"] = true;
                     config.conf["lists"][editedListName]["bookmarks"] = json::object();
+                    waterfallBookmarks.setList(editedListName, true);
                 }
-                refreshWaterfallBookmarks(false);
                 config.release(true);
                 refreshLists();
                 loadByName(editedListName);
@@ -258,8 +251,8 @@ private:
                 if (ImGui::Checkbox((listName + "##freq_manager_sel_list_").c_str(), &shown)) {
                     config.acquire();
                     config.conf["lists"][listName]["showOnWaterfall"] = shown;
-                    refreshWaterfallBookmarks(false);
                     config.release(true);
+                    waterfallBookmarks.setList(listName, shown);
                 }
             }
 
@@ -284,23 +277,42 @@ private:
         config.release();
     }
 
-    void refreshWaterfallBookmarks(bool lockConfig = true) {
-        if (lockConfig) { config.acquire(); }
+    // Only done once, edits are then applied to the store directly
+    void loadWaterfallBookmarks() {
+        config.acquire();
         waterfallBookmarks.clear();
-        for (auto [listName, list] : config.conf["lists"].items()) {
-            if (!((bool)list["showOnWaterfall"])) { continue; }
-            WaterfallBookmark wbm;
-            wbm.listName = listName;
-            for (auto [bookmarkName, bm] : config.conf["lists"][listName]["bookmarks"].items()) {
-                wbm.bookmarkName = bookmarkName;
-                wbm.bookmark.frequency = config.conf["lists"][listName]["bookmarks"][bookmarkName]["frequency"];
-                wbm.bookmark.bandwidth = config.conf["lists"][listName]["bookmarks"][bookmarkName]["bandwidth"];
-                wbm.bookmark.mode = config.conf["lists"][listName]["bookmarks"][bookmarkName]["mode"];
-                wbm.bookmark.selected = false;
-                waterfallBookmarks.push_back(wbm);
+        for (auto& [listName, list] : config.conf["lists"].items()) {
+            waterfallBookmarks.setList(listName, list["showOnWaterfall"]);
+            for (auto& [bookmarkName, bm] : list["bookmarks"].items()) {
+                FrequencyBookmark fbm;
+                fbm.frequency = bm["frequency"];
+                fbm.bandwidth = bm["bandwidth"];
+                fbm.mode = bm["mode"];
+                fbm.selected = false;
+                waterfallBookmarks.set(listName, bookmarkName, fbm);
             }
         }
-        if (lockConfig) { config.release(); }
+        config.release();
+    }
+
+    // Bookmarks in view, with at most one per pixel column so that zooming out on a large list stays fast
+    void getVisibleBookmarks(double lowFreq, double highFreq, double freqToPixelRatio, float minX, float maxX) {
+        visibleBookmarks.clear();
+        int columns = std::max<int>(maxX - minX, 0) + 1;
+        usedColumns.assign(columns, false);
+
+        // Widen the range by half of the longest label so that labels of bookmarks just outside are still drawn
+        double margin = ((waterfallBookmarks.maxNameLength() * ImGui::CalcTextSize("W").x / 2.0) + 5.0) / freqToPixelRatio;
+        queryResults.clear();
+        waterfallBookmarks.query(lowFreq - margin, highFreq + margin, queryResults);
+        for (auto bm : queryResults) {
+            int col = std::clamp<int>(std::round((bm->bookmark.frequency - lowFreq) * freqToPixelRatio), -1, columns);
+            if (col >= 0 && col < columns) {
+                if (usedColumns[col]) { continue; }
+                usedColumns[col] = true;
+            }
+            visibleBookmarks.push_back(bm);
+        }
     }
 
     void loadFirst() {
@@ -323,7 +335,7 @@ private:
         selectedListId = std::distance(listNames.begin(), std::find(listNames.begin(), listNames.end(), listName));
         selectedListName = listName;
         config.acquire();
-        for (auto [bmName, bm] : config.conf["lists"][listName]["bookmarks"].items()) {
+        for (auto& [bmName, bm] : config.conf["lists"][listName]["bookmarks"].items()) {
             FrequencyBookmark fbm;
             fbm.frequency = bm["frequency"];
             fbm.bandwidth = bm["bandwidth"];
@@ -332,29 +344,46 @@ private:
             bookmarks[bmName] = fbm;
         }
         config.release();
+        refreshRows();
     }
 
-    void saveByName(std::string listName) {
+    // Write the given bookmarks of the selected list to the config and the waterfall, the ones no longer in the list are removed
+    void saveBookmarks(const std::vector<std::string>& names) {
         config.acquire();
-        config.conf["lists"][listName]["bookmarks"] = json::object();
-        for (auto [bmName, bm] : bookmarks) {
-            config.conf["lists"][listName]["bookmarks"][bmName]["frequency"] = bm.frequency;
-            config.conf["lists"][listName]["bookmarks"][bmName]["bandwidth"] = bm.bandwidth;
-            config.conf["lists"][listName]["bookmarks"][bmName]["mode"] = bm.mode;
+        json& list = config.conf["lists"][selectedListName]["bookmarks"];
+        for (auto& bmName : names) {
+            auto it = bookmarks.find(bmName);
+            if (it == bookmarks.end()) {
+                list.erase(bmName);
+                waterfallBookmarks.remove(selectedListName, bmName);
+                continue;
+            }
+            json& bm = list[bmName];
+            bm["frequency"] = it->second.frequency;
+            bm["bandwidth"] = it->second.bandwidth;
+            bm["mode"] = it->second.mode;
+            waterfallBookmarks.set(selectedListName, bmName, it->second);
         }
-        refreshWaterfallBookmarks(false);
         config.release(true);
+        refreshRows();
+    }
+
+    void refreshRows() {
+        bookmarkRows.clear();
+        selectedNames.clear();
+        bookmarkRows.reserve(bookmarks.size());
+        for (auto it = bookmarks.begin(); it != bookmarks.end(); it++) {
+            bookmarkRows.push_back(it);
+            if (it->second.selected) { selectedNames.push_back(it->first); }
+        }
     }
 
     static void menuHandler(void* ctx) {
         FrequencyManagerModule* _this = (FrequencyManagerModule*)ctx;
         float menuWidth = ImGui::GetContentRegionAvail().x;
 
-        // TODO: Replace with something that won't iterate every frame
-        std::vector<std::string> selectedNames;
-        for (auto& [name, bm] : _this->bookmarks) {
-            if (bm.selected) { selectedNames.push_back(name); }
-        }
+        // Copied since the selection can change while drawing
+        std::vector<std::string> selectedNames = _this->selectedNames;
 
         float lineHeight = ImGui::GetTextLineHeightWithSpacing();
 
@@ -403,8 +432,8 @@ private:
             }) == GENERIC_DIALOG_BUTTON_YES) {
             config.acquire();
             config.conf["lists"].erase(_this->selectedListName);
-            _this->refreshWaterfallBookmarks(false);
             config.release(true);
+            _this->waterfallBookmarks.removeList(_this->selectedListName);
             _this->refreshLists();
             _this->selectedListId = std::clamp<int>(_this->selectedListId, 0, _this->listNames.size());
             if (_this->listNames.size() > 0) {
@@ -481,7 +510,7 @@ private:
                 ImGui::TextUnformatted("Deleting selected bookmaks. Are you sure?");
             }) == GENERIC_DIALOG_BUTTON_YES) {
             for (auto& _name : selectedNames) { _this->bookmarks.erase(_name); }
-            _this->saveByName(_this->selectedListName);
+            _this->saveBookmarks(selectedNames);
         }
 
         // Bookmark list
@@ -490,27 +519,34 @@ private:
             ImGui::TableSetupColumn("Bookmark");
             ImGui::TableSetupScrollFreeze(2, 1);
             ImGui::TableHeadersRow();
-            for (auto& [name, bm] : _this->bookmarks) {
-                ImGui::TableNextRow();
-                ImGui::TableSetColumnIndex(0);
-                ImVec2 min = ImGui::GetCursorPos();
-
-                if (ImGui::Selectable((name + "##_freq_mgr_bkm_name_" + _this->name).c_str(), &bm.selected, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_SelectOnClick)) {
-                    // if shift or control isn't pressed, deselect all others
-                    if (!ImGui::GetIO().KeyShift && !ImGui::GetIO().KeyCtrl) {
-                        for (auto& [_name, _bm] : _this->bookmarks) {
-                            if (name == _name) { continue; }
-                            _bm.selected = false;
+            // Only the rows in view are drawn
+            ImGuiListClipper clipper;
+            clipper.Begin(_this->bookmarkRows.size());
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                    auto& [name, bm] = *_this->bookmarkRows[i];
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImVec2 min = ImGui::GetCursorPos();
+
+                    if (ImGui::Selectable((name + "##_freq_mgr_bkm_name_" + _this->name).c_str(), &bm.selected, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_SelectOnClick)) {
+                        // if shift or control isn't pressed, deselect all others
+                        if (!ImGui::GetIO().KeyShift && !ImGui::GetIO().KeyCtrl) {
+                            for (auto& _name : _this->selectedNames) {
+                                if (name == _name) { continue; }
+                                _this->bookmarks[_name].selected = false;
+                            }
                         }
+                        _this->refreshRows();
+                    }
+                    if (ImGui::TableGetHoveredColumn() >= 0 && ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+                        applyBookmark(bm, gui::waterfall.selectedVFO);
                     }
-                }
-                if (ImGui::TableGetHoveredColumn() >= 0 && ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
-                    applyBookmark(bm, gui::waterfall.selectedVFO);
-                }
 
-                ImGui::TableSetColumnIndex(1);
-                ImGui::Text("%s %s", utils::formatFreq(bm.frequency).c_str(), demodModeList[bm.mode]);
-                ImVec2 max = ImGui::GetCursorPos();
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%s %s", utils::formatFreq(bm.frequency).c_str(), demodModeList[bm.mode]);
+                    ImVec2 max = ImGui::GetCursorPos();
+                }
             }
             ImGui::EndTable();
         }
@@ -521,6 +557,7 @@ private:
             FrequencyBookmark& bm = _this->bookmarks[selectedNames[0]];
             applyBookmark(bm, gui::waterfall.selectedVFO);
             bm.selected = false;
+            _this->refreshRows();
         }
         if (selectedNames.size() != 1 && _this->selectedListName != "") { style::endDisabled(); }
 
@@ -531,7 +568,7 @@ private:
         ImGui::TableSetColumnIndex(0);
         if (ImGui::Button(("Import##_freq_mgr_imp_" + _this->name).c_str(), ImVec2(ImGui::GetContentRegionAvail().x, 0)) && !_this->importOpen) {
             _this->importOpen = true;
-            _this->importDialog = new pfd::open_file("Import bookmarks", "", { "JSON Files (*.json)", "*.json", "All Files", "*" }, pfd::opt::multiselect);
+            _this->importDialog = new pfd::open_file("Import bookmarks", "", { "Bookmark Files (*.json *.csv)", "*.json *.csv", "JSON Files (*.json)", "*.json", "CSV Files (*.csv)", "*.csv", "All Files", "*" }, pfd::opt::multiselect);
         }
 
         ImGui::TableSetColumnIndex(1);
@@ -605,16 +642,17 @@ private:
     static void fftRedraw(ImGui::WaterFall::FFTRedrawArgs args, void* ctx) {
         FrequencyManagerModule* _this = (FrequencyManagerModule*)ctx;
         if (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_OFF) { return; }
+        _this->getVisibleBookmarks(args.lowFreq, args.highFreq, args.freqToPixelRatio, args.min.x, args.max.x);
 
         if (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_TOP) {
-            for (auto const bm : _this->waterfallBookmarks) {
-                double centerXpos = args.min.x + std::round((bm.bookmark.frequency - args.lowFreq) * args.freqToPixelRatio);
+            for (auto bm : _this->visibleBookmarks) {
+                double centerXpos = args.min.x + std::round((bm->bookmark.frequency - args.lowFreq) * args.freqToPixelRatio);
 
-                if (bm.bookmark.frequency >= args.lowFreq && bm.bookmark.frequency <= args.highFreq) {
+                if (bm->bookmark.frequency >= args.lowFreq && bm->bookmark.frequency <= args.highFreq) {
                     args.window->DrawList->AddLine(ImVec2(centerXpos, args.min.y), ImVec2(centerXpos, args.max.y), IM_COL32(255, 255, 0, 255));
                 }
 
-                ImVec2 nameSize = ImGui::CalcTextSize(bm.bookmarkName.c_str());
+                ImVec2 nameSize = ImGui::CalcTextSize(bm->bookmarkName.c_str());
                 ImVec2 rectMin = ImVec2(centerXpos - (nameSize.x / 2) - 5, args.min.y);
                 ImVec2 rectMax = ImVec2(centerXpos + (nameSize.x / 2) + 5, args.min.y + nameSize.y);
                 ImVec2 clampedRectMin = ImVec2(std::clamp<double>(rectMin.x, args.min.x, args.max.x), rectMin.y);
@@ -624,19 +662,19 @@ private:
                     args.window->DrawList->AddRectFilled(clampedRectMin, clampedRectMax, IM_COL32(255, 255, 0, 255));
                 }
                 if (rectMin.x >= args.min.x && rectMax.x <= args.max.x) {
-                    args.window->DrawList->AddText(ImVec2(centerXpos - (nameSize.x / 2), args.min.y), IM_COL32(0, 0, 0, 255), bm.bookmarkName.c_str());
+                    args.window->DrawList->AddText(ImVec2(centerXpos - (nameSize.x / 2), args.min.y), IM_COL32(0, 0, 0, 255), bm->bookmarkName.c_str());
                 }
             }
         }
         else if (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_BOTTOM) {
-            for (auto const bm : _this->waterfallBookmarks) {
-                double centerXpos = args.min.x + std::round((bm.bookmark.frequency - args.lowFreq) * args.freqToPixelRatio);
+            for (auto bm : _this->visibleBookmarks) {
+                double centerXpos = args.min.x + std::round((bm->bookmark.frequency - args.lowFreq) * args.freqToPixelRatio);
 
-                if (bm.bookmark.frequency >= args.lowFreq && bm.bookmark.frequency <= args.highFreq) {
+                if (bm->bookmark.frequency >= args.lowFreq && bm->bookmark.frequency <= args.highFreq) {
                     args.window->DrawList->AddLine(ImVec2(centerXpos, args.min.y), ImVec2(centerXpos, args.max.y), IM_COL32(255, 255, 0, 255));
                 }
 
-                ImVec2 nameSize = ImGui::CalcTextSize(bm.bookmarkName.c_str());
+                ImVec2 nameSize = ImGui::CalcTextSize(bm->bookmarkName.c_str());
                 ImVec2 rectMin = ImVec2(centerXpos - (nameSize.x / 2) - 5, args.max.y - nameSize.y);
                 ImVec2 rectMax = ImVec2(centerXpos + (nameSize.x / 2) + 5, args.max.y);
                 ImVec2 clampedRectMin = ImVec2(std::clamp<double>(rectMin.x, args.min.x, args.max.x), rectMin.y);
@@ -646,7 +684,7 @@ private:
                     args.window->DrawList->AddRectFilled(clampedRectMin, clampedRectMax, IM_COL32(255, 255, 0, 255));
                 }
                 if (rectMin.x >= args.min.x && rectMax.x <= args.max.x) {
-                    args.window->DrawList->AddText(ImVec2(centerXpos - (nameSize.x / 2), args.max.y - nameSize.y), IM_COL32(0, 0, 0, 255), bm.bookmarkName.c_str());
+                    args.window->DrawList->AddText(ImVec2(centerXpos - (nameSize.x / 2), args.max.y - nameSize.y), IM_COL32(0, 0, 0, 255), bm->bookmarkName.c_str());
                 }
             }
         }
@@ -670,11 +708,12 @@ private:
         bool inALabel = false;
         WaterfallBookmark hoveredBookmark;
         std::string hoveredBookmarkName;
+        _this->getVisibleBookmarks(args.lowFreq, args.highFreq, args.freqToPixelRatio, args.fftRectMin.x, args.fftRectMax.x);
 
         if (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_TOP) {
-            int count = _this->waterfallBookmarks.size();
+            int count = _this->visibleBookmarks.size();
             for (int i = count - 1; i >= 0; i--) {
-                auto& bm = _this->waterfallBookmarks[i];
+                auto& bm = *_this->visibleBookmarks[i];
                 double centerXpos = args.fftRectMin.x + std::round((bm.bookmark.frequency - args.lowFreq) * args.freqToPixelRatio);
                 ImVec2 nameSize = ImGui::CalcTextSize(bm.bookmarkName.c_str());
                 ImVec2 rectMin = ImVec2(centerXpos - (nameSize.x / 2) - 5, args.fftRectMin.y);
@@ -691,9 +730,9 @@ private:
             }
         }
         else if (_this->bookmarkDisplayMode == BOOKMARK_DISP_MODE_BOTTOM) {
-            int count = _this->waterfallBookmarks.size();
+            int count = _this->visibleBookmarks.size();
             for (int i = count - 1; i >= 0; i--) {
-                auto& bm = _this->waterfallBookmarks[i];
+                auto& bm = *_this->visibleBookmarks[i];
                 double centerXpos = args.fftRectMin.x + std::round((bm.bookmark.frequency - args.lowFreq) * args.freqToPixelRatio);
                 ImVec2 nameSize = ImGui::CalcTextSize(bm.bookmarkName.c_str());
                 ImVec2 rectMin = ImVec2(centerXpos - (nameSize.x / 2) - 5, args.fftRectMax.y - nameSize.y);
@@ -753,36 +792,25 @@ private:
     pfd::save_file* exportDialog;
 
     void importBookmarks(std::string path) {
-        std::ifstream fs(path);
-        json importBookmarks;
-        fs >> importBookmarks;
-
-        if (!importBookmarks.contains("bookmarks")) {
-            flog::error("File does not contains any bookmarks");
-            return;
-        }
-
-        if (!importBookmarks["bookmarks"].is_object()) {
-            flog::error("Bookmark attribute is invalid");
-            return;
-        }
+        std::vector<std::pair<std::string, FrequencyBookmark>> imported;
+        if (!BookmarkStore::readFile(path, demodModeList, demodModeCount, imported)) { return; }
 
         // Load every bookmark
-        for (auto const [_name, bm] : importBookmarks["bookmarks"].items()) {
-            if (bookmarks.find(_name) != bookmarks.end()) {
-                flog::warn("Bookmark with the name '{0}' already exists in list, skipping", _name);
+        std::vector<std::string> added;
+        added.reserve(imported.size());
+        int skipped = 0;
+        for (auto& [_name, fbm] : imported) {
+            if (!bookmarks.emplace(_name, fbm).second) {
+                skipped++;
                 continue;
             }
-            FrequencyBookmark fbm;
-            fbm.frequency = bm["frequency"];
-            fbm.bandwidth = bm["bandwidth"];
-            fbm.mode = bm["mode"];
-            fbm.selected = false;
-            bookmarks[_name] = fbm;
+            added.push_back(_name);
         }
-        saveByName(selectedListName);
-
-        fs.close();
+        if (skipped) {
+            flog::warn("Skipped {0} bookmarks whose name already exists in the list", skipped);
+        }
+        saveBookmarks(added);
+        flog::info("Imported {0} bookmarks", (int)added.size());
     }
 
     void exportBookmarks(std::string path) {
@@ -806,6 +834,8 @@ private:
     EventHandler<ImGui::WaterFall::InputHandlerArgs> inputHandler;
 
     std::map<std::string, FrequencyBookmark> bookmarks;
+    std::vector<std::map<std::string, FrequencyBookmark>::iterator> bookmarkRows;
+    std::vector<std::string> selectedNames;
 
     std::string editedBookmarkName = "";
     std::string firstEditedBookmarkName = "";
@@ -819,7 +849,10 @@ private:
     std::string editedListName;
     std::string firstEditedListName;
 
-    std::vector<WaterfallBookmark> waterfallBookmarks;
+    BookmarkStore waterfallBookmarks;
+    std::vector<const WaterfallBookmark*> queryResults;
+    std::vector<const WaterfallBookmark*> visibleBookmarks;
+    std::vector<bool> usedColumns;
 
     int bookmarkDisplayMode = 0;
 };
@@ -832,6 +865,7 @@ MOD_EXPORT void _INIT_() {
     def["lists"]["General"]["bookmarks"] = json::object();
 
     config.setPath(core::args["root"].s() + "/frequency_manager_config.json");
+    config.setSeparate("lists", ConfigManager::FORMAT_COMPACT);
     config.load(def);
     config.enableAutoSave();
 
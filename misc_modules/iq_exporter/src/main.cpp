@@ -9,6 +9,7 @@
 #include <volk/volk.h>
 #include <signal_path/signal_path.h>
 #include <dsp/buffer/reshaper.h>
+#include <dsp/compression/sample_stream_compressor.h>
 #include <gui/dialogs/dialog_box.h>
 #include <core.h>
 
@@ -38,9 +39,28 @@ enum SampleType {
     SAMPLE_TYPE_INT8,
     SAMPLE_TYPE_INT16,
     SAMPLE_TYPE_INT32,
-    SAMPLE_TYPE_FLOAT32
+    SAMPLE_TYPE_FLOAT32,
+
+    // Coded types, sent as frames in the sample format of the SDR++ server, each prefixed by its size as a uint32
+    SAMPLE_TYPE_BFP8,
+    SAMPLE_TYPE_BFP10,
+    SAMPLE_TYPE_BFP12,
+    SAMPLE_TYPE_RICE16,
+    SAMPLE_TYPE_RICE12
 };
 
+const dsp::compression::PCMType CODED_PCM_TYPES[] {
+    dsp::compression::PCM_TYPE_BFP8,
+    dsp::compression::PCM_TYPE_BFP10,
+    dsp::compression::PCM_TYPE_BFP12,
+    dsp::compression::PCM_TYPE_RICE16,
+    dsp::compression::PCM_TYPE_RICE12
+};
+
+bool isCodedSampleType(SampleType type) {
+    return type >= SAMPLE_TYPE_BFP8;
+}
+
 class IQExporterModule : public ModuleManager::Instance {
 public:
     IQExporterModule(std::string name) {
@@ -74,6 +94,11 @@ public:
         sampleTypes.define("Int16", SAMPLE_TYPE_INT16);
         sampleTypes.define("Int32", SAMPLE_TYPE_INT32);
         sampleTypes.define("Float32", SAMPLE_TYPE_FLOAT32);
+        sampleTypes.define("BFP 8bit", SAMPLE_TYPE_BFP8);
+        sampleTypes.define("BFP 10bit", SAMPLE_TYPE_BFP10);
+        sampleTypes.define("BFP 12bit", SAMPLE_TYPE_BFP12);
+        sampleTypes.define("Rice 16bit", SAMPLE_TYPE_RICE16);
+        sampleTypes.define("Rice 12bit", SAMPLE_TYPE_RICE12);
 
         // Define packet sizes
         for (int i = 8; i <= 32768; i <<= 1) {
@@ -480,7 +505,8 @@ private:
         case SAMPLE_TYPE_FLOAT32:
             return sizeof(dsp::complex_t);
         default:
-            return -1;
+            // The packet size of the coded types is counted in Int16 samples, the frames end up smaller
+            return isCodedSampleType(sampType) ? sizeof(int16_t)*2 : -1;
         }
     }
 
@@ -497,6 +523,16 @@ private:
             return;
         }
         
+        // Coded types are sent as frames prefixed by their size
+        if (isCodedSampleType(_this->sampType)) {
+            dsp::compression::PCMType pcmType = CODED_PCM_TYPES[_this->sampType - SAMPLE_TYPE_BFP8];
+            uint32_t frameSize = dsp::compression::SampleStreamCompressor::process(count, pcmType, data, &_this->buffer[sizeof(uint32_t)]);
+            *(uint32_t*)_this->buffer = frameSize;
+            _this->sock->send(_this->buffer, sizeof(uint32_t) + frameSize);
+            _this->sockMtx.unlock();
+            return;
+        }
+
         // Convert the samples or send directory for float32
         int size;
         switch (_this->sampType) {
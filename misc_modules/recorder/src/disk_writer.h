@@ -0,0 +1,229 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <dsp/buffer/buffer.h>
+
+// Frames in each block of the pool
+#define DISK_WRITER_BLOCK_FRAMES    65536
+
+// Hands samples over to an I/O thread through a pool of blocks allocated when starting, so that a slow disk
+// never stalls the thread producing them. If every block is still waiting to be written, the samples are dropped
+// and counted instead. Blocks are filled until full, or handed over right away if the I/O thread is idle.
+class DiskWriter {
+public:
+    // Given by the producer with the samples, since the I/O thread only gets to them later. A block never mixes
+    // frequencies or samplerates.
+    struct BlockInfo {
+        double time;        // When the first frame was received, in seconds since epoch
+        double frequency;
+        double samplerate;
+    };
+
+    struct Stats {
+        int queued;
+        int capacity;
+        int highWater;
+        uint64_t droppedWrites;     // Calls to write() that lost samples, not pool blocks
+        uint64_t droppedFrames;
+    };
+
+    ~DiskWriter() { stop(); }
+
+    // The handler is called from the I/O thread with the frames to write to disk
+    void start(int channels, size_t poolSize, void (*handler)(float* data, int count, const BlockInfo& info, void* ctx), void* ctx) {
+        std::lock_guard<std::mutex> lck(ctrlMtx);
+        if (running) { return; }
+        _channels = channels;
+        _handler = handler;
+        _ctx = ctx;
+
+        // Allocate the whole pool now
+        int blockCount = std::max<int>(poolSize / (DISK_WRITER_BLOCK_FRAMES * channels * sizeof(float)), 2);
+        capacity = blockCount;
+        blocks.resize(blockCount);
+        sizes.resize(blockCount);
+        infos.resize(blockCount);
+        for (auto& block : blocks) { block = dsp::buffer::alloc<float>(DISK_WRITER_BLOCK_FRAMES * channels); }
+
+        head = 0;
+        queued = 0;
+        highWater = 0;
+        droppedWrites = 0;
+        droppedFrames = 0;
+        backlog.clear();
+        fillBlock = -1;
+        fillFrames = 0;
+        stopFlag = false;
+        running = true;
+        workerThread = std::thread(&DiskWriter::worker, this);
+    }
+
+    // Writes whatever is left, backlog included. The producer must no longer be calling write().
+    void stop() {
+        std::lock_guard<std::mutex> lck(ctrlMtx);
+        if (!running) { return; }
+        if (fillBlock >= 0) { publish(); }
+        {
+            std::lock_guard<std::mutex> lck2(mtx);
+            stopFlag = true;
+        }
+        cnd.notify_all();
+        if (workerThread.joinable()) { workerThread.join(); }
+        for (auto& block : blocks) { dsp::buffer::free(block); }
+        blocks.clear();
+        sizes.clear();
+        infos.clear();
+        running = false;
+    }
+
+    // Only called from a single thread at a time
+    void write(const float* data, int count, const BlockInfo& info) {
+        if (fillBlock >= 0 && (infos[fillBlock].frequency != info.frequency || infos[fillBlock].samplerate != info.samplerate)) {
+            publish();
+        }
+
+        int done = 0;
+        while (done < count) {
+            // Take the next free block
+            if (fillBlock < 0) {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (queued == (int)blocks.size()) {
+                    droppedWrites++;
+                    droppedFrames += count - done;
+                    return;
+                }
+                fillBlock = (head + queued) % blocks.size();
+                fillFrames = 0;
+                infos[fillBlock] = info;
+                infos[fillBlock].time = info.time + (double)done / info.samplerate;
+            }
+
+            int n = std::min<int>(count - done, DISK_WRITER_BLOCK_FRAMES - fillFrames);
+            memcpy(&blocks[fillBlock][fillFrames * _channels], &data[done * _channels], n * _channels * sizeof(float));
+            fillFrames += n;
+            done += n;
+            if (fillFrames == DISK_WRITER_BLOCK_FRAMES) { publish(); }
+        }
+
+        // Don't keep the I/O thread waiting for a full block
+        if (fillBlock >= 0 && idle()) { publish(); }
+    }
+
+    // Frames to write before anything given to write(), in the order given. They aren't copied, so they must stay
+    // untouched until stop(). Only called from the producer thread, before its first write().
+    void writeBacklog(const float* data, int count, const BlockInfo& info) {
+        if (count <= 0) { return; }
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            backlog.push_back({ data, count, info });
+        }
+        cnd.notify_one();
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> lck(mtx);
+        Stats stats;
+        stats.queued = queued;
+        stats.capacity = capacity;
+        stats.highWater = highWater;
+        stats.droppedWrites = droppedWrites;
+        stats.droppedFrames = droppedFrames;
+        return stats;
+    }
+
+    bool isRunning() { return running; }
+
+private:
+    bool idle() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return !queued;
+    }
+
+    void publish() {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            sizes[fillBlock] = fillFrames;
+            queued++;
+            highWater = std::max<int>(highWater, queued);
+        }
+        fillBlock = -1;
+        cnd.notify_one();
+    }
+
+    void worker() {
+        while (true) {
+            // Wait for a block
+            int id, count;
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                cnd.wait(lck, [this]() { return queued || !backlog.empty() || stopFlag; });
+                if (!backlog.empty()) {
+                    Span span = backlog.front();
+                    backlog.erase(backlog.begin());
+                    lck.unlock();
+                    writeSpan(span);
+                    continue;
+                }
+                if (!queued) { return; }
+                id = head;
+                count = sizes[head];
+            }
+
+            // The block stays out of the pool until written
+            _handler(blocks[id], count, infos[id], _ctx);
+
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                head = (head + 1) % blocks.size();
+                queued--;
+            }
+        }
+    }
+
+    struct Span {
+        const float* data;
+        int count;
+        BlockInfo info;
+    };
+
+    void writeSpan(const Span& span) {
+        // The handler gets the same block sizes as for the pool
+        BlockInfo info = span.info;
+        for (int i = 0; i < span.count; i += DISK_WRITER_BLOCK_FRAMES) {
+            info.time = span.info.time + (double)i / info.samplerate;
+            _handler((float*)&span.data[i * _channels], std::min<int>(span.count - i, DISK_WRITER_BLOCK_FRAMES), info, _ctx);
+        }
+    }
+
+    int _channels;
+    void (*_handler)(float* data, int count, const BlockInfo& info, void* ctx);
+    void* _ctx;
+
+    std::vector<float*> blocks;
+    std::vector<int> sizes;
+    std::vector<BlockInfo> infos;
+    int capacity = 0;
+
+    // Written blocks go from head to head + queued, the producer fills the one after
+    std::mutex mtx;
+    std::condition_variable cnd;
+    int head = 0;
+    int queued = 0;
+    int highWater = 0;
+    uint64_t droppedWrites = 0;
+    uint64_t droppedFrames = 0;
+    bool stopFlag = false;
+    std::vector<Span> backlog;
+
+    // Producer side
+    int fillBlock = -1;
+    int fillFrames = 0;
+
+    std::mutex ctrlMtx;
+    std::thread workerThread;
+    bool running = false;
+};
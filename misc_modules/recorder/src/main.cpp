@@ -8,6 +8,8 @@
 #include <dsp/audio/volume.h>
 #include <dsp/convert/stereo_to_mono.h>
 #include <thread>
+#include <atomic>
+#include <chrono>
 #include <ctime>
 #include <gui/gui.h>
 #include <filesystem>
@@ -21,12 +23,28 @@
 #include <core.h>
 #include <utils/optionlist.h>
 #include <utils/wav.h>
+#include <utils/sigmf.h>
 #include <radio_interface.h>
+#include <disk_writer.h>
+#include <pre_record_buffer.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
 #define SILENCE_LVL 10e-6
 
+// Memory for samples waiting to be written to disk, about 1.6s of baseband at 20MS/s
+#define BASEBAND_POOL_SIZE  (256 * 1024 * 1024)
+#define AUDIO_POOL_SIZE     (16 * 1024 * 1024)
+
+// Longest time kept from before a recording starts, which is cut short at high samplerates by the memory it may take
+#define PRE_RECORD_MAX_TIME 30
+#define PRE_RECORD_MAX_SIZE (1024 * 1024 * 1024)
+
+enum Container {
+    CONTAINER_WAV,
+    CONTAINER_SIGMF
+};
+
 SDRPP_MOD_INFO{
     /* Name:            */ "recorder",
     /* Description:     */ "Recorder module for SDR++",
@@ -45,16 +63,21 @@ public:
         strcpy(nameTemplate, "$t_$f_$h-$m-$s_$d-$M-$y");
 
         // Define option lists
-        containers.define("WAV", wav::FORMAT_WAV);
+        containers.define("WAV", CONTAINER_WAV);
         // containers.define("RF64", wav::FORMAT_RF64); // Disabled for now
+        containers.define("SigMF", CONTAINER_SIGMF);
         sampleTypes.define(wav::SAMP_TYPE_UINT8, "Uint8", wav::SAMP_TYPE_UINT8);
         sampleTypes.define(wav::SAMP_TYPE_INT16, "Int16", wav::SAMP_TYPE_INT16);
         sampleTypes.define(wav::SAMP_TYPE_INT32, "Int32", wav::SAMP_TYPE_INT32);
         sampleTypes.define(wav::SAMP_TYPE_FLOAT32, "Float32", wav::SAMP_TYPE_FLOAT32);
+        sigmfSampleTypes.define(sigmf::SAMP_TYPE_INT8, "Int8", sigmf::SAMP_TYPE_INT8);
+        sigmfSampleTypes.define(sigmf::SAMP_TYPE_INT16, "Int16", sigmf::SAMP_TYPE_INT16);
+        sigmfSampleTypes.define(sigmf::SAMP_TYPE_FLOAT32, "Float32", sigmf::SAMP_TYPE_FLOAT32);
 
         // Load default config for option lists
-        containerId = containers.valueId(wav::FORMAT_WAV);
+        containerId = containers.valueId(CONTAINER_WAV);
         sampleTypeId = sampleTypes.valueId(wav::SAMP_TYPE_INT16);
+        sigmfSampleTypeId = sigmfSampleTypes.valueId(sigmf::SAMP_TYPE_INT16);
 
         // Load config
         config.acquire();
@@ -70,6 +93,9 @@ public:
         if (config.conf[name].contains("sampleType") && sampleTypes.keyExists(config.conf[name]["sampleType"])) {
             sampleTypeId = sampleTypes.keyId(config.conf[name]["sampleType"]);
         }
+        if (config.conf[name].contains("sigmfSampleType") && sigmfSampleTypes.keyExists(config.conf[name]["sigmfSampleType"])) {
+            sigmfSampleTypeId = sigmfSampleTypes.keyId(config.conf[name]["sigmfSampleType"]);
+        }
         if (config.conf[name].contains("audioStream")) {
             selectedStreamName = config.conf[name]["audioStream"];
         }
@@ -82,6 +108,9 @@ public:
         if (config.conf[name].contains("ignoreSilence")) {
             ignoreSilence = config.conf[name]["ignoreSilence"];
         }
+        if (config.conf[name].contains("preRecordTime")) {
+            preRecordTime = std::clamp<int>(config.conf[name]["preRecordTime"], 0, PRE_RECORD_MAX_TIME);
+        }
         if (config.conf[name].contains("nameTemplate")) {
             std::string _nameTemplate = config.conf[name]["nameTemplate"];
             if (_nameTemplate.length() > sizeof(nameTemplate)-1) {
@@ -103,6 +132,10 @@ public:
         stereoSink.init(&stereoStream, stereoHandler, this);
         monoSink.init(&s2m.out, monoHandler, this);
 
+        fftRedrawHandler.ctx = this;
+        fftRedrawHandler.handler = fftRedraw;
+        gui::waterfall.onFFTRedraw.bindHandler(&fftRedrawHandler);
+
         gui::menu.registerEntry(name, menuHandler, this);
         core::modComManager.registerInterface("recorder", name, moduleInterfaceHandler, this);
     }
@@ -111,7 +144,9 @@ public:
         std::lock_guard<std::recursive_mutex> lck(recMtx);
         core::modComManager.unregisterInterface(name);
         gui::menu.removeEntry(name);
+        gui::waterfall.onFFTRedraw.unbindHandler(&fftRedrawHandler);
         stop();
+        disarm();
         deselectStream();
         sigpath::sinkManager.onStreamRegistered.unbindHandler(&onStreamRegisteredHandler);
         sigpath::sinkManager.onStreamUnregister.unbindHandler(&onStreamUnregisterHandler);
@@ -136,14 +171,20 @@ public:
 
         // Select the stream
         selectStream(selectedStreamName);
+
+        // Batch runs record from the start of the file
+        if (core::isBatchMode() && enabled) { start(); }
+        updatePreRecord();
     }
 
     void enable() {
         enabled = true;
+        updatePreRecord();
     }
 
     void disable() {
         enabled = false;
+        updatePreRecord();
     }
 
     bool isEnabled() {
@@ -154,30 +195,82 @@ public:
         std::lock_guard<std::recursive_mutex> lck(recMtx);
         if (recording) { return; }
 
-        // Configure the wav writer
-        if (recMode == RECORDER_MODE_AUDIO) {
-            if (selectedStreamName.empty()) { return; }
-            samplerate = sigpath::sinkManager.getStreamSampleRate(selectedStreamName);
+        // Configure the writer
+        if (recMode == RECORDER_MODE_AUDIO && selectedStreamName.empty()) { return; }
+        samplerate = getStreamSamplerate();
+        recContainer = containers[containerId];
+        if (recContainer == CONTAINER_SIGMF) {
+            // Baseband is stored as complex samples and audio as one or two real channels
+            sigmfWriter.setComplex(recMode == RECORDER_MODE_BASEBAND);
+            sigmfWriter.setChannels((recMode == RECORDER_MODE_AUDIO && stereo) ? 2 : 1);
+            sigmfWriter.setSampleType(sigmfSampleTypes[sigmfSampleTypeId]);
+            sigmfWriter.setSamplerate(samplerate);
+            updateFrequency();
+            sigmfWriter.setFrequency((recMode == RECORDER_MODE_BASEBAND) ? getFrequency() : 0.0);
         }
         else {
-            samplerate = sigpath::iqFrontEnd.getSampleRate();
+            writer.setFormat(wav::FORMAT_WAV);
+            writer.setChannels((recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2);
+            writer.setSampleType(sampleTypes[sampleTypeId]);
+            writer.setSamplerate(samplerate);
         }
-        writer.setFormat(containers[containerId]);
-        writer.setChannels((recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2);
-        writer.setSampleType(sampleTypes[sampleTypeId]);
-        writer.setSamplerate(samplerate);
 
-        // Open file
+        // Open file, SigMF adds its own extensions
         std::string type = (recMode == RECORDER_MODE_AUDIO) ? "audio" : "baseband";
         std::string vfoName = (recMode == RECORDER_MODE_AUDIO) ? selectedStreamName : "";
-        std::string extension = ".wav";
+        std::string extension = (recContainer == CONTAINER_SIGMF) ? "" : ".wav";
         std::string expandedPath = expandString(folderSelect.path + "/" + genFileName(nameTemplate, type, vfoName) + extension);
-        if (!writer.open(expandedPath)) {
+        bool opened = (recContainer == CONTAINER_SIGMF) ? sigmfWriter.open(expandedPath) : writer.open(expandedPath);
+        if (!opened) {
             flog::error("Failed to open file for recording: {0}", expandedPath);
             return;
         }
 
-        // Open audio stream or baseband
+        // Samples are written to disk from a separate thread
+        diskWriter.start(getChannels(), (recMode == RECORDER_MODE_AUDIO) ? AUDIO_POOL_SIZE : BASEBAND_POOL_SIZE, diskHandler, this);
+
+        // Open audio stream or baseband, unless it's already running into the pre-record buffer.
+        // The sink then writes what the buffer holds ahead of its next block.
+        backlogQueued = false;
+        recording = true;
+        if (!armed) { startPath(); }
+        armed = false;
+    }
+
+    void stop() {
+        std::lock_guard<std::recursive_mutex> lck(recMtx);
+        if (!recording) { return; }
+
+        // Close audio stream or baseband
+        stopPath();
+
+        // Write what's left and close file
+        diskWriter.stop();
+        DiskWriter::Stats stats = diskWriter.getStats();
+        if (stats.droppedFrames) {
+            flog::warn("Recorder dropped {0} samples over {1} writes because the disk couldn't keep up", stats.droppedFrames, stats.droppedWrites);
+        }
+        writer.close();
+        sigmfWriter.close();
+        recording = false;
+
+        // Start over filling the pre-record buffer
+        preRecord.clear();
+        updatePreRecord();
+    }
+
+private:
+    uint64_t getStreamSamplerate() {
+        if (recMode == RECORDER_MODE_AUDIO) { return sigpath::sinkManager.getStreamSampleRate(selectedStreamName); }
+        return sigpath::iqFrontEnd.getSampleRate();
+    }
+
+    int getChannels() {
+        return (recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2;
+    }
+
+    void startPath() {
+        pathMode = recMode;
         if (recMode == RECORDER_MODE_AUDIO) {
             // Start correct path depending on 
             if (stereo) {
@@ -196,16 +289,10 @@ public:
             basebandSink.start();
             sigpath::iqFrontEnd.bindIQStream(basebandStream);
         }
-
-        recording = true;
     }
 
-    void stop() {
-        std::lock_guard<std::recursive_mutex> lck(recMtx);
-        if (!recording) { return; }
-
-        // Close audio stream or baseband
-        if (recMode == RECORDER_MODE_AUDIO) {
+    void stopPath() {
+        if (pathMode == RECORDER_MODE_AUDIO) {
             splitter.unbindStream(&stereoStream);
             monoSink.stop();
             stereoSink.stop();
@@ -218,14 +305,38 @@ public:
             basebandSink.stop();
             delete basebandStream;
         }
+    }
 
-        // Close file
-        writer.close();
-        
-        recording = false;
+    // While idle, keeps the stream running into the pre-record buffer so that recordings start before the trigger
+    void updatePreRecord(bool restart = false) {
+        std::lock_guard<std::recursive_mutex> lck(recMtx);
+        if (recording) { return; }
+        bool arm = enabled && preRecordTime > 0 && !core::isBatchMode() && (recMode == RECORDER_MODE_BASEBAND || audioStream);
+        if (restart || !arm) { disarm(); }
+        if (!arm) {
+            preRecord.free();
+            return;
+        }
+        if (armed) { return; }
+
+        // The buffer is sized for the current samplerate, it's armed again if that changes
+        preRecordSamplerate = getStreamSamplerate();
+        int channels = getChannels();
+        double frames = (double)preRecordTime * preRecordSamplerate;
+        double maxFrames = PRE_RECORD_MAX_SIZE / (channels * sizeof(float));
+        preRecordLimited = (frames > maxFrames);
+        preRecord.alloc(channels, std::min<double>(frames, maxFrames));
+        startPath();
+        armed = true;
+    }
+
+    void disarm() {
+        std::lock_guard<std::recursive_mutex> lck(recMtx);
+        if (!armed) { return; }
+        stopPath();
+        armed = false;
     }
 
-private:
     static void menuHandler(void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
         float menuWidth = ImGui::GetContentRegionAvail().x;
@@ -236,6 +347,7 @@ private:
         ImGui::Columns(2, CONCAT("RecorderModeColumns##_", _this->name), false);
         if (ImGui::RadioButton(CONCAT("Baseband##_recorder_mode_", _this->name), _this->recMode == RECORDER_MODE_BASEBAND)) {
             _this->recMode = RECORDER_MODE_BASEBAND;
+            _this->updatePreRecord(true);
             config.acquire();
             config.conf[_this->name]["mode"] = _this->recMode;
             config.release(true);
@@ -243,6 +355,7 @@ private:
         ImGui::NextColumn();
         if (ImGui::RadioButton(CONCAT("Audio##_recorder_mode_", _this->name), _this->recMode == RECORDER_MODE_AUDIO)) {
             _this->recMode = RECORDER_MODE_AUDIO;
+            _this->updatePreRecord(true);
             config.acquire();
             config.conf[_this->name]["mode"] = _this->recMode;
             config.release(true);
@@ -278,12 +391,31 @@ private:
 
         ImGui::LeftLabel("Sample type");
         ImGui::FillWidth();
-        if (ImGui::Combo(CONCAT("##_recorder_st_", _this->name), &_this->sampleTypeId, _this->sampleTypes.txt)) {
+        if (_this->containers[_this->containerId] == CONTAINER_SIGMF) {
+            if (ImGui::Combo(CONCAT("##_recorder_sigmf_st_", _this->name), &_this->sigmfSampleTypeId, _this->sigmfSampleTypes.txt)) {
+                config.acquire();
+                config.conf[_this->name]["sigmfSampleType"] = _this->sigmfSampleTypes.key(_this->sigmfSampleTypeId);
+                config.release(true);
+            }
+        }
+        else if (ImGui::Combo(CONCAT("##_recorder_st_", _this->name), &_this->sampleTypeId, _this->sampleTypes.txt)) {
             config.acquire();
             config.conf[_this->name]["sampleType"] = _this->sampleTypes.key(_this->sampleTypeId);
             config.release(true);
         }
 
+        ImGui::LeftLabel("Pre-record");
+        ImGui::FillWidth();
+        if (ImGui::SliderInt(CONCAT("##_recorder_pre_record_", _this->name), &_this->preRecordTime, 0, PRE_RECORD_MAX_TIME, (_this->preRecordTime > 0) ? "%d s" : "Off")) {
+            config.acquire();
+            config.conf[_this->name]["preRecordTime"] = _this->preRecordTime;
+            config.release(true);
+        }
+        if (ImGui::IsItemDeactivatedAfterEdit()) { _this->updatePreRecord(true); }
+        if (_this->armed && _this->preRecordLimited) {
+            ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Limited to %.1fs by memory", (double)_this->preRecord.getCapacity() / _this->preRecordSamplerate);
+        }
+
         // Show additional audio options
         if (_this->recMode == RECORDER_MODE_AUDIO) {
             ImGui::LeftLabel("Stream");
@@ -314,6 +446,7 @@ private:
                 config.acquire();
                 config.conf[_this->name]["stereo"] = _this->stereo;
                 config.release(true);
+                _this->updatePreRecord(true);
             }
             if (_this->recording) { style::endDisabled(); }
 
@@ -337,7 +470,8 @@ private:
             if (ImGui::Button(CONCAT("Stop##_recorder_rec_", _this->name), ImVec2(menuWidth, 0))) {
                 _this->stop();
             }
-            uint64_t seconds = _this->writer.getSamplesWritten() / _this->samplerate;
+            size_t written = (_this->recContainer == CONTAINER_SIGMF) ? _this->sigmfWriter.getSamplesWritten() : _this->writer.getSamplesWritten();
+            uint64_t seconds = written / _this->samplerate;
             time_t diff = seconds;
             tm* dtm = gmtime(&diff);
 
@@ -347,6 +481,12 @@ private:
             else {
                 ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Recording %02d:%02d:%02d", dtm->tm_hour, dtm->tm_min, dtm->tm_sec);
             }
+
+            DiskWriter::Stats stats = _this->diskWriter.getStats();
+            ImGui::Text("Buffer: %d%% (peak %d%%)", (stats.queued * 100) / stats.capacity, (stats.highWater * 100) / stats.capacity);
+            if (stats.droppedFrames) {
+                ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Dropped %.1fs of samples", (double)stats.droppedFrames / _this->samplerate);
+            }
         }
     }
 
@@ -369,6 +509,7 @@ private:
         streamId = audioStreams.keyId(name);
         volume.setInput(audioStream);
         startAudioPath();
+        updatePreRecord();
     }
 
     void deselectStream() {
@@ -382,6 +523,7 @@ private:
         sigpath::sinkManager.unbindStream(selectedStreamName, audioStream);
         selectedStreamName.clear();
         audioStream = NULL;
+        updatePreRecord();
     }
 
     void startAudioPath() {
@@ -501,7 +643,7 @@ private:
 
     static void complexHandler(dsp::complex_t* data, int count, void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
-        _this->writer.write((float*)data, count);
+        _this->write((float*)data, count);
     }
 
     static void stereoHandler(dsp::stereo_t* data, int count, void* ctx) {
@@ -517,7 +659,7 @@ private:
             _this->ignoringSilence = (absMax < SILENCE_LVL);
             if (_this->ignoringSilence) { return; }
         }
-        _this->writer.write((float*)data, count);
+        _this->write((float*)data, count);
     }
 
     static void monoHandler(float* data, int count, void* ctx) {
@@ -531,7 +673,73 @@ private:
             _this->ignoringSilence = (absMax < SILENCE_LVL);
             if (_this->ignoringSilence) { return; }
         }
-        _this->writer.write(data, count);
+        _this->write(data, count);
+    }
+
+    // Called from whichever sink is running, so from a single thread at a time
+    void write(float* data, int count) {
+        if (!recording) {
+            preRecord.write(data, count);
+            return;
+        }
+
+        // The samples are dated and tagged as they are received, the disk writer only gets to them later
+        DiskWriter::BlockInfo info;
+        double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        info.samplerate = (recMode == RECORDER_MODE_BASEBAND) ? sigpath::iqFrontEnd.getSampleRate() : samplerate;
+        info.frequency = (recMode == RECORDER_MODE_BASEBAND) ? getFrequency() : 0.0;
+        info.time = now - (double)count / info.samplerate;
+
+        // What came before the recording started goes to disk first, straight out of the pre-record buffer.
+        // It ends right where this block starts.
+        if (!backlogQueued && preRecord.getFrames()) {
+            int olderCount, newerCount;
+            const float* older = preRecord.getOlder(olderCount);
+            const float* newer = preRecord.getNewer(newerCount);
+            DiskWriter::BlockInfo backlogInfo = info;
+            backlogInfo.samplerate = preRecordSamplerate;
+            backlogInfo.time = info.time - (double)(olderCount + newerCount) / preRecordSamplerate;
+            diskWriter.writeBacklog(older, olderCount, backlogInfo);
+            backlogInfo.time += (double)olderCount / preRecordSamplerate;
+            diskWriter.writeBacklog(newer, newerCount, backlogInfo);
+        }
+        backlogQueued = true;
+        diskWriter.write(data, count, info);
+    }
+
+    static void diskHandler(float* data, int count, const DiskWriter::BlockInfo& info, void* ctx) {
+        RecorderModule* _this = (RecorderModule*)ctx;
+        if (_this->recContainer != CONTAINER_SIGMF) {
+            _this->writer.write(data, count);
+            return;
+        }
+
+        // Retuning or changing the samplerate starts a new capture
+        if (_this->recMode == RECORDER_MODE_BASEBAND) {
+            _this->sigmfWriter.setFrequency(info.frequency);
+            _this->sigmfWriter.setSamplerate(info.samplerate);
+        }
+        _this->sigmfWriter.write(data, count, info.time);
+    }
+
+    // The waterfall can only be read from the UI thread, the DSP thread gets the center frequency through here
+    void updateFrequency() {
+        double freq = gui::waterfall.getCenterFrequency();
+        std::lock_guard<std::mutex> lck(freqMtx);
+        centerFrequency = freq;
+    }
+
+    double getFrequency() {
+        std::lock_guard<std::mutex> lck(freqMtx);
+        return centerFrequency;
+    }
+
+    // Called every frame, the pre-record buffer holds a given time so it has to follow the samplerate
+    static void fftRedraw(ImGui::WaterFall::FFTRedrawArgs args, void* ctx) {
+        RecorderModule* _this = (RecorderModule*)ctx;
+        _this->updateFrequency();
+        std::lock_guard<std::recursive_mutex> lck(_this->recMtx);
+        if (_this->armed && _this->getStreamSamplerate() != _this->preRecordSamplerate) { _this->updatePreRecord(true); }
     }
 
     static void moduleInterfaceHandler(int code, void* in, void* out, void* ctx) {
@@ -545,6 +753,7 @@ private:
             if (_this->recording) { return; }
             int* _in = (int*)in;
             _this->recMode = std::clamp<int>(*_in, 0, 1);
+            _this->updatePreRecord(true);
         }
         else if (code == RECORDER_IFACE_CMD_START) {
             if (!_this->recording) { _this->start(); }
@@ -559,22 +768,39 @@ private:
     std::string root;
     char nameTemplate[1024];
 
-    OptionList<std::string, wav::Format> containers;
+    OptionList<std::string, Container> containers;
     OptionList<int, wav::SampleType> sampleTypes;
+    OptionList<int, sigmf::SampleType> sigmfSampleTypes;
     FolderSelect folderSelect;
 
     int recMode = RECORDER_MODE_AUDIO;
     int containerId;
     int sampleTypeId;
+    int sigmfSampleTypeId;
     bool stereo = true;
     std::string selectedStreamName = "";
     float audioVolume = 1.0f;
     bool ignoreSilence = false;
+    int preRecordTime = 0;
     dsp::stereo_t audioLvl = { -100.0f, -100.0f };
 
-    bool recording = false;
+    std::atomic_bool recording = false;
     bool ignoringSilence = false;
+    Container recContainer = CONTAINER_WAV;
     wav::Writer writer;
+    sigmf::Writer sigmfWriter;
+    DiskWriter diskWriter;
+    int pathMode = RECORDER_MODE_AUDIO;
+
+    // The stream runs into the pre-record buffer while armed, then the sink hands it to the disk writer
+    PreRecordBuffer preRecord;
+    bool armed = false;
+    bool preRecordLimited = false;
+    double preRecordSamplerate = 0.0;
+    bool backlogQueued = false;
+    EventHandler<ImGui::WaterFall::FFTRedrawArgs> fftRedrawHandler;
+    std::mutex freqMtx;
+    double centerFrequency = 0.0;
     std::recursive_mutex recMtx;
     dsp::stream<dsp::complex_t>* basebandStream;
     dsp::stream<dsp::stereo_t> stereoStream;
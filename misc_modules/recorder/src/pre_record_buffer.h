@@ -0,0 +1,77 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <dsp/buffer/buffer.h>
+
+// Keeps the last frames of a stream in memory so that a recording can include what came before it was started.
+// Only the thread producing the samples writes to it, and it is handed over to the disk writer as is once recording,
+// so it needs no locking at all.
+class PreRecordBuffer {
+public:
+    ~PreRecordBuffer() { free(); }
+
+    // Keeps the memory if the size didn't change
+    void alloc(int channels, int frames) {
+        if (buf && channels == _channels && frames == capacity) {
+            clear();
+            return;
+        }
+        free();
+        if (frames <= 0) { return; }
+        buf = dsp::buffer::alloc<float>(frames * channels);
+        _channels = channels;
+        capacity = frames;
+        clear();
+    }
+
+    void free() {
+        if (buf) { dsp::buffer::free(buf); }
+        buf = NULL;
+        capacity = 0;
+        clear();
+    }
+
+    void clear() {
+        pos = 0;
+        frames = 0;
+    }
+
+    // Overwrites the oldest frames once full
+    void write(const float* data, int count) {
+        if (!capacity) { return; }
+
+        // Only the end of blocks bigger than the whole buffer is kept
+        if (count > capacity) {
+            data += (count - capacity) * _channels;
+            count = capacity;
+        }
+
+        int first = std::min<int>(count, capacity - pos);
+        memcpy(&buf[pos * _channels], data, first * _channels * sizeof(float));
+        memcpy(buf, &data[first * _channels], (count - first) * _channels * sizeof(float));
+        pos = (pos + count) % capacity;
+        frames = std::min<int>(frames + count, capacity);
+    }
+
+    int getFrames() { return frames; }
+    int getCapacity() { return capacity; }
+
+    // The frames from oldest to newest are the older part followed by the newer part
+    const float* getOlder(int& count) {
+        count = (frames < capacity) ? 0 : capacity - pos;
+        return &buf[pos * _channels];
+    }
+
+    const float* getNewer(int& count) {
+        count = (frames < capacity) ? frames : pos;
+        return buf;
+    }
+
+private:
+    float* buf = NULL;
+    int _channels = 1;
+    int capacity = 0;
+    int pos = 0;
+    int frames = 0;
+};
@@ -3,6 +3,7 @@
 #include <gui/gui.h>
 #include <gui/style.h>
 #include <signal_path/signal_path.h>
+#include <dsp/math/reduce.h>
 
 SDRPP_MOD_INFO{
     /* Name:            */ "scanner",
@@ -259,11 +260,7 @@ private:
         double high = freq + (width/2.0);
         int lowId = std::clamp<int>((low - wfStart) * (double)dataWidth / wfWidth, 0, dataWidth - 1);
         int highId = std::clamp<int>((high - wfStart) * (double)dataWidth / wfWidth, 0, dataWidth - 1);
-        float max = -INFINITY;
-        for (int i = lowId; i <= highId; i++) {
-            if (data[i] > max) { max = data[i]; }
-        }
-        return max;
+        return dsp::math::reduce(&data[lowId], highId - lowId + 1, dsp::math::REDUCE_MAX);
     }
 
     std::string name;
@@ -4,20 +4,30 @@
 #include <module.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
-#include <wavreader.h>
+#include <utils/iq_reader.h>
 #include <core.h>
 #include <gui/widgets/file_select.h>
 #include <filesystem>
 #include <regex>
 #include <gui/tuner.h>
+#include <gui/style.h>
+#include <utils/optionlist.h>
 #include <algorithm>
 #include <stdexcept>
+#include <atomic>
+#include <chrono>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
+// Seconds of samples the OS is asked to read ahead of playback
+#define READ_AHEAD_TIME     1.0
+
+// If playback falls further behind than this, it continues from there instead of trying to catch up
+#define MAX_PLAYBACK_LAG    0.5
+
 SDRPP_MOD_INFO{
     /* Name:            */ "file_source",
-    /* Description:     */ "Wav file source module for SDR++",
+    /* Description:     */ "Wav and SigMF file source module for SDR++",
     /* Author:          */ "Ryzerth",
     /* Version:         */ 0, 1, 1,
     /* Max instances    */ 1
@@ -27,14 +37,29 @@ ConfigManager config;
 
 class FileSourceModule : public ModuleManager::Instance {
 public:
-    FileSourceModule(std::string name) : fileSelect("", { "Wav IQ Files (*.wav)", "*.wav", "All Files", "*" }) {
+    FileSourceModule(std::string name) : fileSelect("", { "Wav IQ Files (*.wav)", "*.wav", "SigMF Recordings (*.sigmf-meta)", "*.sigmf-meta", "All Files", "*" }) {
         this->name = name;
 
         if (core::args["server"].b()) { return; }
 
+        // Playback speeds, 0 meaning as fast as possible
+        speeds.define("0.1x", "0.1x", 0.1);
+        speeds.define("0.25x", "0.25x", 0.25);
+        speeds.define("0.5x", "0.5x", 0.5);
+        speeds.define("1x", "1x", 1.0);
+        speeds.define("2x", "2x", 2.0);
+        speeds.define("5x", "5x", 5.0);
+        speeds.define("10x", "10x", 10.0);
+        speeds.define("max", "Max", 0.0);
+        speedId = speeds.keyId("1x");
+
         config.acquire();
         fileSelect.setPath(config.conf["path"], true);
+        if (config.conf.contains("speed") && speeds.keyExists(config.conf["speed"])) {
+            speedId = speeds.keyId(config.conf["speed"]);
+        }
         config.release();
+        speed = speeds.value(speedId);
 
         handler.ctx = this;
         handler.selectHandler = menuSelected;
@@ -45,11 +70,19 @@ public:
         handler.tuneHandler = tune;
         handler.stream = &stream;
         sigpath::sourceManager.registerSource("File", &handler);
+
+        // Frequency and samplerate changes recorded in the file are applied from the GUI thread
+        fftRedrawHandler.ctx = this;
+        fftRedrawHandler.handler = fftRedraw;
+        gui::waterfall.onFFTRedraw.bindHandler(&fftRedrawHandler);
     }
 
     ~FileSourceModule() {
+        if (core::args["server"].b()) { return; }
+        gui::waterfall.onFFTRedraw.unbindHandler(&fftRedrawHandler);
         stop(this);
         sigpath::sourceManager.unregisterSource("File");
+        delete reader;
     }
 
     void postInit() {}
@@ -69,6 +102,7 @@ public:
 private:
     static void menuSelected(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
+        _this->selected = true;
         core::setInputSampleRate(_this->sampleRate);
         tuner::tune(tuner::TUNER_MODE_IQ_ONLY, "", _this->centerFreq);
         sigpath::iqFrontEnd.setBuffering(false);
@@ -81,6 +115,7 @@ private:
 
     static void menuDeselected(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
+        _this->selected = false;
         sigpath::iqFrontEnd.setBuffering(true);
         //gui::freqSelect.limitFreq = false;
         gui::waterfall.centerFrequencyLocked = false;
@@ -91,8 +126,10 @@ private:
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (_this->running) { return; }
         if (_this->reader == NULL) { return; }
+        _this->reader->setForceFloat(_this->float32Mode);
+        if (!_this->reader->getFrameCount()) { return; }
         _this->running = true;
-        _this->workerThread = _this->float32Mode ? std::thread(floatWorker, _this) : std::thread(worker, _this);
+        _this->workerThread = std::thread(worker, _this);
         flog::info("FileSourceModule '{0}': Start!", _this->name);
     }
 
@@ -104,7 +141,7 @@ private:
         _this->workerThread.join();
         _this->stream.clearWriteStop();
         _this->running = false;
-        _this->reader->rewind();
+        _this->position = 0;
         flog::info("FileSourceModule '{0}': Stop!", _this->name);
     }
 
@@ -116,31 +153,32 @@ private:
     static void menuHandler(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
 
+        if (_this->running) { style::beginDisabled(); }
         if (_this->fileSelect.render("##file_source_" + _this->name)) {
             if (_this->fileSelect.pathIsValid()) {
                 if (_this->reader != NULL) {
                     _this->reader->close();
                     delete _this->reader;
+                    _this->reader = NULL;
                 }
-                try {
-                    _this->reader = new WavReader(_this->fileSelect.path);
-                    if (_this->reader->getSampleRate() == 0) {
-                        _this->reader->close();
-                        delete _this->reader;
-                        _this->reader = NULL;
-                        throw std::runtime_error("Sample rate may not be zero");
-                    }
-                    _this->sampleRate = _this->reader->getSampleRate();
+                _this->position = 0;
+                _this->reader = IQReader::open(_this->fileSelect.path);
+                if (_this->reader != NULL) {
+                    _this->reader->setForceFloat(_this->float32Mode);
+                    _this->capture = 0;
+                    _this->appliedCapture = 0;
+                    IQReader::Capture cap = _this->reader->getCapture(0);
+                    _this->sampleRate = cap.sampleRate;
                     core::setInputSampleRate(_this->sampleRate);
                     std::string filename = std::filesystem::path(_this->fileSelect.path).filename().string();
-                    _this->centerFreq = _this->getFrequency(filename);
+                    _this->centerFreq = cap.frequency ? cap.frequency : _this->getFrequency(filename);
                     tuner::tune(tuner::TUNER_MODE_IQ_ONLY, "", _this->centerFreq);
                     //gui::freqSelect.minFreq = _this->centerFreq - (_this->sampleRate/2);
                     //gui::freqSelect.maxFreq = _this->centerFreq + (_this->sampleRate/2);
                     //gui::freqSelect.limitFreq = true;
                 }
-                catch (const std::exception& e) {
-                    flog::error("Error: {}", e.what());
+                else {
+                    flog::error("Error: Unsupported or invalid recording");
                 }
                 config.acquire();
                 config.conf["path"] = _this->fileSelect.path;
@@ -148,36 +186,141 @@ private:
             }
         }
 
-        ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode);
+        if (ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode) && _this->reader != NULL) {
+            _this->reader->setForceFloat(_this->float32Mode);
+        }
+        if (_this->running) { style::endDisabled(); }
+
+        ImGui::LeftLabel("Speed");
+        ImGui::FillWidth();
+        if (ImGui::Combo(CONCAT("##_file_source_speed_", _this->name), &_this->speedId, _this->speeds.txt)) {
+            _this->speed = _this->speeds.value(_this->speedId);
+            config.acquire();
+            config.conf["speed"] = _this->speeds.key(_this->speedId);
+            config.release(true);
+        }
+
+        // Position in the file, seeking is done by the worker when running. Recordings with timestamps are shown and
+        // seeked by the time of day (UTC) at which they were recorded.
+        if (_this->reader != NULL && _this->reader->getFrameCount()) {
+            uint64_t frameCount = _this->reader->getFrameCount();
+            double sampleRate = std::max<double>(_this->reader->getSampleRate(), 1.0);
+            double startTime = _this->reader->getTime(0);
+            bool timed = (startTime >= 0.0);
+            double minTime = timed ? startTime : 0.0;
+            double maxTime = timed ? _this->reader->getTime(frameCount - 1) : frameCount / sampleRate;
+            double time = timed ? _this->reader->getTime(_this->position) : _this->position / sampleRate;
+            double dayLen = timed ? 86400.0 : INFINITY;
+            char timeStr[64];
+            sprintf(timeStr, timed ? "%s / %s UTC" : "%s / %s", formatTime(fmod(time, dayLen)).c_str(), formatTime(fmod(maxTime, dayLen)).c_str());
+            ImGui::FillWidth();
+            if (ImGui::SliderScalar(CONCAT("##_file_source_pos_", _this->name), ImGuiDataType_Double, &time, &minTime, &maxTime, timeStr)) {
+                uint64_t target = timed ? _this->reader->findFrame(time) : std::clamp<double>(time * sampleRate, 0.0, (double)(frameCount - 1));
+                if (_this->running) {
+                    _this->seekTarget = target;
+                }
+                else {
+                    _this->position = target;
+                }
+            }
+        }
     }
 
-    static void worker(void* ctx) {
+    static void fftRedraw(ImGui::WaterFall::FFTRedrawArgs args, void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        int16_t* inBuf = new int16_t[blockSize * 2];
-
-        while (true) {
-            _this->reader->readSamples(inBuf, blockSize * 2 * sizeof(int16_t));
-            volk_16i_s32f_convert_32f((float*)_this->stream.writeBuf, inBuf, 32768.0f, blockSize * 2);
-            if (!_this->stream.swap(blockSize)) { break; };
+        int id = _this->capture;
+        if (!_this->selected || !_this->running || id == _this->appliedCapture) { return; }
+        _this->appliedCapture = id;
+
+        // Follow the frequency and samplerate the part being played was recorded with
+        IQReader::Capture cap = _this->reader->getCapture(id);
+        if (cap.sampleRate != _this->sampleRate) {
+            _this->sampleRate = cap.sampleRate;
+            core::setInputSampleRate(_this->sampleRate);
         }
+        if (cap.frequency && cap.frequency != _this->centerFreq) {
+            _this->centerFreq = cap.frequency;
+            tuner::tune(tuner::TUNER_MODE_IQ_ONLY, "", _this->centerFreq);
+        }
+    }
 
-        delete[] inBuf;
+    static std::string formatTime(double time) {
+        uint64_t secs = std::max<double>(time, 0.0);
+        char buf[32];
+        sprintf(buf, "%02d:%02d:%02d", (int)(secs / 3600), (int)((secs / 60) % 60), (int)(secs % 60));
+        return buf;
     }
 
-    static void floatWorker(void* ctx) {
+    static void worker(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        dsp::complex_t* inBuf = new dsp::complex_t[blockSize];
+        IQReader* reader = _this->reader;
+        uint64_t frameCount = reader->getFrameCount();
+        if (!frameCount) { return; }
+        uint64_t pos = std::min<uint64_t>(_this->position, frameCount - 1);
+        uint64_t prefetched = pos;
+        int captureCount = reader->getCaptureCount();
+        int capture = -1;
+        uint64_t captureEnd = 0;
+        double sampleRate = 1.0;
+        int blockSize = 1;
+        uint64_t readAhead = 1;
+
+        // Playback is paced against the time the first sample since the last seek, speed or samplerate change was sent
+        auto refTime = std::chrono::steady_clock::now();
+        uint64_t sent = 0;
+        double speed = _this->speed;
 
         while (true) {
-            _this->reader->readSamples(_this->stream.writeBuf, blockSize * sizeof(dsp::complex_t));
-            if (!_this->stream.swap(blockSize)) { break; };
-        }
+            int64_t seek = _this->seekTarget.exchange(-1);
+            if (seek >= 0 || _this->speed != speed) {
+                if (seek >= 0) { pos = std::min<uint64_t>(seek, frameCount - 1); }
+                speed = _this->speed;
+                refTime = std::chrono::steady_clock::now();
+                sent = 0;
+            }
+
+            // Entering another part of the recording, the GUI thread retunes to it
+            if (capture < 0 || pos < reader->getCapture(capture).frame || pos >= captureEnd) {
+                capture = reader->findCapture(pos);
+                captureEnd = (capture + 1 < captureCount) ? reader->getCapture(capture + 1).frame : frameCount;
+                sampleRate = std::max<double>(reader->getCapture(capture).sampleRate, 1.0);
+                blockSize = std::clamp<int>(sampleRate / 200.0, 1, STREAM_BUFFER_SIZE);
+                readAhead = sampleRate * READ_AHEAD_TIME;
+                _this->capture = capture;
+                refTime = std::chrono::steady_clock::now();
+                sent = 0;
+            }
+
+            // Keep the OS reading ahead of playback
+            if (prefetched < pos || prefetched - pos < readAhead / 2) {
+                reader->prefetch(pos, readAhead);
+                prefetched = pos + readAhead;
+            }
+
+            // Convert straight out of the mapped file, blocks never span two captures
+            int count = reader->read(pos, _this->stream.writeBuf, std::min<uint64_t>(blockSize, captureEnd - pos));
+
+            // Loop back to the start at the end of the file
+            pos += count;
+            if (pos >= frameCount) { pos = 0; }
+            _this->position = pos;
+            sent += count;
+
+            // Wait until the block is due unless running as fast as possible
+            if (speed > 0.0) {
+                auto due = refTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(sent / (sampleRate * speed)));
+                auto now = std::chrono::steady_clock::now();
+                if (now - due > std::chrono::duration<double>(MAX_PLAYBACK_LAG)) {
+                    refTime = now;
+                    sent = 0;
+                }
+                else {
+                    std::this_thread::sleep_until(due);
+                }
+            }
 
-        delete[] inBuf;
+            if (!_this->stream.swap(count)) { break; };
+        }
     }
 
     double getFrequency(std::string filename) {
@@ -193,20 +336,33 @@ private:
     std::string name;
     dsp::stream<dsp::complex_t> stream;
     SourceManager::SourceHandler handler;
-    WavReader* reader = NULL;
+    IQReader* reader = NULL;
     bool running = false;
     bool enabled = true;
-    float sampleRate = 1000000;
+    bool selected = false;
+    double sampleRate = 1000000;
     std::thread workerThread;
 
     double centerFreq = 100000000;
 
     bool float32Mode = false;
+
+    OptionList<std::string, double> speeds;
+    int speedId = 0;
+    std::atomic<double> speed = 1.0;
+    std::atomic<uint64_t> position = 0;
+    std::atomic<int64_t> seekTarget = -1;
+
+    // Capture being played and the one the frequency and samplerate were last set for
+    std::atomic<int> capture = 0;
+    int appliedCapture = 0;
+    EventHandler<ImGui::WaterFall::FFTRedrawArgs> fftRedrawHandler;
 };
 
 MOD_EXPORT void _INIT_() {
     json def = json({});
     def["path"] = "";
+    def["speed"] = "1x";
     config.setPath(core::args["root"].s() + "/file_source_config.json");
     config.load(def);
     config.enableAutoSave();
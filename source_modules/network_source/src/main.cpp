@@ -9,6 +9,8 @@
 #include <gui/smgui.h>
 #include <gui/widgets/stepped_slider.h>
 #include <utils/optionlist.h>
+#include <dsp/convert/sample_format.h>
+#include <dsp/compression/sample_stream_decompressor.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
@@ -32,9 +34,20 @@ enum SampleType {
     SAMPLE_TYPE_INT8,
     SAMPLE_TYPE_INT16,
     SAMPLE_TYPE_INT32,
-    SAMPLE_TYPE_FLOAT32
+    SAMPLE_TYPE_FLOAT32,
+
+    // Coded types, sent as frames in the sample format of the SDR++ server, each prefixed by its size as a uint32
+    SAMPLE_TYPE_BFP8,
+    SAMPLE_TYPE_BFP10,
+    SAMPLE_TYPE_BFP12,
+    SAMPLE_TYPE_RICE16,
+    SAMPLE_TYPE_RICE12
 };
 
+bool isCodedSampleType(SampleType type) {
+    return type >= SAMPLE_TYPE_BFP8;
+}
+
 const size_t SAMPLE_TYPE_SIZE[] {
     sizeof(int8_t)*2,
     sizeof(int16_t)*2,
@@ -82,6 +95,11 @@ public:
         sampleTypes.define("Int16", SAMPLE_TYPE_INT16);
         sampleTypes.define("Int32", SAMPLE_TYPE_INT32);
         sampleTypes.define("Float32", SAMPLE_TYPE_FLOAT32);
+        sampleTypes.define("BFP 8bit", SAMPLE_TYPE_BFP8);
+        sampleTypes.define("BFP 10bit", SAMPLE_TYPE_BFP10);
+        sampleTypes.define("BFP 12bit", SAMPLE_TYPE_BFP12);
+        sampleTypes.define("Rice 16bit", SAMPLE_TYPE_RICE16);
+        sampleTypes.define("Rice 12bit", SAMPLE_TYPE_RICE12);
 
         // Load config
         config.acquire();
@@ -277,6 +295,11 @@ private:
     }
 
     void worker() {
+        if (isCodedSampleType(sampType)) {
+            frameWorker();
+            return;
+        }
+
         // Compute sizes
         int blockSize = samplerate / 200;
         int sampleSize = SAMPLE_TYPE_SIZE[sampType];
@@ -294,13 +317,13 @@ private:
             int count = bytes / sampleSize;
             switch (sampType) {
             case SAMPLE_TYPE_INT8:
-                volk_8i_s32f_convert_32f((float*)stream.writeBuf, (int8_t*)buffer, 128.0f, count*2);
+                dsp::convert::s8ToComplex(count, (int8_t*)buffer, stream.writeBuf, 0.0f, 1.0f / 128.0f);
                 break;
             case SAMPLE_TYPE_INT16:
-                volk_16i_s32f_convert_32f((float*)stream.writeBuf, (int16_t*)buffer, 32768.0f, count*2);
+                dsp::convert::s16ToComplex(count, (int16_t*)buffer, stream.writeBuf, 0.0f, 1.0f / 32768.0f);
                 break;
             case SAMPLE_TYPE_INT32:
-                volk_32i_s32f_convert_32f((float*)stream.writeBuf, (int32_t*)buffer, 2147483647.0f, count*2);
+                dsp::convert::s32ToComplex(count, (int32_t*)buffer, stream.writeBuf, 0.0f, 1.0f / 2147483647.0f);
                 break;
             case SAMPLE_TYPE_FLOAT32:
                 memcpy(stream.writeBuf, buffer, bytes);
@@ -317,6 +340,41 @@ private:
         dsp::buffer::free(buffer);
     }
 
+    void frameWorker() {
+        // Allocate receive buffer for the largest frame
+        const uint32_t maxFrameSize = STREAM_BUFFER_SIZE*sizeof(dsp::complex_t) + 8;
+        uint8_t* buffer = dsp::buffer::alloc<uint8_t>(sizeof(uint32_t) + maxFrameSize);
+
+        while (true) {
+            // Read a frame, UDP datagrams hold exactly one
+            uint32_t frameSize;
+            if (proto == PROTOCOL_UDP) {
+                int bytes = sock->recv(buffer, sizeof(uint32_t) + maxFrameSize, false);
+                if (bytes <= 0) { break; }
+                frameSize = *(uint32_t*)buffer;
+                if (bytes < sizeof(uint32_t) || frameSize > bytes - sizeof(uint32_t)) { continue; }
+            }
+            else {
+                if (sock->recv(buffer, sizeof(uint32_t), true) <= 0) { break; }
+                frameSize = *(uint32_t*)buffer;
+
+                // There's no way to find the next frame after an invalid size
+                if (frameSize < 8 || frameSize > maxFrameSize) {
+                    flog::error("NetworkSourceModule '{0}': Received a frame of invalid size ({1} bytes)", name, frameSize);
+                    break;
+                }
+                if (sock->recv(&buffer[sizeof(uint32_t)], frameSize, true) <= 0) { break; }
+            }
+
+            // Decode, the frame holds its own sample type
+            int count = dsp::compression::SampleStreamDecompressor::process(frameSize, &buffer[sizeof(uint32_t)], stream.writeBuf);
+            if (count && !stream.swap(count)) { break; }
+        }
+
+        // Free receive buffer
+        dsp::buffer::free(buffer);
+    }
+
     std::string name;
     bool enabled = true;
     dsp::stream<dsp::complex_t> stream;
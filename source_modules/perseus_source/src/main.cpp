@@ -9,6 +9,7 @@
 #include <gui/widgets/stepped_slider.h>
 #include <perseus-sdr.h>
 #include <utils/optionlist.h>
+#include <dsp/convert/sample_format.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
@@ -404,21 +405,8 @@ private:
 
     static int callback(void* buf, int bufferSize, void* ctx) {
         PerseusSourceModule* _this = (PerseusSourceModule*)ctx;
-        uint8_t* samples = (uint8_t*)buf;
         int sampleCount = bufferSize / 6;
-        for (int i = 0; i < sampleCount; i++) {
-            int32_t re, im;
-            re = *(samples++);
-            re |= *(samples++) << 8;
-            re |= *(samples++) << 16;
-            re |= (re >> 23) * (0xFF << 24); // Sign extend
-            im = *(samples++);
-            im |= *(samples++) << 8;
-            im |= *(samples++) << 16;
-            im |= (im >> 23) * (0xFF << 24); // Sign extend
-            _this->stream.writeBuf[i].re = ((float)re / (float)0x7FFFFF);
-            _this->stream.writeBuf[i].im = ((float)im / (float)0x7FFFFF);
-        }
+        dsp::convert::s24ToComplex(sampleCount, (uint8_t*)buf, _this->stream.writeBuf, 0.0f, 1.0f / (float)0x7FFFFF);
         _this->stream.swap(sampleCount);
         return 0;
     }
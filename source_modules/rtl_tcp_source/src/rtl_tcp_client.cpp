@@ -1,4 +1,5 @@
 #include "rtl_tcp_client.h"
+#include <dsp/convert/sample_format.h>
 
 namespace rtltcp {
     Client::Client(std::shared_ptr<net::Socket> sock, dsp::stream<dsp::complex_t>* stream) {
@@ -82,10 +83,7 @@ namespace rtltcp {
 
             // Convert to complex float
             int scount = count/2;
-            for (int i = 0; i < scount; i++) {
-                stream->writeBuf[i].re = ((double)buffer[i * 2] - 128.0) / 128.0;
-                stream->writeBuf[i].im = ((double)buffer[(i * 2) + 1] - 128.0) / 128.0;
-            }
+            dsp::convert::u8ToComplex(scount, buffer, stream->writeBuf, 128.0f, 1.0f / 128.0f);
 
             // Swap buffer
             if (!stream->swap(scount)) { break; }
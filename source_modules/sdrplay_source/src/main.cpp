@@ -8,6 +8,7 @@
 #include <config.h>
 #include <sdrplay_api.h>
 #include <gui/smgui.h>
+#include <dsp/convert/sample_format.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
@@ -1111,12 +1112,14 @@ private:
     static void streamCB(short* xi, short* xq, sdrplay_api_StreamCbParamsT* params,
                          unsigned int numSamples, unsigned int reset, void* cbContext) {
         SDRPlaySourceModule* _this = (SDRPlaySourceModule*)cbContext;
-        // TODO: Optimise using volk and math
         if (!_this->running) { return; }
-        for (int i = 0; i < numSamples; i++) {
-            int id = _this->bufferIndex++;
-            _this->stream.writeBuf[id].re = (float)xi[i] / 32768.0f;
-            _this->stream.writeBuf[id].im = (float)xq[i] / 32768.0f;
+        int i = 0;
+        while (i < numSamples) {
+            // Convert as much as fits in the current block
+            int count = std::min<int>(numSamples - i, _this->bufferSize - _this->bufferIndex);
+            dsp::convert::s16SplitToComplex(count, &xi[i], &xq[i], &_this->stream.writeBuf[_this->bufferIndex], 0.0f, 1.0f / 32768.0f);
+            _this->bufferIndex += count;
+            i += count;
 
             if (_this->bufferIndex >= _this->bufferSize) {
                 _this->stream.swap(_this->bufferSize);
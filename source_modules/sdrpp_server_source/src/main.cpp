@@ -35,7 +35,16 @@ public:
         sampleTypeList.define("Int8", dsp::compression::PCM_TYPE_I8);
         sampleTypeList.define("Int16", dsp::compression::PCM_TYPE_I16);
         sampleTypeList.define("Float32", dsp::compression::PCM_TYPE_F32);
+        sampleTypeList.define("BFP 8bit", dsp::compression::PCM_TYPE_BFP8);
+        sampleTypeList.define("BFP 10bit", dsp::compression::PCM_TYPE_BFP10);
+        sampleTypeList.define("BFP 12bit", dsp::compression::PCM_TYPE_BFP12);
+        sampleTypeList.define("Rice 16bit", dsp::compression::PCM_TYPE_RICE16);
+        sampleTypeList.define("Rice 12bit", dsp::compression::PCM_TYPE_RICE12);
         sampleTypeId = sampleTypeList.valueId(dsp::compression::PCM_TYPE_I16);
+        for (double sr : { 50000.0, 100000.0, 250000.0, 500000.0, 1000000.0, 2000000.0 }) {
+            ddcRateList.define(sr, getBandwdithScaled(sr), sr);
+        }
+        ddcRateId = ddcRateList.valueId(250000.0);
 
         handler.ctx = this;
         handler.selectHandler = menuSelected;
@@ -93,7 +102,7 @@ private:
     static void menuSelected(void* ctx) {
         SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
         if (_this->client) {
-            core::setInputSampleRate(_this->client->getSampleRate());
+            core::setInputSampleRate(_this->getStreamSampleRate());
         }
         gui::mainWindow.playButtonLocked = !(_this->client && _this->client->isOpen());
         flog::info("SDRPPServerSourceModule '{0}': Menu Select!", _this->name);
@@ -116,7 +125,7 @@ private:
         }
 
         // Set configuration
-        _this->client->setFrequency(_this->freq);
+        _this->setFrequency(_this->freq);
         _this->client->start();
 
         _this->running = true;
@@ -136,7 +145,7 @@ private:
     static void tune(double freq, void* ctx) {
         SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
         if (_this->running && _this->connected()) {
-            _this->client->setFrequency(freq);
+            _this->setFrequency(freq);
         }
         _this->freq = freq;
         flog::info("SDRPPServerSourceModule '{0}': Tune: {1}!", _this->name, freq);
@@ -199,10 +208,29 @@ private:
                 config.release(true);
             }
 
-            bool dummy = true;
-            style::beginDisabled();
-            ImGui::Checkbox("Full IQ", &dummy);
-            style::endDisabled();
+            // Without the full IQ, the server extracts the channel and only sends that
+            if (_this->running) { style::beginDisabled(); }
+            if (ImGui::Checkbox("Full IQ##sdrpp_srv_source_full_iq", &_this->fullIQ)) {
+                _this->updateStream();
+
+                // Save config
+                config.acquire();
+                config.conf["servers"][_this->devConfName]["fullIQ"] = _this->fullIQ;
+                config.release(true);
+            }
+            if (!_this->fullIQ) {
+                ImGui::LeftLabel("DDC Samplerate");
+                ImGui::FillWidth();
+                if (ImGui::Combo("##sdrpp_srv_source_ddc_sr", &_this->ddcRateId, _this->ddcRateList.txt)) {
+                    _this->updateStream();
+
+                    // Save config
+                    config.acquire();
+                    config.conf["servers"][_this->devConfName]["ddcSampleRate"] = _this->ddcRateList.key(_this->ddcRateId);
+                    config.release(true);
+                }
+            }
+            if (_this->running) { style::endDisabled(); }
 
             // Calculate datarate
             _this->frametimeCounter += ImGui::GetIO().DeltaTime;
@@ -210,11 +238,24 @@ private:
                 _this->datarate = ((float)_this->client->bytes / (_this->frametimeCounter * 1024.0f * 1024.0f)) * 8;
                 _this->frametimeCounter = 0;
                 _this->client->bytes = 0;
+
+                // Keep the last values when no compressed packet came in
+                server::CompressionStats stats = _this->client->getCompressionStats();
+                if (stats.packets) {
+                    _this->compStats = stats;
+                    _this->compRatio = stats.compressedBytes ? (float)stats.rawBytes / (float)stats.compressedBytes : 0.0f;
+                }
             }
 
             ImGui::TextUnformatted("Status:");
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Connected (%.3f Mbit/s)", _this->datarate);
+            if (_this->compression && _this->compStats.packets) {
+                ImGui::Text("Compression: %.2fx, level %d, %d us/packet", _this->compRatio, _this->compStats.level, (int)(_this->compStats.compressTime / _this->compStats.packets));
+                if (_this->compStats.dropped) {
+                    ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "%u blocks dropped by the server", _this->compStats.dropped);
+                }
+            }
 
             ImGui::CollapsingHeader("Source [REMOTE]", ImGuiTreeNodeFlags_DefaultOpen);
 
@@ -235,6 +276,7 @@ private:
         try {
             if (client) { client.reset(); }
             client = server::connect(hostname, port, &stream);
+            compStats = server::CompressionStats();
             deviceInit();
         }
         catch (const std::exception& e) {
@@ -259,19 +301,66 @@ private:
             compression = config.conf["servers"][devConfName]["compression"];
         }
 
+        fullIQ = true;
+        if (config.conf["servers"][devConfName].contains("fullIQ")) {
+            fullIQ = config.conf["servers"][devConfName]["fullIQ"];
+        }
+        ddcRateId = ddcRateList.valueId(250000.0);
+        if (config.conf["servers"][devConfName].contains("ddcSampleRate")) {
+            double sr = config.conf["servers"][devConfName]["ddcSampleRate"];
+            if (ddcRateList.keyExists(sr)) { ddcRateId = ddcRateList.keyId(sr); }
+        }
+
         // Set settings
         client->setSampleType(sampleTypeList[sampleTypeId]);
         client->setCompression(compression);
+        updateStream();
+    }
+
+    double getStreamSampleRate() {
+        return fullIQ ? client->getSampleRate() : ddcRateList[ddcRateId];
+    }
+
+    void updateStream() {
+        // Receive either the full band or a channel extracted by the server
+        client->removeVFO(0);
+        client->setBaseband(fullIQ);
+        if (!fullIQ) {
+            double sr = ddcRateList[ddcRateId];
+            if (!client->addVFO(0, sr, sr, freq - client->getCenterFrequency(), &stream)) {
+                flog::error("Could not get a {0} Hz channel from the server, receiving the full IQ", sr);
+                fullIQ = true;
+                client->setBaseband(true);
+            }
+        }
+        core::setInputSampleRate(getStreamSampleRate());
+    }
+
+    void setFrequency(double freq) {
+        if (fullIQ) {
+            client->setFrequency(freq);
+            return;
+        }
+
+        // Only retune the server when the channel is out of its band, the VFOs of the other clients stay in place anyway
+        double offset = freq - client->getCenterFrequency();
+        if (fabs(offset) + (ddcRateList[ddcRateId] / 2.0) > (client->getSampleRate() / 2.0)) {
+            client->setFrequency(freq);
+            offset = 0.0;
+        }
+        client->setVFOOffset(0, offset);
     }
 
     std::string name;
     bool enabled = true;
     bool running = false;
     
-    double freq;
+    double freq = 0.0;
     bool serverBusy = false;
 
     float datarate = 0;
+    server::CompressionStats compStats;
+    float compRatio = 0;
     float frametimeCounter = 0;
 
     char hostname[1024];
@@ -285,6 +374,10 @@ private:
     int sampleTypeId;
     bool compression = false;
 
+    OptionList<double, double> ddcRateList;
+    int ddcRateId;
+    bool fullIQ = true;
+
     std::shared_ptr<server::Client> client;
 };
 
@@ -26,8 +26,9 @@ namespace server {
         s_cmd_hdr = (CommandHeader*)s_pkt_data;
         s_cmd_data = &sbuffer[sizeof(PacketHeader) + sizeof(CommandHeader)];
 
-        // Initialize decompressor
+        // Initialize decompressors
         dctx = ZSTD_createDCtx();
+        basebandCtx = ZSTD_createDCtx();
 
         // Initialize DSP
         decompIn.setBufferSize(STREAM_BUFFER_SIZE*sizeof(dsp::complex_t) + 8);
@@ -49,6 +50,7 @@ namespace server {
     Client::~Client() {
         close();
         ZSTD_freeDCtx(dctx);
+        ZSTD_freeDCtx(basebandCtx);
         delete[] rbuffer;
         delete[] sbuffer;
     }
@@ -117,10 +119,112 @@ namespace server {
 
     void Client::setCompression(bool enabled) {
         if (!isOpen()) { return; }
-         s_cmd_data[0] = enabled;
+        s_cmd_data[0] = enabled ? COMPRESSION_STREAM : COMPRESSION_NONE;
         sendCommand(COMMAND_SET_COMPRESSION, 1);
     }
 
+    void Client::setBaseband(bool enabled) {
+        if (!isOpen()) { return; }
+        baseband = enabled;
+        s_cmd_data[0] = enabled;
+        sendCommand(COMMAND_SET_BASEBAND, 1);
+    }
+
+    double Client::getCenterFrequency() {
+        return centerFrequency;
+    }
+
+    bool Client::addVFO(uint32_t id, double sampleRate, double bandwidth, double offset, dsp::stream<dsp::complex_t>* out) {
+        if (!isOpen()) { return false; }
+        {
+            std::lock_guard<std::mutex> lck(vfoMtx);
+            if (vfos.find(id) != vfos.end()) { return false; }
+        }
+
+        // Get ready to receive the samples before asking for them
+        auto vfo = std::make_shared<RemoteVFO>();
+        vfo->decompIn.setBufferSize(STREAM_BUFFER_SIZE*sizeof(dsp::complex_t) + 8);
+        vfo->decompIn.clearWriteStop();
+        vfo->decomp.init(&vfo->decompIn);
+        vfo->link.init(&vfo->decomp.out, out);
+        vfo->decomp.start();
+        vfo->link.start();
+        {
+            std::lock_guard<std::mutex> lck(vfoMtx);
+            vfos[id] = vfo;
+        }
+
+        // Ask for the VFO and wait for the server to accept it
+        VFOCommand* cmd = (VFOCommand*)s_cmd_data;
+        cmd->id = id;
+        cmd->sampleRate = sampleRate;
+        cmd->bandwidth = bandwidth;
+        cmd->offset = offset;
+        auto waiter = awaitCommandAck(COMMAND_ADD_VFO);
+        sendCommand(COMMAND_ADD_VFO, sizeof(VFOCommand));
+        bool accepted = waiter->await(PROTOCOL_TIMEOUT_MS) && r_cmd_data[0] == ERROR_NONE;
+        waiter->handled();
+        if (!accepted) {
+            flog::error("The server refused a {0} Hz VFO", sampleRate);
+            removeVFO(id);
+        }
+        return accepted;
+    }
+
+    void Client::removeVFO(uint32_t id) {
+        std::shared_ptr<RemoteVFO> vfo;
+        {
+            std::lock_guard<std::mutex> lck(vfoMtx);
+            auto it = vfos.find(id);
+            if (it == vfos.end()) { return; }
+            vfo = it->second;
+            vfos.erase(it);
+        }
+
+        if (isOpen()) {
+            *(uint32_t*)s_cmd_data = id;
+            sendCommand(COMMAND_REMOVE_VFO, sizeof(uint32_t));
+        }
+
+        // The worker may still be writing to it, stopping the writer unblocks it
+        vfo->decompIn.stopWriter();
+        vfo->decomp.stop();
+        vfo->link.stop();
+    }
+
+    void Client::setVFOOffset(uint32_t id, double offset) {
+        if (!isOpen()) { return; }
+        VFOCommand* cmd = (VFOCommand*)s_cmd_data;
+        cmd->id = id;
+        cmd->sampleRate = 0;
+        cmd->bandwidth = 0;
+        cmd->offset = offset;
+        sendCommand(COMMAND_SET_VFO_OFFSET, sizeof(VFOCommand));
+    }
+
+    void Client::setVFOSamplerate(uint32_t id, double sampleRate, double bandwidth) {
+        if (!isOpen()) { return; }
+        VFOCommand* cmd = (VFOCommand*)s_cmd_data;
+        cmd->id = id;
+        cmd->sampleRate = sampleRate;
+        cmd->bandwidth = bandwidth;
+        cmd->offset = 0;
+        sendCommand(COMMAND_SET_VFO_SAMPLERATE, sizeof(VFOCommand));
+    }
+
+    void Client::setFFT(int size, double rate, void (*handler)(float* data, int size, void* ctx), void* ctx) {
+        {
+            std::lock_guard<std::mutex> lck(fftMtx);
+            fftHandler = handler;
+            fftCtx = ctx;
+        }
+        if (!isOpen()) { return; }
+        FFTCommand* cmd = (FFTCommand*)s_cmd_data;
+        cmd->size = size;
+        cmd->rate = rate;
+        sendCommand(COMMAND_SET_FFT, sizeof(FFTCommand));
+    }
+
     void Client::start() {
         if (!isOpen()) { return; }
         sendCommand(COMMAND_START, 0);
@@ -143,12 +247,31 @@ namespace server {
         // Stop DSP
         decomp.stop();
         link.stop();
+
+        // Stop the VFOs
+        std::lock_guard<std::mutex> lck(vfoMtx);
+        for (auto& [id, vfo] : vfos) {
+            vfo->decompIn.stopWriter();
+            vfo->decomp.stop();
+            vfo->link.stop();
+        }
+        vfos.clear();
     }
 
     bool Client::isOpen() {
         return sock && sock->isOpen();
     }
 
+    CompressionStats Client::getCompressionStats() {
+        std::lock_guard<std::mutex> lck(statsMtx);
+        CompressionStats s = stats;
+        stats.rawBytes = 0;
+        stats.compressedBytes = 0;
+        stats.packets = 0;
+        stats.compressTime = 0;
+        return s;
+    }
+
     void Client::worker() {
         while (true) {
             // Receive header
@@ -169,7 +292,12 @@ namespace server {
                 // TODO: Move to command handler
                 if (r_cmd_hdr->cmd == COMMAND_SET_SAMPLERATE && r_pkt_hdr->size == sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(double)) {
                     currentSampleRate = *(double*)r_cmd_data;
-                    core::setInputSampleRate(currentSampleRate);
+
+                    // Without the baseband, the samplerate of the stream is the one of the VFO
+                    if (baseband) { core::setInputSampleRate(currentSampleRate); }
+                }
+                else if (r_cmd_hdr->cmd == COMMAND_SET_CENTER_FREQUENCY && r_pkt_hdr->size == sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(double)) {
+                    centerFrequency = *(double*)r_cmd_data;
                 }
                 else if (r_cmd_hdr->cmd == COMMAND_DISCONNECT) {
                     flog::error("Asked to disconnect by the server");
@@ -177,42 +305,57 @@ namespace server {
 
                     // Cancel waiters
                     std::vector<PacketWaiter*> toBeRemoved;
-                    for (auto& [waiter, cmd] : commandAckWaiters) {
-                        waiter->cancel();
-                        toBeRemoved.push_back(waiter);
+                    {
+                        std::lock_guard<std::mutex> lck(waitersMtx);
+                        for (auto& [waiter, cmd] : commandAckWaiters) { toBeRemoved.push_back(waiter); }
+                        commandAckWaiters.clear();
                     }
-
-                    // Remove handled waiters
                     for (auto& waiter : toBeRemoved) {
-                        commandAckWaiters.erase(waiter);
+                        waiter->cancel();
                         delete waiter;
                     }
                 }
             }
             else if (r_pkt_hdr->type == PACKET_TYPE_COMMAND_ACK) {
-                // Notify waiters
+                // Take the waiters out first, a waiter registered once the first one is handled is waiting for the next ack
                 std::vector<PacketWaiter*> toBeRemoved;
-                for (auto& [waiter, cmd] : commandAckWaiters) {
-                    if (cmd != r_cmd_hdr->cmd) { continue; }
-                    waiter->notify();
-                    toBeRemoved.push_back(waiter);
+                {
+                    std::lock_guard<std::mutex> lck(waitersMtx);
+                    for (auto& [waiter, cmd] : commandAckWaiters) {
+                        if (cmd == r_cmd_hdr->cmd) { toBeRemoved.push_back(waiter); }
+                    }
+                    for (auto& waiter : toBeRemoved) { commandAckWaiters.erase(waiter); }
                 }
 
-                // Remove handled waiters
+                // Notify and delete handled waiters
                 for (auto& waiter : toBeRemoved) {
-                    commandAckWaiters.erase(waiter);
+                    waiter->notify();
                     delete waiter;
                 }
             }
-            else if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND) {
-                memcpy(decompIn.writeBuf, &rbuffer[sizeof(PacketHeader)], r_pkt_hdr->size - sizeof(PacketHeader));
-                if (!decompIn.swap(r_pkt_hdr->size - sizeof(PacketHeader))) { break; }
+            else if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND || r_pkt_hdr->type == PACKET_TYPE_BASEBAND_COMPRESSED || r_pkt_hdr->type == PACKET_TYPE_BASEBAND_STREAM) {
+                Compression compression = COMPRESSION_NONE;
+                if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND_COMPRESSED) { compression = COMPRESSION_BLOCK; }
+                else if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND_STREAM) { compression = COMPRESSION_STREAM; }
+                if (!writeSamples(&decompIn, r_pkt_data, r_pkt_hdr->size - sizeof(PacketHeader), compression, basebandCtx)) { break; }
             }
-            else if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND_COMPRESSED) {
-                size_t outCount = ZSTD_decompressDCtx(dctx, decompIn.writeBuf, STREAM_BUFFER_SIZE*sizeof(dsp::complex_t)+8, r_pkt_data, r_pkt_hdr->size - sizeof(PacketHeader));
-                if (outCount) {
-                    if (!decompIn.swap(outCount)) { break; }
-                };
+            else if (r_pkt_hdr->type == PACKET_TYPE_VFO && r_pkt_hdr->size >= sizeof(PacketHeader) + sizeof(VFOHeader)) {
+                VFOHeader* vhdr = (VFOHeader*)r_pkt_data;
+                std::shared_ptr<RemoteVFO> vfo;
+                {
+                    std::lock_guard<std::mutex> lck(vfoMtx);
+                    auto it = vfos.find(vhdr->id);
+                    if (it != vfos.end()) { vfo = it->second; }
+                }
+
+                // Packets of a VFO that was just removed are dropped
+                if (vfo) {
+                    writeSamples(&vfo->decompIn, &r_pkt_data[sizeof(VFOHeader)], r_pkt_hdr->size - sizeof(PacketHeader) - sizeof(VFOHeader), (Compression)vhdr->compressed, vfo->dctx);
+                }
+            }
+            else if (r_pkt_hdr->type == PACKET_TYPE_FFT) {
+                std::lock_guard<std::mutex> lck(fftMtx);
+                if (fftHandler) { fftHandler((float*)r_pkt_data, (r_pkt_hdr->size - sizeof(PacketHeader)) / sizeof(float), fftCtx); }
             }
             else if (r_pkt_hdr->type == PACKET_TYPE_ERROR) {
                 flog::error("SDR++ Server Error: {0}", rbuffer[sizeof(PacketHeader)]);
@@ -223,6 +366,50 @@ namespace server {
         }
     }
 
+    bool Client::writeSamples(dsp::stream<uint8_t>* stream, uint8_t* data, int len, Compression compression, ZSTD_DCtx* streamCtx) {
+        const size_t maxSize = STREAM_BUFFER_SIZE*sizeof(dsp::complex_t) + 8;
+        if (compression == COMPRESSION_NONE) {
+            if (len > maxSize) { return true; }
+            memcpy(stream->writeBuf, data, len);
+            return stream->swap(len);
+        }
+        else if (compression == COMPRESSION_BLOCK) {
+            size_t outCount = ZSTD_decompressDCtx(dctx, stream->writeBuf, maxSize, data, len);
+            if (!outCount || ZSTD_isError(outCount)) { return true; }
+            return stream->swap(outCount);
+        }
+        else if (compression != COMPRESSION_STREAM || len < sizeof(StreamHeader)) {
+            return true;
+        }
+
+        // The packet continues the zstd stream of the previous one unless the server started a new one
+        StreamHeader* shdr = (StreamHeader*)data;
+        if (shdr->reset) { ZSTD_DCtx_reset(streamCtx, ZSTD_reset_session_only); }
+        ZSTD_inBuffer in = { &data[sizeof(StreamHeader)], len - sizeof(StreamHeader), 0 };
+        ZSTD_outBuffer out = { stream->writeBuf, maxSize, 0 };
+        while (in.pos < in.size && out.pos < out.size) {
+            size_t ret = ZSTD_decompressStream(streamCtx, &out, &in);
+            if (ZSTD_isError(ret)) {
+                flog::error("Could not decompress samples: {0}", ZSTD_getErrorName(ret));
+                return true;
+            }
+        }
+
+        // Keep the stats for the menu
+        {
+            std::lock_guard<std::mutex> lck(statsMtx);
+            stats.rawBytes += shdr->rawSize;
+            stats.compressedBytes += len;
+            stats.packets++;
+            stats.level = shdr->level;
+            stats.compressTime += shdr->compressTime;
+            stats.dropped = shdr->dropped;
+        }
+
+        if (!out.pos) { return true; }
+        return stream->swap(out.pos);
+    }
+
     int Client::getUI() {
         if (!isOpen()) { return -1; }
         auto waiter = awaitCommandAck(COMMAND_GET_UI);
@@ -258,6 +445,7 @@ namespace server {
 
     PacketWaiter* Client::awaitCommandAck(Command cmd) {
         PacketWaiter* waiter = new PacketWaiter;
+        std::lock_guard<std::mutex> lck(waitersMtx);
         commandAckWaiters[waiter] = cmd;
         return waiter;
     }
@@ -71,6 +71,16 @@ namespace server {
         std::mutex handledMtx;
     };
 
+    // Compression of the samples as reported by the server with every packet
+    struct CompressionStats {
+        size_t rawBytes = 0;
+        size_t compressedBytes = 0;
+        int packets = 0;
+        int level = 0;
+        uint32_t compressTime = 0; // Total over the packets, in microseconds
+        uint32_t dropped = 0;
+    };
+
     class Client {
     public:
         Client(std::shared_ptr<net::Socket> sock, dsp::stream<dsp::complex_t>* out);
@@ -84,17 +94,45 @@ namespace server {
         void setSampleType(dsp::compression::PCMType type);
         void setCompression(bool enabled);
 
+        // Receive the full band, otherwise only the VFOs and FFT asked for are sent
+        void setBaseband(bool enabled);
+
+        // Frequency the server is tuned to, the VFO offsets are relative to it
+        double getCenterFrequency();
+
+        // Narrow channel extracted by the server, written to out. Returns false if the server refused it.
+        bool addVFO(uint32_t id, double sampleRate, double bandwidth, double offset, dsp::stream<dsp::complex_t>* out);
+        void removeVFO(uint32_t id);
+        void setVFOOffset(uint32_t id, double offset);
+        void setVFOSamplerate(uint32_t id, double sampleRate, double bandwidth);
+
+        // FFT lines computed by the server from the full band, a rate of 0 stops them
+        void setFFT(int size, double rate, void (*handler)(float* data, int size, void* ctx), void* ctx);
+
         void start();
         void stop();
 
         void close();
         bool isOpen();
 
+        // Returns the stats gathered since the last call
+        CompressionStats getCompressionStats();
+
         int bytes = 0;
         bool serverBusy = false;
 
     private:
+        struct RemoteVFO {
+            RemoteVFO() { dctx = ZSTD_createDCtx(); }
+            ~RemoteVFO() { ZSTD_freeDCtx(dctx); }
+            dsp::stream<uint8_t> decompIn;
+            dsp::compression::SampleStreamDecompressor decomp;
+            dsp::routing::StreamLink<dsp::complex_t> link;
+            ZSTD_DCtx* dctx; // State of the zstd stream, only used by the worker
+        };
+
         void worker();
+        bool writeSamples(dsp::stream<uint8_t>* stream, uint8_t* data, int len, Compression compression, ZSTD_DCtx* streamCtx);
 
         int getUI();
 
@@ -105,6 +143,7 @@ namespace server {
         PacketWaiter* awaitCommandAck(Command cmd);
         void commandAckHandled(PacketWaiter* waiter);
         std::map<PacketWaiter*, Command> commandAckWaiters;
+        std::mutex waitersMtx;
 
         static void dHandler(dsp::complex_t *data, int count, void *ctx);
 
@@ -132,10 +171,24 @@ namespace server {
         std::mutex dlMtx;
 
         ZSTD_DCtx* dctx;
+        ZSTD_DCtx* basebandCtx;
+
+        CompressionStats stats;
+        std::mutex statsMtx;
 
         std::thread workerThread;
 
+        // Kept alive by the worker while it writes to them
+        std::map<uint32_t, std::shared_ptr<RemoteVFO>> vfos;
+        std::mutex vfoMtx;
+
+        void (*fftHandler)(float* data, int size, void* ctx) = NULL;
+        void* fftCtx = NULL;
+        std::mutex fftMtx;
+
         double currentSampleRate = 1000000.0;
+        std::atomic<double> centerFrequency = 0.0;
+        std::atomic<bool> baseband = true;
     };
 
     std::shared_ptr<Client> connect(std::string host, uint16_t port, dsp::stream<dsp::complex_t>* out);